@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "guminvocationfilter.h"
+
+#include <gum/gumexceptor.h>
+#include <string.h>
+
+typedef guint GumInvocationPredicateKind;
+typedef struct _GumInvocationPredicate GumInvocationPredicate;
+
+enum _GumInvocationPredicateKind
+{
+  GUM_INVOCATION_PREDICATE_EQUALS,
+  GUM_INVOCATION_PREDICATE_IN,
+  GUM_INVOCATION_PREDICATE_MASKED,
+  GUM_INVOCATION_PREDICATE_PREFIX
+};
+
+struct _GumInvocationFilter
+{
+  GArray * predicates;
+  GumExceptor * exceptor;
+};
+
+struct _GumInvocationPredicate
+{
+  GumInvocationPredicateKind kind;
+  guint index;
+  guint width;
+  gboolean is_signed;
+
+  gsize mask;
+  gsize value;
+  GArray * values;
+  GBytes * prefix;
+};
+
+static gboolean gum_invocation_predicate_parse (GumInvocationPredicate * pred,
+    const gchar * line);
+static void gum_invocation_predicate_clear (GumInvocationPredicate * pred);
+static gboolean gum_invocation_predicate_matches (
+    const GumInvocationPredicate * pred, gsize arg, GumExceptor * exceptor);
+static gsize gum_invocation_predicate_narrow (
+    const GumInvocationPredicate * pred, gsize value);
+static gboolean gum_string_has_prefix (const gchar * str, GBytes * prefix,
+    GumExceptor * exceptor);
+
+static gboolean gum_parse_argument (const gchar * str,
+    GumInvocationPredicate * pred);
+static gboolean gum_parse_value (const gchar * str, gsize * value);
+static GBytes * gum_parse_hex_bytes (const gchar * str);
+
+/*
+ * Parses one predicate per line, all of which must hold for an invocation
+ * to match:
+ *
+ *   <arg> eq <value>
+ *   <arg> in <value>,<value>,...
+ *   <arg> mask <mask> <value>
+ *   <arg> prefix <hex-encoded bytes>
+ *
+ * Where <arg> is the zero-based argument index, optionally followed by a
+ * type of s8, u8, s16, u16, s32, u32, s64 or u64, e.g. "0:s32", and values
+ * are in hex. Without a type the full register is compared, so upper bits
+ * left undefined by the calling convention take part; with one, both the
+ * argument and the values are first truncated to that width and then
+ * zero- or sign-extended. The prefix predicate treats the argument as a
+ * pointer to a NUL-terminated string, does not accept a type, and does not
+ * match if that pointer is bad.
+ */
+GumInvocationFilter *
+gum_invocation_filter_new (const gchar * spec,
+                           GError ** error)
+{
+  GumInvocationFilter * filter;
+  gchar ** lines;
+  guint i;
+
+  filter = g_slice_new (GumInvocationFilter);
+  filter->predicates =
+      g_array_new (FALSE, FALSE, sizeof (GumInvocationPredicate));
+  g_array_set_clear_func (filter->predicates,
+      (GDestroyNotify) gum_invocation_predicate_clear);
+  filter->exceptor = NULL;
+
+  lines = g_strsplit (spec, "\n", -1);
+
+  for (i = 0; lines[i] != NULL; i++)
+  {
+    const gchar * line = lines[i];
+    GumInvocationPredicate pred = { 0, };
+
+    if (line[0] == '\0')
+      continue;
+
+    if (!gum_invocation_predicate_parse (&pred, line))
+      goto invalid_predicate;
+
+    if (pred.kind == GUM_INVOCATION_PREDICATE_PREFIX &&
+        filter->exceptor == NULL)
+    {
+      filter->exceptor = gum_exceptor_obtain ();
+    }
+
+    g_array_append_val (filter->predicates, pred);
+  }
+
+  g_strfreev (lines);
+
+  return filter;
+
+invalid_predicate:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
+        "invalid argument predicate: \"%s\"", lines[i]);
+
+    g_strfreev (lines);
+    gum_invocation_filter_free (filter);
+
+    return NULL;
+  }
+}
+
+void
+gum_invocation_filter_free (GumInvocationFilter * filter)
+{
+  if (filter == NULL)
+    return;
+
+  g_clear_object (&filter->exceptor);
+  g_array_free (filter->predicates, TRUE);
+
+  g_slice_free (GumInvocationFilter, filter);
+}
+
+gboolean
+gum_invocation_filter_matches (const GumInvocationFilter * self,
+                               GumInvocationContext * ic)
+{
+  guint i;
+
+  for (i = 0; i != self->predicates->len; i++)
+  {
+    const GumInvocationPredicate * pred =
+        &g_array_index (self->predicates, GumInvocationPredicate, i);
+    gsize arg;
+
+    arg = GPOINTER_TO_SIZE (
+        gum_invocation_context_get_nth_argument (ic, pred->index));
+
+    if (!gum_invocation_predicate_matches (pred, arg, self->exceptor))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gum_invocation_predicate_parse (GumInvocationPredicate * pred,
+                                const gchar * line)
+{
+  gboolean success = FALSE;
+  gchar ** tokens;
+  guint n;
+  const gchar * op;
+
+  tokens = g_strsplit (line, " ", -1);
+  n = g_strv_length (tokens);
+  if (n < 3)
+    goto beach;
+
+  if (!gum_parse_argument (tokens[0], pred))
+    goto beach;
+
+  op = tokens[1];
+  if (strcmp (op, "eq") == 0 && n == 3)
+  {
+    pred->kind = GUM_INVOCATION_PREDICATE_EQUALS;
+    success = gum_parse_value (tokens[2], &pred->value);
+  }
+  else if (strcmp (op, "in") == 0 && n == 3)
+  {
+    gchar ** elements;
+    guint i;
+
+    pred->kind = GUM_INVOCATION_PREDICATE_IN;
+    pred->values = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+    elements = g_strsplit (tokens[2], ",", -1);
+    success = elements[0] != NULL;
+    for (i = 0; elements[i] != NULL && success; i++)
+    {
+      gsize value;
+
+      success = gum_parse_value (elements[i], &value);
+      if (success)
+        g_array_append_val (pred->values, value);
+    }
+    g_strfreev (elements);
+  }
+  else if (strcmp (op, "mask") == 0 && n == 4)
+  {
+    pred->kind = GUM_INVOCATION_PREDICATE_MASKED;
+    success = gum_parse_value (tokens[2], &pred->mask) &&
+        gum_parse_value (tokens[3], &pred->value);
+  }
+  else if (strcmp (op, "prefix") == 0 && n == 3 && pred->width == 0)
+  {
+    pred->kind = GUM_INVOCATION_PREDICATE_PREFIX;
+    pred->prefix = gum_parse_hex_bytes (tokens[2]);
+    success = pred->prefix != NULL;
+  }
+
+  if (success)
+  {
+    pred->value = gum_invocation_predicate_narrow (pred, pred->value);
+    pred->mask = gum_invocation_predicate_narrow (pred, pred->mask);
+
+    if (pred->values != NULL)
+    {
+      guint i;
+
+      for (i = 0; i != pred->values->len; i++)
+      {
+        gsize * v = &g_array_index (pred->values, gsize, i);
+
+        *v = gum_invocation_predicate_narrow (pred, *v);
+      }
+    }
+  }
+
+beach:
+  g_strfreev (tokens);
+
+  if (!success)
+    gum_invocation_predicate_clear (pred);
+
+  return success;
+}
+
+static void
+gum_invocation_predicate_clear (GumInvocationPredicate * pred)
+{
+  g_clear_pointer (&pred->values, g_array_unref);
+  g_clear_pointer (&pred->prefix, g_bytes_unref);
+}
+
+static gboolean
+gum_invocation_predicate_matches (const GumInvocationPredicate * pred,
+                                  gsize arg,
+                                  GumExceptor * exceptor)
+{
+  arg = gum_invocation_predicate_narrow (pred, arg);
+
+  switch (pred->kind)
+  {
+    case GUM_INVOCATION_PREDICATE_EQUALS:
+      return arg == pred->value;
+    case GUM_INVOCATION_PREDICATE_IN:
+    {
+      guint i;
+
+      for (i = 0; i != pred->values->len; i++)
+      {
+        if (arg == g_array_index (pred->values, gsize, i))
+          return TRUE;
+      }
+
+      return FALSE;
+    }
+    case GUM_INVOCATION_PREDICATE_MASKED:
+      return (arg & pred->mask) == pred->value;
+    case GUM_INVOCATION_PREDICATE_PREFIX:
+      return gum_string_has_prefix (GSIZE_TO_POINTER (arg), pred->prefix,
+          exceptor);
+    default:
+      g_assert_not_reached ();
+  }
+
+  return FALSE;
+}
+
+static gsize
+gum_invocation_predicate_narrow (const GumInvocationPredicate * pred,
+                                 gsize value)
+{
+  if (pred->is_signed)
+  {
+    switch (pred->width)
+    {
+      case 8:
+        return (gsize) (gssize) (gint8) value;
+      case 16:
+        return (gsize) (gssize) (gint16) value;
+      case 32:
+        return (gsize) (gssize) (gint32) value;
+      default:
+        return value;
+    }
+  }
+  else
+  {
+    switch (pred->width)
+    {
+      case 8:
+        return (guint8) value;
+      case 16:
+        return (guint16) value;
+      case 32:
+        return (guint32) value;
+      default:
+        return value;
+    }
+  }
+}
+
+static gboolean
+gum_string_has_prefix (const gchar * str,
+                       GBytes * prefix,
+                       GumExceptor * exceptor)
+{
+  gboolean matches = FALSE;
+  const guint8 * expected;
+  gsize size;
+  GumExceptorScope scope;
+
+  if (str == NULL)
+    return FALSE;
+
+  expected = g_bytes_get_data (prefix, &size);
+
+  if (gum_exceptor_try (exceptor, &scope))
+  {
+    gsize i;
+
+    /* Compare byte by byte so we never read past the terminating NUL. */
+    for (i = 0; i != size && (guint8) str[i] == expected[i]; i++)
+      ;
+
+    matches = i == size;
+  }
+
+  if (gum_exceptor_catch (exceptor, &scope))
+    return FALSE;
+
+  return matches;
+}
+
+static gboolean
+gum_parse_argument (const gchar * str,
+                    GumInvocationPredicate * pred)
+{
+  guint64 index, width;
+  gchar * end;
+
+  index = g_ascii_strtoull (str, &end, 10);
+  if (end == str || index > G_MAXUINT8)
+    return FALSE;
+  pred->index = index;
+
+  if (*end == '\0')
+    return TRUE;
+
+  if (end[0] != ':' || (end[1] != 's' && end[1] != 'u'))
+    return FALSE;
+  pred->is_signed = end[1] == 's';
+
+  str = end + 2;
+  width = g_ascii_strtoull (str, &end, 10);
+  if (end == str || *end != '\0')
+    return FALSE;
+  if (width != 8 && width != 16 && width != 32 && width != 64)
+    return FALSE;
+  if (width > GLIB_SIZEOF_VOID_P * 8)
+    return FALSE;
+  pred->width = width;
+
+  return TRUE;
+}
+
+static gboolean
+gum_parse_value (const gchar * str,
+                 gsize * value)
+{
+  gchar * end;
+
+  if (!g_str_has_prefix (str, "0x"))
+    return FALSE;
+
+  *value = g_ascii_strtoull (str + 2, &end, 16);
+
+  return end != str + 2 && *end == '\0';
+}
+
+static GBytes *
+gum_parse_hex_bytes (const gchar * str)
+{
+  gsize length, size, i;
+  guint8 * data;
+
+  length = strlen (str);
+  if (length == 0 || length % 2 != 0)
+    return NULL;
+
+  size = length / 2;
+  data = g_malloc (size);
+
+  for (i = 0; i != size; i++)
+  {
+    gint upper, lower;
+
+    upper = g_ascii_xdigit_value (str[i * 2]);
+    lower = g_ascii_xdigit_value (str[(i * 2) + 1]);
+    if (upper == -1 || lower == -1)
+      goto invalid_hex;
+
+    data[i] = (upper << 4) | lower;
+    if (data[i] == 0)
+      goto invalid_hex;
+  }
+
+  return g_bytes_new_take (data, size);
+
+invalid_hex:
+  {
+    g_free (data);
+
+    return NULL;
+  }
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_INVOCATION_FILTER_H__
+#define __GUM_INVOCATION_FILTER_H__
+
+#include <gum/guminvocationcontext.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GumInvocationFilter GumInvocationFilter;
+
+GumInvocationFilter * gum_invocation_filter_new (const gchar * spec,
+    GError ** error);
+void gum_invocation_filter_free (GumInvocationFilter * filter);
+
+gboolean gum_invocation_filter_matches (const GumInvocationFilter * self,
+    GumInvocationContext * ic);
+
+G_END_DECLS
+
+#endif
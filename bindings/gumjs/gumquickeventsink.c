@@ -21,6 +21,8 @@ struct _GumQuickJSEventSink
   GArray * queue;
   guint queue_capacity;
   guint queue_drain_interval;
+  guint queue_high_water_mark;
+  gint drain_requested;
 
   GumQuickCore * core;
   GMainContext * main_context;
@@ -28,6 +30,7 @@ struct _GumQuickJSEventSink
   JSValue on_receive;
   JSValue on_call_summary;
   GSource * source;
+  GSource * wakeup;
 };
 
 struct _GumQuickNativeEventSink
@@ -52,6 +55,10 @@ static void gum_quick_js_event_sink_stop (GumEventSink * sink);
 static gboolean gum_quick_js_event_sink_stop_when_idle (
     GumQuickJSEventSink * self);
 static gboolean gum_quick_js_event_sink_drain (GumQuickJSEventSink * self);
+static gboolean gum_quick_js_event_sink_drain_on_wakeup (
+    GumQuickJSEventSink * self);
+static gboolean gum_quick_js_event_sink_dispatch_wakeup (GSource * source,
+    GSourceFunc callback, gpointer user_data);
 
 static void gum_quick_native_event_sink_iface_init (gpointer g_iface,
     gpointer iface_data);
@@ -60,6 +67,14 @@ static GumEventType gum_quick_native_event_sink_query_mask (
 static void gum_quick_native_event_sink_process (GumEventSink * sink,
     const GumEvent * event, GumCpuContext * cpu_context);
 
+static GSourceFuncs gum_quick_js_event_sink_wakeup_funcs =
+{
+  NULL,
+  NULL,
+  gum_quick_js_event_sink_dispatch_wakeup,
+  NULL,
+};
+
 G_DEFINE_TYPE_EXTENDED (GumQuickJSEventSink,
                         gum_quick_js_event_sink,
                         G_TYPE_OBJECT,
@@ -100,6 +115,8 @@ gum_quick_event_sink_new (JSContext * ctx,
         options->queue_capacity);
     sink->queue_capacity = options->queue_capacity;
     sink->queue_drain_interval = options->queue_drain_interval;
+    sink->queue_high_water_mark = MIN (options->queue_high_water_mark,
+        options->queue_capacity);
 
     g_object_ref (options->core->script);
     sink->core = options->core;
@@ -181,6 +198,7 @@ gum_quick_js_event_sink_finalize (GObject * obj)
   GumQuickJSEventSink * self = GUM_QUICK_JS_EVENT_SINK (obj);
 
   g_assert (self->source == NULL);
+  g_assert (self->wakeup == NULL);
 
   g_array_free (self->queue, TRUE);
 
@@ -205,6 +223,21 @@ gum_quick_js_event_sink_start (GumEventSink * sink)
         (GSourceFunc) gum_quick_js_event_sink_drain, g_object_ref (self),
         g_object_unref);
     g_source_attach (self->source, self->main_context);
+
+    /*
+     * Dispatched by process() through g_source_set_ready_time() once the
+     * queue fills up past the high-water mark, so bursts get drained right
+     * away instead of overflowing while waiting for the timer.
+     */
+    if (self->queue_high_water_mark != 0)
+    {
+      self->wakeup = g_source_new (&gum_quick_js_event_sink_wakeup_funcs,
+          sizeof (GSource));
+      g_source_set_callback (self->wakeup,
+          (GSourceFunc) gum_quick_js_event_sink_drain_on_wakeup,
+          g_object_ref (self), g_object_unref);
+      g_source_attach (self->wakeup, self->main_context);
+    }
   }
 }
 
@@ -214,11 +247,24 @@ gum_quick_js_event_sink_process (GumEventSink * sink,
                                  GumCpuContext * cpu_context)
 {
   GumQuickJSEventSink * self = GUM_QUICK_JS_EVENT_SINK_CAST (sink);
+  GSource * wakeup = NULL;
 
   gum_spinlock_acquire (&self->lock);
   if (self->queue->len != self->queue_capacity)
     g_array_append_val (self->queue, *event);
+  if (self->wakeup != NULL &&
+      self->queue->len >= self->queue_high_water_mark &&
+      g_atomic_int_compare_and_exchange (&self->drain_requested, FALSE, TRUE))
+  {
+    wakeup = g_source_ref (self->wakeup);
+  }
   gum_spinlock_release (&self->lock);
+
+  if (wakeup != NULL)
+  {
+    g_source_set_ready_time (wakeup, 0);
+    g_source_unref (wakeup);
+  }
 }
 
 static void
@@ -257,6 +303,8 @@ gum_quick_js_event_sink_stop (GumEventSink * sink)
 static gboolean
 gum_quick_js_event_sink_stop_when_idle (GumQuickJSEventSink * self)
 {
+  GSource * wakeup;
+
   gum_quick_js_event_sink_drain (self);
 
   g_object_ref (self);
@@ -268,6 +316,16 @@ gum_quick_js_event_sink_stop_when_idle (GumQuickJSEventSink * self)
     self->source = NULL;
   }
 
+  gum_spinlock_acquire (&self->lock);
+  wakeup = g_steal_pointer (&self->wakeup);
+  gum_spinlock_release (&self->lock);
+
+  if (wakeup != NULL)
+  {
+    g_source_destroy (wakeup);
+    g_source_unref (wakeup);
+  }
+
   gum_quick_js_event_sink_release_core (self);
 
   g_object_unref (self);
@@ -275,6 +333,23 @@ gum_quick_js_event_sink_stop_when_idle (GumQuickJSEventSink * self)
   return FALSE;
 }
 
+static gboolean
+gum_quick_js_event_sink_drain_on_wakeup (GumQuickJSEventSink * self)
+{
+  g_source_set_ready_time (self->wakeup, -1);
+  g_atomic_int_set (&self->drain_requested, FALSE);
+
+  return gum_quick_js_event_sink_drain (self);
+}
+
+static gboolean
+gum_quick_js_event_sink_dispatch_wakeup (GSource * source,
+                                         GSourceFunc callback,
+                                         gpointer user_data)
+{
+  return callback (user_data);
+}
+
 static gboolean
 gum_quick_js_event_sink_drain (GumQuickJSEventSink * self)
 {
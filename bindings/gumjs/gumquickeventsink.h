@@ -39,6 +39,7 @@ struct _GumQuickEventSinkOptions
 
   guint queue_capacity;
   guint queue_drain_interval;
+  guint queue_high_water_mark;
   JSValue on_receive;
   JSValue on_call_summary;
 
@@ -6,6 +6,7 @@
 
 #include "gumquickinterceptor.h"
 
+#include "guminvocationfilter.h"
 #include "gumquickmacros.h"
 
 #define GUM_QUICK_TYPE_INVOCATION_LISTENER \
@@ -81,6 +82,7 @@ struct _GumQuickJSCallListener
 
   JSValue on_enter;
   JSValue on_leave;
+  GumInvocationFilter * filter;
 };
 
 struct _GumQuickJSCallListenerClass
@@ -128,6 +130,7 @@ struct _GumQuickCProbeListenerClass
 struct _GumQuickInvocationState
 {
   GumQuickInvocationContext * jic;
+  gboolean filtered_out;
 };
 
 struct _GumQuickInvocationArgs
@@ -285,7 +288,7 @@ static void gum_quick_interceptor_release_invocation_retval (
 
 static const JSCFunctionListEntry gumjs_interceptor_entries[] =
 {
-  JS_CFUNC_DEF ("_attach", 3, gumjs_interceptor_attach),
+  JS_CFUNC_DEF ("_attach", 4, gumjs_interceptor_attach),
   JS_CFUNC_DEF ("detachAll", 0, gumjs_interceptor_detach_all),
   JS_CFUNC_DEF ("_replace", 0, gumjs_interceptor_replace),
   JS_CFUNC_DEF ("_replaceFast", 0, gumjs_interceptor_replace_fast),
@@ -485,14 +488,35 @@ GUMJS_DEFINE_FUNCTION (gumjs_interceptor_attach)
   JSValue target_val = args->elements[0];
   JSValue cb_val = args->elements[1];
   JSValue data_val = args->elements[2];
+  JSValue filter_val = args->elements[3];
   GumQuickInterceptor * self;
   gpointer target, cb_ptr;
+  GumInvocationFilter * filter = NULL;
   GumQuickInvocationListener * listener = NULL;
   gpointer listener_function_data;
   GumAttachReturn attach_ret;
 
   self = gumjs_get_parent_module (core);
 
+  if (!JS_IsUndefined (filter_val) && !JS_IsNull (filter_val))
+  {
+    const gchar * spec;
+    GError * error = NULL;
+
+    if (!_gum_quick_string_get (ctx, filter_val, &spec))
+      goto propagate_exception;
+
+    filter = gum_invocation_filter_new (spec, &error);
+
+    JS_FreeCString (ctx, spec);
+
+    if (error != NULL)
+    {
+      _gum_quick_throw_error (ctx, &error);
+      goto propagate_exception;
+    }
+  }
+
   if (JS_IsFunction (ctx, cb_val))
   {
     GumQuickJSProbeListener * l;
@@ -534,6 +558,7 @@ GUMJS_DEFINE_FUNCTION (gumjs_interceptor_attach)
       l = g_object_new (GUM_QUICK_TYPE_JS_CALL_LISTENER, NULL);
       l->on_enter = JS_DupValue (ctx, on_enter_js);
       l->on_leave = JS_DupValue (ctx, on_leave_js);
+      l->filter = g_steal_pointer (&filter);
 
       listener = GUM_QUICK_INVOCATION_LISTENER (l);
     }
@@ -553,6 +578,9 @@ GUMJS_DEFINE_FUNCTION (gumjs_interceptor_attach)
     }
   }
 
+  if (filter != NULL)
+    goto filter_unsupported;
+
   if (!JS_IsUndefined (data_val))
   {
     if (!_gum_quick_native_pointer_get (ctx, data_val, core,
@@ -611,8 +639,15 @@ expected_callback:
     _gum_quick_throw_literal (ctx, "expected at least one callback");
     goto propagate_exception;
   }
+filter_unsupported:
+  {
+    _gum_quick_throw_literal (ctx,
+        "argument predicates require onEnter and/or onLeave callbacks");
+    goto propagate_exception;
+  }
 propagate_exception:
   {
+    gum_invocation_filter_free (filter);
     g_clear_object (&listener);
 
     return JS_EXCEPTION;
@@ -900,6 +935,8 @@ gum_quick_js_call_listener_dispose (GObject * object)
   JS_FreeValue (ctx, self->on_leave);
   self->on_leave = JS_NULL;
 
+  g_clear_pointer (&self->filter, gum_invocation_filter_free);
+
   gum_quick_invocation_listener_release_wrapper (base_listener, ctx);
 
   _gum_quick_scope_leave (&scope);
@@ -917,6 +954,14 @@ gum_quick_js_call_listener_on_enter (GumInvocationListener * listener,
   self = GUM_QUICK_JS_CALL_LISTENER_CAST (listener);
   state = GUM_IC_GET_INVOCATION_DATA (ic, GumQuickInvocationState);
 
+  state->filtered_out = self->filter != NULL &&
+      !gum_invocation_filter_matches (self->filter, ic);
+  if (state->filtered_out)
+  {
+    state->jic = NULL;
+    return;
+  }
+
   if (!JS_IsNull (self->on_enter))
   {
     GumQuickInterceptor * parent;
@@ -973,6 +1018,9 @@ gum_quick_js_call_listener_on_leave (GumInvocationListener * listener,
   parent = GUM_QUICK_INVOCATION_LISTENER_CAST (listener)->parent;
   state = GUM_IC_GET_INVOCATION_DATA (ic, GumQuickInvocationState);
 
+  if (state->filtered_out)
+    return;
+
   if (!JS_IsNull (self->on_leave))
   {
     GumQuickScope scope;
@@ -8,6 +8,7 @@
 
 #include "gumquickeventsink.h"
 #include "gumquickmacros.h"
+#include "gumstalkerrules.h"
 
 #include <string.h>
 
@@ -85,6 +86,8 @@ GUMJS_DECLARE_SETTER (gumjs_stalker_set_queue_capacity)
 
 GUMJS_DECLARE_GETTER (gumjs_stalker_get_queue_drain_interval)
 GUMJS_DECLARE_SETTER (gumjs_stalker_set_queue_drain_interval)
+GUMJS_DECLARE_GETTER (gumjs_stalker_get_queue_high_water_mark)
+GUMJS_DECLARE_SETTER (gumjs_stalker_set_queue_high_water_mark)
 
 GUMJS_DECLARE_FUNCTION (gumjs_stalker_flush)
 GUMJS_DECLARE_FUNCTION (gumjs_stalker_garbage_collect)
@@ -165,6 +168,13 @@ static GumQuickProbeArgs * gum_quick_stalker_obtain_probe_args (
 static void gum_quick_stalker_release_probe_args (GumQuickStalker * self,
     GumQuickProbeArgs * args);
 
+static gboolean gum_quick_stalker_rules_get (JSContext * ctx,
+    JSValueConst val, GumQuickCore * core, GumStalkerRules ** rules);
+static gboolean gum_quick_stalker_rule_add (JSContext * ctx,
+    JSValueConst val, GumQuickCore * core, GumStalkerRules * rules);
+static gboolean gum_quick_stalker_rule_operands_get (JSContext * ctx,
+    JSValueConst val, GumQuickCore * core, GArray ** operands);
+
 static JSValue gum_encode_pointer (JSContext * ctx, gpointer value,
     gboolean stringify, GumQuickCore * core);
 
@@ -176,6 +186,9 @@ static const JSCFunctionListEntry gumjs_stalker_entries[] =
       gumjs_stalker_set_queue_capacity),
   JS_CGETSET_DEF ("queueDrainInterval", gumjs_stalker_get_queue_drain_interval,
       gumjs_stalker_set_queue_drain_interval),
+  JS_CGETSET_DEF ("queueHighWaterMark",
+      gumjs_stalker_get_queue_high_water_mark,
+      gumjs_stalker_set_queue_high_water_mark),
   JS_CFUNC_DEF ("flush", 0, gumjs_stalker_flush),
   JS_CFUNC_DEF ("garbageCollect", 0, gumjs_stalker_garbage_collect),
   JS_CFUNC_DEF ("_exclude", 0, gumjs_stalker_exclude),
@@ -247,6 +260,7 @@ _gum_quick_stalker_init (GumQuickStalker * self,
   self->stalker = NULL;
   self->queue_capacity = 16384;
   self->queue_drain_interval = 250;
+  self->queue_high_water_mark = 8192;
 
   self->flush_timer = NULL;
 
@@ -470,6 +484,23 @@ GUMJS_DEFINE_SETTER (gumjs_stalker_set_queue_drain_interval)
   return JS_UNDEFINED;
 }
 
+GUMJS_DEFINE_GETTER (gumjs_stalker_get_queue_high_water_mark)
+{
+  GumQuickStalker * self = gumjs_get_parent_module (core);
+
+  return JS_NewInt32 (ctx, self->queue_high_water_mark);
+}
+
+GUMJS_DEFINE_SETTER (gumjs_stalker_set_queue_high_water_mark)
+{
+  GumQuickStalker * self = gumjs_get_parent_module (core);
+
+  if (!_gum_quick_uint_get (ctx, val, &self->queue_high_water_mark))
+    return JS_EXCEPTION;
+
+  return JS_UNDEFINED;
+}
+
 GUMJS_DEFINE_FUNCTION (gumjs_stalker_flush)
 {
   GumStalker * stalker =
@@ -519,6 +550,7 @@ GUMJS_DEFINE_FUNCTION (gumjs_stalker_follow)
   GumStalkerTransformerCallback transformer_callback_c;
   GumQuickEventSinkOptions so;
   gpointer user_data;
+  JSValue rules_js;
   GumStalkerTransformer * transformer;
   GumEventSink * sink;
 
@@ -529,15 +561,26 @@ GUMJS_DEFINE_FUNCTION (gumjs_stalker_follow)
   so.main_context = gum_script_scheduler_get_js_context (core->scheduler);
   so.queue_capacity = parent->queue_capacity;
   so.queue_drain_interval = parent->queue_drain_interval;
+  so.queue_high_water_mark = parent->queue_high_water_mark;
 
-  if (!_gum_quick_args_parse (args, "ZF*?uF?F?pp", &thread_id,
+  if (!_gum_quick_args_parse (args, "ZF*?uF?F?ppA?", &thread_id,
       &transformer_callback_js, &transformer_callback_c, &so.event_mask,
-      &so.on_receive, &so.on_call_summary, &so.on_event, &user_data))
+      &so.on_receive, &so.on_call_summary, &so.on_event, &user_data,
+      &rules_js))
     return JS_EXCEPTION;
 
   so.user_data = user_data;
 
-  if (!JS_IsNull (transformer_callback_js))
+  if (!JS_IsNull (rules_js))
+  {
+    GumStalkerRules * rules;
+
+    if (!gum_quick_stalker_rules_get (ctx, rules_js, core, &rules))
+      return JS_EXCEPTION;
+
+    transformer = GUM_STALKER_TRANSFORMER (rules);
+  }
+  else if (!JS_IsNull (transformer_callback_js))
   {
     GumQuickTransformer * cbt;
 
@@ -1662,6 +1705,194 @@ gum_quick_stalker_release_probe_args (GumQuickStalker * self,
     JS_FreeValue (self->core->ctx, args->wrapper);
 }
 
+static gboolean
+gum_quick_stalker_rules_get (JSContext * ctx,
+                             JSValueConst val,
+                             GumQuickCore * core,
+                             GumStalkerRules ** rules)
+{
+  GumStalkerRules * result;
+  JSValue element = JS_NULL;
+  guint n, i;
+
+  if (!_gum_quick_array_get_length (ctx, val, core, &n))
+    return FALSE;
+
+  result = gum_stalker_rules_new ();
+
+  for (i = 0; i != n; i++)
+  {
+    element = JS_GetPropertyUint32 (ctx, val, i);
+    if (JS_IsException (element))
+      goto propagate_exception;
+
+    if (!gum_quick_stalker_rule_add (ctx, element, core, result))
+      goto propagate_exception;
+
+    JS_FreeValue (ctx, element);
+    element = JS_NULL;
+  }
+
+  *rules = result;
+  return TRUE;
+
+propagate_exception:
+  {
+    JS_FreeValue (ctx, element);
+    g_object_unref (result);
+
+    return FALSE;
+  }
+}
+
+static gboolean
+gum_quick_stalker_rule_add (JSContext * ctx,
+                            JSValueConst val,
+                            GumQuickCore * core,
+                            GumStalkerRules * rules)
+{
+  gboolean success = FALSE;
+  GumStalkerRuleDetails d = { NULL, };
+  const char * mnemonic = NULL;
+  JSValue v = JS_NULL;
+  GError * error = NULL;
+
+  if (!JS_IsObject (val))
+    goto expected_rule;
+
+  v = JS_GetPropertyStr (ctx, val, "mnemonic");
+  if (JS_IsException (v))
+    goto beach;
+  if (!JS_IsNull (v) && !_gum_quick_string_get (ctx, v, &mnemonic))
+    goto beach;
+  d.mnemonic = mnemonic;
+  JS_FreeValue (ctx, v);
+
+  v = JS_GetPropertyStr (ctx, val, "operands");
+  if (JS_IsException (v))
+    goto beach;
+  if (!JS_IsNull (v) &&
+      !gum_quick_stalker_rule_operands_get (ctx, v, core, &d.operands))
+    goto beach;
+  JS_FreeValue (ctx, v);
+
+  v = JS_GetPropertyStr (ctx, val, "ranges");
+  if (JS_IsException (v))
+    goto beach;
+  if (!JS_IsNull (v) && !_gum_quick_memory_ranges_get (ctx, v, core,
+      &d.ranges))
+    goto beach;
+  JS_FreeValue (ctx, v);
+
+  v = JS_GetPropertyStr (ctx, val, "count");
+  if (JS_IsException (v))
+    goto beach;
+  if (!JS_IsNull (v) && !_gum_quick_native_pointer_get (ctx, v, core,
+      (gpointer *) &d.counter))
+    goto beach;
+  JS_FreeValue (ctx, v);
+
+  v = JS_GetPropertyStr (ctx, val, "callout");
+  if (JS_IsException (v))
+    goto beach;
+  if (!JS_IsNull (v) && !_gum_quick_native_pointer_get (ctx, v, core,
+      (gpointer *) &d.callout))
+    goto beach;
+  JS_FreeValue (ctx, v);
+
+  v = JS_GetPropertyStr (ctx, val, "data");
+  if (JS_IsException (v))
+    goto beach;
+  if (!_gum_quick_native_pointer_get (ctx, v, core, &d.data))
+    goto beach;
+  JS_FreeValue (ctx, v);
+
+  v = JS_NULL;
+
+  if (!gum_stalker_rules_add (rules, &d, &error))
+  {
+    _gum_quick_throw_error (ctx, &error);
+    goto beach;
+  }
+
+  success = TRUE;
+  goto beach;
+
+expected_rule:
+  {
+    _gum_quick_throw_literal (ctx, "expected a rule object");
+    goto beach;
+  }
+beach:
+  {
+    JS_FreeValue (ctx, v);
+    if (mnemonic != NULL)
+      JS_FreeCString (ctx, mnemonic);
+    g_clear_pointer (&d.operands, g_array_unref);
+    g_clear_pointer (&d.ranges, g_array_unref);
+
+    return success;
+  }
+}
+
+static gboolean
+gum_quick_stalker_rule_operands_get (JSContext * ctx,
+                                     JSValueConst val,
+                                     GumQuickCore * core,
+                                     GArray ** operands)
+{
+  GArray * result;
+  JSValue element = JS_NULL;
+  const char * kind = NULL;
+  guint n, i;
+
+  if (!_gum_quick_array_get_length (ctx, val, core, &n))
+    return FALSE;
+
+  result = g_array_sized_new (FALSE, FALSE, sizeof (GumStalkerRuleOperand), n);
+
+  for (i = 0; i != n; i++)
+  {
+    GumStalkerRuleOperand op;
+
+    element = JS_GetPropertyUint32 (ctx, val, i);
+    if (JS_IsException (element))
+      goto propagate_exception;
+
+    if (!_gum_quick_string_get (ctx, element, &kind))
+      goto propagate_exception;
+
+    if (!gum_stalker_rule_operand_parse (kind, &op))
+      goto invalid_operand;
+    g_array_append_val (result, op);
+
+    JS_FreeCString (ctx, kind);
+    kind = NULL;
+
+    JS_FreeValue (ctx, element);
+    element = JS_NULL;
+  }
+
+  *operands = result;
+  return TRUE;
+
+invalid_operand:
+  {
+    _gum_quick_throw_literal (ctx,
+        "expected operands to be \"reg\", \"imm\", \"mem\", or \"*\"");
+    goto propagate_exception;
+  }
+propagate_exception:
+  {
+    if (kind != NULL)
+      JS_FreeCString (ctx, kind);
+    JS_FreeValue (ctx, element);
+    g_array_free (result, TRUE);
+
+    return FALSE;
+  }
+}
+
 static JSValue
 gum_encode_pointer (JSContext * ctx,
                     gpointer value,
@@ -25,6 +25,7 @@ struct _GumQuickStalker
   GumStalker * stalker;
   guint queue_capacity;
   guint queue_drain_interval;
+  guint queue_high_water_mark;
 
   GSource * flush_timer;
 
@@ -6,6 +6,13 @@
 
 #include "gumscriptscheduler.h"
 
+#define GUM_SCRIPT_WORKERS_MIN 4
+#define GUM_SCRIPT_WORKERS_MAX 16
+
+typedef struct _GumScriptRunQueue GumScriptRunQueue;
+typedef struct _GumScriptWorkerPool GumScriptWorkerPool;
+typedef struct _GumScriptWorker GumScriptWorker;
+
 struct _GumScriptScheduler
 {
   GObject parent;
@@ -18,7 +25,10 @@ struct _GumScriptScheduler
   GMainContext * js_context;
   volatile gint start_request_seqno;
 
-  GThreadPool * thread_pool;
+  GMutex js_lock;
+  GSList * js_queues;
+
+  GumScriptWorkerPool * worker_pool;
 };
 
 struct _GumScriptJob
@@ -28,17 +38,71 @@ struct _GumScriptJob
   GDestroyNotify data_destroy;
 
   GumScriptScheduler * scheduler;
+  gboolean free_when_done;
+};
+
+struct _GumScriptRunQueue
+{
+  GSource source;
+
+  gint priority;
+  GMutex * lock;
+  GQueue jobs;
+};
+
+struct _GumScriptWorkerPool
+{
+  GumScriptWorker * workers;
+  guint n_workers;
+  volatile gint n_started_workers;
+  volatile gint next_worker;
+
+  volatile gint n_pending_jobs;
+  volatile gint n_idle_workers;
+  GMutex idle_lock;
+  GCond idle_cond;
+  gboolean stopping;
+};
+
+struct _GumScriptWorker
+{
+  GumScriptWorkerPool * pool;
+  guint index;
+  GThread * thread;
+
+  GMutex lock;
+  GQueue jobs;
 };
 
 static void gum_script_scheduler_dispose (GObject * obj);
+static void gum_script_scheduler_finalize (GObject * obj);
+
+static void gum_script_scheduler_enqueue_js_job (GumScriptScheduler * self,
+    gint priority, GumScriptJob * job);
+static gboolean gum_script_run_queue_dispatch (GSource * source,
+    GSourceFunc callback, gpointer user_data);
+static void gum_script_run_queue_finalize (GSource * source);
 
-static gboolean gum_script_scheduler_perform_js_job (
+static GumScriptWorkerPool * gum_script_worker_pool_new (void);
+static void gum_script_worker_pool_free (GumScriptWorkerPool * pool);
+static void gum_script_worker_pool_push (GumScriptWorkerPool * pool,
     GumScriptJob * job);
-static void gum_script_scheduler_perform_pool_job (GumScriptJob * job,
-    GumScriptScheduler * self);
+static guint gum_script_worker_pool_maybe_grow (GumScriptWorkerPool * pool);
+static GumScriptJob * gum_script_worker_pool_take (GumScriptWorkerPool * pool,
+    GumScriptWorker * worker);
+static gpointer gum_script_worker_run (GumScriptWorker * worker);
 
 static gpointer gum_script_scheduler_run_js_loop (GumScriptScheduler * self);
 
+static GSourceFuncs gum_script_run_queue_funcs = {
+  NULL,
+  NULL,
+  gum_script_run_queue_dispatch,
+  gum_script_run_queue_finalize,
+};
+
+static GPrivate gum_script_worker_current;
+
 G_DEFINE_TYPE (GumScriptScheduler, gum_script_scheduler, G_TYPE_OBJECT)
 
 static void
@@ -47,6 +111,7 @@ gum_script_scheduler_class_init (GumScriptSchedulerClass * klass)
   GObjectClass * object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = gum_script_scheduler_dispose;
+  object_class->finalize = gum_script_scheduler_finalize;
 }
 
 static void
@@ -55,6 +120,8 @@ gum_script_scheduler_init (GumScriptScheduler * self)
   self->enable_background_thread = TRUE;
 
   self->js_context = g_main_context_new ();
+
+  g_mutex_init (&self->js_lock);
 }
 
 static void
@@ -64,16 +131,27 @@ gum_script_scheduler_dispose (GObject * obj)
 
   if (!self->disposed)
   {
+    GSList * queues, * cur;
+
     self->disposed = TRUE;
 
-    if (self->thread_pool != NULL)
-    {
-      g_thread_pool_free (self->thread_pool, FALSE, TRUE);
-      self->thread_pool = NULL;
-    }
+    g_clear_pointer (&self->worker_pool, gum_script_worker_pool_free);
 
     gum_script_scheduler_stop (self);
 
+    g_mutex_lock (&self->js_lock);
+    queues = g_steal_pointer (&self->js_queues);
+    g_mutex_unlock (&self->js_lock);
+
+    for (cur = queues; cur != NULL; cur = cur->next)
+    {
+      GSource * source = cur->data;
+
+      g_source_destroy (source);
+      g_source_unref (source);
+    }
+    g_slist_free (queues);
+
     g_main_context_unref (self->js_context);
     self->js_context = NULL;
   }
@@ -81,6 +159,16 @@ gum_script_scheduler_dispose (GObject * obj)
   G_OBJECT_CLASS (gum_script_scheduler_parent_class)->dispose (obj);
 }
 
+static void
+gum_script_scheduler_finalize (GObject * obj)
+{
+  GumScriptScheduler * self = GUM_SCRIPT_SCHEDULER (obj);
+
+  g_mutex_clear (&self->js_lock);
+
+  G_OBJECT_CLASS (gum_script_scheduler_parent_class)->finalize (obj);
+}
+
 GumScriptScheduler *
 gum_script_scheduler_new (void)
 {
@@ -150,18 +238,11 @@ gum_script_scheduler_push_job_on_js_thread (GumScriptScheduler * self,
                                             GDestroyNotify data_destroy)
 {
   GumScriptJob * job;
-  GSource * source;
 
   job = gum_script_job_new (self, func, data, data_destroy);
+  job->free_when_done = TRUE;
 
-  source = g_idle_source_new ();
-  g_source_set_priority (source, priority);
-  g_source_set_callback (source,
-      (GSourceFunc) gum_script_scheduler_perform_js_job,
-      job,
-      (GDestroyNotify) gum_script_job_free);
-  g_source_attach (source, self->js_context);
-  g_source_unref (source);
+  gum_script_scheduler_enqueue_js_job (self, priority, job);
 
   gum_script_scheduler_start (self);
 }
@@ -172,36 +253,304 @@ gum_script_scheduler_push_job_on_thread_pool (GumScriptScheduler * self,
                                               gpointer data,
                                               GDestroyNotify data_destroy)
 {
-  if (self->thread_pool == NULL)
+  GumScriptJob * job;
+
+  if (g_once_init_enter (&self->worker_pool))
+    g_once_init_leave (&self->worker_pool, gum_script_worker_pool_new ());
+
+  job = gum_script_job_new (self, func, data, data_destroy);
+  job->free_when_done = TRUE;
+
+  gum_script_worker_pool_push (self->worker_pool, job);
+}
+
+/*
+ * JS thread jobs go through one long-lived source per priority rather than
+ * an idle source each, so pushing a job is a queue append plus at most one
+ * wakeup of the JS thread.
+ */
+static void
+gum_script_scheduler_enqueue_js_job (GumScriptScheduler * self,
+                                     gint priority,
+                                     GumScriptJob * job)
+{
+  GumScriptRunQueue * queue = NULL;
+  GSList * cur;
+
+  g_mutex_lock (&self->js_lock);
+
+  for (cur = self->js_queues; cur != NULL; cur = cur->next)
   {
-    self->thread_pool = g_thread_pool_new (
-        (GFunc) gum_script_scheduler_perform_pool_job,
-        self,
-        4,
-        FALSE,
-        NULL);
+    GumScriptRunQueue * q = cur->data;
+
+    if (q->priority == priority)
+    {
+      queue = q;
+      break;
+    }
+  }
+
+  if (queue == NULL)
+  {
+    GSource * source;
+
+    source = g_source_new (&gum_script_run_queue_funcs,
+        sizeof (GumScriptRunQueue));
+    g_source_set_priority (source, priority);
+    g_source_set_can_recurse (source, TRUE);
+    g_source_set_name (source, "GumScriptRunQueue");
+
+    queue = (GumScriptRunQueue *) source;
+    queue->priority = priority;
+    queue->lock = &self->js_lock;
+    g_queue_init (&queue->jobs);
+
+    g_source_attach (source, self->js_context);
+
+    self->js_queues = g_slist_prepend (self->js_queues, queue);
   }
 
-  g_thread_pool_push (self->thread_pool,
-      gum_script_job_new (self, func, data, data_destroy),
-      NULL);
+  g_queue_push_tail (&queue->jobs, job);
+  if (queue->jobs.length == 1)
+    g_source_set_ready_time (&queue->source, 0);
+
+  g_mutex_unlock (&self->js_lock);
 }
 
 static gboolean
-gum_script_scheduler_perform_js_job (GumScriptJob * job)
+gum_script_run_queue_dispatch (GSource * source,
+                               GSourceFunc callback,
+                               gpointer user_data)
 {
-  job->func (job->data);
+  GumScriptRunQueue * self = (GumScriptRunQueue *) source;
+  guint remaining;
+
+  g_mutex_lock (self->lock);
+  remaining = self->jobs.length;
+  g_mutex_unlock (self->lock);
+
+  /*
+   * Only run what was queued when we got dispatched, so other sources get a
+   * chance between batches. Jobs are popped one at a time as a job may
+   * recurse into the main loop, e.g. through recv().wait().
+   */
+  while (remaining-- != 0)
+  {
+    GumScriptJob * job;
+
+    g_mutex_lock (self->lock);
+    job = g_queue_pop_head (&self->jobs);
+    if (self->jobs.length == 0)
+      g_source_set_ready_time (source, -1);
+    g_mutex_unlock (self->lock);
+
+    if (job == NULL)
+      break;
 
-  return FALSE;
+    job->func (job->data);
+
+    if (job->free_when_done)
+      gum_script_job_free (job);
+  }
+
+  return G_SOURCE_CONTINUE;
 }
 
 static void
-gum_script_scheduler_perform_pool_job (GumScriptJob * job,
-                                       GumScriptScheduler * self)
+gum_script_run_queue_finalize (GSource * source)
 {
-  job->func (job->data);
+  GumScriptRunQueue * self = (GumScriptRunQueue *) source;
+  GumScriptJob * job;
 
-  gum_script_job_free (job);
+  while ((job = g_queue_pop_head (&self->jobs)) != NULL)
+  {
+    if (job->free_when_done)
+      gum_script_job_free (job);
+  }
+}
+
+static GumScriptWorkerPool *
+gum_script_worker_pool_new (void)
+{
+  GumScriptWorkerPool * pool;
+  guint i;
+
+  pool = g_slice_new0 (GumScriptWorkerPool);
+  pool->n_workers = CLAMP (g_get_num_processors (), GUM_SCRIPT_WORKERS_MIN,
+      GUM_SCRIPT_WORKERS_MAX);
+  pool->workers = g_new0 (GumScriptWorker, pool->n_workers);
+  g_mutex_init (&pool->idle_lock);
+  g_cond_init (&pool->idle_cond);
+
+  for (i = 0; i != pool->n_workers; i++)
+  {
+    GumScriptWorker * worker = &pool->workers[i];
+
+    worker->pool = pool;
+    worker->index = i;
+    g_mutex_init (&worker->lock);
+    g_queue_init (&worker->jobs);
+  }
+
+  return pool;
+}
+
+static void
+gum_script_worker_pool_free (GumScriptWorkerPool * pool)
+{
+  guint i;
+
+  g_mutex_lock (&pool->idle_lock);
+  pool->stopping = TRUE;
+  g_cond_broadcast (&pool->idle_cond);
+  g_mutex_unlock (&pool->idle_lock);
+
+  for (i = 0; i != (guint) pool->n_started_workers; i++)
+    g_thread_join (pool->workers[i].thread);
+
+  for (i = 0; i != pool->n_workers; i++)
+    g_mutex_clear (&pool->workers[i].lock);
+  g_free (pool->workers);
+
+  g_cond_clear (&pool->idle_cond);
+  g_mutex_clear (&pool->idle_lock);
+
+  g_slice_free (GumScriptWorkerPool, pool);
+}
+
+static void
+gum_script_worker_pool_push (GumScriptWorkerPool * pool,
+                             GumScriptJob * job)
+{
+  GumScriptWorker * worker;
+  guint n_started;
+
+  n_started = gum_script_worker_pool_maybe_grow (pool);
+
+  worker = g_private_get (&gum_script_worker_current);
+  if (worker == NULL || worker->pool != pool)
+  {
+    guint index = (guint) g_atomic_int_add (&pool->next_worker, 1);
+
+    worker = &pool->workers[index % n_started];
+  }
+
+  g_mutex_lock (&worker->lock);
+  g_queue_push_tail (&worker->jobs, job);
+  g_mutex_unlock (&worker->lock);
+
+  g_atomic_int_inc (&pool->n_pending_jobs);
+
+  if (g_atomic_int_get (&pool->n_idle_workers) != 0)
+  {
+    g_mutex_lock (&pool->idle_lock);
+    g_cond_signal (&pool->idle_cond);
+    g_mutex_unlock (&pool->idle_lock);
+  }
+}
+
+/*
+ * Workers are started on demand: one for the first job, and another one
+ * whenever a job arrives while none of the running workers are idle.
+ */
+static guint
+gum_script_worker_pool_maybe_grow (GumScriptWorkerPool * pool)
+{
+  guint n_started;
+
+  n_started = g_atomic_int_get (&pool->n_started_workers);
+  if (n_started == pool->n_workers ||
+      (n_started != 0 && g_atomic_int_get (&pool->n_idle_workers) != 0))
+  {
+    return n_started;
+  }
+
+  g_mutex_lock (&pool->idle_lock);
+
+  n_started = pool->n_started_workers;
+  if (n_started != pool->n_workers &&
+      (n_started == 0 || g_atomic_int_get (&pool->n_idle_workers) == 0))
+  {
+    GumScriptWorker * worker = &pool->workers[n_started];
+
+    worker->thread = g_thread_new ("gum-js-worker",
+        (GThreadFunc) gum_script_worker_run, worker);
+
+    g_atomic_int_set (&pool->n_started_workers, ++n_started);
+  }
+
+  g_mutex_unlock (&pool->idle_lock);
+
+  return n_started;
+}
+
+static GumScriptJob *
+gum_script_worker_pool_take (GumScriptWorkerPool * pool,
+                             GumScriptWorker * worker)
+{
+  GumScriptJob * job;
+  guint n_started, i;
+
+  g_mutex_lock (&worker->lock);
+  job = g_queue_pop_head (&worker->jobs);
+  g_mutex_unlock (&worker->lock);
+
+  n_started = g_atomic_int_get (&pool->n_started_workers);
+
+  for (i = 1; job == NULL && i < n_started; i++)
+  {
+    GumScriptWorker * victim =
+        &pool->workers[(worker->index + i) % n_started];
+
+    g_mutex_lock (&victim->lock);
+    job = g_queue_pop_tail (&victim->jobs);
+    g_mutex_unlock (&victim->lock);
+  }
+
+  if (job != NULL)
+    g_atomic_int_add (&pool->n_pending_jobs, -1);
+
+  return job;
+}
+
+static gpointer
+gum_script_worker_run (GumScriptWorker * worker)
+{
+  GumScriptWorkerPool * pool = worker->pool;
+
+  g_private_set (&gum_script_worker_current, worker);
+
+  while (TRUE)
+  {
+    GumScriptJob * job;
+    gboolean done;
+
+    job = gum_script_worker_pool_take (pool, worker);
+    if (job != NULL)
+    {
+      job->func (job->data);
+      gum_script_job_free (job);
+      continue;
+    }
+
+    g_mutex_lock (&pool->idle_lock);
+
+    g_atomic_int_inc (&pool->n_idle_workers);
+    while (g_atomic_int_get (&pool->n_pending_jobs) <= 0 && !pool->stopping)
+      g_cond_wait (&pool->idle_cond, &pool->idle_lock);
+    g_atomic_int_add (&pool->n_idle_workers, -1);
+
+    done = pool->stopping && g_atomic_int_get (&pool->n_pending_jobs) <= 0;
+
+    g_mutex_unlock (&pool->idle_lock);
+
+    if (done)
+      break;
+  }
+
+  g_private_set (&gum_script_worker_current, NULL);
+
+  return NULL;
 }
 
 static gpointer
@@ -228,6 +577,7 @@ gum_script_job_new (GumScriptScheduler * scheduler,
   job->data_destroy = data_destroy;
 
   job->scheduler = scheduler;
+  job->free_when_done = FALSE;
 
   return job;
 }
@@ -252,15 +602,8 @@ gum_script_job_start_on_js_thread (GumScriptJob * job)
   }
   else
   {
-    GSource * source;
-
-    source = g_idle_source_new ();
-    g_source_set_callback (source,
-        (GSourceFunc) gum_script_scheduler_perform_js_job,
-        job,
-        NULL);
-    g_source_attach (source, js_context);
-    g_source_unref (source);
+    gum_script_scheduler_enqueue_js_job (job->scheduler,
+        G_PRIORITY_DEFAULT_IDLE, job);
 
     gum_script_scheduler_start (job->scheduler);
   }
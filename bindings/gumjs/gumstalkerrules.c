@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gumstalkerrules.h"
+
+#include <string.h>
+
+typedef struct _GumStalkerRule GumStalkerRule;
+
+struct _GumStalkerRules
+{
+  GObject parent;
+
+  GArray * rules;
+};
+
+struct _GumStalkerRule
+{
+  gchar * mnemonic;
+  GArray * operands;
+  GArray * ranges;
+
+  guint64 * counter;
+  GumStalkerCallout callout;
+  gpointer data;
+};
+
+static void gum_stalker_rules_iface_init (gpointer g_iface,
+    gpointer iface_data);
+static void gum_stalker_rules_finalize (GObject * object);
+static void gum_stalker_rules_transform_block (
+    GumStalkerTransformer * transformer, GumStalkerIterator * iterator,
+    GumStalkerOutput * output);
+static void gum_stalker_rules_put_increment (GumStalkerIterator * iterator,
+    GumStalkerOutput * output, guint64 * counter);
+
+static void gum_stalker_rule_clear (GumStalkerRule * rule);
+static gboolean gum_stalker_rule_matches (const GumStalkerRule * rule,
+    const cs_insn * insn);
+
+#if !defined (HAVE_I386) && !defined (HAVE_ARM64)
+static void gum_stalker_rules_increment_counter (GumCpuContext * cpu_context,
+    gpointer user_data);
+#endif
+
+static guint gum_count_operands (const cs_insn * insn);
+static GumStalkerRuleOperand gum_get_operand_kind (const cs_insn * insn,
+    guint index);
+
+G_DEFINE_TYPE_EXTENDED (GumStalkerRules,
+                        gum_stalker_rules,
+                        G_TYPE_OBJECT,
+                        0,
+                        G_IMPLEMENT_INTERFACE (GUM_TYPE_STALKER_TRANSFORMER,
+                            gum_stalker_rules_iface_init))
+
+#if !defined (HAVE_I386) && !defined (HAVE_ARM64) && GLIB_SIZEOF_VOID_P != 8
+G_LOCK_DEFINE_STATIC (gum_stalker_rules_counters);
+#endif
+
+static void
+gum_stalker_rules_class_init (GumStalkerRulesClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gum_stalker_rules_finalize;
+}
+
+static void
+gum_stalker_rules_iface_init (gpointer g_iface,
+                              gpointer iface_data)
+{
+  GumStalkerTransformerInterface * iface = g_iface;
+
+  iface->transform_block = gum_stalker_rules_transform_block;
+}
+
+static void
+gum_stalker_rules_init (GumStalkerRules * self)
+{
+  self->rules = g_array_new (FALSE, FALSE, sizeof (GumStalkerRule));
+  g_array_set_clear_func (self->rules,
+      (GDestroyNotify) gum_stalker_rule_clear);
+}
+
+static void
+gum_stalker_rules_finalize (GObject * object)
+{
+  GumStalkerRules * self = GUM_STALKER_RULES (object);
+
+  g_array_free (self->rules, TRUE);
+
+  G_OBJECT_CLASS (gum_stalker_rules_parent_class)->finalize (object);
+}
+
+GumStalkerRules *
+gum_stalker_rules_new (void)
+{
+  return g_object_new (GUM_TYPE_STALKER_RULES, NULL);
+}
+
+/*
+ * Adds a rule that applies to every instruction matching all of its criteria,
+ * where a NULL mnemonic, operands or ranges matches anything. Operands are
+ * GumStalkerRuleOperand values, ranges are GumMemoryRange values. A rule
+ * either bumps a 64-bit counter, which must be 8-byte aligned, or calls out.
+ */
+gboolean
+gum_stalker_rules_add (GumStalkerRules * self,
+                       const GumStalkerRuleDetails * details,
+                       GError ** error)
+{
+  GumStalkerRule rule;
+
+  if ((details->counter != NULL) == (details->callout != NULL))
+    goto invalid_action;
+
+  if (details->counter != NULL &&
+      GPOINTER_TO_SIZE (details->counter) % sizeof (guint64) != 0)
+  {
+    goto misaligned_counter;
+  }
+
+  rule.mnemonic = g_strdup (details->mnemonic);
+  rule.operands = (details->operands != NULL)
+      ? g_array_ref (details->operands)
+      : NULL;
+  rule.ranges = (details->ranges != NULL)
+      ? g_array_ref (details->ranges)
+      : NULL;
+
+  rule.counter = details->counter;
+  rule.callout = details->callout;
+  rule.data = details->data;
+
+  g_array_append_val (self->rules, rule);
+
+  return TRUE;
+
+invalid_action:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
+        "each rule must specify exactly one of count or callout");
+    return FALSE;
+  }
+misaligned_counter:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
+        "counters must be 8-byte aligned");
+    return FALSE;
+  }
+}
+
+gboolean
+gum_stalker_rule_operand_parse (const gchar * str,
+                                GumStalkerRuleOperand * operand)
+{
+  if (strcmp (str, "*") == 0)
+    *operand = GUM_STALKER_RULE_OPERAND_ANY;
+  else if (strcmp (str, "reg") == 0)
+    *operand = GUM_STALKER_RULE_OPERAND_REG;
+  else if (strcmp (str, "imm") == 0)
+    *operand = GUM_STALKER_RULE_OPERAND_IMM;
+  else if (strcmp (str, "mem") == 0)
+    *operand = GUM_STALKER_RULE_OPERAND_MEM;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+gum_stalker_rules_transform_block (GumStalkerTransformer * transformer,
+                                   GumStalkerIterator * iterator,
+                                   GumStalkerOutput * output)
+{
+  GumStalkerRules * self = GUM_STALKER_RULES (transformer);
+  const cs_insn * insn;
+
+  while (gum_stalker_iterator_next (iterator, &insn))
+  {
+    guint i;
+
+    /*
+     * Counters go first, as a callout leaves a prolog open that the inline
+     * increments have no business running inside of.
+     */
+    for (i = 0; i != self->rules->len; i++)
+    {
+      const GumStalkerRule * rule =
+          &g_array_index (self->rules, GumStalkerRule, i);
+
+      if (rule->counter != NULL && gum_stalker_rule_matches (rule, insn))
+        gum_stalker_rules_put_increment (iterator, output, rule->counter);
+    }
+
+    for (i = 0; i != self->rules->len; i++)
+    {
+      const GumStalkerRule * rule =
+          &g_array_index (self->rules, GumStalkerRule, i);
+
+      if (rule->callout != NULL && gum_stalker_rule_matches (rule, insn))
+        gum_stalker_iterator_put_callout (iterator, rule->callout, rule->data,
+            NULL);
+    }
+
+    gum_stalker_iterator_keep (iterator);
+  }
+}
+
+/*
+ * Counters are shared between threads, so the increment has to be atomic,
+ * and as it runs in the middle of application code it must leave both the
+ * registers and the flags as it found them.
+ */
+static void
+gum_stalker_rules_put_increment (GumStalkerIterator * iterator,
+                                 GumStalkerOutput * output,
+                                 guint64 * counter)
+{
+#if defined (HAVE_I386)
+  GumX86Writer * cw = output->writer.x86;
+
+  gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+      GUM_X86_XSP, -GUM_RED_ZONE_SIZE);
+  gum_x86_writer_put_pushfx (cw);
+  gum_x86_writer_put_push_reg (cw, GUM_X86_XAX);
+  gum_x86_writer_put_push_reg (cw, GUM_X86_XCX);
+
+  gum_x86_writer_put_mov_reg_address (cw, GUM_X86_XAX, GUM_ADDRESS (counter));
+  gum_x86_writer_put_mov_reg_u32 (cw, GUM_X86_ECX, 1);
+  gum_x86_writer_put_lock_xadd_reg_ptr_reg (cw, GUM_X86_XAX, GUM_X86_XCX);
+
+  if (cw->target_cpu == GUM_CPU_IA32)
+  {
+    gconstpointer done = cw->code + 1;
+
+    /* ECX holds the old low word, so carry into the high one on wrap. */
+    gum_x86_writer_put_inc_reg (cw, GUM_X86_ECX);
+    gum_x86_writer_put_jcc_short_label (cw, X86_INS_JNE, done, GUM_NO_HINT);
+    gum_x86_writer_put_mov_reg_address (cw, GUM_X86_EAX,
+        GUM_ADDRESS (counter) + 4);
+    gum_x86_writer_put_mov_reg_u32 (cw, GUM_X86_ECX, 1);
+    gum_x86_writer_put_lock_xadd_reg_ptr_reg (cw, GUM_X86_EAX, GUM_X86_ECX);
+    gum_x86_writer_put_label (cw, done);
+  }
+
+  gum_x86_writer_put_pop_reg (cw, GUM_X86_XCX);
+  gum_x86_writer_put_pop_reg (cw, GUM_X86_XAX);
+  gum_x86_writer_put_popfx (cw);
+  gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+      GUM_X86_XSP, GUM_RED_ZONE_SIZE);
+#elif defined (HAVE_ARM64)
+  GumArm64Writer * cw = output->writer.arm64;
+  gconstpointer retry = cw->code + 1;
+
+  /*
+   * An LDXR/STXR loop rather than LDADD, so it also works without LSE. None
+   * of these instructions touch NZCV.
+   */
+  gum_arm64_writer_put_stp_reg_reg_reg_offset (cw, ARM64_REG_X16,
+      ARM64_REG_X17, ARM64_REG_SP, -(16 + GUM_RED_ZONE_SIZE),
+      GUM_INDEX_PRE_ADJUST);
+  gum_arm64_writer_put_stp_reg_reg_reg_offset (cw, ARM64_REG_X14,
+      ARM64_REG_X15, ARM64_REG_SP, -16, GUM_INDEX_PRE_ADJUST);
+
+  gum_arm64_writer_put_ldr_reg_address (cw, ARM64_REG_X16,
+      GUM_ADDRESS (counter));
+
+  gum_arm64_writer_put_label (cw, retry);
+  /* ldxr x17, [x16] */
+  gum_arm64_writer_put_instruction (cw, 0xc85f7e11);
+  gum_arm64_writer_put_add_reg_reg_imm (cw, ARM64_REG_X17, ARM64_REG_X17, 1);
+  /* stxr w15, x17, [x16] */
+  gum_arm64_writer_put_instruction (cw, 0xc80f7e11);
+  gum_arm64_writer_put_cbnz_reg_label (cw, ARM64_REG_W15, retry);
+
+  gum_arm64_writer_put_ldp_reg_reg_reg_offset (cw, ARM64_REG_X14,
+      ARM64_REG_X15, ARM64_REG_SP, 16, GUM_INDEX_POST_ADJUST);
+  gum_arm64_writer_put_ldp_reg_reg_reg_offset (cw, ARM64_REG_X16,
+      ARM64_REG_X17, ARM64_REG_SP, 16 + GUM_RED_ZONE_SIZE,
+      GUM_INDEX_POST_ADJUST);
+#else
+  gum_stalker_iterator_put_callout (iterator,
+      gum_stalker_rules_increment_counter, counter, NULL);
+#endif
+}
+
+static void
+gum_stalker_rule_clear (GumStalkerRule * rule)
+{
+  g_clear_pointer (&rule->mnemonic, g_free);
+  g_clear_pointer (&rule->operands, g_array_unref);
+  g_clear_pointer (&rule->ranges, g_array_unref);
+}
+
+static gboolean
+gum_stalker_rule_matches (const GumStalkerRule * rule,
+                          const cs_insn * insn)
+{
+  if (rule->ranges != NULL)
+  {
+    gboolean in_range = FALSE;
+    guint i;
+
+    for (i = 0; i != rule->ranges->len && !in_range; i++)
+    {
+      const GumMemoryRange * r =
+          &g_array_index (rule->ranges, GumMemoryRange, i);
+
+      in_range = GUM_MEMORY_RANGE_INCLUDES (r, insn->address);
+    }
+
+    if (!in_range)
+      return FALSE;
+  }
+
+  if (rule->mnemonic != NULL && strcmp (insn->mnemonic, rule->mnemonic) != 0)
+    return FALSE;
+
+  if (rule->operands != NULL)
+  {
+    guint i;
+
+    if (gum_count_operands (insn) != rule->operands->len)
+      return FALSE;
+
+    for (i = 0; i != rule->operands->len; i++)
+    {
+      GumStalkerRuleOperand expected =
+          g_array_index (rule->operands, GumStalkerRuleOperand, i);
+
+      if (expected != GUM_STALKER_RULE_OPERAND_ANY &&
+          gum_get_operand_kind (insn, i) != expected)
+        return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+#if !defined (HAVE_I386) && !defined (HAVE_ARM64)
+
+static void
+gum_stalker_rules_increment_counter (GumCpuContext * cpu_context,
+                                     gpointer user_data)
+{
+#if GLIB_SIZEOF_VOID_P == 8
+  g_atomic_pointer_add ((gsize *) user_data, 1);
+#else
+  guint64 * counter = user_data;
+
+  G_LOCK (gum_stalker_rules_counters);
+  (*counter)++;
+  G_UNLOCK (gum_stalker_rules_counters);
+#endif
+}
+
+#endif
+
+static guint
+gum_count_operands (const cs_insn * insn)
+{
+#if defined (HAVE_I386)
+  return insn->detail->x86.op_count;
+#elif defined (HAVE_ARM)
+  return insn->detail->arm.op_count;
+#elif defined (HAVE_ARM64)
+  return insn->detail->arm64.op_count;
+#elif defined (HAVE_MIPS)
+  return insn->detail->mips.op_count;
+#else
+  return 0;
+#endif
+}
+
+static GumStalkerRuleOperand
+gum_get_operand_kind (const cs_insn * insn,
+                      guint index)
+{
+#if defined (HAVE_I386)
+  switch (insn->detail->x86.operands[index].type)
+  {
+    case X86_OP_REG: return GUM_STALKER_RULE_OPERAND_REG;
+    case X86_OP_IMM: return GUM_STALKER_RULE_OPERAND_IMM;
+    case X86_OP_MEM: return GUM_STALKER_RULE_OPERAND_MEM;
+    default:         return GUM_STALKER_RULE_OPERAND_OTHER;
+  }
+#elif defined (HAVE_ARM)
+  switch (insn->detail->arm.operands[index].type)
+  {
+    case ARM_OP_REG: return GUM_STALKER_RULE_OPERAND_REG;
+    case ARM_OP_IMM: return GUM_STALKER_RULE_OPERAND_IMM;
+    case ARM_OP_MEM: return GUM_STALKER_RULE_OPERAND_MEM;
+    default:         return GUM_STALKER_RULE_OPERAND_OTHER;
+  }
+#elif defined (HAVE_ARM64)
+  switch (insn->detail->arm64.operands[index].type)
+  {
+    case ARM64_OP_REG: return GUM_STALKER_RULE_OPERAND_REG;
+    case ARM64_OP_IMM: return GUM_STALKER_RULE_OPERAND_IMM;
+    case ARM64_OP_MEM: return GUM_STALKER_RULE_OPERAND_MEM;
+    default:           return GUM_STALKER_RULE_OPERAND_OTHER;
+  }
+#elif defined (HAVE_MIPS)
+  switch (insn->detail->mips.operands[index].type)
+  {
+    case MIPS_OP_REG: return GUM_STALKER_RULE_OPERAND_REG;
+    case MIPS_OP_IMM: return GUM_STALKER_RULE_OPERAND_IMM;
+    case MIPS_OP_MEM: return GUM_STALKER_RULE_OPERAND_MEM;
+    default:          return GUM_STALKER_RULE_OPERAND_OTHER;
+  }
+#else
+  return GUM_STALKER_RULE_OPERAND_OTHER;
+#endif
+}
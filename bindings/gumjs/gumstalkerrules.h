@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_STALKER_RULES_H__
+#define __GUM_STALKER_RULES_H__
+
+#include <gum/gumstalker.h>
+
+G_BEGIN_DECLS
+
+#define GUM_TYPE_STALKER_RULES (gum_stalker_rules_get_type ())
+G_DECLARE_FINAL_TYPE (GumStalkerRules, gum_stalker_rules, GUM, STALKER_RULES,
+    GObject)
+
+typedef struct _GumStalkerRuleDetails GumStalkerRuleDetails;
+typedef guint8 GumStalkerRuleOperand;
+
+enum _GumStalkerRuleOperand
+{
+  GUM_STALKER_RULE_OPERAND_ANY,
+  GUM_STALKER_RULE_OPERAND_REG,
+  GUM_STALKER_RULE_OPERAND_IMM,
+  GUM_STALKER_RULE_OPERAND_MEM,
+  GUM_STALKER_RULE_OPERAND_OTHER
+};
+
+struct _GumStalkerRuleDetails
+{
+  const gchar * mnemonic;
+  GArray * operands;
+  GArray * ranges;
+
+  guint64 * counter;
+  GumStalkerCallout callout;
+  gpointer data;
+};
+
+GumStalkerRules * gum_stalker_rules_new (void);
+
+gboolean gum_stalker_rules_add (GumStalkerRules * self,
+    const GumStalkerRuleDetails * details, GError ** error);
+
+gboolean gum_stalker_rule_operand_parse (const gchar * str,
+    GumStalkerRuleOperand * operand);
+
+G_END_DECLS
+
+#endif
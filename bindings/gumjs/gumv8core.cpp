@@ -265,6 +265,22 @@ GUMJS_DECLARE_FUNCTION (gumjs_native_pointer_to_uint32)
 GUMJS_DECLARE_FUNCTION (gumjs_native_pointer_to_string)
 GUMJS_DECLARE_FUNCTION (gumjs_native_pointer_to_json)
 GUMJS_DECLARE_FUNCTION (gumjs_native_pointer_to_match_pattern)
+#ifdef GUM_V8_HAVE_FAST_API_CALLS
+static bool gumjs_native_pointer_is_null_fast (Local<Object> receiver);
+static int32_t gumjs_native_pointer_compare_fast (Local<Object> receiver,
+    Local<Value> rhs, FastApiCallbackOptions & options);
+static int32_t gumjs_native_pointer_to_int32_fast (Local<Object> receiver);
+static uint32_t gumjs_native_pointer_to_uint32_fast (Local<Object> receiver);
+
+static const CFunction gumjs_native_pointer_is_null_fast_cfunction =
+    CFunction::Make (gumjs_native_pointer_is_null_fast);
+static const CFunction gumjs_native_pointer_compare_fast_cfunction =
+    CFunction::Make (gumjs_native_pointer_compare_fast);
+static const CFunction gumjs_native_pointer_to_int32_fast_cfunction =
+    CFunction::Make (gumjs_native_pointer_to_int32_fast);
+static const CFunction gumjs_native_pointer_to_uint32_fast_cfunction =
+    CFunction::Make (gumjs_native_pointer_to_uint32_fast);
+#endif
 
 GUMJS_DECLARE_FUNCTION (gumjs_array_buffer_wrap)
 GUMJS_DECLARE_FUNCTION (gumjs_array_buffer_unwrap)
@@ -450,7 +466,8 @@ static const GumV8Function gumjs_uint64_functions[] =
 
 static const GumV8Function gumjs_native_pointer_functions[] =
 {
-  { "isNull", gumjs_native_pointer_is_null },
+  { "isNull", gumjs_native_pointer_is_null,
+    GUM_V8_FAST_CALLBACK (gumjs_native_pointer_is_null_fast) },
   { "add", gumjs_native_pointer_add },
   { "sub", gumjs_native_pointer_sub },
   { "and", gumjs_native_pointer_and },
@@ -462,9 +479,12 @@ static const GumV8Function gumjs_native_pointer_functions[] =
   { "sign", gumjs_native_pointer_sign },
   { "strip", gumjs_native_pointer_strip },
   { "blend", gumjs_native_pointer_blend },
-  { "compare", gumjs_native_pointer_compare },
-  { "toInt32", gumjs_native_pointer_to_int32 },
-  { "toUInt32", gumjs_native_pointer_to_uint32 },
+  { "compare", gumjs_native_pointer_compare,
+    GUM_V8_FAST_CALLBACK (gumjs_native_pointer_compare_fast) },
+  { "toInt32", gumjs_native_pointer_to_int32,
+    GUM_V8_FAST_CALLBACK (gumjs_native_pointer_to_int32_fast) },
+  { "toUInt32", gumjs_native_pointer_to_uint32,
+    GUM_V8_FAST_CALLBACK (gumjs_native_pointer_to_uint32_fast) },
   { "toString", gumjs_native_pointer_to_string },
   { "toJSON", gumjs_native_pointer_to_json },
   { "toMatchPattern", gumjs_native_pointer_to_match_pattern },
@@ -2455,6 +2475,54 @@ GUMJS_DEFINE_FUNCTION (gumjs_native_pointer_to_uint32)
       GUMJS_NATIVE_POINTER_VALUE (info.Holder ())));
 }
 
+#ifdef GUM_V8_HAVE_FAST_API_CALLS
+
+static bool
+gumjs_native_pointer_is_null_fast (Local<Object> receiver)
+{
+  HandleScope handle_scope (Isolate::GetCurrent ());
+
+  return GUMJS_NATIVE_POINTER_VALUE (receiver) == NULL;
+}
+
+static int32_t
+gumjs_native_pointer_compare_fast (Local<Object> receiver,
+                                   Local<Value> rhs,
+                                   FastApiCallbackOptions & options)
+{
+  HandleScope handle_scope (Isolate::GetCurrent ());
+
+  gpointer rhs_ptr;
+  if (!_gum_v8_native_pointer_try_get_fast (rhs, &rhs_ptr))
+  {
+    options.fallback = true;
+    return 0;
+  }
+
+  gsize lhs = GPOINTER_TO_SIZE (GUMJS_NATIVE_POINTER_VALUE (receiver));
+  gsize rhs_value = GPOINTER_TO_SIZE (rhs_ptr);
+
+  return (lhs == rhs_value) ? 0 : ((lhs < rhs_value) ? -1 : 1);
+}
+
+static int32_t
+gumjs_native_pointer_to_int32_fast (Local<Object> receiver)
+{
+  HandleScope handle_scope (Isolate::GetCurrent ());
+
+  return (int32_t) GPOINTER_TO_SIZE (GUMJS_NATIVE_POINTER_VALUE (receiver));
+}
+
+static uint32_t
+gumjs_native_pointer_to_uint32_fast (Local<Object> receiver)
+{
+  HandleScope handle_scope (Isolate::GetCurrent ());
+
+  return (uint32_t) GPOINTER_TO_SIZE (GUMJS_NATIVE_POINTER_VALUE (receiver));
+}
+
+#endif
+
 GUMJS_DEFINE_FUNCTION (gumjs_native_pointer_to_string)
 {
   gint radix = 0;
@@ -25,6 +25,8 @@ struct _GumV8JSEventSink
   GArray * queue;
   guint queue_capacity;
   guint queue_drain_interval;
+  guint queue_high_water_mark;
+  gint drain_requested;
 
   GumV8Core * core;
   GMainContext * main_context;
@@ -32,6 +34,7 @@ struct _GumV8JSEventSink
   Global<Function> * on_receive;
   Global<Function> * on_call_summary;
   GSource * source;
+  GSource * wakeup;
 };
 
 struct _GumV8NativeEventSink
@@ -55,6 +58,9 @@ static void gum_v8_js_event_sink_flush (GumEventSink * sink);
 static void gum_v8_js_event_sink_stop (GumEventSink * sink);
 static gboolean gum_v8_js_event_sink_stop_when_idle (GumV8JSEventSink * self);
 static gboolean gum_v8_js_event_sink_drain (GumV8JSEventSink * self);
+static gboolean gum_v8_js_event_sink_drain_on_wakeup (GumV8JSEventSink * self);
+static gboolean gum_v8_js_event_sink_dispatch_wakeup (GSource * source,
+    GSourceFunc callback, gpointer user_data);
 
 static void gum_v8_native_event_sink_iface_init (gpointer g_iface,
     gpointer iface_data);
@@ -62,6 +68,14 @@ static GumEventType gum_v8_native_event_sink_query_mask (GumEventSink * sink);
 static void gum_v8_native_event_sink_process (GumEventSink * sink,
     const GumEvent * event, GumCpuContext * cpu_context);
 
+static GSourceFuncs gum_v8_js_event_sink_wakeup_funcs =
+{
+  NULL,
+  NULL,
+  gum_v8_js_event_sink_dispatch_wakeup,
+  NULL,
+};
+
 G_DEFINE_TYPE_EXTENDED (GumV8JSEventSink,
                         gum_v8_js_event_sink,
                         G_TYPE_OBJECT,
@@ -101,6 +115,8 @@ gum_v8_event_sink_new (const GumV8EventSinkOptions * options)
         options->queue_capacity);
     sink->queue_capacity = options->queue_capacity;
     sink->queue_drain_interval = options->queue_drain_interval;
+    sink->queue_high_water_mark = MIN (options->queue_high_water_mark,
+        options->queue_capacity);
 
     g_object_ref (options->core->script);
     sink->core = options->core;
@@ -185,6 +201,7 @@ gum_v8_js_event_sink_finalize (GObject * obj)
   auto self = GUM_V8_JS_EVENT_SINK (obj);
 
   g_assert (self->source == NULL);
+  g_assert (self->wakeup == NULL);
 
   g_array_free (self->queue, TRUE);
 
@@ -209,6 +226,16 @@ gum_v8_js_event_sink_start (GumEventSink * sink)
         (GSourceFunc) gum_v8_js_event_sink_drain, g_object_ref (self),
         g_object_unref);
     g_source_attach (self->source, self->main_context);
+
+    if (self->queue_high_water_mark != 0)
+    {
+      self->wakeup = g_source_new (&gum_v8_js_event_sink_wakeup_funcs,
+          sizeof (GSource));
+      g_source_set_callback (self->wakeup,
+          (GSourceFunc) gum_v8_js_event_sink_drain_on_wakeup,
+          g_object_ref (self), g_object_unref);
+      g_source_attach (self->wakeup, self->main_context);
+    }
   }
 }
 
@@ -218,11 +245,24 @@ gum_v8_js_event_sink_process (GumEventSink * sink,
                               GumCpuContext * cpu_context)
 {
   auto self = GUM_V8_JS_EVENT_SINK_CAST (sink);
+  GSource * wakeup = NULL;
 
   gum_spinlock_acquire (&self->lock);
   if (self->queue->len != self->queue_capacity)
     g_array_append_val (self->queue, *event);
+  if (self->wakeup != NULL &&
+      self->queue->len >= self->queue_high_water_mark &&
+      g_atomic_int_compare_and_exchange (&self->drain_requested, FALSE, TRUE))
+  {
+    wakeup = g_source_ref (self->wakeup);
+  }
   gum_spinlock_release (&self->lock);
+
+  if (wakeup != NULL)
+  {
+    g_source_set_ready_time (wakeup, 0);
+    g_source_unref (wakeup);
+  }
 }
 
 static void
@@ -270,6 +310,16 @@ gum_v8_js_event_sink_stop_when_idle (GumV8JSEventSink * self)
     self->source = NULL;
   }
 
+  gum_spinlock_acquire (&self->lock);
+  auto wakeup = (GSource *) g_steal_pointer (&self->wakeup);
+  gum_spinlock_release (&self->lock);
+
+  if (wakeup != NULL)
+  {
+    g_source_destroy (wakeup);
+    g_source_unref (wakeup);
+  }
+
   gum_v8_js_event_sink_release_core (self);
 
   g_object_unref (self);
@@ -277,6 +327,23 @@ gum_v8_js_event_sink_stop_when_idle (GumV8JSEventSink * self)
   return FALSE;
 }
 
+static gboolean
+gum_v8_js_event_sink_drain_on_wakeup (GumV8JSEventSink * self)
+{
+  g_source_set_ready_time (self->wakeup, -1);
+  g_atomic_int_set (&self->drain_requested, FALSE);
+
+  return gum_v8_js_event_sink_drain (self);
+}
+
+static gboolean
+gum_v8_js_event_sink_dispatch_wakeup (GSource * source,
+                                      GSourceFunc callback,
+                                      gpointer user_data)
+{
+  return callback (user_data);
+}
+
 static gboolean
 gum_v8_js_event_sink_drain (GumV8JSEventSink * self)
 {
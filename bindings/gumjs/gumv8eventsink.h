@@ -33,6 +33,7 @@ struct GumV8EventSinkOptions
 
   guint queue_capacity;
   guint queue_drain_interval;
+  guint queue_high_water_mark;
   v8::Local<v8::Function> on_receive;
   v8::Local<v8::Function> on_call_summary;
 
@@ -6,6 +6,7 @@
 
 #include "gumv8interceptor.h"
 
+#include "guminvocationfilter.h"
 #include "gumv8macros.h"
 #include "gumv8scope.h"
 
@@ -65,6 +66,7 @@ struct GumV8JSCallListener
 
   Global<Function> * on_enter;
   Global<Function> * on_leave;
+  GumInvocationFilter * filter;
 };
 
 struct GumV8JSCallListenerClass
@@ -112,6 +114,7 @@ struct GumV8CProbeListenerClass
 struct GumV8InvocationState
 {
   GumV8InvocationContext * jic;
+  gboolean filtered_out;
 };
 
 struct GumV8InvocationArgs
@@ -546,6 +549,7 @@ GUMJS_DEFINE_FUNCTION (gumjs_interceptor_attach)
 
   gpointer target;
   GumV8InvocationListener * listener;
+  GumV8JSCallListener * js_call_listener = NULL;
   auto target_val = info[0];
   auto callback_val = info[1];
   auto native_pointer = Local<FunctionTemplate>::New (isolate,
@@ -595,6 +599,7 @@ GUMJS_DEFINE_FUNCTION (gumjs_interceptor_attach)
         l->on_leave = new Global<Function> (isolate, on_leave_js);
 
       listener = GUM_V8_INVOCATION_LISTENER (l);
+      js_call_listener = l;
     }
     else if (on_enter_c != NULL || on_leave_c != NULL)
     {
@@ -615,6 +620,35 @@ GUMJS_DEFINE_FUNCTION (gumjs_interceptor_attach)
   listener->resource = new Global<Object> (isolate, callback_val.As<Object> ());
   listener->module = module;
 
+  auto filter_val = info[3];
+  if (!filter_val->IsUndefined () && !filter_val->IsNull ())
+  {
+    if (js_call_listener == NULL)
+    {
+      g_object_unref (listener);
+      _gum_v8_throw_ascii_literal (isolate,
+          "argument predicates require onEnter and/or onLeave callbacks");
+      return;
+    }
+
+    if (!filter_val->IsString ())
+    {
+      g_object_unref (listener);
+      _gum_v8_throw_ascii_literal (isolate,
+          "expected a string of argument predicates");
+      return;
+    }
+
+    String::Utf8Value spec (isolate, filter_val);
+    GError * error = NULL;
+    js_call_listener->filter = gum_invocation_filter_new (*spec, &error);
+    if (_gum_v8_maybe_throw (isolate, &error))
+    {
+      g_object_unref (listener);
+      return;
+    }
+  }
+
   gpointer listener_function_data;
   auto data_val = info[2];
   if (!data_val->IsUndefined ())
@@ -901,6 +935,8 @@ gum_v8_js_call_listener_dispose (GObject * object)
     gum_v8_invocation_listener_release_resource (base_listener);
   }
 
+  g_clear_pointer (&self->filter, gum_invocation_filter_free);
+
   G_OBJECT_CLASS (gum_v8_js_call_listener_parent_class)->dispose (object);
 }
 
@@ -911,6 +947,14 @@ gum_v8_js_call_listener_on_enter (GumInvocationListener * listener,
   auto self = GUM_V8_JS_CALL_LISTENER_CAST (listener);
   auto state = GUM_IC_GET_INVOCATION_DATA (ic, GumV8InvocationState);
 
+  state->filtered_out = self->filter != NULL &&
+      !gum_invocation_filter_matches (self->filter, ic);
+  if (state->filtered_out)
+  {
+    state->jic = NULL;
+    return;
+  }
+
   if (self->on_enter != nullptr)
   {
     auto module = GUM_V8_INVOCATION_LISTENER_CAST (listener)->module;
@@ -963,6 +1007,9 @@ gum_v8_js_call_listener_on_leave (GumInvocationListener * listener,
   auto core = module->core;
   auto state = GUM_IC_GET_INVOCATION_DATA (ic, GumV8InvocationState);
 
+  if (state->filtered_out)
+    return;
+
   if (self->on_leave != nullptr)
   {
     ScriptScope scope (core->script);
@@ -105,13 +105,76 @@ static gchar * gum_ansi_string_from_utf8 (const gchar * str_utf8);
     GUM_DEFINE_MEMORY_READ (T); \
     GUM_DEFINE_MEMORY_WRITE (T)
 
+#ifdef GUM_V8_HAVE_FAST_API_CALLS
+
+static GumExceptor * gum_v8_memory_exceptor = NULL;
+
+template<typename T, typename R>
+static R
+gum_v8_memory_read_fast (Local<Value> address,
+                         FastApiCallbackOptions & options)
+{
+  HandleScope handle_scope (Isolate::GetCurrent ());
+  gpointer ptr;
+  GumExceptorScope scope;
+  R result = 0;
+
+  if (!_gum_v8_native_pointer_try_get_fast (address, &ptr))
+    goto fallback;
+
+  if (gum_exceptor_try (gum_v8_memory_exceptor, &scope))
+  {
+    result = *((T *) ptr);
+  }
+
+  if (gum_exceptor_catch (gum_v8_memory_exceptor, &scope))
+    goto fallback;
+
+  return result;
+
+fallback:
+  {
+    options.fallback = true;
+    return 0;
+  }
+}
+
+# define GUM_DEFINE_MEMORY_READ_FAST(T, C, R) \
+    static R \
+    gumjs_memory_read_##T##_fast (Local<Object> receiver, \
+                                  Local<Value> address, \
+                                  FastApiCallbackOptions & options) \
+    { \
+      return gum_v8_memory_read_fast<C, R> (address, options); \
+    } \
+    \
+    static const CFunction gumjs_memory_read_##T##_fast_cfunction = \
+        CFunction::Make (gumjs_memory_read_##T##_fast)
+
+GUM_DEFINE_MEMORY_READ_FAST (S8, gint8, int32_t);
+GUM_DEFINE_MEMORY_READ_FAST (U8, guint8, uint32_t);
+GUM_DEFINE_MEMORY_READ_FAST (S16, gint16, int32_t);
+GUM_DEFINE_MEMORY_READ_FAST (U16, guint16, uint32_t);
+GUM_DEFINE_MEMORY_READ_FAST (S32, gint32, int32_t);
+GUM_DEFINE_MEMORY_READ_FAST (U32, guint32, uint32_t);
+GUM_DEFINE_MEMORY_READ_FAST (FLOAT, gfloat, double);
+GUM_DEFINE_MEMORY_READ_FAST (DOUBLE, gdouble, double);
+
+#endif
+
 #define GUMJS_EXPORT_MEMORY_READ(N, T) \
     { "read" N, gumjs_memory_read_##T }
+#define GUMJS_EXPORT_MEMORY_READ_FAST(N, T) \
+    { "read" N, gumjs_memory_read_##T, \
+      GUM_V8_FAST_CALLBACK (gumjs_memory_read_##T##_fast) }
 #define GUMJS_EXPORT_MEMORY_WRITE(N, T) \
     { "write" N, gumjs_memory_write_##T }
 #define GUMJS_EXPORT_MEMORY_READ_WRITE(N, T) \
     GUMJS_EXPORT_MEMORY_READ (N, T), \
     GUMJS_EXPORT_MEMORY_WRITE (N, T)
+#define GUMJS_EXPORT_MEMORY_READ_FAST_WRITE(N, T) \
+    GUMJS_EXPORT_MEMORY_READ_FAST (N, T), \
+    GUMJS_EXPORT_MEMORY_WRITE (N, T)
 
 GUM_DEFINE_MEMORY_READ_WRITE (POINTER)
 GUM_DEFINE_MEMORY_READ_WRITE (S8)
@@ -160,22 +223,22 @@ static const GumV8Function gumjs_memory_functions[] =
   { "_checkCodePointer", gumjs_memory_check_code_pointer },
 
   GUMJS_EXPORT_MEMORY_READ_WRITE ("Pointer", POINTER),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("S8", S8),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("U8", U8),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("S16", S16),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("U16", U16),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("S32", S32),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("U32", U32),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("S8", S8),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("U8", U8),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("S16", S16),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("U16", U16),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("S32", S32),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("U32", U32),
   GUMJS_EXPORT_MEMORY_READ_WRITE ("S64", S64),
   GUMJS_EXPORT_MEMORY_READ_WRITE ("U64", U64),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("Short", S16),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("UShort", U16),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("Int", S32),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("UInt", U32),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("Short", S16),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("UShort", U16),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("Int", S32),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("UInt", U32),
   GUMJS_EXPORT_MEMORY_READ_WRITE ("Long", LONG),
   GUMJS_EXPORT_MEMORY_READ_WRITE ("ULong", ULONG),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("Float", FLOAT),
-  GUMJS_EXPORT_MEMORY_READ_WRITE ("Double", DOUBLE),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("Float", FLOAT),
+  GUMJS_EXPORT_MEMORY_READ_FAST_WRITE ("Double", DOUBLE),
   GUMJS_EXPORT_MEMORY_READ_WRITE ("ByteArray", BYTE_ARRAY),
   GUMJS_EXPORT_MEMORY_READ ("CString", C_STRING),
   GUMJS_EXPORT_MEMORY_READ_WRITE ("Utf8String", UTF8_STRING),
@@ -210,6 +273,10 @@ _gum_v8_memory_init (GumV8Memory * self,
 
   self->core = core;
 
+#ifdef GUM_V8_HAVE_FAST_API_CALLS
+  gum_v8_memory_exceptor = core->exceptor;
+#endif
+
   auto module = External::New (isolate, self);
 
   auto memory = _gum_v8_create_module ("Memory", scope, isolate);
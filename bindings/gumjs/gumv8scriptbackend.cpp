@@ -23,8 +23,16 @@
 # define GUM_V8_PLATFORM_FLAGS
 #endif
 
+#ifdef GUM_V8_HAVE_FAST_API_CALLS
+# define GUM_V8_FAST_API_FLAGS \
+    "--turbo-fast-api-calls "
+#else
+# define GUM_V8_FAST_API_FLAGS
+#endif
+
 #define GUM_V8_FLAGS \
     GUM_V8_PLATFORM_FLAGS \
+    GUM_V8_FAST_API_FLAGS \
     "--no-freeze-flags-after-init " \
     "--turbo-instruction-scheduling " \
     "--use-strict " \
@@ -6,6 +6,7 @@
 
 #include "gumv8stalker.h"
 
+#include "gumstalkerrules.h"
 #include "gumv8eventsink.h"
 #include "gumv8macros.h"
 #include "gumv8scope.h"
@@ -97,6 +98,8 @@ GUMJS_DECLARE_SETTER (gumjs_stalker_set_queue_capacity)
 
 GUMJS_DECLARE_GETTER (gumjs_stalker_get_queue_drain_interval)
 GUMJS_DECLARE_SETTER (gumjs_stalker_set_queue_drain_interval)
+GUMJS_DECLARE_GETTER (gumjs_stalker_get_queue_high_water_mark)
+GUMJS_DECLARE_SETTER (gumjs_stalker_set_queue_high_water_mark)
 
 GUMJS_DECLARE_FUNCTION (gumjs_stalker_flush)
 GUMJS_DECLARE_FUNCTION (gumjs_stalker_garbage_collect)
@@ -176,6 +179,13 @@ static GumV8InstructionValue * gum_v8_stalker_obtain_instruction (
 static void gum_v8_stalker_release_instruction (GumV8Stalker * self,
     GumV8InstructionValue * value);
 
+static GumStalkerRules * gum_v8_stalker_rules_get (Local<Array> rules,
+    GumV8Core * core);
+static gboolean gum_v8_stalker_rule_add (Local<Value> value,
+    GumStalkerRules * rules, GumV8Core * core);
+static GArray * gum_v8_stalker_rule_operands_get (Local<Value> value,
+    GumV8Core * core);
+
 static Local<Value> gum_make_pointer (gpointer value, gboolean stringify,
     GumV8Core * core);
 
@@ -196,6 +206,11 @@ static const GumV8Property gumjs_stalker_values[] =
     gumjs_stalker_get_queue_drain_interval,
     gumjs_stalker_set_queue_drain_interval
   },
+  {
+    "queueHighWaterMark",
+    gumjs_stalker_get_queue_high_water_mark,
+    gumjs_stalker_set_queue_high_water_mark
+  },
 
   { NULL, NULL, NULL }
 };
@@ -263,6 +278,7 @@ _gum_v8_stalker_init (GumV8Stalker * self,
   self->stalker = NULL;
   self->queue_capacity = 16384;
   self->queue_drain_interval = 250;
+  self->queue_high_water_mark = 8192;
 
   self->flush_timer = NULL;
 
@@ -524,6 +540,20 @@ GUMJS_DEFINE_SETTER (gumjs_stalker_set_queue_drain_interval)
   module->queue_drain_interval = interval;
 }
 
+GUMJS_DEFINE_GETTER (gumjs_stalker_get_queue_high_water_mark)
+{
+  info.GetReturnValue ().Set (module->queue_high_water_mark);
+}
+
+GUMJS_DEFINE_SETTER (gumjs_stalker_set_queue_high_water_mark)
+{
+  guint mark;
+  if (!_gum_v8_uint_get (value, &mark, core))
+    return;
+
+  module->queue_high_water_mark = mark;
+}
+
 GUMJS_DEFINE_FUNCTION (gumjs_stalker_flush)
 {
   auto stalker = _gum_v8_stalker_get (module);
@@ -568,20 +598,30 @@ GUMJS_DEFINE_FUNCTION (gumjs_stalker_follow)
   so.main_context = gum_script_scheduler_get_js_context (core->scheduler);
   so.queue_capacity = module->queue_capacity;
   so.queue_drain_interval = module->queue_drain_interval;
+  so.queue_high_water_mark = module->queue_high_water_mark;
 
   gpointer user_data;
+  Local<Array> rules_js;
 
-  if (!_gum_v8_args_parse (args, "ZF*?uF?F?pp", &thread_id,
+  if (!_gum_v8_args_parse (args, "ZF*?uF?F?ppA?", &thread_id,
       &transformer_callback_js, &transformer_callback_c,
       &so.event_mask, &so.on_receive, &so.on_call_summary,
-      &so.on_event, &user_data))
+      &so.on_event, &user_data, &rules_js))
     return;
 
   so.user_data = user_data;
 
   GumStalkerTransformer * transformer = NULL;
 
-  if (!transformer_callback_js.IsEmpty ())
+  if (!rules_js.IsEmpty ())
+  {
+    auto rules = gum_v8_stalker_rules_get (rules_js, core);
+    if (rules == NULL)
+      return;
+
+    transformer = GUM_STALKER_TRANSFORMER (rules);
+  }
+  else if (!transformer_callback_js.IsEmpty ())
   {
     auto cbt = (GumV8CallbackTransformer *)
         g_object_new (GUM_V8_TYPE_CALLBACK_TRANSFORMER, NULL);
@@ -1466,6 +1506,164 @@ gum_v8_stalker_release_instruction (GumV8Stalker * self,
   }
 }
 
+static GumStalkerRules *
+gum_v8_stalker_rules_get (Local<Array> rules,
+                          GumV8Core * core)
+{
+  auto context = core->isolate->GetCurrentContext ();
+
+  auto result = gum_stalker_rules_new ();
+
+  guint n = rules->Length ();
+  for (guint i = 0; i != n; i++)
+  {
+    Local<Value> element;
+    if (!rules->Get (context, i).ToLocal (&element) ||
+        !gum_v8_stalker_rule_add (element, result, core))
+    {
+      g_object_unref (result);
+      return NULL;
+    }
+  }
+
+  return result;
+}
+
+static gboolean
+gum_v8_stalker_rule_add (Local<Value> value,
+                         GumStalkerRules * rules,
+                         GumV8Core * core)
+{
+  auto isolate = core->isolate;
+  auto context = isolate->GetCurrentContext ();
+
+  if (!value->IsObject ())
+  {
+    _gum_v8_throw_ascii_literal (isolate, "expected a rule object");
+    return FALSE;
+  }
+  auto rule = value.As<Object> ();
+
+  Local<Value> mnemonic_val, operands_val, ranges_val, count_val,
+      callout_val, data_val;
+  if (!rule->Get (context, _gum_v8_string_new_ascii (isolate, "mnemonic"))
+          .ToLocal (&mnemonic_val) ||
+      !rule->Get (context, _gum_v8_string_new_ascii (isolate, "operands"))
+          .ToLocal (&operands_val) ||
+      !rule->Get (context, _gum_v8_string_new_ascii (isolate, "ranges"))
+          .ToLocal (&ranges_val) ||
+      !rule->Get (context, _gum_v8_string_new_ascii (isolate, "count"))
+          .ToLocal (&count_val) ||
+      !rule->Get (context, _gum_v8_string_new_ascii (isolate, "callout"))
+          .ToLocal (&callout_val) ||
+      !rule->Get (context, _gum_v8_string_new_ascii (isolate, "data"))
+          .ToLocal (&data_val))
+    return FALSE;
+
+  GumStalkerRuleDetails d = { NULL, };
+  gboolean success = FALSE;
+  gchar * mnemonic = NULL;
+  GError * error = NULL;
+
+  if (!mnemonic_val->IsNull ())
+  {
+    if (!mnemonic_val->IsString ())
+    {
+      _gum_v8_throw_ascii_literal (isolate, "expected a string mnemonic");
+      goto beach;
+    }
+    String::Utf8Value mnemonic_utf8 (isolate, mnemonic_val);
+    mnemonic = g_strdup (*mnemonic_utf8);
+    d.mnemonic = mnemonic;
+  }
+
+  if (!operands_val->IsNull ())
+  {
+    d.operands = gum_v8_stalker_rule_operands_get (operands_val, core);
+    if (d.operands == NULL)
+      goto beach;
+  }
+
+  if (!ranges_val->IsNull ())
+  {
+    d.ranges = _gum_v8_memory_ranges_get (ranges_val, core);
+    if (d.ranges == NULL)
+      goto beach;
+  }
+
+  if (!count_val->IsNull () &&
+      !_gum_v8_native_pointer_get (count_val, (gpointer *) &d.counter, core))
+    goto beach;
+
+  if (!callout_val->IsNull () &&
+      !_gum_v8_native_pointer_get (callout_val, (gpointer *) &d.callout, core))
+    goto beach;
+
+  if (!_gum_v8_native_pointer_get (data_val, &d.data, core))
+    goto beach;
+
+  success = gum_stalker_rules_add (rules, &d, &error);
+  _gum_v8_maybe_throw (isolate, &error);
+
+beach:
+  g_clear_pointer (&d.ranges, g_array_unref);
+  g_clear_pointer (&d.operands, g_array_unref);
+  g_free (mnemonic);
+
+  return success;
+}
+
+static GArray *
+gum_v8_stalker_rule_operands_get (Local<Value> value,
+                                  GumV8Core * core)
+{
+  auto isolate = core->isolate;
+  auto context = isolate->GetCurrentContext ();
+
+  if (!value->IsArray ())
+  {
+    _gum_v8_throw_ascii_literal (isolate, "expected an array of operands");
+    return NULL;
+  }
+  auto operands = value.As<Array> ();
+
+  guint n = operands->Length ();
+  auto result = g_array_sized_new (FALSE, FALSE,
+      sizeof (GumStalkerRuleOperand), n);
+
+  for (guint i = 0; i != n; i++)
+  {
+    Local<Value> element;
+    if (!operands->Get (context, i).ToLocal (&element))
+      goto propagate_exception;
+
+    GumStalkerRuleOperand op;
+    if (!element->IsString ())
+      goto invalid_operand;
+    {
+      String::Utf8Value kind (isolate, element);
+      if (!gum_stalker_rule_operand_parse (*kind, &op))
+        goto invalid_operand;
+    }
+    g_array_append_val (result, op);
+  }
+
+  return result;
+
+invalid_operand:
+  {
+    _gum_v8_throw_ascii_literal (isolate,
+        "expected operands to be \"reg\", \"imm\", \"mem\", or \"*\"");
+    goto propagate_exception;
+  }
+propagate_exception:
+  {
+    g_array_free (result, TRUE);
+
+    return NULL;
+  }
+}
+
 static Local<Value>
 gum_make_pointer (gpointer value,
                   gboolean stringify,
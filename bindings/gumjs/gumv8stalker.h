@@ -23,6 +23,7 @@ struct GumV8Stalker
   GumStalker * stalker;
   guint queue_capacity;
   guint queue_drain_interval;
+  guint queue_high_water_mark;
 
   GSource * flush_timer;
 
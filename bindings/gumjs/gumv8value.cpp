@@ -7,6 +7,8 @@
 
 #include "gumv8value.h"
 
+#include "gumv8script-priv.h"
+
 #include <string.h>
 #include <string>
 
@@ -95,6 +97,9 @@ static void gum_v8_kernel_resource_on_weak_notify (
     const WeakCallbackInfo<GumV8KernelResource> & info);
 
 static const gchar * gum_exception_type_to_string (GumExceptionType type);
+static Local<FunctionTemplate> gum_v8_function_template_new (
+    const GumV8Function * func, Local<External> module,
+    Local<Signature> signature, Isolate * isolate);
 
 static void gum_cpu_context_on_weak_notify (
     const WeakCallbackInfo<GumCpuContextWrapper> & info);
@@ -1227,6 +1232,35 @@ _gum_v8_native_pointer_get (Local<Value> value,
   return TRUE;
 }
 
+/*
+ * Only recognizes actual NativePointer instances, without touching the JS
+ * heap, so that it can be used from Fast API callbacks. Anything else is
+ * left to the regular callback. Int64 and UInt64 share the same layout, so
+ * we have to check the template rather than the internal field.
+ */
+gboolean
+_gum_v8_native_pointer_try_get_fast (Local<Value> value,
+                                     gpointer * ptr)
+{
+  if (!value->IsObject ())
+    return FALSE;
+
+  auto isolate = Isolate::GetCurrent ();
+  auto script = (GumV8Script *) isolate->GetData (0);
+  auto native_pointer = Local<FunctionTemplate>::New (isolate,
+      *script->core.native_pointer);
+  if (!native_pointer->HasInstance (value))
+    return FALSE;
+
+  auto field = value.As<Object> ()->GetInternalField (0).As<Value> ();
+  if (!field->IsBigInt ())
+    return FALSE;
+
+  *ptr = GSIZE_TO_POINTER (field.As<BigInt> ()->Uint64Value ());
+
+  return TRUE;
+}
+
 gboolean
 _gum_v8_native_pointer_parse (Local<Value> value,
                               gpointer * ptr,
@@ -1887,11 +1921,26 @@ _gum_v8_module_add (Local<External> module,
   while (func->name != NULL)
   {
     object->Set (_gum_v8_string_new_ascii (isolate, func->name),
-        FunctionTemplate::New (isolate, func->callback, module));
+        gum_v8_function_template_new (func, module, Local<Signature> (),
+            isolate));
     func++;
   }
 }
 
+static Local<FunctionTemplate>
+gum_v8_function_template_new (const GumV8Function * func,
+                              Local<External> module,
+                              Local<Signature> signature,
+                              Isolate * isolate)
+{
+  if (func->fast_callback == nullptr)
+    return FunctionTemplate::New (isolate, func->callback, module);
+
+  return FunctionTemplate::New (isolate, func->callback, module, signature, 0,
+      ConstructorBehavior::kThrow, SideEffectType::kHasSideEffect,
+      func->fast_callback);
+}
+
 Local<FunctionTemplate>
 _gum_v8_create_class (const gchar * name,
                       FunctionCallback ctor,
@@ -1933,7 +1982,8 @@ _gum_v8_class_add_static (Local<FunctionTemplate> klass,
   while (func->name != NULL)
   {
     klass->Set (_gum_v8_string_new_ascii (isolate, func->name),
-        FunctionTemplate::New (isolate, func->callback, module));
+        gum_v8_function_template_new (func, module, Local<Signature> (),
+            isolate));
     func++;
   }
 }
@@ -1962,12 +2012,13 @@ _gum_v8_class_add (Local<FunctionTemplate> klass,
                    Isolate * isolate)
 {
   auto proto = klass->PrototypeTemplate ();
+  auto signature = Signature::New (isolate, klass);
 
   auto func = functions;
   while (func->name != NULL)
   {
     proto->Set (_gum_v8_string_new_ascii (isolate, func->name),
-        FunctionTemplate::New (isolate, func->callback, module));
+        gum_v8_function_template_new (func, module, signature, isolate));
     func++;
   }
 }
@@ -9,6 +9,20 @@
 
 #include "gumv8core.h"
 
+#include <v8-fast-api-calls.h>
+
+/*
+ * Fast API callbacks bail out to the regular callback through
+ * FastApiCallbackOptions::fallback, e.g. on bad pointers or faults, which
+ * later V8 versions no longer offer.
+ */
+#if V8_MAJOR_VERSION < 12 || (V8_MAJOR_VERSION == 12 && V8_MINOR_VERSION < 9)
+# define GUM_V8_HAVE_FAST_API_CALLS 1
+# define GUM_V8_FAST_CALLBACK(N) (&N##_cfunction)
+#else
+# define GUM_V8_FAST_CALLBACK(N) nullptr
+#endif
+
 struct GumV8Args
 {
   const v8::FunctionCallbackInfo<v8::Value> * info;
@@ -26,6 +40,7 @@ struct GumV8Function
 {
   const gchar * name;
   v8::FunctionCallback callback;
+  const v8::CFunction * fast_callback;
 };
 
 G_GNUC_INTERNAL gboolean _gum_v8_args_parse (const GumV8Args * args,
@@ -94,6 +109,8 @@ G_GNUC_INTERNAL gboolean _gum_v8_native_pointer_get (
     v8::Local<v8::Value> value, gpointer * ptr, GumV8Core * core);
 G_GNUC_INTERNAL gboolean _gum_v8_native_pointer_parse (
     v8::Local<v8::Value> value, gpointer * ptr, GumV8Core * core);
+G_GNUC_INTERNAL gboolean _gum_v8_native_pointer_try_get_fast (
+    v8::Local<v8::Value> value, gpointer * ptr);
 
 G_GNUC_INTERNAL void _gum_v8_throw (v8::Isolate * isolate, const gchar * format,
     ...);
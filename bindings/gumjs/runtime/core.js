@@ -472,12 +472,84 @@ if (Process.findRangeByAddress === undefined) {
 }
 
 if (globalThis.Interceptor !== undefined) {
+  /*
+   * Without a type, equals, in and mask look at the full register, upper bits
+   * included, so e.g. an int argument should be given `type: 'int'` to have
+   * it truncated to 32 bits and sign-extended before being compared.
+   */
+  const argumentPredicateTypes = {
+    pointer: '',
+    int8: ':s8',
+    uint8: ':u8',
+    int16: ':s16',
+    uint16: ':u16',
+    int: ':s32',
+    uint: ':u32',
+    int32: ':s32',
+    uint32: ':u32',
+    int64: ':s64',
+    uint64: ':u64',
+  };
+
+  function compileArgumentPredicate(predicate) {
+    if (predicate === null || typeof predicate !== 'object')
+      throw new Error('argument predicates must be objects');
+
+    const { arg } = predicate;
+    if (!Number.isInteger(arg) || arg < 0 || arg > 255)
+      throw new Error('invalid argument index');
+
+    let argSpec = arg;
+    if ('type' in predicate) {
+      const { type } = predicate;
+      if (!argumentPredicateTypes.hasOwnProperty(type))
+        throw new Error('invalid argument type');
+      if ((type === 'int64' || type === 'uint64') && Process.pointerSize !== 8)
+        throw new Error('64-bit argument types require a 64-bit process');
+      argSpec = `${arg}${argumentPredicateTypes[type]}`;
+    }
+
+    if ('equals' in predicate)
+      return `${argSpec} eq ${ptr(predicate.equals)}`;
+
+    if ('in' in predicate) {
+      const values = predicate.in;
+      if (!Array.isArray(values) || values.length === 0)
+        throw new Error('in must be a non-empty array');
+      return `${argSpec} in ${values.map(v => ptr(v).toString()).join(',')}`;
+    }
+
+    if ('mask' in predicate)
+      return `${argSpec} mask ${ptr(predicate.mask)} ${ptr(predicate.value)}`;
+
+    if ('startsWith' in predicate) {
+      if ('type' in predicate)
+        throw new Error('startsWith does not take a type');
+      const prefix = predicate.startsWith;
+      if (typeof prefix !== 'string' || prefix.length === 0)
+        throw new Error('startsWith must be a non-empty string');
+      const hex = Array.from(unescape(encodeURIComponent(prefix)))
+          .map(c => c.charCodeAt(0).toString(16).padStart(2, '0'))
+          .join('');
+      return `${arg} prefix ${hex}`;
+    }
+
+    throw new Error('expected one of equals, in, mask, or startsWith');
+  }
+
   Object.defineProperties(Interceptor, {
     attach: {
       enumerable: true,
       value: function (target, callbacks, data) {
         Memory._checkCodePointer(target);
-        return Interceptor._attach(target, callbacks, data);
+
+        let predicates = null;
+        if (callbacks !== null && typeof callbacks === 'object' &&
+            Array.isArray(callbacks.when)) {
+          predicates = callbacks.when.map(compileArgumentPredicate).join('\n');
+        }
+
+        return Interceptor._attach(target, callbacks, data, predicates);
       }
     },
     replace: {
@@ -506,6 +578,45 @@ if (globalThis.Stalker !== undefined) {
     compile: 16,
   };
 
+  const stalkerOperandKinds = new Set(['reg', 'imm', 'mem', '*']);
+
+  function compileStalkerRule(rule) {
+    if (rule === null || typeof rule !== 'object')
+      throw new Error('transform rules must be objects');
+
+    const {
+      mnemonic = null,
+      operands = null,
+      ranges = null,
+      count = null,
+      callout = null,
+      data = NULL,
+    } = rule;
+
+    if (mnemonic !== null && typeof mnemonic !== 'string')
+      throw new Error('invalid mnemonic');
+
+    if (operands !== null) {
+      if (!Array.isArray(operands) || operands.length === 0 ||
+          !operands.every(kind => stalkerOperandKinds.has(kind)))
+        throw new Error('operands must be a non-empty array of "reg", "imm", "mem", or "*"');
+    }
+
+    if (ranges !== null) {
+      if (!Array.isArray(ranges) || ranges.length === 0)
+        throw new Error('ranges must be a non-empty array');
+    }
+
+    return {
+      mnemonic,
+      operands,
+      ranges,
+      count: (count !== null) ? ptr(count) : null,
+      callout: (callout !== null) ? ptr(callout) : null,
+      data: ptr(data),
+    };
+  }
+
   Object.defineProperties(Stalker, {
     exclude: {
       enumerable: true,
@@ -559,7 +670,14 @@ if (globalThis.Stalker !== undefined) {
           return enabled ? (result | value) : result;
         }, 0);
 
-        Stalker._follow(threadId, transform, eventMask, onReceive, onCallSummary, onEvent, data);
+        let callback = transform;
+        let rules = null;
+        if (Array.isArray(transform)) {
+          callback = null;
+          rules = transform.map(compileStalkerRule);
+        }
+
+        Stalker._follow(threadId, callback, eventMask, onReceive, onCallSummary, onEvent, data, rules);
       }
     },
     parse: {
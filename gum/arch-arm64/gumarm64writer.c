@@ -153,6 +153,10 @@ static GumAddress gum_arm64_writer_strip (GumArm64Writer * self,
 static gboolean gum_arm64_writer_try_commit_label_refs (GumArm64Writer * self);
 static void gum_arm64_writer_maybe_commit_literals (GumArm64Writer * self);
 static void gum_arm64_writer_commit_literals (GumArm64Writer * self);
+static gboolean gum_arm64_writer_try_commit_literal_to_island (
+    GumArm64Writer * self, GumArm64LiteralRef * r);
+static void gum_arm64_writer_patch_literal_load (guint32 * insn,
+    gint64 distance);
 
 static void gum_arm64_writer_describe_reg (GumArm64Writer * self,
     arm64_reg reg, GumArm64RegInfo * ri);
@@ -220,6 +224,7 @@ gum_arm64_writer_init (GumArm64Writer * writer,
   writer->label_defs = NULL;
   writer->label_refs.data = NULL;
   writer->literal_refs.data = NULL;
+  writer->literal_island = NULL;
 
   gum_arm64_writer_reset (writer, code_address);
 }
@@ -1983,13 +1988,16 @@ gum_arm64_writer_commit_literals (GumArm64Writer * self)
     GumArm64LiteralRef * r;
     gint64 * slot;
     gint64 distance;
-    guint32 insn;
 
     r = gum_metal_array_element_at (&self->literal_refs, ref_index);
 
     if (r->width != GUM_LITERAL_64BIT)
       continue;
 
+    if (self->literal_island != NULL &&
+        gum_arm64_writer_try_commit_literal_to_island (self, r))
+      continue;
+
     for (slot = first_slot; slot != last_slot; slot++)
     {
       if (GINT64_FROM_LE (*slot) == r->val)
@@ -2005,9 +2013,7 @@ gum_arm64_writer_commit_literals (GumArm64Writer * self)
     distance = (gint64) GPOINTER_TO_SIZE (slot) -
         (gint64) GPOINTER_TO_SIZE (r->insn);
 
-    insn = GUINT32_FROM_LE (*r->insn);
-    insn |= ((distance / 4) & GUM_INT19_MASK) << 5;
-    *r->insn = GUINT32_TO_LE (insn);
+    gum_arm64_writer_patch_literal_load (r->insn, distance);
   }
 
   for (ref_index = 0; ref_index != num_refs; ref_index++)
@@ -2015,7 +2021,6 @@ gum_arm64_writer_commit_literals (GumArm64Writer * self)
     GumArm64LiteralRef * r;
     gint32 * slot;
     gint64 distance;
-    guint32 insn;
 
     r = gum_metal_array_element_at (&self->literal_refs, ref_index);
 
@@ -2037,9 +2042,7 @@ gum_arm64_writer_commit_literals (GumArm64Writer * self)
     distance = (gint64) GPOINTER_TO_SIZE (slot) -
         (gint64) GPOINTER_TO_SIZE (r->insn);
 
-    insn = GUINT32_FROM_LE (*r->insn);
-    insn |= ((distance / 4) & GUM_INT19_MASK) << 5;
-    *r->insn = GUINT32_TO_LE (insn);
+    gum_arm64_writer_patch_literal_load (r->insn, distance);
   }
 
   self->code = (guint32 *) last_slot;
@@ -2048,6 +2051,57 @@ gum_arm64_writer_commit_literals (GumArm64Writer * self)
   gum_metal_array_remove_all (&self->literal_refs);
 }
 
+/*
+ * The island is shared by everything written near it, e.g. all blocks in a
+ * code slab, so constants such as helper addresses only need to be stored
+ * once instead of once per pool.
+ */
+static gboolean
+gum_arm64_writer_try_commit_literal_to_island (GumArm64Writer * self,
+                                               GumArm64LiteralRef * r)
+{
+  GumArm64LiteralIsland * island = self->literal_island;
+  GumAddress insn_pc;
+  guint i;
+  gint64 distance;
+
+  insn_pc = self->pc - ((self->code - r->insn) * sizeof (guint32));
+
+  for (i = 0; i != island->length; i++)
+  {
+    if (GINT64_FROM_LE (island->slots[i]) == r->val)
+      break;
+  }
+
+  distance = (gint64) (island->pc + (i * sizeof (guint64))) - (gint64) insn_pc;
+  if (distance < -1048576 || distance > 1048572)
+    return FALSE;
+
+  if (i == island->length)
+  {
+    if (island->length == island->capacity)
+      return FALSE;
+
+    island->slots[i] = GINT64_TO_LE (r->val);
+    island->length++;
+  }
+
+  gum_arm64_writer_patch_literal_load (r->insn, distance);
+
+  return TRUE;
+}
+
+static void
+gum_arm64_writer_patch_literal_load (guint32 * insn,
+                                     gint64 distance)
+{
+  guint32 value;
+
+  value = GUINT32_FROM_LE (*insn);
+  value |= ((distance / 4) & GUM_INT19_MASK) << 5;
+  *insn = GUINT32_TO_LE (value);
+}
+
 static void
 gum_arm64_writer_describe_reg (GumArm64Writer * self,
                                arm64_reg reg,
@@ -32,6 +32,7 @@
 G_BEGIN_DECLS
 
 typedef struct _GumArm64Writer GumArm64Writer;
+typedef struct _GumArm64LiteralIsland GumArm64LiteralIsland;
 typedef guint GumArm64IndexMode;
 
 struct _GumArm64Writer
@@ -51,6 +52,15 @@ struct _GumArm64Writer
   GumMetalArray label_refs;
   GumMetalArray literal_refs;
   const guint32 * earliest_literal_insn;
+  GumArm64LiteralIsland * literal_island;
+};
+
+struct _GumArm64LiteralIsland
+{
+  guint64 * slots;
+  GumAddress pc;
+  guint capacity;
+  guint length;
 };
 
 enum _GumArm64IndexMode
@@ -14,6 +14,7 @@
 #include "gumarmrelocator.h"
 #include "gumarmwriter.h"
 #include "gummemory.h"
+#include "gummetalarray.h"
 #include "gummetalhash.h"
 #include "gumspinlock.h"
 #include "gumthumbreader.h"
@@ -46,6 +47,7 @@ typedef struct _GumInfectContext GumInfectContext;
 typedef struct _GumDisinfectContext GumDisinfectContext;
 typedef struct _GumActivation GumActivation;
 typedef struct _GumInvalidateContext GumInvalidateContext;
+typedef struct _GumInvalidateRangeContext GumInvalidateRangeContext;
 typedef struct _GumCallProbe GumCallProbe;
 
 typedef struct _GumExecCtx GumExecCtx;
@@ -148,6 +150,13 @@ struct _GumInvalidateContext
   gboolean is_executing_target_block;
 };
 
+struct _GumInvalidateRangeContext
+{
+  GumExecBlock ** blocks;
+  guint num_blocks;
+  gboolean is_executing_target_block;
+};
+
 struct _GumCallProbe
 {
   gint ref_count;
@@ -203,6 +212,15 @@ struct _GumExecCtx
   GumDataSlab * data_slab;
   GumCodeSlab * scratch_slab;
   GumMetalHashTable * mappings;
+
+  /*
+   * Index of the blocks in mappings, ordered by real_start. Only kept sorted
+   * lazily, as it is only consulted when invalidating a range, whereas blocks
+   * are added to it every time one is compiled.
+   */
+  GumMetalArray block_index;
+  gboolean block_index_sorted;
+  guint block_index_max_real_size;
   gpointer last_arm_invalidator;
   gpointer last_thumb_invalidator;
 
@@ -431,6 +449,12 @@ static gboolean gum_stalker_do_invalidate (GumExecCtx * ctx,
     gconstpointer address, GumActivation * activation);
 static void gum_stalker_try_invalidate_block_owned_by_thread (
     GumThreadId thread_id, GumCpuContext * cpu_context, gpointer user_data);
+static void gum_stalker_invalidate_range_for_all_threads (GumStalker * self,
+    const GumMemoryRange * range, GumActivation * activation);
+static gboolean gum_stalker_do_invalidate_range (GumExecCtx * ctx,
+    const GumMemoryRange * range, GumActivation * activation);
+static void gum_stalker_try_invalidate_blocks_owned_by_thread (
+    GumThreadId thread_id, GumCpuContext * cpu_context, gpointer user_data);
 
 static GumCallProbe * gum_call_probe_ref (GumCallProbe * probe);
 static void gum_call_probe_unref (GumCallProbe * probe);
@@ -475,6 +499,11 @@ static GumExecBlock * gum_exec_ctx_obtain_block_for (GumExecCtx * ctx,
     gpointer real_address, gpointer * code_address);
 static void gum_exec_ctx_recompile_block (GumExecCtx * ctx,
     GumExecBlock * block);
+static void gum_exec_ctx_index_block (GumExecCtx * ctx, GumExecBlock * block);
+static GumExecBlock ** gum_exec_ctx_find_blocks_in_range (GumExecCtx * ctx,
+    const GumMemoryRange * range, guint * n_blocks);
+static gint gum_exec_block_compare_by_real_start (gconstpointer a,
+    gconstpointer b);
 static void gum_exec_ctx_compile_block (GumExecCtx * ctx, GumExecBlock * block,
     gconstpointer input_code, gpointer output_code, GumAddress output_pc,
     guint * input_size, guint * output_size);
@@ -814,6 +843,22 @@ gum_stalker_exclude (GumStalker * self,
   g_array_append_val (self->exclusions, *range);
 }
 
+void
+gum_stalker_set_code_policy (GumStalker * self,
+                             const GumMemoryRange * range,
+                             GumStalkerCodePolicy policy)
+{
+  /* Not yet supported by this backend, blocks are always checked. */
+}
+
+void
+gum_stalker_set_trust_threshold_for_range (GumStalker * self,
+                                           const GumMemoryRange * range,
+                                           gint trust_threshold)
+{
+  /* Not yet supported by this backend, the global threshold applies. */
+}
+
 static gboolean
 gum_stalker_is_call_excluding (GumExecCtx * ctx,
                                gconstpointer address)
@@ -858,6 +903,19 @@ gum_stalker_set_trust_threshold (GumStalker * self,
   self->trust_threshold = trust_threshold;
 }
 
+void
+gum_stalker_set_block_counters_enabled (GumStalker * self,
+                                        gboolean enabled)
+{
+}
+
+void
+gum_stalker_enumerate_block_counters (GumStalker * self,
+                                      GumFoundBlockCounterFunc func,
+                                      gpointer user_data)
+{
+}
+
 void
 gum_stalker_flush (GumStalker * self)
 {
@@ -1374,6 +1432,19 @@ gum_stalker_invalidate_for_thread (GumStalker * self,
   gum_stalker_maybe_reactivate (self, &activation);
 }
 
+void
+gum_stalker_invalidate_range (GumStalker * self,
+                              const GumMemoryRange * range)
+{
+  GumActivation activation;
+
+  gum_stalker_maybe_deactivate (self, &activation);
+
+  gum_stalker_invalidate_range_for_all_threads (self, range, &activation);
+
+  gum_stalker_maybe_reactivate (self, &activation);
+}
+
 static void
 gum_stalker_invalidate_for_all_threads (GumStalker * self,
                                         gconstpointer address,
@@ -1452,6 +1523,96 @@ gum_stalker_try_invalidate_block_owned_by_thread (GumThreadId thread_id,
   gum_exec_block_invalidate (block);
 }
 
+static void
+gum_stalker_invalidate_range_for_all_threads (GumStalker * self,
+                                              const GumMemoryRange * range,
+                                              GumActivation * activation)
+{
+  GSList * contexts, * cur;
+
+  GUM_STALKER_LOCK (self);
+  contexts = g_slist_copy (self->contexts);
+  GUM_STALKER_UNLOCK (self);
+
+  cur = contexts;
+
+  while (cur != NULL)
+  {
+    GumExecCtx * ctx = cur->data;
+    GSList * l;
+
+    if (!gum_stalker_do_invalidate_range (ctx, range, activation))
+    {
+      cur = g_slist_append (cur, ctx);
+    }
+
+    l = cur;
+    cur = cur->next;
+    g_slist_free_1 (l);
+  }
+}
+
+static gboolean
+gum_stalker_do_invalidate_range (GumExecCtx * ctx,
+                                 const GumMemoryRange * range,
+                                 GumActivation * activation)
+{
+  GumInvalidateRangeContext ic;
+
+  ic.is_executing_target_block = FALSE;
+
+  gum_spinlock_acquire (&ctx->code_lock);
+
+  ic.blocks = gum_exec_ctx_find_blocks_in_range (ctx, range, &ic.num_blocks);
+  if (ic.num_blocks != 0)
+  {
+    if (ctx == activation->ctx)
+    {
+      guint i;
+
+      for (i = 0; i != ic.num_blocks; i++)
+        gum_exec_block_invalidate (ic.blocks[i]);
+    }
+    else
+    {
+      gum_process_modify_thread (ctx->thread_id,
+          gum_stalker_try_invalidate_blocks_owned_by_thread, &ic,
+          GUM_MODIFY_THREAD_FLAGS_NONE);
+    }
+  }
+
+  gum_spinlock_release (&ctx->code_lock);
+
+  g_free (ic.blocks);
+
+  return !ic.is_executing_target_block;
+}
+
+static void
+gum_stalker_try_invalidate_blocks_owned_by_thread (GumThreadId thread_id,
+                                                   GumCpuContext * cpu_context,
+                                                   gpointer user_data)
+{
+  GumInvalidateRangeContext * ic = user_data;
+  const guint8 * pc = GSIZE_TO_POINTER (cpu_context->pc);
+  guint i;
+
+  for (i = 0; i != ic->num_blocks; i++)
+  {
+    GumExecBlock * block = ic->blocks[i];
+
+    if (pc >= block->code_start &&
+        pc < block->code_start + GUM_INVALIDATE_TRAMPOLINE_SIZE)
+    {
+      ic->is_executing_target_block = TRUE;
+      return;
+    }
+  }
+
+  for (i = 0; i != ic->num_blocks; i++)
+    gum_exec_block_invalidate (ic->blocks[i]);
+}
+
 GumProbeId
 gum_stalker_add_call_probe (GumStalker * self,
                             gpointer target_address,
@@ -1759,6 +1920,8 @@ gum_exec_ctx_new (GumStalker * stalker,
   gum_scratch_slab_init (ctx->scratch_slab, stalker->scratch_slab_size);
 
   ctx->mappings = gum_metal_hash_table_new (NULL, NULL);
+  gum_metal_array_init (&ctx->block_index, sizeof (GumExecBlock *));
+  ctx->block_index_sorted = TRUE;
 
   gum_exec_ctx_ensure_inline_helpers_reachable (ctx);
 
@@ -1772,6 +1935,7 @@ gum_exec_ctx_free (GumExecCtx * ctx)
   GumDataSlab * data_slab;
   GumCodeSlab * code_slab;
 
+  gum_metal_array_free (&ctx->block_index);
   gum_metal_hash_table_unref (ctx->mappings);
 
   data_slab = ctx->data_slab;
@@ -2125,6 +2289,7 @@ gum_exec_ctx_obtain_block_for (GumExecCtx * ctx,
     gum_exec_block_propagate_exclusive_access_state (block);
 
     gum_metal_hash_table_insert (ctx->mappings, real_address, block);
+    gum_exec_ctx_index_block (ctx, block);
 
     gum_spinlock_release (&ctx->code_lock);
 
@@ -2175,6 +2340,8 @@ gum_exec_ctx_recompile_block (GumExecCtx * ctx,
   if (new_block_size <= block->capacity)
   {
     block->real_size = input_size;
+    if (input_size > ctx->block_index_max_real_size)
+      ctx->block_index_max_real_size = input_size;
     block->code_size = output_size;
 
     memcpy (internal_code, scratch_base, output_size);
@@ -2227,6 +2394,103 @@ gum_exec_ctx_recompile_block (GumExecCtx * ctx,
   gum_exec_ctx_maybe_emit_compile_event (ctx, block);
 }
 
+static void
+gum_exec_ctx_index_block (GumExecCtx * ctx,
+                          GumExecBlock * block)
+{
+  GumMetalArray * index = &ctx->block_index;
+  GumExecBlock ** entry;
+
+  if (ctx->block_index_sorted && index->length != 0)
+  {
+    GumExecBlock * last = *((GumExecBlock **) gum_metal_array_element_at (
+        index, index->length - 1));
+
+    ctx->block_index_sorted = last->real_start <= block->real_start;
+  }
+
+  entry = gum_metal_array_append (index);
+  *entry = block;
+
+  if (block->real_size > ctx->block_index_max_real_size)
+    ctx->block_index_max_real_size = block->real_size;
+}
+
+static GumExecBlock **
+gum_exec_ctx_find_blocks_in_range (GumExecCtx * ctx,
+                                   const GumMemoryRange * range,
+                                   guint * n_blocks)
+{
+  GumMetalArray * index = &ctx->block_index;
+  GumExecBlock ** entries = index->data;
+  const guint8 * range_start, * range_end, * search_start;
+  GArray * blocks;
+  guint lo, hi, i;
+
+  if (!ctx->block_index_sorted)
+  {
+    qsort (entries, index->length, sizeof (GumExecBlock *),
+        gum_exec_block_compare_by_real_start);
+    ctx->block_index_sorted = TRUE;
+  }
+
+  range_start = GSIZE_TO_POINTER (range->base_address);
+  range_end = range_start + range->size;
+
+  /* No block starting before this can reach into the range. */
+  search_start = (range->base_address > ctx->block_index_max_real_size)
+      ? range_start - ctx->block_index_max_real_size
+      : NULL;
+
+  lo = 0;
+  hi = index->length;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (entries[mid]->real_start < search_start)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  blocks = g_array_new (FALSE, FALSE, sizeof (GumExecBlock *));
+
+  for (i = lo; i != index->length; i++)
+  {
+    GumExecBlock * block = entries[i];
+    guint real_size;
+
+    if (block->real_start >= range_end)
+      break;
+
+    real_size = block->real_size;
+    if (block->storage_block != NULL)
+      real_size = MAX (real_size, block->storage_block->real_size);
+
+    if (block->real_start + real_size > range_start)
+      g_array_append_val (blocks, block);
+  }
+
+  *n_blocks = blocks->len;
+
+  return (GumExecBlock **) g_array_free (blocks, FALSE);
+}
+
+static gint
+gum_exec_block_compare_by_real_start (gconstpointer a,
+                                      gconstpointer b)
+{
+  const GumExecBlock * block_a = *((const GumExecBlock **) a);
+  const GumExecBlock * block_b = *((const GumExecBlock **) b);
+
+  if (block_a->real_start < block_b->real_start)
+    return -1;
+  if (block_a->real_start > block_b->real_start)
+    return 1;
+  return 0;
+}
+
 static void
 gum_exec_ctx_compile_block (GumExecCtx * ctx,
                             GumExecBlock * block,
@@ -17,6 +17,9 @@
 # include "gumdarwin.h"
 # include "gumdarwingrafter-priv.h"
 #endif
+#ifdef HAVE_LINUX
+# include "guminterceptor-elf.h"
+#endif
 
 #include <string.h>
 #include <unistd.h>
@@ -68,6 +71,8 @@ static void gum_interceptor_backend_create_thunks (
 static void gum_interceptor_backend_destroy_thunks (
     GumInterceptorBackend * self);
 
+static void gum_emit_leave_trampoline (GumInterceptorBackend * self,
+    GumFunctionContext * ctx);
 static void gum_emit_thunks (gpointer mem, GumInterceptorBackend * self);
 static void gum_emit_enter_thunk (GumArm64Writer * aw);
 static void gum_emit_leave_thunk (GumArm64Writer * aw);
@@ -195,6 +200,9 @@ _gum_interceptor_backend_claim_grafted_trampoline (GumInterceptorBackend * self,
   Dl_info info;
   GumClaimHookOperation op;
 
+  if (gum_process_get_code_signing_policy () != GUM_CODE_SIGNING_REQUIRED)
+    return FALSE;
+
   if (gum_interceptor_backend == NULL)
   {
     gum_interceptor_backend = self;
@@ -611,6 +619,16 @@ gum_is_system_module (const gchar * path)
   return FALSE;
 }
 
+#elif defined (HAVE_LINUX)
+
+gboolean
+_gum_interceptor_backend_claim_grafted_trampoline (GumInterceptorBackend * self,
+                                                   GumFunctionContext * ctx)
+{
+  return _gum_interceptor_elf_claim_grafted_trampoline (ctx,
+      _gum_interceptor_begin_invocation, _gum_interceptor_end_invocation);
+}
+
 #else
 
 gboolean
@@ -707,6 +725,11 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
   if (!gum_interceptor_backend_prepare_trampoline (self, ctx, &need_deflector))
     return FALSE;
 
+#ifdef HAVE_PTRAUTH
+  /* Our thunks return through BR, so there is nothing to balance. */
+  ctx->return_stack_balanced = FALSE;
+#endif
+
   gum_arm64_writer_reset (aw, ctx->trampoline_slice->data);
 
   if (ctx->type == GUM_INTERCEPTOR_TYPE_FAST)
@@ -746,17 +769,33 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
 
   if (ctx->type != GUM_INTERCEPTOR_TYPE_FAST)
   {
+    if (ctx->return_stack_balanced)
+    {
+      gconstpointer enter = aw->code + 1;
+
+      /*
+       * Give the enter thunk's RET a return stack buffer entry of its own to
+       * consume, instead of the one belonging to our caller.
+       */
+      gum_arm64_writer_put_mov_reg_reg (aw, ARM64_REG_X16, ARM64_REG_LR);
+      gum_arm64_writer_put_bl_label (aw, enter);
+      gum_arm64_writer_put_brk_imm (aw, 0);
+
+      gum_arm64_writer_put_label (aw, enter);
+      gum_arm64_writer_put_mov_reg_reg (aw, ARM64_REG_LR, ARM64_REG_X16);
+    }
+
     gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X17, GUM_ADDRESS (ctx));
     gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X16,
         GUM_ADDRESS (gum_sign_code_pointer (self->enter_thunk)));
     gum_arm64_writer_put_br_reg (aw, ARM64_REG_X16);
 
-    ctx->on_leave_trampoline = gum_arm64_writer_cur (aw);
+    if (!ctx->return_stack_balanced)
+    {
+      ctx->on_leave_trampoline = gum_arm64_writer_cur (aw);
 
-    gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X17, GUM_ADDRESS (ctx));
-    gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X16,
-        GUM_ADDRESS (gum_sign_code_pointer (self->leave_thunk)));
-    gum_arm64_writer_put_br_reg (aw, ARM64_REG_X16);
+      gum_emit_leave_trampoline (self, ctx);
+    }
 
     gum_arm64_writer_flush (aw);
     g_assert (gum_arm64_writer_offset (aw) <= ctx->trampoline_slice->size);
@@ -872,6 +911,26 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
   gum_arm64_writer_flush (aw);
   g_assert (gum_arm64_writer_offset (aw) <= ctx->trampoline_slice->size);
 
+  if (ctx->type != GUM_INTERCEPTOR_TYPE_FAST && ctx->return_stack_balanced)
+  {
+    /*
+     * Swap the caller's return address for our own by calling the function,
+     * so that its RET and ours each have a matching BL.
+     */
+    ctx->on_call_trampoline =
+        gum_sign_code_pointer (gum_arm64_writer_cur (aw));
+
+    gum_arm64_writer_put_bl_imm (aw,
+        GUM_ADDRESS (gum_strip_code_pointer (ctx->on_invoke_trampoline)));
+
+    ctx->on_leave_trampoline = gum_arm64_writer_cur (aw);
+
+    gum_emit_leave_trampoline (self, ctx);
+
+    gum_arm64_writer_flush (aw);
+    g_assert (gum_arm64_writer_offset (aw) <= ctx->trampoline_slice->size);
+  }
+
   ctx->overwritten_prologue_len = reloc_bytes;
   gum_memcpy (ctx->overwritten_prologue, function_address, reloc_bytes);
 
@@ -895,6 +954,12 @@ _gum_interceptor_backend_destroy_trampoline (GumInterceptorBackend * self,
     gum_import_target_clear_user_data (ctx->import_target);
     return;
   }
+#elif defined (HAVE_LINUX)
+  if (ctx->grafted_hook != NULL || ctx->import_target != NULL)
+  {
+    _gum_interceptor_elf_destroy_grafted_trampoline (ctx);
+    return;
+  }
 #endif
 
   gum_code_slice_unref (ctx->trampoline_slice);
@@ -929,6 +994,12 @@ _gum_interceptor_backend_activate_trampoline (GumInterceptorBackend * self,
     gum_import_target_activate_all (ctx->import_target);
     return;
   }
+#elif defined (HAVE_LINUX)
+  if (ctx->grafted_hook != NULL || ctx->import_target != NULL)
+  {
+    _gum_interceptor_elf_activate_grafted_trampoline (ctx);
+    return;
+  }
 #endif
 
   gum_arm64_writer_reset (aw, prologue);
@@ -990,6 +1061,12 @@ _gum_interceptor_backend_deactivate_trampoline (GumInterceptorBackend * self,
     gum_import_target_deactivate_all (ctx->import_target);
     return;
   }
+#elif defined (HAVE_LINUX)
+  if (ctx->grafted_hook != NULL || ctx->import_target != NULL)
+  {
+    _gum_interceptor_elf_deactivate_grafted_trampoline (ctx);
+    return;
+  }
 #endif
 
   gum_memcpy (prologue, ctx->overwritten_prologue,
@@ -1006,7 +1083,17 @@ gpointer
 _gum_interceptor_backend_resolve_redirect (GumInterceptorBackend * self,
                                            gpointer address)
 {
-  return gum_arm64_reader_try_get_relative_jump_target (address);
+  gpointer target;
+
+  target = gum_arm64_reader_try_get_relative_jump_target (address);
+
+#ifdef HAVE_LINUX
+  /* Avoid following grafted branches. */
+  if (target != NULL && _gum_interceptor_elf_is_grafted_hook_site (address))
+    return NULL;
+#endif
+
+  return target;
 }
 
 static void
@@ -1034,6 +1121,18 @@ gum_interceptor_backend_destroy_thunks (GumInterceptorBackend * self)
   gum_memory_free (self->thunks, gum_query_page_size ());
 }
 
+static void
+gum_emit_leave_trampoline (GumInterceptorBackend * self,
+                           GumFunctionContext * ctx)
+{
+  GumArm64Writer * aw = &self->writer;
+
+  gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X17, GUM_ADDRESS (ctx));
+  gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X16,
+      GUM_ADDRESS (gum_sign_code_pointer (self->leave_thunk)));
+  gum_arm64_writer_put_br_reg (aw, ARM64_REG_X16);
+}
+
 static void
 gum_emit_thunks (gpointer mem,
                  GumInterceptorBackend * self)
@@ -56,6 +56,12 @@ _gum_memory_backend_query_page_size (void)
   return getpagesize ();
 }
 
+gsize
+_gum_memory_backend_query_huge_page_size (void)
+{
+  return 0;
+}
+
 gboolean
 gum_darwin_query_ptrauth_support (mach_port_t task,
                                   GumPtrauthSupport * ptrauth_support)
@@ -253,6 +259,14 @@ gum_memory_is_readable (gconstpointer address,
   return is_readable;
 }
 
+gboolean
+gum_memory_query_protection (gconstpointer address,
+                             GumPageProtection * prot)
+{
+  return gum_darwin_query_protection (mach_task_self (), GUM_ADDRESS (address),
+      prot);
+}
+
 guint8 *
 gum_memory_read (gconstpointer address,
                  gsize len,
@@ -718,6 +732,13 @@ gum_memory_discard (gpointer address,
   return res == 0;
 }
 
+gboolean
+gum_memory_advise_huge_pages (gpointer address,
+                              gsize size)
+{
+  return FALSE;
+}
+
 gboolean
 gum_memory_decommit (gpointer address,
                      gsize size)
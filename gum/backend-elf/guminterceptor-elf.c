@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "guminterceptor-elf.h"
+
+#include "gum-init.h"
+#include "gumelfgrafter-priv.h"
+#include "gummemory.h"
+#include "gumprocess.h"
+
+#include <link.h>
+#include <stdlib.h>
+
+typedef struct _GumElfImportTarget GumElfImportTarget;
+typedef struct _GumElfImportEntry GumElfImportEntry;
+typedef struct _GumGraftedImageDetails GumGraftedImageDetails;
+typedef struct _GumLoadGeneration GumLoadGeneration;
+typedef struct _GumClaimHookOperation GumClaimHookOperation;
+typedef struct _GumFindHookOperation GumFindHookOperation;
+typedef struct _GumCollectImportsOperation GumCollectImportsOperation;
+
+typedef gboolean (* GumFoundGraftedImageFunc) (
+    const GumGraftedImageDetails * details, gpointer user_data);
+
+struct _GumElfImportTarget
+{
+  gpointer implementation;
+  GumFunctionContext * ctx;
+  GArray * entries;
+};
+
+struct _GumElfImportEntry
+{
+  gpointer * slot;
+  GumElfGraftedImport * import;
+  gpointer on_enter_trampoline;
+};
+
+struct _GumGraftedImageDetails
+{
+  guint8 * base;
+  const ElfW(Phdr) * phdrs;
+  guint num_phdrs;
+  ElfW(Addr) slide;
+
+  GumElfGraftedHeader * header;
+
+  GumElfGraftedHook * hooks;
+  guint32 num_hooks;
+
+  GumElfGraftedImport * imports;
+  guint32 num_imports;
+};
+
+struct _GumLoadGeneration
+{
+  gboolean known;
+  unsigned long long adds;
+  unsigned long long subs;
+};
+
+struct _GumClaimHookOperation
+{
+  GumFunctionContext * ctx;
+  gpointer begin_invocation;
+  gpointer end_invocation;
+
+  gboolean success;
+};
+
+struct _GumFindHookOperation
+{
+  gpointer address;
+
+  gboolean found;
+};
+
+struct _GumCollectImportsOperation
+{
+  GumElfImportTarget * target;
+  gpointer begin_invocation;
+  gpointer end_invocation;
+};
+
+static gboolean gum_claim_hook_if_found_in_image (
+    const GumGraftedImageDetails * details, gpointer user_data);
+static gboolean gum_check_hook_in_image (
+    const GumGraftedImageDetails * details, gpointer user_data);
+static gboolean gum_collect_imports_in_image (
+    const GumGraftedImageDetails * details, gpointer user_data);
+static GumElfGraftedHook * gum_find_grafted_hook (
+    const GumGraftedImageDetails * details, gpointer address);
+static void gum_elf_import_target_free (GumElfImportTarget * target);
+static void gum_elf_import_entry_write_slot (const GumElfImportEntry * entry,
+    gpointer value);
+static gboolean gum_any_grafted_images (void);
+static void gum_enumerate_grafted_images (GumFoundGraftedImageFunc func,
+    gpointer user_data);
+static void gum_update_grafted_images (void);
+static void gum_deinit_grafted_images (void);
+static int gum_read_load_generation (struct dl_phdr_info * info, size_t size,
+    void * data);
+static int gum_collect_grafted_image (struct dl_phdr_info * info, size_t size,
+    void * data);
+static int gum_compare_grafted_hook (const void * element_a,
+    const void * element_b);
+
+G_LOCK_DEFINE_STATIC (gum_grafted_images);
+static GArray * gum_grafted_images = NULL;
+static GumLoadGeneration gum_grafted_images_generation;
+
+gboolean
+_gum_interceptor_elf_claim_grafted_trampoline (GumFunctionContext * ctx,
+                                               gpointer begin_invocation,
+                                               gpointer end_invocation)
+{
+  GumClaimHookOperation hop;
+  GumCollectImportsOperation iop;
+  GumElfImportTarget * target;
+  const GumElfImportEntry * first;
+
+  if (!gum_any_grafted_images ())
+    return FALSE;
+
+  hop.ctx = ctx;
+  hop.begin_invocation = begin_invocation;
+  hop.end_invocation = end_invocation;
+  hop.success = FALSE;
+
+  gum_enumerate_grafted_images (gum_claim_hook_if_found_in_image, &hop);
+  if (hop.success)
+    return TRUE;
+
+  /*
+   * When code may be modified we are better off patching the implementation
+   * itself, as that also catches callers that did not get grafted.
+   */
+  if (gum_process_get_code_signing_policy () != GUM_CODE_SIGNING_REQUIRED)
+    return FALSE;
+
+  target = g_slice_new (GumElfImportTarget);
+  target->implementation = ctx->function_address;
+  target->ctx = ctx;
+  target->entries = g_array_new (FALSE, FALSE, sizeof (GumElfImportEntry));
+
+  iop.target = target;
+  iop.begin_invocation = begin_invocation;
+  iop.end_invocation = end_invocation;
+
+  gum_enumerate_grafted_images (gum_collect_imports_in_image, &iop);
+
+  if (target->entries->len == 0)
+  {
+    gum_elf_import_target_free (target);
+    return FALSE;
+  }
+
+  first = &g_array_index (target->entries, GumElfImportEntry, 0);
+
+  ctx->import_target = target;
+  ctx->on_enter_trampoline = first->on_enter_trampoline;
+  ctx->on_leave_trampoline = (guint8 *) first->on_enter_trampoline -
+      GUM_ELF_GRAFTED_IMPORT_ON_ENTER_OFFSET (first->import) +
+      GUM_ELF_GRAFTED_IMPORT_ON_LEAVE_OFFSET (first->import);
+  ctx->on_invoke_trampoline = target->implementation;
+
+  return TRUE;
+}
+
+gboolean
+_gum_interceptor_elf_is_grafted_hook_site (gpointer address)
+{
+  GumFindHookOperation op;
+
+  if (!gum_any_grafted_images ())
+    return FALSE;
+
+  op.address = address;
+  op.found = FALSE;
+
+  gum_enumerate_grafted_images (gum_check_hook_in_image, &op);
+
+  return op.found;
+}
+
+void
+_gum_interceptor_elf_activate_grafted_trampoline (GumFunctionContext * ctx)
+{
+  GumElfImportTarget * target;
+  guint i;
+
+  if (ctx->grafted_hook != NULL)
+  {
+    _gum_elf_grafted_hook_activate (ctx->grafted_hook);
+    return;
+  }
+
+  target = ctx->import_target;
+  for (i = 0; i != target->entries->len; i++)
+  {
+    const GumElfImportEntry * entry =
+        &g_array_index (target->entries, GumElfImportEntry, i);
+
+    gum_elf_import_entry_write_slot (entry, entry->on_enter_trampoline);
+  }
+}
+
+void
+_gum_interceptor_elf_deactivate_grafted_trampoline (GumFunctionContext * ctx)
+{
+  GumElfImportTarget * target;
+  guint i;
+
+  if (ctx->grafted_hook != NULL)
+  {
+    _gum_elf_grafted_hook_deactivate (ctx->grafted_hook);
+    return;
+  }
+
+  target = ctx->import_target;
+  for (i = 0; i != target->entries->len; i++)
+  {
+    const GumElfImportEntry * entry =
+        &g_array_index (target->entries, GumElfImportEntry, i);
+
+    gum_elf_import_entry_write_slot (entry, target->implementation);
+  }
+}
+
+void
+_gum_interceptor_elf_destroy_grafted_trampoline (GumFunctionContext * ctx)
+{
+  GumElfImportTarget * target;
+  guint i;
+
+  if (ctx->grafted_hook != NULL)
+  {
+    GumElfGraftedHook * hook = ctx->grafted_hook;
+    hook->user_data = 0;
+    return;
+  }
+
+  target = ctx->import_target;
+  for (i = 0; i != target->entries->len; i++)
+  {
+    const GumElfImportEntry * entry =
+        &g_array_index (target->entries, GumElfImportEntry, i);
+
+    entry->import->user_data = 0;
+  }
+
+  gum_elf_import_target_free (target);
+  ctx->import_target = NULL;
+}
+
+static gboolean
+gum_claim_hook_if_found_in_image (const GumGraftedImageDetails * details,
+                                  gpointer user_data)
+{
+  GumClaimHookOperation * op = user_data;
+  GumFunctionContext * ctx = op->ctx;
+  GumElfGraftedHook * hook;
+  guint8 * trampoline;
+
+  hook = gum_find_grafted_hook (details, ctx->function_address);
+  if (hook == NULL)
+    return TRUE;
+
+  details->header->begin_invocation =
+      GPOINTER_TO_SIZE (op->begin_invocation);
+  details->header->end_invocation = GPOINTER_TO_SIZE (op->end_invocation);
+
+  hook->user_data = GPOINTER_TO_SIZE (ctx);
+
+  ctx->grafted_hook = hook;
+
+  trampoline = details->base + hook->trampoline_offset;
+  ctx->on_enter_trampoline =
+      trampoline + GUM_ELF_GRAFTED_HOOK_ON_ENTER_OFFSET (hook);
+  ctx->on_leave_trampoline =
+      trampoline + GUM_ELF_GRAFTED_HOOK_ON_LEAVE_OFFSET (hook);
+  ctx->on_invoke_trampoline =
+      trampoline + GUM_ELF_GRAFTED_HOOK_ON_INVOKE_OFFSET (hook);
+
+  op->success = TRUE;
+
+  return FALSE;
+}
+
+static gboolean
+gum_check_hook_in_image (const GumGraftedImageDetails * details,
+                         gpointer user_data)
+{
+  GumFindHookOperation * op = user_data;
+
+  op->found = gum_find_grafted_hook (details, op->address) != NULL;
+
+  return !op->found;
+}
+
+static gboolean
+gum_collect_imports_in_image (const GumGraftedImageDetails * details,
+                              gpointer user_data)
+{
+  GumCollectImportsOperation * op = user_data;
+  GumElfImportTarget * target = op->target;
+  gboolean header_initialized = FALSE;
+  guint32 i;
+
+  for (i = 0; i != details->num_imports; i++)
+  {
+    GumElfGraftedImport * import = &details->imports[i];
+    GumElfImportEntry entry;
+
+    entry.slot = (gpointer *) (details->base + import->slot_offset);
+    if (*entry.slot != target->implementation)
+      continue;
+
+    if (!header_initialized)
+    {
+      details->header->begin_invocation =
+          GPOINTER_TO_SIZE (op->begin_invocation);
+      details->header->end_invocation = GPOINTER_TO_SIZE (op->end_invocation);
+      header_initialized = TRUE;
+    }
+
+    import->user_data = GPOINTER_TO_SIZE (target->ctx);
+
+    entry.import = import;
+    entry.on_enter_trampoline = details->base + import->trampoline_offset +
+        GUM_ELF_GRAFTED_IMPORT_ON_ENTER_OFFSET (import);
+    g_array_append_val (target->entries, entry);
+  }
+
+  return TRUE;
+}
+
+static GumElfGraftedHook *
+gum_find_grafted_hook (const GumGraftedImageDetails * details,
+                       gpointer address)
+{
+  GumElfGraftedHook key = { 0, };
+  gboolean inside_image = FALSE;
+  guint i;
+
+  for (i = 0; i != details->num_phdrs; i++)
+  {
+    const ElfW(Phdr) * phdr = &details->phdrs[i];
+    guint8 * start;
+
+    if (phdr->p_type != PT_LOAD)
+      continue;
+
+    start = GSIZE_TO_POINTER (details->slide + phdr->p_vaddr);
+    if ((guint8 *) address >= start &&
+        (guint8 *) address < start + phdr->p_memsz)
+    {
+      inside_image = TRUE;
+      break;
+    }
+  }
+  if (!inside_image)
+    return NULL;
+
+  key.code_offset = (guint8 *) address - details->base;
+
+  return bsearch (&key, details->hooks, details->num_hooks,
+      sizeof (GumElfGraftedHook), gum_compare_grafted_hook);
+}
+
+static void
+gum_elf_import_target_free (GumElfImportTarget * target)
+{
+  g_array_free (target->entries, TRUE);
+
+  g_slice_free (GumElfImportTarget, target);
+}
+
+static void
+gum_elf_import_entry_write_slot (const GumElfImportEntry * entry,
+                                 gpointer value)
+{
+  gboolean flip_needed = GUM_ELF_GRAFTED_IMPORT_IN_RELRO (entry->import);
+
+  if (flip_needed)
+  {
+    if (!gum_try_mprotect (entry->slot, sizeof (gpointer), GUM_PAGE_RW))
+      return;
+  }
+
+  *entry->slot = value;
+
+  if (flip_needed)
+    gum_try_mprotect (entry->slot, sizeof (gpointer), GUM_PAGE_READ);
+}
+
+static gboolean
+gum_any_grafted_images (void)
+{
+  gboolean any;
+
+  G_LOCK (gum_grafted_images);
+  gum_update_grafted_images ();
+  any = gum_grafted_images->len != 0;
+  G_UNLOCK (gum_grafted_images);
+
+  return any;
+}
+
+static void
+gum_enumerate_grafted_images (GumFoundGraftedImageFunc func,
+                              gpointer user_data)
+{
+  guint i;
+
+  G_LOCK (gum_grafted_images);
+
+  gum_update_grafted_images ();
+
+  for (i = 0; i != gum_grafted_images->len; i++)
+  {
+    if (!func (&g_array_index (gum_grafted_images, GumGraftedImageDetails, i),
+        user_data))
+    {
+      break;
+    }
+  }
+
+  G_UNLOCK (gum_grafted_images);
+}
+
+static void
+gum_update_grafted_images (void)
+{
+  GumLoadGeneration generation = { FALSE, 0, 0 };
+
+  /*
+   * Walking the program headers of every loaded object is costly, so only do
+   * it again once the loader tells us that objects got added or removed.
+   */
+  dl_iterate_phdr (gum_read_load_generation, &generation);
+
+  if (gum_grafted_images == NULL)
+  {
+    gum_grafted_images =
+        g_array_new (FALSE, FALSE, sizeof (GumGraftedImageDetails));
+    _gum_register_destructor (gum_deinit_grafted_images);
+  }
+  else if (generation.known && gum_grafted_images_generation.known &&
+      generation.adds == gum_grafted_images_generation.adds &&
+      generation.subs == gum_grafted_images_generation.subs)
+  {
+    return;
+  }
+
+  g_array_set_size (gum_grafted_images, 0);
+  dl_iterate_phdr (gum_collect_grafted_image, gum_grafted_images);
+
+  gum_grafted_images_generation = generation;
+}
+
+static void
+gum_deinit_grafted_images (void)
+{
+  g_clear_pointer (&gum_grafted_images, g_array_unref);
+}
+
+static int
+gum_read_load_generation (struct dl_phdr_info * info,
+                          size_t size,
+                          void * data)
+{
+  GumLoadGeneration * generation = data;
+
+  if (size >= G_STRUCT_OFFSET (struct dl_phdr_info, dlpi_subs) +
+      sizeof (info->dlpi_subs))
+  {
+    generation->known = TRUE;
+    generation->adds = info->dlpi_adds;
+    generation->subs = info->dlpi_subs;
+  }
+
+  return 1;
+}
+
+static int
+gum_collect_grafted_image (struct dl_phdr_info * info,
+                           size_t size,
+                           void * data)
+{
+  GArray * images = data;
+  GumGraftedImageDetails d;
+  guint8 * base = NULL;
+  GumElfGraftedHeader * header = NULL;
+  ElfW(Half) i;
+
+  for (i = 0; i != info->dlpi_phnum; i++)
+  {
+    const ElfW(Phdr) * phdr = &info->dlpi_phdr[i];
+
+    if (phdr->p_type == PT_LOAD && phdr->p_offset == 0)
+      base = GSIZE_TO_POINTER (info->dlpi_addr + phdr->p_vaddr);
+    else if (phdr->p_type == GUM_ELF_PHDR_GUM_GRAFTED)
+      header = GSIZE_TO_POINTER (info->dlpi_addr + phdr->p_vaddr);
+  }
+
+  if (base == NULL || header == NULL ||
+      header->abi_version != GUM_ELF_GRAFTER_ABI_VERSION)
+  {
+    return 0;
+  }
+
+  d.base = base;
+  d.phdrs = info->dlpi_phdr;
+  d.num_phdrs = info->dlpi_phnum;
+  d.slide = info->dlpi_addr;
+
+  d.header = header;
+
+  d.hooks = (GumElfGraftedHook *) (header + 1);
+  d.num_hooks = header->num_hooks;
+
+  d.imports = (GumElfGraftedImport *) (d.hooks + header->num_hooks);
+  d.num_imports = header->num_imports;
+
+  g_array_append_val (images, d);
+
+  return 0;
+}
+
+static int
+gum_compare_grafted_hook (const void * element_a,
+                          const void * element_b)
+{
+  const GumElfGraftedHook * a = element_a;
+  const GumElfGraftedHook * b = element_b;
+
+  return (gssize) a->code_offset - (gssize) b->code_offset;
+}
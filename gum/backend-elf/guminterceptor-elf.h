@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_INTERCEPTOR_ELF_H__
+#define __GUM_INTERCEPTOR_ELF_H__
+
+#include "guminterceptor-priv.h"
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL gboolean _gum_interceptor_elf_claim_grafted_trampoline (
+    GumFunctionContext * ctx, gpointer begin_invocation,
+    gpointer end_invocation);
+G_GNUC_INTERNAL gboolean _gum_interceptor_elf_is_grafted_hook_site (
+    gpointer address);
+
+G_GNUC_INTERNAL void _gum_interceptor_elf_activate_grafted_trampoline (
+    GumFunctionContext * ctx);
+G_GNUC_INTERNAL void _gum_interceptor_elf_deactivate_grafted_trampoline (
+    GumFunctionContext * ctx);
+G_GNUC_INTERNAL void _gum_interceptor_elf_destroy_grafted_trampoline (
+    GumFunctionContext * ctx);
+
+G_END_DECLS
+
+#endif
@@ -67,7 +67,8 @@ static gboolean gum_emit_range_if_module_name_matches (
 static gboolean gum_emit_section (const GumElfSectionDetails * details,
     gpointer user_data);
 
-static GumElfModule * gum_open_elf_module (const gchar * name);
+static GumElfModule * gum_open_elf_module (const gchar * name,
+    GumElfModuleFlags flags);
 
 void
 gum_module_enumerate_imports (const gchar * module_name,
@@ -77,7 +78,7 @@ gum_module_enumerate_imports (const gchar * module_name,
   GumElfModule * module;
   GumEnumerateImportsContext ctx;
 
-  module = gum_open_elf_module (module_name);
+  module = gum_open_elf_module (module_name, GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
   if (module == NULL)
     return;
 
@@ -146,7 +147,8 @@ gum_collect_dependency_exports (const GumDependencyDetails * details,
   GumEnumerateImportsContext * ctx = user_data;
   GumElfModule * module;
 
-  module = gum_open_elf_module (details->name);
+  module = gum_open_elf_module (details->name,
+      GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
   if (module == NULL)
     return TRUE;
   ctx->current_dependency = module;
@@ -199,7 +201,7 @@ gum_module_enumerate_exports (const gchar * module_name,
 {
   GumElfModule * module;
 
-  module = gum_open_elf_module (module_name);
+  module = gum_open_elf_module (module_name, GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
   if (module == NULL)
     return;
   gum_elf_module_enumerate_exports (module, func, user_data);
@@ -214,7 +216,7 @@ gum_module_enumerate_symbols (const gchar * module_name,
   GumElfModule * module;
   GumEnumerateSymbolsContext ctx;
 
-  module = gum_open_elf_module (module_name);
+  module = gum_open_elf_module (module_name, GUM_ELF_MODULE_FLAGS_NONE);
   if (module == NULL)
     return;
 
@@ -309,7 +311,7 @@ gum_module_enumerate_sections (const gchar * module_name,
   GumElfModule * module;
   GumEnumerateSectionsContext ctx;
 
-  module = gum_open_elf_module (module_name);
+  module = gum_open_elf_module (module_name, GUM_ELF_MODULE_FLAGS_NONE);
   if (module == NULL)
     return;
 
@@ -341,7 +343,8 @@ gum_module_enumerate_dependencies (const gchar * module_name,
                                    GumFoundDependencyFunc func,
                                    gpointer user_data)
 {
-  GumElfModule * module = gum_open_elf_module (module_name);
+  GumElfModule * module =
+      gum_open_elf_module (module_name, GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
   if (module == NULL)
     return;
 
@@ -362,7 +365,8 @@ gum_module_find_base_address (const gchar * module_name)
 }
 
 static GumElfModule *
-gum_open_elf_module (const gchar * name)
+gum_open_elf_module (const gchar * name,
+                     GumElfModuleFlags flags)
 {
   gchar * path;
   GumAddress base_address;
@@ -371,7 +375,8 @@ gum_open_elf_module (const gchar * name)
   if (!_gum_process_resolve_module_name (name, &path, &base_address))
     return NULL;
 
-  module = gum_elf_module_new_from_memory (path, base_address, NULL);
+  module = gum_elf_module_new_from_memory_full (path, base_address, flags,
+      NULL);
 
   g_free (path);
 
@@ -21,11 +21,13 @@
 # pragma clang diagnostic pop
 #endif
 #include <libelf.h>
+#include <link.h>
 #include <strings.h>
 
 #define GUM_MAX_CACHE_AGE (0.5)
 
 typedef struct _GumModuleEntry GumModuleEntry;
+typedef struct _GumModuleGenerations GumModuleGenerations;
 
 typedef struct _GumNearestSymbolDetails GumNearestSymbolDetails;
 typedef struct _GumDwarfSymbolDetails GumDwarfSymbolDetails;
@@ -46,7 +48,17 @@ struct _GumModuleEntry
   GumElfModule * module;
   Elf * elf;
   Dwarf_Debug dbg;
+  GumAddress base_address;
+  GumMemoryRange range;
   gboolean collected;
+  gboolean seen;
+};
+
+struct _GumModuleGenerations
+{
+  gboolean valid;
+  guint64 adds;
+  guint64 subs;
 };
 
 struct _GumNearestSymbolDetails
@@ -107,6 +119,12 @@ static GumModuleEntry * gum_module_entry_from_path_and_base (const gchar * path,
 static GHashTable * gum_get_function_addresses (void);
 static GHashTable * gum_get_address_symbols (void);
 static void gum_maybe_refresh_symbol_caches (void);
+static gboolean gum_module_generations_changed (void);
+static int gum_read_module_generations (struct dl_phdr_info * info,
+    size_t size, void * data);
+static gboolean gum_module_entry_purge_if_unseen (const gchar * path,
+    GumModuleEntry * entry, gpointer user_data);
+static void gum_module_entry_purge_symbols (GumModuleEntry * entry);
 static gboolean gum_collect_module_functions (const GumModuleDetails * details,
     gpointer user_data);
 static gboolean gum_collect_symbol_if_function (
@@ -152,6 +170,7 @@ static GHashTable * gum_module_entries = NULL;
 static GHashTable * gum_function_addresses = NULL;
 static GHashTable * gum_address_symbols = NULL;
 static GTimer * gum_cache_timer = NULL;
+static GumModuleGenerations gum_cached_generations = { FALSE, 0, 0 };
 
 gboolean
 gum_symbol_details_from_address (gpointer address,
@@ -533,7 +552,14 @@ gum_module_entry_from_path_and_base (const gchar * path,
 
   entry = g_hash_table_lookup (gum_module_entries, path);
   if (entry != NULL)
-    goto have_entry;
+  {
+    if (entry->base_address == base_address)
+      goto have_entry;
+
+    /* Unloaded and loaded again elsewhere since we last looked. */
+    gum_module_entry_purge_symbols (entry);
+    g_hash_table_remove (gum_module_entries, path);
+  }
 
   module = gum_elf_module_new_from_memory (path, base_address, NULL);
   if (module != NULL)
@@ -569,7 +595,11 @@ gum_module_entry_from_path_and_base (const gchar * path,
   entry->module = module;
   entry->elf = elf;
   entry->dbg = dbg;
+  entry->base_address = base_address;
+  entry->range.base_address = 0;
+  entry->range.size = 0;
   entry->collected = FALSE;
+  entry->seen = TRUE;
 
   g_hash_table_insert (gum_module_entries, g_strdup (path), entry);
 
@@ -613,20 +643,129 @@ gum_maybe_refresh_symbol_caches (void)
 
   gum_symbol_util_ensure_initialized ();
 
-  if (gum_cache_timer == NULL)
+  need_update = gum_module_generations_changed ();
+
+  if (need_update)
   {
-    gum_cache_timer = g_timer_new ();
+    GHashTableIter iter;
+    GumModuleEntry * entry;
 
-    need_update = TRUE;
+    g_hash_table_iter_init (&iter, gum_module_entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+      entry->seen = FALSE;
+
+    gum_process_enumerate_modules (gum_collect_module_functions, NULL);
+
+    g_hash_table_foreach_remove (gum_module_entries,
+        (GHRFunc) gum_module_entry_purge_if_unseen, NULL);
   }
-  else
+}
+
+static gboolean
+gum_module_generations_changed (void)
+{
+  GumModuleGenerations current;
+  gboolean changed;
+
+  current.valid = FALSE;
+  dl_iterate_phdr (gum_read_module_generations, &current);
+
+  if (!current.valid)
   {
-    need_update = g_timer_elapsed (gum_cache_timer, NULL) >= GUM_MAX_CACHE_AGE;
+    /*
+     * The dynamic linker does not keep track of load and unload counts, so
+     * fall back to assuming that things change every now and then.
+     */
+    if (gum_cache_timer == NULL)
+    {
+      gum_cache_timer = g_timer_new ();
+
+      return TRUE;
+    }
+
+    if (g_timer_elapsed (gum_cache_timer, NULL) < GUM_MAX_CACHE_AGE)
+      return FALSE;
+
+    g_timer_start (gum_cache_timer);
+
+    return TRUE;
   }
 
-  if (need_update)
+  changed = !gum_cached_generations.valid ||
+      current.adds != gum_cached_generations.adds ||
+      current.subs != gum_cached_generations.subs;
+
+  gum_cached_generations = current;
+
+  return changed;
+}
+
+static int
+gum_read_module_generations (struct dl_phdr_info * info,
+                             size_t size,
+                             void * data)
+{
+  GumModuleGenerations * generations = data;
+
+  if (size >= G_STRUCT_OFFSET (struct dl_phdr_info, dlpi_subs) +
+      sizeof (info->dlpi_subs))
   {
-    gum_process_enumerate_modules (gum_collect_module_functions, NULL);
+    generations->valid = TRUE;
+    generations->adds = info->dlpi_adds;
+    generations->subs = info->dlpi_subs;
+  }
+
+  return 1;
+}
+
+static gboolean
+gum_module_entry_purge_if_unseen (const gchar * path,
+                                  GumModuleEntry * entry,
+                                  gpointer user_data)
+{
+  if (entry->seen)
+    return FALSE;
+
+  gum_module_entry_purge_symbols (entry);
+
+  return TRUE;
+}
+
+static void
+gum_module_entry_purge_symbols (GumModuleEntry * entry)
+{
+  const GumMemoryRange * range = &entry->range;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  if (!entry->collected)
+    return;
+
+  g_hash_table_iter_init (&iter, gum_address_symbols);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+  {
+    if (GUM_MEMORY_RANGE_INCLUDES (range, GUM_ADDRESS (key)))
+      g_hash_table_iter_remove (&iter);
+  }
+
+  g_hash_table_iter_init (&iter, gum_function_addresses);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+  {
+    GArray * addresses = value;
+    guint i;
+
+    for (i = 0; i != addresses->len;)
+    {
+      gpointer address = g_array_index (addresses, gpointer, i);
+
+      if (GUM_MEMORY_RANGE_INCLUDES (range, GUM_ADDRESS (address)))
+        g_array_remove_index_fast (addresses, i);
+      else
+        i++;
+    }
+
+    if (addresses->len == 0)
+      g_hash_table_iter_remove (&iter);
   }
 }
 
@@ -638,9 +777,16 @@ gum_collect_module_functions (const GumModuleDetails * details,
 
   entry = gum_module_entry_from_path_and_base (details->path,
       details->range->base_address);
-  if (entry == NULL || entry->collected)
+  if (entry == NULL)
     return TRUE;
 
+  entry->seen = TRUE;
+
+  if (entry->collected)
+    return TRUE;
+
+  entry->range = *details->range;
+
   gum_elf_module_enumerate_dynamic_symbols (entry->module,
       gum_collect_symbol_if_function, NULL);
 
@@ -742,6 +888,7 @@ static void
 gum_symbol_util_deinitialize (void)
 {
   g_clear_pointer (&gum_cache_timer, g_timer_destroy);
+  gum_cached_generations.valid = FALSE;
 
   g_hash_table_unref (gum_address_symbols);
   gum_address_symbols = NULL;
@@ -46,6 +46,20 @@ gum_stalker_exclude (GumStalker * self,
 {
 }
 
+void
+gum_stalker_set_code_policy (GumStalker * self,
+                             const GumMemoryRange * range,
+                             GumStalkerCodePolicy policy)
+{
+}
+
+void
+gum_stalker_set_trust_threshold_for_range (GumStalker * self,
+                                           const GumMemoryRange * range,
+                                           gint trust_threshold)
+{
+}
+
 gint
 gum_stalker_get_trust_threshold (GumStalker * self)
 {
@@ -58,6 +72,19 @@ gum_stalker_set_trust_threshold (GumStalker * self,
 {
 }
 
+void
+gum_stalker_set_block_counters_enabled (GumStalker * self,
+                                        gboolean enabled)
+{
+}
+
+void
+gum_stalker_enumerate_block_counters (GumStalker * self,
+                                      GumFoundBlockCounterFunc func,
+                                      gpointer user_data)
+{
+}
+
 void
 gum_stalker_flush (GumStalker * self)
 {
@@ -167,6 +194,12 @@ gum_stalker_invalidate_for_thread (GumStalker * self,
 {
 }
 
+void
+gum_stalker_invalidate_range (GumStalker * self,
+                              const GumMemoryRange * range)
+{
+}
+
 GumProbeId
 gum_stalker_add_call_probe (GumStalker * self,
                             gpointer target_address,
@@ -10,6 +10,7 @@
 #include "gumprocess-priv.h"
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
@@ -63,6 +64,36 @@ _gum_memory_backend_query_page_size (void)
   return sysconf (_SC_PAGE_SIZE);
 }
 
+gsize
+_gum_memory_backend_query_huge_page_size (void)
+{
+#if defined (HAVE_LINUX) && defined (MADV_HUGEPAGE)
+  gsize result = 0;
+  gchar * enabled = NULL;
+  gchar * pmd_size = NULL;
+
+  if (!g_file_get_contents ("/sys/kernel/mm/transparent_hugepage/enabled",
+        &enabled, NULL, NULL))
+    goto beach;
+  if (strstr (enabled, "[never]") != NULL)
+    goto beach;
+
+  if (!g_file_get_contents (
+        "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", &pmd_size, NULL,
+        NULL))
+    goto beach;
+  result = g_ascii_strtoull (pmd_size, NULL, 10);
+
+beach:
+  g_free (pmd_size);
+  g_free (enabled);
+
+  return result;
+#else
+  return 0;
+#endif
+}
+
 gpointer
 gum_try_alloc_n_pages (guint n_pages,
                        GumPageProtection prot)
@@ -346,6 +377,17 @@ gum_memory_discard (gpointer address,
 #endif
 }
 
+gboolean
+gum_memory_advise_huge_pages (gpointer address,
+                              gsize size)
+{
+#if defined (HAVE_LINUX) && defined (MADV_HUGEPAGE)
+  return madvise (address, size, MADV_HUGEPAGE) == 0;
+#else
+  return FALSE;
+#endif
+}
+
 gboolean
 gum_memory_decommit (gpointer address,
                      gsize size)
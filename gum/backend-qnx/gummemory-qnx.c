@@ -33,6 +33,15 @@ gum_memory_is_readable (gconstpointer address,
   return size >= len && (prot & GUM_PAGE_READ) != 0;
 }
 
+gboolean
+gum_memory_query_protection (gconstpointer address,
+                             GumPageProtection * prot)
+{
+  gsize size;
+
+  return gum_memory_get_protection (address, 1, &size, prot);
+}
+
 static gboolean
 gum_memory_is_writable (gconstpointer address,
                         gsize len)
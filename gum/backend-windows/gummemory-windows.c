@@ -37,6 +37,12 @@ _gum_memory_backend_query_page_size (void)
   return si.dwPageSize;
 }
 
+gsize
+_gum_memory_backend_query_huge_page_size (void)
+{
+  return 0;
+}
+
 gboolean
 gum_memory_is_readable (gconstpointer address,
                         gsize len)
@@ -49,6 +55,13 @@ gum_memory_is_readable (gconstpointer address,
   return (prot & GUM_PAGE_READ) != 0;
 }
 
+gboolean
+gum_memory_query_protection (gconstpointer address,
+                             GumPageProtection * prot)
+{
+  return gum_memory_get_protection (address, 1, prot);
+}
+
 guint8 *
 gum_memory_read (gconstpointer address,
                  gsize len,
@@ -334,6 +347,13 @@ gum_memory_discard (gpointer address,
   return VirtualAlloc (address, size, MEM_RESET, PAGE_READWRITE) != NULL;
 }
 
+gboolean
+gum_memory_advise_huge_pages (gpointer address,
+                              gsize size)
+{
+  return FALSE;
+}
+
 gboolean
 gum_memory_decommit (gpointer address,
                      gsize size)
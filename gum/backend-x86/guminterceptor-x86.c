@@ -12,6 +12,10 @@
 #include "gumsysinternals.h"
 #include "gumx86reader.h"
 #include "gumx86relocator.h"
+#if defined (HAVE_LINUX) && GLIB_SIZEOF_VOID_P == 8
+# include "guminterceptor-elf.h"
+# define GUM_HAVE_GRAFTED_TRAMPOLINES 1
+#endif
 
 #include <string.h>
 
@@ -95,7 +99,12 @@ gboolean
 _gum_interceptor_backend_claim_grafted_trampoline (GumInterceptorBackend * self,
                                                    GumFunctionContext * ctx)
 {
+#ifdef GUM_HAVE_GRAFTED_TRAMPOLINES
+  return _gum_interceptor_elf_claim_grafted_trampoline (ctx,
+      self->enter_thunk->data, self->leave_thunk->data);
+#else
   return FALSE;
+#endif
 }
 
 static gboolean
@@ -170,7 +179,7 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
   GumX86Writer * cw = &self->writer;
   GumX86Relocator * rl = &self->relocator;
   GumX86FunctionContextData * data = GUM_FCDATA (ctx);
-  GumAddress function_ctx_ptr;
+  GumAddress function_ctx_ptr = 0;
   guint reloc_bytes;
 
   if (!gum_interceptor_backend_prepare_trampoline (self, ctx))
@@ -186,13 +195,33 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
 
     ctx->on_enter_trampoline = gum_x86_writer_cur (cw);
 
+    if (ctx->return_stack_balanced)
+    {
+      gconstpointer enter = cw->code + 1;
+
+      /*
+       * Give the enter thunk's RET a return stack buffer entry of its own to
+       * consume, instead of the one belonging to our caller.
+       */
+      gum_x86_writer_put_call_near_label (cw, enter);
+      gum_x86_writer_put_breakpoint (cw);
+
+      gum_x86_writer_put_label (cw, enter);
+      gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+          GUM_X86_XSP, sizeof (gpointer));
+    }
+
     gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
     gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->enter_thunk->data));
 
-    ctx->on_leave_trampoline = gum_x86_writer_cur (cw);
+    if (!ctx->return_stack_balanced)
+    {
+      ctx->on_leave_trampoline = gum_x86_writer_cur (cw);
 
-    gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
-    gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->leave_thunk->data));
+      gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
+      gum_x86_writer_put_jmp_address (cw,
+          GUM_ADDRESS (self->leave_thunk->data));
+    }
 
     gum_x86_writer_flush (cw);
     g_assert (gum_x86_writer_offset (cw) <= ctx->trampoline_slice->size);
@@ -218,6 +247,28 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
   gum_x86_writer_flush (cw);
   g_assert (gum_x86_writer_offset (cw) <= ctx->trampoline_slice->size);
 
+  if (ctx->type != GUM_INTERCEPTOR_TYPE_FAST && ctx->return_stack_balanced)
+  {
+    /*
+     * Swap the caller's return address for our own by calling the function,
+     * so that its RET and ours each have a matching CALL.
+     */
+    ctx->on_call_trampoline = gum_x86_writer_cur (cw);
+
+    gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+        GUM_X86_XSP, sizeof (gpointer));
+    gum_x86_writer_put_call_address (cw,
+        GUM_ADDRESS (ctx->on_invoke_trampoline));
+
+    ctx->on_leave_trampoline = gum_x86_writer_cur (cw);
+
+    gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
+    gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->leave_thunk->data));
+
+    gum_x86_writer_flush (cw);
+    g_assert (gum_x86_writer_offset (cw) <= ctx->trampoline_slice->size);
+  }
+
   ctx->overwritten_prologue_len = reloc_bytes;
   gum_memcpy (ctx->overwritten_prologue, ctx->function_address, reloc_bytes);
 
@@ -228,6 +279,14 @@ void
 _gum_interceptor_backend_destroy_trampoline (GumInterceptorBackend * self,
                                              GumFunctionContext * ctx)
 {
+#ifdef GUM_HAVE_GRAFTED_TRAMPOLINES
+  if (ctx->grafted_hook != NULL || ctx->import_target != NULL)
+  {
+    _gum_interceptor_elf_destroy_grafted_trampoline (ctx);
+    return;
+  }
+#endif
+
   gum_code_slice_unref (ctx->trampoline_slice);
   ctx->trampoline_slice = NULL;
 }
@@ -240,6 +299,14 @@ _gum_interceptor_backend_activate_trampoline (GumInterceptorBackend * self,
   GumX86Writer * cw = &self->writer;
   guint padding;
 
+#ifdef GUM_HAVE_GRAFTED_TRAMPOLINES
+  if (ctx->grafted_hook != NULL || ctx->import_target != NULL)
+  {
+    _gum_interceptor_elf_activate_grafted_trampoline (ctx);
+    return;
+  }
+#endif
+
   gum_x86_writer_reset (cw, prologue);
   cw->pc = GPOINTER_TO_SIZE (ctx->function_address);
 
@@ -268,6 +335,14 @@ _gum_interceptor_backend_deactivate_trampoline (GumInterceptorBackend * self,
                                                 GumFunctionContext * ctx,
                                                 gpointer prologue)
 {
+#ifdef GUM_HAVE_GRAFTED_TRAMPOLINES
+  if (ctx->grafted_hook != NULL || ctx->import_target != NULL)
+  {
+    _gum_interceptor_elf_deactivate_grafted_trampoline (ctx);
+    return;
+  }
+#endif
+
   gum_memcpy (prologue, ctx->overwritten_prologue,
       ctx->overwritten_prologue_len);
 }
@@ -288,6 +363,12 @@ _gum_interceptor_backend_resolve_redirect (GumInterceptorBackend * self,
   if (target == NULL)
     target = gum_x86_reader_try_get_indirect_jump_target (address);
 
+#ifdef GUM_HAVE_GRAFTED_TRAMPOLINES
+  /* Avoid following grafted branches. */
+  if (target != NULL && _gum_interceptor_elf_is_grafted_hook_site (address))
+    return NULL;
+#endif
+
   return target;
 }
 
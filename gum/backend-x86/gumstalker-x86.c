@@ -10,15 +10,15 @@
 
 #include "gumstalker.h"
 
+#include "gummetalarray.h"
 #include "gummetalhash.h"
 #include "gumx86reader.h"
 #include "gumx86writer.h"
 #include "gummemory.h"
 #include "gumx86relocator.h"
 #include "gumspinlock.h"
-#ifdef HAVE_WINDOWS
-# include "gumexceptor.h"
-#endif
+#include "gumexceptor.h"
+#include "gumperfmap-priv.h"
 #ifdef HAVE_LINUX
 # include "gum-init.h"
 # include "gumelfmodule.h"
@@ -76,6 +76,11 @@
     (sizeof (GumCpuContext) + sizeof (gpointer))
 #define GUM_X86_THUNK_ARGLIST_STACK_RESERVE 64 /* x64 ABI compatibility */
 
+#define GUM_GUARDED_PAGE_ARMED (1 << 0)
+#define GUM_GUARDED_PAGE_DIRTY (1 << 1)
+
+#define GUM_TRUST_THRESHOLD_INHERIT G_MININT
+
 #define GUM_STALKER_LOCK(o) g_mutex_lock (&(o)->mutex)
 #define GUM_STALKER_UNLOCK(o) g_mutex_unlock (&(o)->mutex)
 
@@ -83,7 +88,16 @@ typedef struct _GumInfectContext GumInfectContext;
 typedef struct _GumDisinfectContext GumDisinfectContext;
 typedef struct _GumActivation GumActivation;
 typedef struct _GumInvalidateContext GumInvalidateContext;
+typedef struct _GumInvalidateRangeContext GumInvalidateRangeContext;
+typedef struct _GumCodePolicyEntry GumCodePolicyEntry;
+typedef struct _GumGuardedPage GumGuardedPage;
+typedef struct _GumGuardedPageTable GumGuardedPageTable;
+typedef struct _GumCollectGuardablePagesContext
+    GumCollectGuardablePagesContext;
 typedef struct _GumCallProbe GumCallProbe;
+typedef struct _GumCallProbeSite GumCallProbeSite;
+typedef struct _GumCallProbeSnapshot GumCallProbeSnapshot;
+typedef struct _GumProbeGarbage GumProbeGarbage;
 
 typedef struct _GumExecCtx GumExecCtx;
 typedef guint GumExecCtxMode;
@@ -110,6 +124,7 @@ typedef struct _GumBackpatchRet GumBackpatchRet;
 typedef struct _GumBackpatchJmp GumBackpatchJmp;
 typedef struct _GumBackpatchInlineCache GumBackpatchInlineCache;
 typedef struct _GumIcEntry GumIcEntry;
+typedef struct _GumPerfMapEntry GumPerfMapEntry;
 
 typedef guint GumVirtualizationRequirements;
 
@@ -168,6 +183,7 @@ struct _GumStalker
   goffset code_slab_offset;
   gsize code_slab_size_initial;
   gsize code_slab_size_dynamic;
+  gsize code_slab_alignment;
 
   /*
    * The instrumented code which Stalker generates is split into two parts.
@@ -203,11 +219,38 @@ struct _GumStalker
 
   GArray * exclusions;
   gint trust_threshold;
+  gboolean block_counters_enabled;
   volatile gboolean any_probes_attached;
   volatile gint last_probe_id;
   GumSpinlock probe_lock;
   GHashTable * probe_target_by_id;
-  GHashTable * probe_array_by_address;
+  GHashTable * probe_site_by_address;
+  volatile gint probe_epoch;
+  GSList * probe_garbage;
+
+  /*
+   * Code policies let static code be trusted outright, and JIT regions be
+   * guarded by write-protecting the source pages of the blocks compiled from
+   * them. Writes to a guarded page are caught by the exceptor, which runs in
+   * signal context and therefore only restores write access and marks the
+   * page dirty. The guarded page table is immutable once published, so the
+   * handler can look pages up without taking any locks. The affected blocks
+   * are invalidated by the next stalked thread that looks up a block, and
+   * pages are re-armed as blocks on them get compiled again. Guarded blocks
+   * are never backpatched nor added to inline caches, so control always goes
+   * through such a lookup before entering one.
+   *
+   * Note that writes done by the kernel on behalf of a syscall, e.g. read(2)
+   * into an armed page, do not fault but fail with EFAULT instead. Such
+   * regions must not be guarded.
+   */
+  GumSpinlock code_policy_lock;
+  GArray * code_policies;
+  GumGuardedPageTable * guarded_pages;
+  GSList * retired_guarded_page_tables;
+  volatile gint guarded_pages_dirty;
+  volatile gint guarded_pages_draining;
+  GumExceptor * code_guard_exceptor;
 
 #ifdef HAVE_WINDOWS
   GumExceptor * exceptor;
@@ -245,6 +288,40 @@ struct _GumInvalidateContext
   gboolean is_executing_target_block;
 };
 
+struct _GumInvalidateRangeContext
+{
+  GumExecBlock ** blocks;
+  guint num_blocks;
+  gboolean is_executing_target_block;
+};
+
+struct _GumCodePolicyEntry
+{
+  GumMemoryRange range;
+  GumStalkerCodePolicy policy;
+  gint trust_threshold;
+};
+
+struct _GumGuardedPage
+{
+  gpointer base;
+  GumPageProtection protection;
+  volatile guint state;
+};
+
+struct _GumGuardedPageTable
+{
+  GumGuardedPage ** pages;
+  guint length;
+};
+
+struct _GumCollectGuardablePagesContext
+{
+  const GumMemoryRange * range;
+  gsize page_size;
+  GArray * pages;
+};
+
 struct _GumCallProbe
 {
   gint ref_count;
@@ -254,6 +331,33 @@ struct _GumCallProbe
   GDestroyNotify user_notify;
 };
 
+/*
+ * Call probes are dispatched without taking any locks. Each probed target
+ * address gets a site, which lives for as long as the GumStalker and is baked
+ * into the compiled blocks. The site points to an immutable snapshot of the
+ * probes attached, which is replaced wholesale whenever a probe is added or
+ * removed. Replaced snapshots are retired along with the epoch at which that
+ * happened, and reclaimed once no thread is still dispatching from an epoch
+ * that old.
+ */
+struct _GumCallProbeSite
+{
+  GumCallProbeSnapshot * snapshot;
+  GPtrArray * probes;
+};
+
+struct _GumCallProbeSnapshot
+{
+  guint num_probes;
+  GumCallProbe * probes[1];
+};
+
+struct _GumProbeGarbage
+{
+  gint epoch;
+  GumCallProbeSnapshot * snapshot;
+};
+
 struct _GumExecCtx
 {
   volatile gint state;
@@ -294,6 +398,8 @@ struct _GumExecCtx
   gpointer app_stack;
   gconstpointer activation_target;
 
+  volatile gint probe_epoch;
+
   gpointer thunks;
   gpointer infect_thunk;
   GumAddress infect_body;
@@ -304,6 +410,24 @@ struct _GumExecCtx
   GumDataSlab * data_slab;
   GumCodeSlab * scratch_slab;
   GumMetalHashTable * mappings;
+
+  /*
+   * Index of the blocks in mappings, ordered by real_start. Only kept sorted
+   * lazily, as it is only consulted when invalidating a range, whereas blocks
+   * are added to it every time one is compiled.
+   */
+  GumMetalArray block_index;
+  gboolean block_index_sorted;
+  guint block_index_max_real_size;
+
+  /*
+   * Perf map entries for blocks compiled while holding code_lock. Resolving
+   * symbol names and writing to the perf map is far too slow to be done with
+   * the lock held, so they are queued here and written once it is released.
+   * Only ever touched by the thread compiling the blocks.
+   */
+  GumMetalArray pending_perf_map_entries;
+
   gpointer last_prolog_minimal;
   gpointer last_epilog_minimal;
   gpointer last_prolog_full;
@@ -367,6 +491,8 @@ struct _GumExecBlock
 
   GumExecBlockFlags flags;
   gint recycle_count;
+  gint trust_threshold;
+  guint64 exec_count;
 
   GumIcEntry * ic_entries;
 };
@@ -374,6 +500,9 @@ struct _GumExecBlock
 enum _GumExecBlockFlags
 {
   GUM_EXEC_BLOCK_ACTIVATION_TARGET = 1 << 0,
+  GUM_EXEC_BLOCK_TRUSTED           = 1 << 1,
+  GUM_EXEC_BLOCK_GUARDED           = 1 << 2,
+  GUM_EXEC_BLOCK_STORAGE           = 1 << 3,
 };
 
 struct _GumSlab
@@ -525,6 +654,15 @@ struct _GumIcEntry
   gpointer code_start;
 };
 
+struct _GumPerfMapEntry
+{
+  gconstpointer real_start;
+  gconstpointer code_start;
+  gsize code_size;
+  gconstpointer slow_start;
+  gsize slow_size;
+};
+
 enum _GumVirtualizationRequirements
 {
   GUM_REQUIRE_NOTHING         = 0,
@@ -584,9 +722,45 @@ static gboolean gum_stalker_do_invalidate (GumExecCtx * ctx,
     gconstpointer address, GumActivation * activation);
 static void gum_stalker_try_invalidate_block_owned_by_thread (
     GumThreadId thread_id, GumCpuContext * cpu_context, gpointer user_data);
+static void gum_stalker_invalidate_range_for_all_threads (GumStalker * self,
+    const GumMemoryRange * range, GumActivation * activation);
+static gboolean gum_stalker_do_invalidate_range (GumExecCtx * ctx,
+    const GumMemoryRange * range, GumActivation * activation);
+static void gum_stalker_try_invalidate_blocks_owned_by_thread (
+    GumThreadId thread_id, GumCpuContext * cpu_context, gpointer user_data);
+
+static gboolean gum_stalker_collect_guardable_pages (
+    const GumRangeDetails * details, gpointer user_data);
+static void gum_stalker_add_guarded_pages (GumStalker * self,
+    GArray * candidates);
+static void gum_stalker_add_code_policy (GumStalker * self,
+    const GumMemoryRange * range, GumStalkerCodePolicy policy,
+    gint trust_threshold);
+static GumStalkerCodePolicy gum_stalker_get_code_policy (GumStalker * self,
+    gconstpointer address, gint * trust_threshold);
+static gboolean gum_stalker_guard_code (GumStalker * self,
+    gconstpointer start, gsize size);
+static void gum_stalker_unguard_all_pages (GumStalker * self);
+static void gum_stalker_free_guarded_pages (GumStalker * self);
+static gboolean gum_stalker_on_guarded_code_write (
+    GumExceptionDetails * details, gpointer user_data);
+static void gum_stalker_invalidate_dirty_guarded_pages (GumStalker * self,
+    GumExecCtx * ctx);
+static GumGuardedPage * gum_guarded_page_table_lookup (
+    const GumGuardedPageTable * table, gconstpointer base);
+static void gum_guarded_page_table_free (GumGuardedPageTable * table);
+static gint gum_compare_guarded_pages (gconstpointer a, gconstpointer b);
+static gint gum_compare_guarded_page_refs (gconstpointer a, gconstpointer b);
 
 static GumCallProbe * gum_call_probe_ref (GumCallProbe * probe);
 static void gum_call_probe_unref (GumCallProbe * probe);
+static GumCallProbeSite * gum_call_probe_site_new (void);
+static void gum_call_probe_site_free (GumCallProbeSite * site);
+static void gum_call_probe_site_publish (GumCallProbeSite * site,
+    GumStalker * stalker);
+static GumCallProbeSnapshot * gum_call_probe_snapshot_new (GPtrArray * probes);
+static void gum_call_probe_snapshot_free (GumCallProbeSnapshot * snapshot);
+static void gum_stalker_collect_probe_garbage (GumStalker * self);
 
 static GumExecCtx * gum_stalker_create_exec_ctx (GumStalker * self,
     GumThreadId thread_id, GumStalkerTransformer * transformer,
@@ -602,6 +776,8 @@ static gsize gum_stalker_get_ic_entry_size (GumStalker * stalker);
 
 static void gum_stalker_thaw (GumStalker * self, gpointer code, gsize size);
 static void gum_stalker_freeze (GumStalker * self, gpointer code, gsize size);
+static gpointer gum_stalker_allocate_code_slab (GumStalker * self,
+    const GumAddressSpec * spec, gsize size);
 
 static GumExecCtx * gum_exec_ctx_new (GumStalker * self, GumThreadId thread_id,
     GumStalkerTransformer * transformer, GumEventSink * sink);
@@ -634,11 +810,21 @@ static GumExecBlock * gum_exec_ctx_build_block (GumExecCtx * ctx,
     gpointer real_address);
 static void gum_exec_ctx_recompile_block (GumExecCtx * ctx,
     GumExecBlock * block);
+static void gum_exec_ctx_apply_code_policy (GumExecCtx * ctx,
+    GumExecBlock * block);
+static void gum_exec_ctx_index_block (GumExecCtx * ctx, GumExecBlock * block);
+static GumExecBlock ** gum_exec_ctx_find_blocks_in_range (GumExecCtx * ctx,
+    const GumMemoryRange * range, guint * n_blocks);
+static gint gum_exec_block_compare_by_real_start (gconstpointer a,
+    gconstpointer b);
 static void gum_exec_ctx_compile_block (GumExecCtx * ctx, GumExecBlock * block,
     gconstpointer input_code, gpointer output_code, GumAddress output_pc,
     guint * input_size, guint * output_size, guint * slow_size);
 static void gum_exec_ctx_maybe_emit_compile_event (GumExecCtx * ctx,
     GumExecBlock * block);
+static void gum_exec_ctx_maybe_queue_perf_map_entries (GumExecCtx * ctx,
+    GumExecBlock * block);
+static void gum_exec_ctx_flush_perf_map_entries (GumExecCtx * ctx);
 
 static gboolean gum_stalker_iterator_is_out_of_space (
     GumStalkerIterator * self);
@@ -692,6 +878,7 @@ static void gum_exec_block_clear (GumExecBlock * block);
 static void gum_exec_block_commit (GumExecBlock * block);
 static void gum_exec_block_invalidate (GumExecBlock * block);
 static gpointer gum_exec_block_get_snapshot_start (GumExecBlock * block);
+static gint gum_exec_block_get_trust_threshold (GumExecBlock * block);
 static GumCalloutEntry * gum_exec_block_get_last_callout_entry (
     const GumExecBlock * block);
 static void gum_exec_block_set_last_callout_entry (GumExecBlock * block,
@@ -787,12 +974,14 @@ static void gum_exec_block_write_block_event_code (GumExecBlock * block,
 static void gum_exec_block_write_unfollow_check_code (GumExecBlock * block,
     GumGeneratorContext * gc, GumCodeContext cc);
 
+static void gum_exec_block_maybe_write_counter_code (GumExecBlock * block,
+    GumGeneratorContext * gc);
 static void gum_exec_block_maybe_write_call_probe_code (GumExecBlock * block,
     GumGeneratorContext * gc);
 static void gum_exec_block_write_call_probe_code (GumExecBlock * block,
-    GumGeneratorContext * gc);
+    GumCallProbeSite * site, GumGeneratorContext * gc);
 static void gum_exec_block_invoke_call_probes (GumExecBlock * block,
-    GumCpuContext * cpu_context);
+    GumCallProbeSite * site, GumCpuContext * cpu_context);
 
 static gpointer gum_exec_block_write_inline_data (GumX86Writer * cw,
     gconstpointer data, gsize size, GumAddress * address);
@@ -906,15 +1095,19 @@ gum_stalker_class_init (GumStalkerClass * klass)
 static void
 gum_stalker_init (GumStalker * self)
 {
-  gsize page_size;
+  gsize page_size, huge_page_size;
 
   self->exclusions = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
   self->trust_threshold = 1;
 
   gum_spinlock_init (&self->probe_lock);
   self->probe_target_by_id = g_hash_table_new_full (NULL, NULL, NULL, NULL);
-  self->probe_array_by_address = g_hash_table_new_full (NULL, NULL, NULL,
-      (GDestroyNotify) g_ptr_array_unref);
+  self->probe_site_by_address = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) gum_call_probe_site_free);
+  self->probe_epoch = 1;
+
+  gum_spinlock_init (&self->code_policy_lock);
+  self->code_policies = g_array_new (FALSE, FALSE, sizeof (GumCodePolicyEntry));
 
   page_size = gum_query_page_size ();
 
@@ -955,6 +1148,21 @@ gum_stalker_init (GumStalker * self)
   self->cpu_features = gum_query_cpu_features ();
   self->is_rwx_supported = gum_query_rwx_support () != GUM_RWX_NONE;
 
+  /*
+   * Only when RWX is supported, as mprotect()ing parts of a huge page would
+   * split it right back up.
+   */
+  huge_page_size = gum_query_huge_page_size ();
+  if (self->is_rwx_supported && huge_page_size != 0 &&
+      self->code_slab_size_dynamic % huge_page_size == 0)
+  {
+    self->code_slab_alignment = huge_page_size;
+  }
+  else
+  {
+    self->code_slab_alignment = page_size;
+  }
+
   g_mutex_init (&self->mutex);
   self->contexts = NULL;
 
@@ -1175,13 +1383,24 @@ gum_stalker_exception_find_fde (const void * pc,
 static void
 gum_stalker_dispose (GObject * object)
 {
+  GumStalker * self = GUM_STALKER (object);
+  GumExceptor * code_guard_exceptor;
+
+  code_guard_exceptor = g_steal_pointer (&self->code_guard_exceptor);
+  if (code_guard_exceptor != NULL)
+  {
+    gum_exceptor_remove (code_guard_exceptor,
+        gum_stalker_on_guarded_code_write, self);
+
+    g_object_unref (code_guard_exceptor);
+  }
+
+  gum_stalker_unguard_all_pages (self);
+
 #ifdef HAVE_WINDOWS
   {
-    GumStalker * self;
     GumExceptor * exceptor;
 
-    self = GUM_STALKER (object);
-
     exceptor = g_steal_pointer (&self->exceptor);
     if (exceptor != NULL)
     {
@@ -1204,9 +1423,15 @@ gum_stalker_finalize (GObject * object)
   g_array_unref (self->wow_transition_impls);
 #endif
 
-  g_hash_table_unref (self->probe_array_by_address);
+  gum_stalker_collect_probe_garbage (self);
+  g_assert (self->probe_garbage == NULL);
+
+  g_hash_table_unref (self->probe_site_by_address);
   g_hash_table_unref (self->probe_target_by_id);
 
+  gum_stalker_free_guarded_pages (self);
+  g_array_free (self->code_policies, TRUE);
+
   g_array_free (self->exclusions, TRUE);
 
   g_assert (self->contexts == NULL);
@@ -1288,6 +1513,432 @@ gum_stalker_is_excluding (GumStalker * self,
   return FALSE;
 }
 
+void
+gum_stalker_set_code_policy (GumStalker * self,
+                             const GumMemoryRange * range,
+                             GumStalkerCodePolicy policy)
+{
+  if (policy == GUM_STALKER_CODE_GUARDED)
+  {
+    GumCollectGuardablePagesContext cc;
+
+    cc.range = range;
+    cc.page_size = self->page_size;
+    cc.pages = g_array_new (FALSE, FALSE, sizeof (GumGuardedPage));
+
+    gum_process_enumerate_ranges (GUM_PAGE_WRITE,
+        gum_stalker_collect_guardable_pages, &cc);
+
+    gum_spinlock_acquire (&self->code_policy_lock);
+    gum_stalker_add_guarded_pages (self, cc.pages);
+    gum_spinlock_release (&self->code_policy_lock);
+
+    g_array_free (cc.pages, TRUE);
+
+    GUM_STALKER_LOCK (self);
+    if (self->code_guard_exceptor == NULL)
+    {
+      self->code_guard_exceptor = gum_exceptor_obtain ();
+      gum_exceptor_add (self->code_guard_exceptor,
+          gum_stalker_on_guarded_code_write, self);
+    }
+    GUM_STALKER_UNLOCK (self);
+  }
+
+  gum_stalker_add_code_policy (self, range, policy,
+      GUM_TRUST_THRESHOLD_INHERIT);
+}
+
+void
+gum_stalker_set_trust_threshold_for_range (GumStalker * self,
+                                           const GumMemoryRange * range,
+                                           gint trust_threshold)
+{
+  gum_stalker_add_code_policy (self, range, GUM_STALKER_CODE_CHECKED,
+      trust_threshold);
+}
+
+static void
+gum_stalker_add_code_policy (GumStalker * self,
+                             const GumMemoryRange * range,
+                             GumStalkerCodePolicy policy,
+                             gint trust_threshold)
+{
+  GumCodePolicyEntry entry;
+
+  entry.range = *range;
+  entry.policy = policy;
+  entry.trust_threshold = trust_threshold;
+
+  gum_spinlock_acquire (&self->code_policy_lock);
+  g_array_append_val (self->code_policies, entry);
+  gum_spinlock_release (&self->code_policy_lock);
+
+  gum_stalker_invalidate_range (self, range);
+}
+
+static gboolean
+gum_stalker_collect_guardable_pages (const GumRangeDetails * details,
+                                     gpointer user_data)
+{
+  GumCollectGuardablePagesContext * cc = user_data;
+  const GumMemoryRange * r = details->range;
+  GumAddress start, end, page;
+
+  start = MAX (r->base_address, cc->range->base_address);
+  end = MIN (r->base_address + r->size,
+      cc->range->base_address + cc->range->size);
+  if (start >= end)
+    return TRUE;
+
+  for (page = start & ~((GumAddress) cc->page_size - 1);
+      page < end;
+      page += cc->page_size)
+  {
+    GumGuardedPage p;
+
+    p.base = GSIZE_TO_POINTER (page);
+    p.protection = details->protection;
+    p.state = 0;
+
+    g_array_append_val (cc->pages, p);
+  }
+
+  return TRUE;
+}
+
+static void
+gum_stalker_add_guarded_pages (GumStalker * self,
+                               GArray * candidates)
+{
+  GumGuardedPageTable * old_table, * table;
+  GPtrArray * pages;
+  gpointer previous_base;
+  guint i;
+
+  old_table = self->guarded_pages;
+
+  pages = g_ptr_array_sized_new (candidates->len +
+      ((old_table != NULL) ? old_table->length : 0));
+
+  if (old_table != NULL)
+  {
+    for (i = 0; i != old_table->length; i++)
+      g_ptr_array_add (pages, old_table->pages[i]);
+  }
+
+  g_array_sort (candidates, gum_compare_guarded_pages);
+
+  previous_base = NULL;
+  for (i = 0; i != candidates->len; i++)
+  {
+    GumGuardedPage * candidate =
+        &g_array_index (candidates, GumGuardedPage, i);
+
+    if (candidate->base == previous_base)
+      continue;
+    previous_base = candidate->base;
+
+    if (old_table != NULL &&
+        gum_guarded_page_table_lookup (old_table, candidate->base) != NULL)
+    {
+      continue;
+    }
+
+    g_ptr_array_add (pages, g_slice_dup (GumGuardedPage, candidate));
+  }
+
+  g_ptr_array_sort (pages, gum_compare_guarded_page_refs);
+
+  table = g_slice_new (GumGuardedPageTable);
+  table->length = pages->len;
+  table->pages = (GumGuardedPage **) g_ptr_array_free (pages, FALSE);
+
+  /*
+   * The exception handler may still be looking at the old table, so it is
+   * kept around until we are finalized.
+   */
+  g_atomic_pointer_set (&self->guarded_pages, table);
+  if (old_table != NULL)
+  {
+    self->retired_guarded_page_tables =
+        g_slist_prepend (self->retired_guarded_page_tables, old_table);
+  }
+}
+
+static GumStalkerCodePolicy
+gum_stalker_get_code_policy (GumStalker * self,
+                             gconstpointer address,
+                             gint * trust_threshold)
+{
+  GumStalkerCodePolicy policy = GUM_STALKER_CODE_CHECKED;
+  GArray * policies = self->code_policies;
+  guint i;
+
+  *trust_threshold = GUM_TRUST_THRESHOLD_INHERIT;
+
+  gum_spinlock_acquire (&self->code_policy_lock);
+
+  for (i = policies->len; i != 0; i--)
+  {
+    GumCodePolicyEntry * entry =
+        &g_array_index (policies, GumCodePolicyEntry, i - 1);
+
+    if (GUM_MEMORY_RANGE_INCLUDES (&entry->range, GUM_ADDRESS (address)))
+    {
+      policy = entry->policy;
+      *trust_threshold = entry->trust_threshold;
+      break;
+    }
+  }
+
+  gum_spinlock_release (&self->code_policy_lock);
+
+  return policy;
+}
+
+static gboolean
+gum_stalker_guard_code (GumStalker * self,
+                        gconstpointer start,
+                        gsize size)
+{
+  gboolean success = TRUE;
+  const gsize page_size = self->page_size;
+  guint8 * base, * end;
+  GumGuardedPageTable * table;
+
+  base = GSIZE_TO_POINTER (GPOINTER_TO_SIZE (start) & ~(page_size - 1));
+  end = (guint8 *) start + size;
+
+  gum_spinlock_acquire (&self->code_policy_lock);
+
+  table = self->guarded_pages;
+
+  for (; base < end && success; base += page_size)
+  {
+    GumGuardedPage * page;
+
+    page = (table != NULL) ? gum_guarded_page_table_lookup (table, base) : NULL;
+    if (page == NULL)
+    {
+      success = FALSE;
+    }
+    else if ((g_atomic_int_or (&page->state, GUM_GUARDED_PAGE_ARMED) &
+        GUM_GUARDED_PAGE_ARMED) == 0)
+    {
+      GumPageProtection prot;
+
+      /* The application may have changed it since the policy was applied. */
+      if (gum_memory_query_protection (base, &prot))
+        page->protection = prot;
+
+      success = gum_try_mprotect (base, page_size,
+          page->protection & ~GUM_PAGE_WRITE);
+      if (!success)
+        g_atomic_int_and (&page->state, ~GUM_GUARDED_PAGE_ARMED);
+    }
+  }
+
+  gum_spinlock_release (&self->code_policy_lock);
+
+  return success;
+}
+
+static void
+gum_stalker_unguard_all_pages (GumStalker * self)
+{
+  GumGuardedPageTable * table;
+  guint i;
+
+  gum_spinlock_acquire (&self->code_policy_lock);
+
+  table = self->guarded_pages;
+  if (table != NULL)
+  {
+    for (i = 0; i != table->length; i++)
+    {
+      GumGuardedPage * page = table->pages[i];
+
+      if ((g_atomic_int_and (&page->state, ~GUM_GUARDED_PAGE_ARMED) &
+          GUM_GUARDED_PAGE_ARMED) != 0)
+      {
+        gum_try_mprotect (page->base, self->page_size, page->protection);
+      }
+    }
+  }
+
+  gum_spinlock_release (&self->code_policy_lock);
+}
+
+static void
+gum_stalker_free_guarded_pages (GumStalker * self)
+{
+  GumGuardedPageTable * table;
+  guint i;
+
+  table = g_steal_pointer (&self->guarded_pages);
+  if (table != NULL)
+  {
+    for (i = 0; i != table->length; i++)
+      g_slice_free (GumGuardedPage, table->pages[i]);
+
+    gum_guarded_page_table_free (table);
+  }
+
+  g_slist_free_full (g_steal_pointer (&self->retired_guarded_page_tables),
+      (GDestroyNotify) gum_guarded_page_table_free);
+}
+
+static gboolean
+gum_stalker_on_guarded_code_write (GumExceptionDetails * details,
+                                   gpointer user_data)
+{
+  GumStalker * self = user_data;
+  GumGuardedPageTable * table;
+  GumGuardedPage * page;
+  gpointer base;
+  GumPageProtection prot;
+
+  if (details->type != GUM_EXCEPTION_ACCESS_VIOLATION ||
+      details->memory.operation != GUM_MEMOP_WRITE)
+  {
+    return FALSE;
+  }
+
+  table = g_atomic_pointer_get (&self->guarded_pages);
+  if (table == NULL)
+    return FALSE;
+
+  base = GSIZE_TO_POINTER (GPOINTER_TO_SIZE (details->memory.address) &
+      ~(self->page_size - 1));
+
+  page = gum_guarded_page_table_lookup (table, base);
+  if (page == NULL)
+    return FALSE;
+
+  /*
+   * Restore write access before disarming, so that a block compiled from the
+   * page in the meantime either sees it armed and gets invalidated along with
+   * the others, or re-arms it and gets caught by the retried write. Only the
+   * write bit is ours to give back, the rest is taken from the page as it is
+   * now.
+   */
+  if (gum_memory_query_protection (base, &prot))
+    prot |= page->protection & GUM_PAGE_WRITE;
+  else
+    prot = page->protection;
+  gum_try_mprotect (base, self->page_size, prot);
+
+  if ((g_atomic_int_and (&page->state, ~GUM_GUARDED_PAGE_ARMED) &
+      GUM_GUARDED_PAGE_ARMED) != 0)
+  {
+    g_atomic_int_or (&page->state, GUM_GUARDED_PAGE_DIRTY);
+    g_atomic_int_set (&self->guarded_pages_dirty, TRUE);
+  }
+
+  return TRUE;
+}
+
+static void
+gum_stalker_invalidate_dirty_guarded_pages (GumStalker * self,
+                                            GumExecCtx * ctx)
+{
+  GumActivation activation;
+
+  if (!g_atomic_int_compare_and_exchange (&self->guarded_pages_draining,
+      FALSE, TRUE))
+  {
+    return;
+  }
+
+  activation.ctx = ctx;
+  activation.pending = FALSE;
+  activation.target = NULL;
+
+  while (g_atomic_int_compare_and_exchange (&self->guarded_pages_dirty,
+      TRUE, FALSE))
+  {
+    GumGuardedPageTable * table;
+    guint i;
+
+    table = g_atomic_pointer_get (&self->guarded_pages);
+
+    for (i = 0; i != table->length; i++)
+    {
+      GumGuardedPage * page = table->pages[i];
+      GumMemoryRange range;
+
+      if ((g_atomic_int_and (&page->state, ~GUM_GUARDED_PAGE_DIRTY) &
+          GUM_GUARDED_PAGE_DIRTY) == 0)
+      {
+        continue;
+      }
+
+      range.base_address = GUM_ADDRESS (page->base);
+      range.size = self->page_size;
+
+      gum_stalker_invalidate_range_for_all_threads (self, &range, &activation);
+    }
+  }
+
+  g_atomic_int_set (&self->guarded_pages_draining, FALSE);
+}
+
+static GumGuardedPage *
+gum_guarded_page_table_lookup (const GumGuardedPageTable * table,
+                               gconstpointer base)
+{
+  guint lo, hi;
+
+  lo = 0;
+  hi = table->length;
+
+  while (lo != hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+    GumGuardedPage * page = table->pages[mid];
+
+    if (page->base == base)
+      return page;
+
+    if ((gconstpointer) page->base < base)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return NULL;
+}
+
+static void
+gum_guarded_page_table_free (GumGuardedPageTable * table)
+{
+  g_free (table->pages);
+
+  g_slice_free (GumGuardedPageTable, table);
+}
+
+static gint
+gum_compare_guarded_pages (gconstpointer a,
+                           gconstpointer b)
+{
+  const GumGuardedPage * page_a = a;
+  const GumGuardedPage * page_b = b;
+
+  if (page_a->base == page_b->base)
+    return 0;
+
+  return (page_a->base < page_b->base) ? -1 : 1;
+}
+
+static gint
+gum_compare_guarded_page_refs (gconstpointer a,
+                               gconstpointer b)
+{
+  return gum_compare_guarded_pages (*((GumGuardedPage * const *) a),
+      *((GumGuardedPage * const *) b));
+}
+
 gint
 gum_stalker_get_trust_threshold (GumStalker * self)
 {
@@ -1301,6 +1952,59 @@ gum_stalker_set_trust_threshold (GumStalker * self,
   self->trust_threshold = trust_threshold;
 }
 
+void
+gum_stalker_set_block_counters_enabled (GumStalker * self,
+                                        gboolean enabled)
+{
+  self->block_counters_enabled = enabled;
+}
+
+void
+gum_stalker_enumerate_block_counters (GumStalker * self,
+                                      GumFoundBlockCounterFunc func,
+                                      gpointer user_data)
+{
+  gboolean carry_on = TRUE;
+  GSList * cur;
+
+  GUM_STALKER_LOCK (self);
+
+  for (cur = self->contexts; cur != NULL && carry_on; cur = cur->next)
+  {
+    GumExecCtx * ctx = cur->data;
+    GumExecBlock * block;
+
+    for (block = ctx->block_list;
+        block != NULL && carry_on;
+        block = block->next)
+    {
+      GumBlockCounterDetails details;
+
+      if ((block->flags & GUM_EXEC_BLOCK_STORAGE) != 0)
+        continue;
+
+      details.thread_id = ctx->thread_id;
+      details.real_start = block->real_start;
+      details.real_size = block->real_size;
+      details.count = block->exec_count;
+
+      /*
+       * Code in a storage block is compiled on behalf of the block itself, so
+       * it keeps counting there, but the storage block has the current size.
+       */
+      if (block->storage_block != NULL)
+        details.real_size = block->storage_block->real_size;
+
+      if (details.count == 0)
+        continue;
+
+      carry_on = func (&details, user_data);
+    }
+  }
+
+  GUM_STALKER_UNLOCK (self);
+}
+
 void
 gum_stalker_flush (GumStalker * self)
 {
@@ -1332,13 +2036,22 @@ void
 gum_stalker_stop (GumStalker * self)
 {
   GSList * cur;
+  GHashTableIter iter;
+  GumCallProbeSite * site;
 
   gum_spinlock_acquire (&self->probe_lock);
   g_hash_table_remove_all (self->probe_target_by_id);
-  g_hash_table_remove_all (self->probe_array_by_address);
+  g_hash_table_iter_init (&iter, self->probe_site_by_address);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &site))
+  {
+    g_ptr_array_set_size (site->probes, 0);
+    gum_call_probe_site_publish (site, self);
+  }
   self->any_probes_attached = FALSE;
   gum_spinlock_release (&self->probe_lock);
 
+  gum_stalker_collect_probe_garbage (self);
+
 rescan:
   GUM_STALKER_LOCK (self);
 
@@ -1402,6 +2115,8 @@ rescan:
 
   GUM_STALKER_UNLOCK (self);
 
+  gum_stalker_collect_probe_garbage (self);
+
   return have_pending_garbage;
 }
 
@@ -1958,6 +2673,19 @@ gum_stalker_invalidate_for_thread (GumStalker * self,
   gum_stalker_maybe_reactivate (self, &activation);
 }
 
+void
+gum_stalker_invalidate_range (GumStalker * self,
+                              const GumMemoryRange * range)
+{
+  GumActivation activation;
+
+  gum_stalker_maybe_deactivate (self, &activation);
+
+  gum_stalker_invalidate_range_for_all_threads (self, range, &activation);
+
+  gum_stalker_maybe_reactivate (self, &activation);
+}
+
 static void
 gum_stalker_invalidate_for_all_threads (GumStalker * self,
                                         gconstpointer address,
@@ -2007,33 +2735,123 @@ gum_stalker_do_invalidate (GumExecCtx * ctx,
     else
     {
       gum_process_modify_thread (ctx->thread_id,
-          gum_stalker_try_invalidate_block_owned_by_thread, &ic,
+          gum_stalker_try_invalidate_block_owned_by_thread, &ic,
+          GUM_MODIFY_THREAD_FLAGS_NONE);
+    }
+  }
+
+  gum_spinlock_release (&ctx->code_lock);
+
+  return !ic.is_executing_target_block;
+}
+
+static void
+gum_stalker_try_invalidate_block_owned_by_thread (GumThreadId thread_id,
+                                                  GumCpuContext * cpu_context,
+                                                  gpointer user_data)
+{
+  GumInvalidateContext * ic = user_data;
+  GumExecBlock * block = ic->block;
+  const guint8 * pc = GSIZE_TO_POINTER (GUM_CPU_CONTEXT_XIP (cpu_context));
+
+  if (pc >= block->code_start &&
+      pc < block->code_start + GUM_INVALIDATE_TRAMPOLINE_SIZE)
+  {
+    ic->is_executing_target_block = TRUE;
+    return;
+  }
+
+  gum_exec_block_invalidate (block);
+}
+
+static void
+gum_stalker_invalidate_range_for_all_threads (GumStalker * self,
+                                              const GumMemoryRange * range,
+                                              GumActivation * activation)
+{
+  GSList * contexts, * cur;
+
+  GUM_STALKER_LOCK (self);
+  contexts = g_slist_copy (self->contexts);
+  GUM_STALKER_UNLOCK (self);
+
+  cur = contexts;
+
+  while (cur != NULL)
+  {
+    GumExecCtx * ctx = cur->data;
+    GSList * l;
+
+    if (!gum_stalker_do_invalidate_range (ctx, range, activation))
+    {
+      cur = g_slist_append (cur, ctx);
+    }
+
+    l = cur;
+    cur = cur->next;
+    g_slist_free_1 (l);
+  }
+}
+
+static gboolean
+gum_stalker_do_invalidate_range (GumExecCtx * ctx,
+                                 const GumMemoryRange * range,
+                                 GumActivation * activation)
+{
+  GumInvalidateRangeContext ic;
+
+  ic.is_executing_target_block = FALSE;
+
+  gum_spinlock_acquire (&ctx->code_lock);
+
+  ic.blocks = gum_exec_ctx_find_blocks_in_range (ctx, range, &ic.num_blocks);
+  if (ic.num_blocks != 0)
+  {
+    if (ctx == activation->ctx)
+    {
+      guint i;
+
+      for (i = 0; i != ic.num_blocks; i++)
+        gum_exec_block_invalidate (ic.blocks[i]);
+    }
+    else
+    {
+      gum_process_modify_thread (ctx->thread_id,
+          gum_stalker_try_invalidate_blocks_owned_by_thread, &ic,
           GUM_MODIFY_THREAD_FLAGS_NONE);
     }
   }
 
   gum_spinlock_release (&ctx->code_lock);
 
+  g_free (ic.blocks);
+
   return !ic.is_executing_target_block;
 }
 
 static void
-gum_stalker_try_invalidate_block_owned_by_thread (GumThreadId thread_id,
-                                                  GumCpuContext * cpu_context,
-                                                  gpointer user_data)
+gum_stalker_try_invalidate_blocks_owned_by_thread (GumThreadId thread_id,
+                                                   GumCpuContext * cpu_context,
+                                                   gpointer user_data)
 {
-  GumInvalidateContext * ic = user_data;
-  GumExecBlock * block = ic->block;
+  GumInvalidateRangeContext * ic = user_data;
   const guint8 * pc = GSIZE_TO_POINTER (GUM_CPU_CONTEXT_XIP (cpu_context));
+  guint i;
 
-  if (pc >= block->code_start &&
-      pc < block->code_start + GUM_INVALIDATE_TRAMPOLINE_SIZE)
+  for (i = 0; i != ic->num_blocks; i++)
   {
-    ic->is_executing_target_block = TRUE;
-    return;
+    GumExecBlock * block = ic->blocks[i];
+
+    if (pc >= block->code_start &&
+        pc < block->code_start + GUM_INVALIDATE_TRAMPOLINE_SIZE)
+    {
+      ic->is_executing_target_block = TRUE;
+      return;
+    }
   }
 
-  gum_exec_block_invalidate (block);
+  for (i = 0; i != ic->num_blocks; i++)
+    gum_exec_block_invalidate (ic->blocks[i]);
 }
 
 GumProbeId
@@ -2045,13 +2863,12 @@ gum_stalker_add_call_probe (GumStalker * self,
 {
   GumActivation activation;
   GumCallProbe * probe;
-  GPtrArray * probes;
+  GumCallProbeSite * site;
   gboolean is_first_for_target;
 
   gum_stalker_maybe_deactivate (self, &activation);
 
   target_address = gum_strip_code_pointer (target_address);
-  is_first_for_target = FALSE;
 
   probe = g_slice_new (GumCallProbe);
   probe->ref_count = 1;
@@ -2065,17 +2882,17 @@ gum_stalker_add_call_probe (GumStalker * self,
   g_hash_table_insert (self->probe_target_by_id, GSIZE_TO_POINTER (probe->id),
       target_address);
 
-  probes = g_hash_table_lookup (self->probe_array_by_address, target_address);
-  if (probes == NULL)
+  site = g_hash_table_lookup (self->probe_site_by_address, target_address);
+  if (site == NULL)
   {
-    probes =
-        g_ptr_array_new_with_free_func ((GDestroyNotify) gum_call_probe_unref);
-    g_hash_table_insert (self->probe_array_by_address, target_address, probes);
-
-    is_first_for_target = TRUE;
+    site = gum_call_probe_site_new ();
+    g_hash_table_insert (self->probe_site_by_address, target_address, site);
   }
 
-  g_ptr_array_add (probes, probe);
+  is_first_for_target = site->probes->len == 0;
+
+  g_ptr_array_add (site->probes, probe);
+  gum_call_probe_site_publish (site, self);
 
   self->any_probes_attached = TRUE;
 
@@ -2086,6 +2903,8 @@ gum_stalker_add_call_probe (GumStalker * self,
 
   gum_stalker_maybe_reactivate (self, &activation);
 
+  gum_stalker_collect_probe_garbage (self);
+
   return probe->id;
 }
 
@@ -2107,14 +2926,16 @@ gum_stalker_remove_call_probe (GumStalker * self,
 
   if (target_address != NULL)
   {
+    GumCallProbeSite * site;
     GPtrArray * probes;
     gint match_index = -1;
     guint i;
 
     g_hash_table_remove (self->probe_target_by_id, GSIZE_TO_POINTER (id));
 
-    probes = g_hash_table_lookup (self->probe_array_by_address, target_address);
-    g_assert (probes != NULL);
+    site = g_hash_table_lookup (self->probe_site_by_address, target_address);
+    g_assert (site != NULL);
+    probes = site->probes;
 
     for (i = 0; i != probes->len; i++)
     {
@@ -2128,16 +2949,12 @@ gum_stalker_remove_call_probe (GumStalker * self,
     g_assert (match_index != -1);
 
     g_ptr_array_remove_index (probes, match_index);
+    gum_call_probe_site_publish (site, self);
 
-    if (probes->len == 0)
-    {
-      g_hash_table_remove (self->probe_array_by_address, target_address);
-
-      is_last_for_target = TRUE;
-    }
+    is_last_for_target = probes->len == 0;
 
     self->any_probes_attached =
-        g_hash_table_size (self->probe_array_by_address) != 0;
+        g_hash_table_size (self->probe_target_by_id) != 0;
   }
 
   gum_spinlock_release (&self->probe_lock);
@@ -2146,6 +2963,8 @@ gum_stalker_remove_call_probe (GumStalker * self,
     gum_stalker_invalidate_for_all_threads (self, target_address, &activation);
 
   gum_stalker_maybe_reactivate (self, &activation);
+
+  gum_stalker_collect_probe_garbage (self);
 }
 
 static void
@@ -2153,6 +2972,8 @@ gum_call_probe_finalize (GumCallProbe * probe)
 {
   if (probe->user_notify != NULL)
     probe->user_notify (probe->user_data);
+
+  g_slice_free (GumCallProbe, probe);
 }
 
 static GumCallProbe *
@@ -2172,6 +2993,133 @@ gum_call_probe_unref (GumCallProbe * probe)
   }
 }
 
+static GumCallProbeSite *
+gum_call_probe_site_new (void)
+{
+  GumCallProbeSite * site;
+
+  site = g_slice_new (GumCallProbeSite);
+  site->snapshot = NULL;
+  site->probes =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gum_call_probe_unref);
+
+  return site;
+}
+
+static void
+gum_call_probe_site_free (GumCallProbeSite * site)
+{
+  g_clear_pointer (&site->snapshot, gum_call_probe_snapshot_free);
+  g_ptr_array_unref (site->probes);
+
+  g_slice_free (GumCallProbeSite, site);
+}
+
+static void
+gum_call_probe_site_publish (GumCallProbeSite * site,
+                             GumStalker * stalker)
+{
+  GumCallProbeSnapshot * old_snapshot;
+  GumProbeGarbage * garbage;
+
+  old_snapshot = site->snapshot;
+  g_atomic_pointer_set (&site->snapshot,
+      gum_call_probe_snapshot_new (site->probes));
+
+  if (old_snapshot == NULL)
+    return;
+
+  garbage = g_slice_new (GumProbeGarbage);
+  garbage->epoch = g_atomic_int_add (&stalker->probe_epoch, 1);
+  garbage->snapshot = old_snapshot;
+
+  stalker->probe_garbage = g_slist_prepend (stalker->probe_garbage, garbage);
+}
+
+static GumCallProbeSnapshot *
+gum_call_probe_snapshot_new (GPtrArray * probes)
+{
+  GumCallProbeSnapshot * snapshot;
+  guint i;
+
+  if (probes->len == 0)
+    return NULL;
+
+  snapshot = g_malloc (G_STRUCT_OFFSET (GumCallProbeSnapshot, probes) +
+      probes->len * sizeof (GumCallProbe *));
+  snapshot->num_probes = probes->len;
+  for (i = 0; i != probes->len; i++)
+    snapshot->probes[i] = gum_call_probe_ref (g_ptr_array_index (probes, i));
+
+  return snapshot;
+}
+
+static void
+gum_call_probe_snapshot_free (GumCallProbeSnapshot * snapshot)
+{
+  guint i;
+
+  for (i = 0; i != snapshot->num_probes; i++)
+    gum_call_probe_unref (snapshot->probes[i]);
+
+  g_free (snapshot);
+}
+
+static void
+gum_stalker_collect_probe_garbage (GumStalker * self)
+{
+  gint oldest_epoch;
+  GSList * cur, * collected, * remaining;
+
+  if (self->probe_garbage == NULL)
+    return;
+
+  /*
+   * Anything retired before this point in time may only be referenced by
+   * threads that were already dispatching probes, so the oldest epoch such a
+   * thread is in determines what we can reclaim.
+   */
+  oldest_epoch = g_atomic_int_get (&self->probe_epoch);
+
+  GUM_STALKER_LOCK (self);
+  for (cur = self->contexts; cur != NULL; cur = cur->next)
+  {
+    GumExecCtx * ctx = cur->data;
+    gint epoch;
+
+    epoch = g_atomic_int_get (&ctx->probe_epoch);
+    if (epoch != 0 && epoch < oldest_epoch)
+      oldest_epoch = epoch;
+  }
+  GUM_STALKER_UNLOCK (self);
+
+  collected = NULL;
+  remaining = NULL;
+
+  gum_spinlock_acquire (&self->probe_lock);
+  for (cur = self->probe_garbage; cur != NULL; cur = cur->next)
+  {
+    GumProbeGarbage * garbage = cur->data;
+
+    if (garbage->epoch < oldest_epoch)
+      collected = g_slist_prepend (collected, garbage);
+    else
+      remaining = g_slist_prepend (remaining, garbage);
+  }
+  g_slist_free (self->probe_garbage);
+  self->probe_garbage = remaining;
+  gum_spinlock_release (&self->probe_lock);
+
+  for (cur = collected; cur != NULL; cur = cur->next)
+  {
+    GumProbeGarbage * garbage = cur->data;
+
+    gum_call_probe_snapshot_free (garbage->snapshot);
+    g_slice_free (GumProbeGarbage, garbage);
+  }
+  g_slist_free (collected);
+}
+
 static GumExecCtx *
 gum_stalker_create_exec_ctx (GumStalker * self,
                              GumThreadId thread_id,
@@ -2250,7 +3198,14 @@ static gsize
 gum_stalker_snapshot_space_needed_for (GumStalker * self,
                                        gsize real_size)
 {
-  return (self->trust_threshold != 0) ? real_size : 0;
+  /*
+   * Blocks covered by a code policy may be checked according to a threshold
+   * of their own, so keep snapshots around as soon as one is in place.
+   */
+  if (self->trust_threshold == 0 && self->code_policies->len == 0)
+    return 0;
+
+  return real_size;
 }
 
 static gsize
@@ -2364,6 +3319,10 @@ gum_exec_ctx_new (GumStalker * stalker,
   gum_scratch_slab_init (ctx->scratch_slab, stalker->scratch_slab_size);
 
   ctx->mappings = gum_metal_hash_table_new (NULL, NULL);
+  gum_metal_array_init (&ctx->block_index, sizeof (GumExecBlock *));
+  ctx->block_index_sorted = TRUE;
+  gum_metal_array_init (&ctx->pending_perf_map_entries,
+      sizeof (GumPerfMapEntry));
 
   gum_exec_ctx_ensure_inline_helpers_reachable (ctx);
 
@@ -2400,6 +3359,8 @@ gum_exec_ctx_free (GumExecCtx * ctx)
   GumDataSlab * data_slab;
   GumCodeSlab * code_slab;
 
+  gum_metal_array_free (&ctx->pending_perf_map_entries);
+  gum_metal_array_free (&ctx->block_index);
   gum_metal_hash_table_unref (ctx->mappings);
 
   data_slab = ctx->data_slab;
@@ -2602,9 +3563,32 @@ gum_exec_ctx_may_now_backpatch (GumExecCtx * ctx,
   if ((target_block->flags & GUM_EXEC_BLOCK_ACTIVATION_TARGET) != 0)
     return FALSE;
 
-  if (target_block->recycle_count < ctx->stalker->trust_threshold)
+  /*
+   * Writes to guarded code are only acted upon when switching blocks, so we
+   * have to keep going through there instead of jumping straight to them.
+   */
+  if ((target_block->flags & GUM_EXEC_BLOCK_GUARDED) != 0)
     return FALSE;
 
+  if ((target_block->flags & GUM_EXEC_BLOCK_TRUSTED) == 0)
+  {
+    gint trust_threshold = gum_exec_block_get_trust_threshold (target_block);
+
+    if (target_block->recycle_count < trust_threshold)
+      return FALSE;
+
+    /*
+     * The generated code carries backpatching callouts whenever the global
+     * threshold allows it, so a range that is never to be trusted has to be
+     * turned down here.
+     */
+    if (trust_threshold < 0 &&
+        target_block->trust_threshold != GUM_TRUST_THRESHOLD_INHERIT)
+    {
+      return FALSE;
+    }
+  }
+
   return TRUE;
 }
 
@@ -2652,9 +3636,14 @@ gum_exec_ctx_switch_block (GumExecCtx * ctx,
                            gpointer start_address,
                            gpointer from_insn)
 {
+  GumStalker * stalker = ctx->stalker;
+
   if (ctx->observer != NULL)
     gum_stalker_observer_increment_total (ctx->observer);
 
+  if (g_atomic_int_get (&stalker->guarded_pages_dirty))
+    gum_stalker_invalidate_dirty_guarded_pages (stalker, ctx);
+
   if (start_address == gum_stalker_unfollow_me ||
       start_address == gum_stalker_deactivate)
   {
@@ -2770,10 +3759,12 @@ gum_exec_ctx_obtain_block_for (GumExecCtx * ctx,
   block = gum_metal_hash_table_lookup (ctx->mappings, real_address);
   if (block != NULL)
   {
-    const gint trust_threshold = ctx->stalker->trust_threshold;
+    const gint trust_threshold = gum_exec_block_get_trust_threshold (block);
     gboolean still_up_to_date;
 
     still_up_to_date =
+        (block->flags &
+            (GUM_EXEC_BLOCK_TRUSTED | GUM_EXEC_BLOCK_GUARDED)) != 0 ||
         (trust_threshold >= 0 && block->recycle_count >= trust_threshold) ||
         memcmp (block->real_start, gum_exec_block_get_snapshot_start (block),
             block->real_size) == 0;
@@ -2837,6 +3828,8 @@ gum_exec_ctx_obtain_block_for (GumExecCtx * ctx,
     }
 
     gum_spinlock_release (&ctx->code_lock);
+
+    gum_exec_ctx_flush_perf_map_entries (ctx);
   }
 
   *code_address = block->code_start;
@@ -2855,10 +3848,13 @@ gum_exec_ctx_build_block (GumExecCtx * ctx,
       GUM_ADDRESS (block->code_start), &block->real_size, &block->code_size,
       &block->slow_size);
   gum_exec_block_commit (block);
+  gum_exec_ctx_apply_code_policy (ctx, block);
 
   gum_metal_hash_table_insert (ctx->mappings, real_address, block);
+  gum_exec_ctx_index_block (ctx, block);
 
   gum_exec_ctx_maybe_emit_compile_event (ctx, block);
+  gum_exec_ctx_maybe_queue_perf_map_entries (ctx, block);
 
   return block;
 }
@@ -2901,6 +3897,8 @@ gum_exec_ctx_recompile_block (GumExecCtx * ctx,
   if (new_block_size <= block->capacity)
   {
     block->real_size = input_size;
+    if (input_size > ctx->block_index_max_real_size)
+      ctx->block_index_max_real_size = input_size;
     block->code_size = output_size;
 
     memcpy (internal_code, scratch_base, output_size);
@@ -2915,6 +3913,7 @@ gum_exec_ctx_recompile_block (GumExecCtx * ctx,
     GumX86Writer * cw = &ctx->code_writer;
 
     storage_block = gum_exec_block_new (ctx);
+    storage_block->flags |= GUM_EXEC_BLOCK_STORAGE;
     storage_block->real_start = block->real_start;
     gum_exec_ctx_compile_block (ctx, block, block->real_start,
         storage_block->code_start, GUM_ADDRESS (storage_block->code_start),
@@ -2922,6 +3921,8 @@ gum_exec_ctx_recompile_block (GumExecCtx * ctx,
         &storage_block->slow_size);
     gum_exec_block_commit (storage_block);
     block->storage_block = storage_block;
+    if (storage_block->real_size > ctx->block_index_max_real_size)
+      ctx->block_index_max_real_size = storage_block->real_size;
 
     gum_stalker_thaw (stalker, internal_code, block->capacity);
     gum_x86_writer_reset (cw, internal_code);
@@ -2933,9 +3934,153 @@ gum_exec_ctx_recompile_block (GumExecCtx * ctx,
     gum_stalker_freeze (stalker, internal_code, block->capacity);
   }
 
+  gum_exec_ctx_apply_code_policy (ctx, block);
+  gum_exec_ctx_maybe_queue_perf_map_entries (ctx, block);
+
   gum_spinlock_release (&ctx->code_lock);
 
   gum_exec_ctx_maybe_emit_compile_event (ctx, block);
+  gum_exec_ctx_flush_perf_map_entries (ctx);
+}
+
+static void
+gum_exec_ctx_apply_code_policy (GumExecCtx * ctx,
+                                GumExecBlock * block)
+{
+  GumStalker * stalker = ctx->stalker;
+  GumExecBlock * latest;
+
+  block->flags &= ~(GUM_EXEC_BLOCK_TRUSTED | GUM_EXEC_BLOCK_GUARDED);
+  block->trust_threshold = GUM_TRUST_THRESHOLD_INHERIT;
+
+  if (stalker->code_policies->len == 0)
+    return;
+
+  switch (gum_stalker_get_code_policy (stalker, block->real_start,
+      &block->trust_threshold))
+  {
+    case GUM_STALKER_CODE_CHECKED:
+      break;
+    case GUM_STALKER_CODE_TRUSTED:
+      block->flags |= GUM_EXEC_BLOCK_TRUSTED;
+      break;
+    case GUM_STALKER_CODE_GUARDED:
+      latest = (block->storage_block != NULL) ? block->storage_block : block;
+
+      /*
+       * The code may have been written to after we read it and before the
+       * pages got armed, in which case the block is left to be checked.
+       */
+      if (gum_stalker_guard_code (stalker, latest->real_start,
+              latest->real_size) &&
+          memcmp (latest->real_start,
+              gum_exec_block_get_snapshot_start (latest),
+              gum_stalker_snapshot_space_needed_for (stalker,
+                  latest->real_size)) == 0)
+      {
+        block->flags |= GUM_EXEC_BLOCK_GUARDED;
+      }
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+}
+
+static void
+gum_exec_ctx_index_block (GumExecCtx * ctx,
+                          GumExecBlock * block)
+{
+  GumMetalArray * index = &ctx->block_index;
+  GumExecBlock ** entry;
+
+  if (ctx->block_index_sorted && index->length != 0)
+  {
+    GumExecBlock * last = *((GumExecBlock **) gum_metal_array_element_at (
+        index, index->length - 1));
+
+    ctx->block_index_sorted = last->real_start <= block->real_start;
+  }
+
+  entry = gum_metal_array_append (index);
+  *entry = block;
+
+  if (block->real_size > ctx->block_index_max_real_size)
+    ctx->block_index_max_real_size = block->real_size;
+}
+
+static GumExecBlock **
+gum_exec_ctx_find_blocks_in_range (GumExecCtx * ctx,
+                                   const GumMemoryRange * range,
+                                   guint * n_blocks)
+{
+  GumMetalArray * index = &ctx->block_index;
+  GumExecBlock ** entries = index->data;
+  const guint8 * range_start, * range_end, * search_start;
+  GArray * blocks;
+  guint lo, hi, i;
+
+  if (!ctx->block_index_sorted)
+  {
+    qsort (entries, index->length, sizeof (GumExecBlock *),
+        gum_exec_block_compare_by_real_start);
+    ctx->block_index_sorted = TRUE;
+  }
+
+  range_start = GSIZE_TO_POINTER (range->base_address);
+  range_end = range_start + range->size;
+
+  /* No block starting before this can reach into the range. */
+  search_start = (range->base_address > ctx->block_index_max_real_size)
+      ? range_start - ctx->block_index_max_real_size
+      : NULL;
+
+  lo = 0;
+  hi = index->length;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (entries[mid]->real_start < search_start)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  blocks = g_array_new (FALSE, FALSE, sizeof (GumExecBlock *));
+
+  for (i = lo; i != index->length; i++)
+  {
+    GumExecBlock * block = entries[i];
+    guint real_size;
+
+    if (block->real_start >= range_end)
+      break;
+
+    real_size = block->real_size;
+    if (block->storage_block != NULL)
+      real_size = MAX (real_size, block->storage_block->real_size);
+
+    if (block->real_start + real_size > range_start)
+      g_array_append_val (blocks, block);
+  }
+
+  *n_blocks = blocks->len;
+
+  return (GumExecBlock **) g_array_free (blocks, FALSE);
+}
+
+static gint
+gum_exec_block_compare_by_real_start (gconstpointer a,
+                                      gconstpointer b)
+{
+  const GumExecBlock * block_a = *((const GumExecBlock **) a);
+  const GumExecBlock * block_b = *((const GumExecBlock **) b);
+
+  if (block_a->real_start < block_b->real_start)
+    return -1;
+  if (block_a->real_start > block_b->real_start)
+    return 1;
+  return 0;
 }
 
 static void
@@ -2986,6 +4131,7 @@ gum_exec_ctx_compile_block (GumExecCtx * ctx,
   output.writer.x86 = cw;
   output.encoding = GUM_INSTRUCTION_DEFAULT;
 
+  gum_exec_block_maybe_write_counter_code (block, &gc);
   gum_exec_block_maybe_write_call_probe_code (block, &gc);
 
   ctx->pending_calls++;
@@ -3034,6 +4180,50 @@ gum_exec_ctx_maybe_emit_compile_event (GumExecCtx * ctx,
   }
 }
 
+static void
+gum_exec_ctx_maybe_queue_perf_map_entries (GumExecCtx * ctx,
+                                           GumExecBlock * block)
+{
+  GumExecBlock * storage;
+  GumPerfMapEntry * entry;
+
+  if (!gum_perf_map_is_open ())
+    return;
+
+  storage = block;
+  while (storage->storage_block != NULL)
+    storage = storage->storage_block;
+
+  entry = gum_metal_array_append (&ctx->pending_perf_map_entries);
+  entry->real_start = block->real_start;
+  entry->code_start = storage->code_start;
+  entry->code_size = storage->code_size;
+  entry->slow_start = storage->slow_start;
+  entry->slow_size = storage->slow_size;
+}
+
+static void
+gum_exec_ctx_flush_perf_map_entries (GumExecCtx * ctx)
+{
+  GumMetalArray * pending = &ctx->pending_perf_map_entries;
+  guint i;
+
+  if (pending->length == 0)
+    return;
+
+  for (i = 0; i != pending->length; i++)
+  {
+    const GumPerfMapEntry * entry = gum_metal_array_element_at (pending, i);
+
+    _gum_perf_map_add_instrumented_code ("stalker", entry->code_start,
+        entry->code_size, entry->real_start);
+    _gum_perf_map_add_instrumented_code ("stalker-slow", entry->slow_start,
+        entry->slow_size, entry->real_start);
+  }
+
+  gum_metal_array_remove_all (pending);
+}
+
 gboolean
 gum_stalker_iterator_next (GumStalkerIterator * self,
                            const cs_insn ** insn)
@@ -3989,6 +5179,7 @@ gum_exec_block_new (GumExecCtx * ctx)
   ctx->block_list = block;
 
   block->ctx = ctx;
+  block->exec_count = 0;
   block->code_slab = code_slab;
   block->slow_slab = slow_slab;
 
@@ -4069,6 +5260,15 @@ gum_exec_block_get_snapshot_start (GumExecBlock * block)
   return block->code_start + block->code_size;
 }
 
+static gint
+gum_exec_block_get_trust_threshold (GumExecBlock * block)
+{
+  if (block->trust_threshold != GUM_TRUST_THRESHOLD_INHERIT)
+    return block->trust_threshold;
+
+  return block->ctx->stalker->trust_threshold;
+}
+
 static GumCalloutEntry *
 gum_exec_block_get_last_callout_entry (const GumExecBlock * block)
 {
@@ -5930,28 +7130,79 @@ gum_exec_block_write_unfollow_check_code (GumExecBlock * block,
   gum_x86_writer_put_label (cw, beach);
 }
 
+static void
+gum_exec_block_maybe_write_counter_code (GumExecBlock * block,
+                                         GumGeneratorContext * gc)
+{
+  GumX86Writer * cw = gc->code_writer;
+
+  if (!block->ctx->stalker->block_counters_enabled)
+    return;
+
+  /*
+   * Bump the counter without touching the flags, as they may be live across
+   * the branch that brought us here. On 32-bit we detect the low word
+   * wrapping around through JECXZ rather than ADC.
+   */
+  gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+      GUM_X86_XSP, -GUM_RED_ZONE_SIZE);
+  gum_x86_writer_put_push_reg (cw, GUM_X86_XAX);
+  gum_x86_writer_put_push_reg (cw, GUM_X86_XCX);
+
+  gum_x86_writer_put_mov_reg_address (cw, GUM_X86_XAX,
+      GUM_ADDRESS (&block->exec_count));
+  gum_x86_writer_put_mov_reg_reg_offset_ptr (cw, GUM_X86_XCX, GUM_X86_XAX, 0);
+  gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XCX, GUM_X86_XCX, 1);
+  gum_x86_writer_put_mov_reg_offset_ptr_reg (cw, GUM_X86_XAX, 0, GUM_X86_XCX);
+
+  if (cw->target_cpu == GUM_CPU_IA32)
+  {
+    gconstpointer carry = cw->code + 1;
+    gconstpointer done = cw->code + 2;
+
+    gum_x86_writer_put_jcc_short_label (cw, X86_INS_JECXZ, carry,
+        GUM_NO_HINT);
+    gum_x86_writer_put_jmp_short_label (cw, done);
+
+    gum_x86_writer_put_label (cw, carry);
+    gum_x86_writer_put_mov_reg_reg_offset_ptr (cw, GUM_X86_ECX, GUM_X86_EAX,
+        4);
+    gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_ECX, GUM_X86_ECX, 1);
+    gum_x86_writer_put_mov_reg_offset_ptr_reg (cw, GUM_X86_EAX, 4,
+        GUM_X86_ECX);
+
+    gum_x86_writer_put_label (cw, done);
+  }
+
+  gum_x86_writer_put_pop_reg (cw, GUM_X86_XCX);
+  gum_x86_writer_put_pop_reg (cw, GUM_X86_XAX);
+  gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+      GUM_X86_XSP, GUM_RED_ZONE_SIZE);
+}
+
 static void
 gum_exec_block_maybe_write_call_probe_code (GumExecBlock * block,
                                             GumGeneratorContext * gc)
 {
   GumStalker * stalker = block->ctx->stalker;
+  GumCallProbeSite * site;
 
   if (!stalker->any_probes_attached)
     return;
 
   gum_spinlock_acquire (&stalker->probe_lock);
 
-  if (g_hash_table_contains (stalker->probe_array_by_address,
-          block->real_start))
-  {
-    gum_exec_block_write_call_probe_code (block, gc);
-  }
+  site = g_hash_table_lookup (stalker->probe_site_by_address,
+      block->real_start);
+  if (site != NULL && site->snapshot != NULL)
+    gum_exec_block_write_call_probe_code (block, site, gc);
 
   gum_spinlock_release (&stalker->probe_lock);
 }
 
 static void
 gum_exec_block_write_call_probe_code (GumExecBlock * block,
+                                      GumCallProbeSite * site,
                                       GumGeneratorContext * gc)
 {
   g_assert (gc->opened_prolog == GUM_PROLOG_NONE);
@@ -5959,45 +7210,30 @@ gum_exec_block_write_call_probe_code (GumExecBlock * block,
 
   gum_x86_writer_put_call_address_with_aligned_arguments (gc->code_writer,
       GUM_CALL_CAPI, GUM_ADDRESS (gum_exec_block_invoke_call_probes),
-      2,
+      3,
       GUM_ARG_ADDRESS, GUM_ADDRESS (block),
+      GUM_ARG_ADDRESS, GUM_ADDRESS (site),
       GUM_ARG_REGISTER, GUM_X86_XBX);
 }
 
 static void
 gum_exec_block_invoke_call_probes (GumExecBlock * block,
+                                   GumCallProbeSite * site,
                                    GumCpuContext * cpu_context)
 {
-  GumStalker * stalker = block->ctx->stalker;
+  GumExecCtx * ctx = block->ctx;
   const gpointer target_address = block->real_start;
-  GumCallProbe ** probes_copy;
-  guint num_probes, i;
+  GumCallProbeSnapshot * snapshot;
   gpointer * return_address_slot;
   GumCallDetails d;
+  guint i;
 
-  probes_copy = NULL;
-  num_probes = 0;
-  {
-    GPtrArray * probes;
-
-    gum_spinlock_acquire (&stalker->probe_lock);
-
-    probes =
-        g_hash_table_lookup (stalker->probe_array_by_address, target_address);
-    if (probes != NULL)
-    {
-      num_probes = probes->len;
-      probes_copy = g_newa (GumCallProbe *, num_probes);
-      for (i = 0; i != num_probes; i++)
-      {
-        probes_copy[i] = gum_call_probe_ref (g_ptr_array_index (probes, i));
-      }
-    }
+  g_atomic_int_set (&ctx->probe_epoch,
+      g_atomic_int_get (&ctx->stalker->probe_epoch));
 
-    gum_spinlock_release (&stalker->probe_lock);
-  }
-  if (num_probes == 0)
-    return;
+  snapshot = g_atomic_pointer_get (&site->snapshot);
+  if (snapshot == NULL)
+    goto beach;
 
   return_address_slot = GSIZE_TO_POINTER (GUM_CPU_CONTEXT_XSP (cpu_context));
 
@@ -6008,14 +7244,15 @@ gum_exec_block_invoke_call_probes (GumExecBlock * block,
 
   GUM_CPU_CONTEXT_XIP (cpu_context) = GPOINTER_TO_SIZE (target_address);
 
-  for (i = 0; i != num_probes; i++)
+  for (i = 0; i != snapshot->num_probes; i++)
   {
-    GumCallProbe * probe = probes_copy[i];
+    GumCallProbe * probe = snapshot->probes[i];
 
     probe->callback (&d, probe->user_data);
-
-    gum_call_probe_unref (probe);
   }
+
+beach:
+  g_atomic_int_set (&ctx->probe_epoch, 0);
 }
 
 static gpointer
@@ -6077,6 +7314,35 @@ gum_exec_block_close_prolog (GumExecBlock * block,
   gc->opened_prolog = GUM_PROLOG_NONE;
 }
 
+static gpointer
+gum_stalker_allocate_code_slab (GumStalker * self,
+                                const GumAddressSpec * spec,
+                                gsize size)
+{
+  GumPageProtection prot;
+
+  prot = self->is_rwx_supported ? GUM_PAGE_RWX : GUM_PAGE_RW;
+
+  if (self->code_slab_alignment != self->page_size)
+  {
+    gpointer slab;
+
+    /*
+     * Hot blocks tend to be spread across many pages, so have the kernel
+     * back the slab with huge pages to save on iTLB misses.
+     */
+    slab = gum_memory_allocate_near (spec, size, self->code_slab_alignment,
+        prot);
+    if (slab != NULL)
+    {
+      gum_memory_advise_huge_pages (slab, size);
+      return slab;
+    }
+  }
+
+  return gum_memory_allocate_near (spec, size, self->page_size, prot);
+}
+
 static GumCodeSlab *
 gum_code_slab_new (GumExecCtx * ctx)
 {
@@ -6087,8 +7353,7 @@ gum_code_slab_new (GumExecCtx * ctx)
 
   gum_exec_ctx_compute_code_address_spec (ctx, slab_size, &spec);
 
-  slab = gum_memory_allocate_near (&spec, slab_size, stalker->page_size,
-      stalker->is_rwx_supported ? GUM_PAGE_RWX : GUM_PAGE_RW);
+  slab = gum_stalker_allocate_code_slab (stalker, &spec, slab_size);
 
   gum_code_slab_init (slab, slab_size, stalker->page_size);
 
@@ -6105,8 +7370,7 @@ gum_slow_slab_new (GumExecCtx * ctx)
 
   gum_exec_ctx_compute_code_address_spec (ctx, slab_size, &spec);
 
-  slab = gum_memory_allocate_near (&spec, slab_size, stalker->page_size,
-      stalker->is_rwx_supported ? GUM_PAGE_RWX : GUM_PAGE_RW);
+  slab = gum_stalker_allocate_code_slab (stalker, &spec, slab_size);
 
   gum_slow_slab_init (slab, slab_size, stalker->page_size);
 
@@ -166,6 +166,8 @@ gum_deinit (void)
 
   _gum_interceptor_deinit ();
 
+  gum_perf_map_close ();
+
   gum_initialized = FALSE;
 }
 
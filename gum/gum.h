@@ -16,6 +16,7 @@
 #include <gum/gumcodesegment.h>
 #include <gum/gumdarwingrafter.h>
 #include <gum/gumdarwinmodule.h>
+#include <gum/gumelfgrafter.h>
 #include <gum/gumelfmodule.h>
 #include <gum/gumevent.h>
 #include <gum/gumeventsink.h>
@@ -29,10 +30,13 @@
 #include <gum/gummemory.h>
 #include <gum/gummemoryaccessmonitor.h>
 #include <gum/gummemorymap.h>
+#include <gum/gummemorysnapshot.h>
 #include <gum/gummetalarray.h>
 #include <gum/gummetalhash.h>
 #include <gum/gummoduleapiresolver.h>
 #include <gum/gummodulemap.h>
+#include <gum/gumpercpucounter.h>
+#include <gum/gumperfmap.h>
 #include <gum/gumprintf.h>
 #include <gum/gumprocess.h>
 #include <gum/gumreturnaddress.h>
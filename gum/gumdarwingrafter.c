@@ -981,7 +981,9 @@ gum_darwin_grafter_transform_load_commands (gconstpointer commands_in,
 
   *merged_binds = NULL;
 
-  commands_out = g_byte_array_sized_new (size_of_commands_in);
+  commands_out = g_byte_array_sized_new (size_of_commands_in +
+      (layout->segment_pair_descriptors->len * 2 *
+       (sizeof (GumSegmentCommand64) + sizeof (GumSection64))));
   n = 0;
 
   command_in = commands_in;
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_ELF_GRAFTER_PRIV_H__
+#define __GUM_ELF_GRAFTER_PRIV_H__
+
+#include "gumelfgrafter.h"
+
+#define GUM_ELF_GRAFTER_ABI_VERSION 1
+
+/*
+ * Program header type used to locate the grafted tables at runtime. It lives
+ * in the OS-specific range, which the kernel and dynamic linkers ignore.
+ */
+#define GUM_ELF_PHDR_GUM_GRAFTED 0x66726461
+
+#define GUM_ELF_GRAFTED_HOOK_ON_ENTER_OFFSET(h) (((h)->flags >> 17) & 0x7f)
+#define GUM_ELF_GRAFTED_HOOK_ON_LEAVE_OFFSET(h) (((h)->flags >> 10) & 0x7f)
+#define GUM_ELF_GRAFTED_HOOK_ON_INVOKE_OFFSET(h) (((h)->flags >> 3) & 0x7f)
+
+#define GUM_ELF_GRAFTED_IMPORT_ON_ENTER_OFFSET(i) (((i)->flags >> 17) & 0x7f)
+#define GUM_ELF_GRAFTED_IMPORT_ON_LEAVE_OFFSET(i) (((i)->flags >> 10) & 0x7f)
+#define GUM_ELF_GRAFTED_IMPORT_IN_RELRO(i) (((i)->flags & 0x2) != 0)
+
+G_BEGIN_DECLS
+
+typedef struct _GumElfGraftedHeader GumElfGraftedHeader;
+typedef struct _GumElfGraftedHook GumElfGraftedHook;
+typedef struct _GumElfGraftedImport GumElfGraftedImport;
+
+#ifdef HAVE_PACK_PRAGMA
+# pragma pack (push, 1)
+#endif
+
+struct _GumElfGraftedHeader
+{
+  guint32 abi_version;
+  guint32 num_hooks;
+  guint32 num_imports;
+  guint32 padding;
+  guint64 begin_invocation;
+  guint64 end_invocation;
+};
+
+struct _GumElfGraftedHook
+{
+  guint32 code_offset;
+  guint32 trampoline_offset;
+  guint32 flags;
+  guint32 padding;
+  guint64 user_data;
+};
+
+struct _GumElfGraftedImport
+{
+  guint32 slot_offset;
+  guint32 trampoline_offset;
+  guint32 flags;
+  guint32 padding;
+  guint64 user_data;
+};
+
+#ifdef HAVE_PACK_PRAGMA
+# pragma pack (pop)
+#endif
+
+G_GNUC_INTERNAL void _gum_elf_grafted_hook_activate (GumElfGraftedHook * self);
+G_GNUC_INTERNAL void _gum_elf_grafted_hook_deactivate (
+    GumElfGraftedHook * self);
+
+G_END_DECLS
+
+#endif
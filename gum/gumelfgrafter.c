@@ -0,0 +1,1625 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gumelfgrafter.h"
+
+#include "gumarm64writer.h"
+#include "gumelfgrafter-priv.h"
+#include "gumelfmodule-priv.h"
+#include "gumx86relocator.h"
+#include "gumx86writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#define GUM_ELF_DF_BIND_NOW 0x8
+#define GUM_ELF_DF_1_NOW    0x1
+
+#define GUM_X86_HOOK_TRAMPOLINE_SIZE   80
+#define GUM_X86_IMPORT_TRAMPOLINE_SIZE 32
+#define GUM_X86_JMP_SIZE                5
+
+#define GUM_ARM64_BTI_C  0xd503245f
+#define GUM_ARM64_BTI_JC 0xd50324df
+
+#ifndef GUM_DIET
+
+typedef struct _GumElfGraftedLayout GumElfGraftedLayout;
+typedef struct _GumElfGraftedSite GumElfGraftedSite;
+typedef struct _GumElfGraftedSlot GumElfGraftedSlot;
+typedef struct _GumElfArm64HookTrampoline GumElfArm64HookTrampoline;
+typedef struct _GumElfArm64ImportTrampoline GumElfArm64ImportTrampoline;
+typedef struct _GumElfArm64Runtime GumElfArm64Runtime;
+typedef struct _GumCollectSitesOperation GumCollectSitesOperation;
+typedef struct _GumCollectSlotsOperation GumCollectSlotsOperation;
+
+enum
+{
+  PROP_0,
+  PROP_PATH,
+  PROP_FLAGS,
+};
+
+struct _GumElfGrafter
+{
+  GObject parent;
+
+  gchar * path;
+  GumElfGrafterFlags flags;
+  GArray * code_offsets;
+  GPtrArray * symbols;
+  GPtrArray * imports;
+};
+
+struct _GumElfGraftedLayout
+{
+  GumElfMachine machine;
+  guint64 page_size;
+  GumAddress preferred_address;
+
+  const GumElfPhdr * phdrs_in;
+  guint16 num_phdrs_in;
+  guint16 num_phdrs_out;
+
+  GumAddress code_address;
+  goffset code_offset;
+  gsize code_size;
+
+  GumAddress hook_trampolines_address;
+  gsize hook_trampoline_size;
+  GumAddress import_trampolines_address;
+  gsize import_trampoline_size;
+  GumAddress runtime_address;
+
+  GumAddress data_address;
+  goffset data_offset;
+  gsize data_size;
+};
+
+struct _GumElfGraftedSite
+{
+  guint32 code_offset;
+  gboolean required;
+};
+
+struct _GumElfGraftedSlot
+{
+  guint32 slot_offset;
+  gboolean in_relro;
+};
+
+#pragma pack (push, 1)
+
+struct _GumElfArm64HookTrampoline
+{
+  guint32 on_enter[5];
+  guint32 on_leave[3];
+  guint32 not_active[1];
+  guint32 on_invoke[3];
+};
+
+struct _GumElfArm64ImportTrampoline
+{
+  guint32 on_enter[4];
+  guint32 on_leave[3];
+};
+
+struct _GumElfArm64Runtime
+{
+  guint32 do_begin_invocation[2];
+  guint32 do_end_invocation[2];
+};
+
+#pragma pack (pop)
+
+struct _GumCollectSitesOperation
+{
+  GArray * sites;
+  GHashTable * wanted;
+  gboolean required;
+};
+
+struct _GumCollectSlotsOperation
+{
+  GArray * slots;
+  GHashTable * wanted;
+  gboolean ingest_all;
+  GumElfMachine machine;
+  GumAddress preferred_address;
+  const GumElfPhdr * phdrs;
+  guint16 num_phdrs;
+};
+
+static void gum_elf_grafter_finalize (GObject * object);
+static void gum_elf_grafter_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gum_elf_grafter_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static gboolean gum_elf_grafter_collect_sites (GumElfGrafter * self,
+    GumElfModule * module, GArray ** sites, GError ** error);
+static gboolean gum_collect_site_if_wanted (
+    const GumElfSymbolDetails * details, gpointer user_data);
+static gboolean gum_collect_exported_site (const GumExportDetails * details,
+    gpointer user_data);
+static gboolean gum_elf_grafter_collect_slots (GumElfGrafter * self,
+    GumElfModule * module, const GumElfPhdr * phdrs, guint16 num_phdrs,
+    GArray ** slots, GError ** error);
+static gboolean gum_collect_slot_if_wanted (
+    const GumElfRelocationDetails * details, gpointer user_data);
+static gboolean gum_check_all_found (GHashTable * wanted, const gchar * kind,
+    GError ** error);
+static void gum_normalize_sites (GArray * sites);
+static int gum_compare_sites (const void * element_a, const void * element_b);
+static void gum_normalize_slots (GArray * slots);
+static int gum_compare_slots (const void * element_a, const void * element_b);
+static void gum_elf_grafter_compute_layout (GumElfMachine machine,
+    GumAddress preferred_address, gsize input_size, const GumElfEhdr * ehdr,
+    const GumElfPhdr * phdrs, guint num_sites, guint num_slots,
+    GumElfGraftedLayout * layout);
+static void gum_elf_grafter_rewrite_program_headers (guint8 * output,
+    const GumElfGraftedLayout * layout);
+static gboolean gum_elf_grafter_enable_bind_now (guint8 * output,
+    const GumElfGraftedLayout * layout, GError ** error);
+static gboolean gum_elf_grafter_emit_x86_64 (guint8 * output,
+    const GumElfGraftedLayout * layout, GArray * sites, GArray * slots,
+    GError ** error);
+static gboolean gum_emit_x86_64_hook_trampoline (GumX86Writer * cw,
+    GumX86Relocator * rl, const guint8 * site_code, GumAddress site_address,
+    guint8 * trampoline, GumAddress trampoline_address,
+    GumAddress flags_address, GumAddress user_data_address, GumAddress begin_invocation_address,
+    GumAddress end_invocation_address, guint32 * flags);
+static void gum_reset_x86_64_writer (GumX86Writer * cw, gpointer code,
+    GumAddress pc);
+static gboolean gum_elf_grafter_emit_arm64 (guint8 * output,
+    const GumElfGraftedLayout * layout, GArray * sites, GArray * slots,
+    GError ** error);
+static gboolean gum_arm64_can_relocate_instruction (guint32 insn);
+static guint8 * gum_elf_grafted_layout_resolve_code (
+    const GumElfGraftedLayout * layout, guint8 * output, GumAddress address,
+    gsize size);
+static gboolean gum_elf_grafted_layout_is_relro (
+    const GumElfPhdr * phdrs, guint16 num_phdrs, GumAddress address);
+static guint64 gum_align_u64 (guint64 value, guint64 alignment);
+
+G_DEFINE_TYPE (GumElfGrafter, gum_elf_grafter, G_TYPE_OBJECT)
+
+static void
+gum_elf_grafter_class_init (GumElfGrafterClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gum_elf_grafter_finalize;
+  object_class->get_property = gum_elf_grafter_get_property;
+  object_class->set_property = gum_elf_grafter_set_property;
+
+  g_object_class_install_property (object_class, PROP_PATH,
+      g_param_spec_string ("path", "Path", "Path", NULL,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class, PROP_FLAGS,
+      g_param_spec_flags ("flags", "Flags", "Optional flags",
+      GUM_TYPE_ELF_GRAFTER_FLAGS, GUM_ELF_GRAFTER_FLAGS_NONE,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gum_elf_grafter_init (GumElfGrafter * self)
+{
+  self->code_offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  self->symbols = g_ptr_array_new_with_free_func (g_free);
+  self->imports = g_ptr_array_new_with_free_func (g_free);
+}
+
+static void
+gum_elf_grafter_finalize (GObject * object)
+{
+  GumElfGrafter * self = GUM_ELF_GRAFTER (object);
+
+  g_ptr_array_unref (self->imports);
+  g_ptr_array_unref (self->symbols);
+  g_array_unref (self->code_offsets);
+  g_free (self->path);
+
+  G_OBJECT_CLASS (gum_elf_grafter_parent_class)->finalize (object);
+}
+
+static void
+gum_elf_grafter_get_property (GObject * object,
+                              guint property_id,
+                              GValue * value,
+                              GParamSpec * pspec)
+{
+  GumElfGrafter * self = GUM_ELF_GRAFTER (object);
+
+  switch (property_id)
+  {
+    case PROP_PATH:
+      g_value_set_string (value, self->path);
+      break;
+    case PROP_FLAGS:
+      g_value_set_flags (value, self->flags);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+  }
+}
+
+static void
+gum_elf_grafter_set_property (GObject * object,
+                              guint property_id,
+                              const GValue * value,
+                              GParamSpec * pspec)
+{
+  GumElfGrafter * self = GUM_ELF_GRAFTER (object);
+
+  switch (property_id)
+  {
+    case PROP_PATH:
+      g_free (self->path);
+      self->path = g_value_dup_string (value);
+      break;
+    case PROP_FLAGS:
+      self->flags = g_value_get_flags (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+  }
+}
+
+GumElfGrafter *
+gum_elf_grafter_new_from_file (const gchar * path,
+                               GumElfGrafterFlags flags)
+{
+  return g_object_new (GUM_TYPE_ELF_GRAFTER,
+      "path", path,
+      "flags", flags,
+      NULL);
+}
+
+void
+gum_elf_grafter_add (GumElfGrafter * self,
+                     guint32 code_offset)
+{
+  g_array_append_val (self->code_offsets, code_offset);
+}
+
+void
+gum_elf_grafter_add_symbol (GumElfGrafter * self,
+                            const gchar * name)
+{
+  g_ptr_array_add (self->symbols, g_strdup (name));
+}
+
+void
+gum_elf_grafter_add_import (GumElfGrafter * self,
+                            const gchar * name)
+{
+  g_ptr_array_add (self->imports, g_strdup (name));
+}
+
+gboolean
+gum_elf_grafter_graft (GumElfGrafter * self,
+                       GError ** error)
+{
+  gboolean success = FALSE;
+  GumElfModule * module;
+  GumElfMachine machine;
+  gconstpointer input;
+  gsize input_size;
+  const GumElfEhdr * ehdr;
+  const GumElfPhdr * phdrs;
+  guint i;
+  GArray * sites = NULL;
+  GArray * slots = NULL;
+  GumElfGraftedLayout layout;
+  GByteArray * output = NULL;
+  gboolean emitted;
+  GStatBuf st;
+  gchar * tmp_path = NULL;
+  gint fd = -1;
+  FILE * file = NULL;
+
+  module = gum_elf_module_new_from_file (self->path, error);
+  if (module == NULL)
+    goto beach;
+
+  machine = gum_elf_module_get_machine (module);
+  if ((machine != GUM_ELF_MACHINE_X86_64 &&
+        machine != GUM_ELF_MACHINE_AARCH64) ||
+      gum_elf_module_get_pointer_size (module) != 8 ||
+      gum_elf_module_get_byte_order (module) != G_LITTLE_ENDIAN)
+  {
+    goto unsupported_binary;
+  }
+
+  /* The headers are accessed in place, so they must be in our byte order. */
+  if (gum_elf_module_get_byte_order (module) != G_BYTE_ORDER)
+    goto foreign_byte_order;
+
+  input = gum_elf_module_get_file_data (module, &input_size);
+
+  ehdr = input;
+  if (ehdr->phentsize != sizeof (GumElfPhdr) ||
+      ehdr->phoff + ((guint64) ehdr->phnum * sizeof (GumElfPhdr)) >
+      input_size ||
+      ehdr->phnum > G_MAXUINT16 - 3)
+  {
+    goto unsupported_binary;
+  }
+  phdrs = (const GumElfPhdr *) ((const guint8 *) input + ehdr->phoff);
+
+  for (i = 0; i != ehdr->phnum; i++)
+  {
+    if (phdrs[i].type == GUM_ELF_PHDR_GUM_GRAFTED)
+      goto already_grafted;
+  }
+
+  if (!gum_elf_grafter_collect_sites (self, module, &sites, error))
+    goto beach;
+
+  if (!gum_elf_grafter_collect_slots (self, module, phdrs, ehdr->phnum,
+      &slots, error))
+  {
+    goto beach;
+  }
+
+  if (sites->len + slots->len == 0)
+    goto nothing_to_instrument;
+
+  gum_elf_grafter_compute_layout (machine,
+      gum_elf_module_get_preferred_address (module), input_size, ehdr, phdrs,
+      sites->len, slots->len, &layout);
+
+  output = g_byte_array_sized_new (layout.data_offset + layout.data_size);
+  g_byte_array_append (output, input, input_size);
+  g_byte_array_set_size (output, layout.data_offset + layout.data_size);
+  memset (output->data + input_size, 0, output->len - input_size);
+
+  layout.phdrs_in = (const GumElfPhdr *) (output->data + ehdr->phoff);
+
+  gum_elf_grafter_rewrite_program_headers (output->data, &layout);
+
+  if (slots->len != 0 &&
+      !gum_elf_grafter_enable_bind_now (output->data, &layout, error))
+  {
+    goto beach;
+  }
+
+  if (machine == GUM_ELF_MACHINE_X86_64)
+  {
+    emitted = gum_elf_grafter_emit_x86_64 (output->data, &layout, sites, slots,
+        error);
+  }
+  else
+  {
+    emitted = gum_elf_grafter_emit_arm64 (output->data, &layout, sites, slots,
+        error);
+  }
+  if (!emitted)
+    goto beach;
+
+  /*
+   * Write to a temporary file next to the original and rename it into place,
+   * so that a failed write never leaves a truncated binary behind.
+   */
+  if (g_stat (self->path, &st) != 0)
+    goto io_error;
+
+  tmp_path = g_strconcat (self->path, ".XXXXXX", NULL);
+  fd = g_mkstemp_full (tmp_path, O_WRONLY, st.st_mode & 0777);
+  if (fd == -1)
+    goto io_error;
+
+  file = fdopen (fd, "wb");
+  if (file == NULL)
+    goto io_error;
+  fd = -1;
+
+  if (fwrite (output->data, output->len, 1, file) != 1)
+    goto io_error;
+
+  if (fclose (g_steal_pointer (&file)) != 0)
+    goto io_error;
+
+  if (g_rename (tmp_path, self->path) != 0)
+    goto io_error;
+
+  g_clear_pointer (&tmp_path, g_free);
+
+  success = TRUE;
+  goto beach;
+
+unsupported_binary:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+        "Only little-endian ELF64 binaries for x86_64 and arm64 are supported");
+    goto beach;
+  }
+foreign_byte_order:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+        "Grafting binaries of a different byte order than the host is not "
+        "supported");
+    goto beach;
+  }
+already_grafted:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_EXISTS, "Already grafted");
+    goto beach;
+  }
+nothing_to_instrument:
+  {
+    success = TRUE;
+    goto beach;
+  }
+io_error:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_FAILED,
+        "%s", g_strerror (errno));
+  }
+beach:
+  {
+    g_clear_pointer (&file, fclose);
+    if (fd != -1)
+      g_close (fd, NULL);
+    if (tmp_path != NULL)
+    {
+      g_unlink (tmp_path);
+      g_free (tmp_path);
+    }
+    g_clear_pointer (&output, g_byte_array_unref);
+    g_clear_pointer (&slots, g_array_unref);
+    g_clear_pointer (&sites, g_array_unref);
+    g_clear_object (&module);
+
+    return success;
+  }
+}
+
+static gboolean
+gum_elf_grafter_collect_sites (GumElfGrafter * self,
+                               GumElfModule * module,
+                               GArray ** sites,
+                               GError ** error)
+{
+  GumCollectSitesOperation op;
+  guint i;
+
+  op.sites = g_array_new (FALSE, FALSE, sizeof (GumElfGraftedSite));
+  op.wanted = g_hash_table_new (g_str_hash, g_str_equal);
+  *sites = op.sites;
+
+  for (i = 0; i != self->code_offsets->len; i++)
+  {
+    GumElfGraftedSite site;
+
+    site.code_offset = g_array_index (self->code_offsets, guint32, i);
+    site.required = TRUE;
+
+    g_array_append_val (op.sites, site);
+  }
+
+  if (self->symbols->len != 0)
+  {
+    for (i = 0; i != self->symbols->len; i++)
+    {
+      g_hash_table_insert (op.wanted, g_ptr_array_index (self->symbols, i),
+          NULL);
+    }
+
+    op.required = TRUE;
+    gum_elf_module_enumerate_dynamic_symbols (module,
+        gum_collect_site_if_wanted, &op);
+    gum_elf_module_enumerate_symbols (module, gum_collect_site_if_wanted, &op);
+
+    if (!gum_check_all_found (op.wanted, "Symbol", error))
+    {
+      g_hash_table_unref (op.wanted);
+      return FALSE;
+    }
+  }
+
+  if ((self->flags & GUM_ELF_GRAFTER_FLAGS_INGEST_EXPORTS) != 0)
+  {
+    op.required = FALSE;
+    gum_elf_module_enumerate_exports (module, gum_collect_exported_site, &op);
+  }
+
+  g_hash_table_unref (op.wanted);
+
+  gum_normalize_sites (op.sites);
+
+  return TRUE;
+}
+
+static gboolean
+gum_collect_site_if_wanted (const GumElfSymbolDetails * details,
+                            gpointer user_data)
+{
+  GumCollectSitesOperation * op = user_data;
+  GumElfGraftedSite site;
+
+  if (details->type != GUM_ELF_SYMBOL_FUNC ||
+      details->shdr_index == GUM_ELF_SHDR_INDEX_UNDEF ||
+      details->address == 0 ||
+      details->address > G_MAXUINT32)
+  {
+    return TRUE;
+  }
+
+  if (!g_hash_table_contains (op->wanted, details->name))
+    return TRUE;
+
+  g_hash_table_insert (op->wanted, (gpointer) details->name,
+      GSIZE_TO_POINTER (TRUE));
+
+  site.code_offset = details->address;
+  site.required = op->required;
+  g_array_append_val (op->sites, site);
+
+  return TRUE;
+}
+
+static gboolean
+gum_collect_exported_site (const GumExportDetails * details,
+                           gpointer user_data)
+{
+  GumCollectSitesOperation * op = user_data;
+  GumElfGraftedSite site;
+
+  if (details->type != GUM_EXPORT_FUNCTION ||
+      details->address == 0 ||
+      details->address > G_MAXUINT32)
+  {
+    return TRUE;
+  }
+
+  site.code_offset = details->address;
+  site.required = op->required;
+  g_array_append_val (op->sites, site);
+
+  return TRUE;
+}
+
+static gboolean
+gum_elf_grafter_collect_slots (GumElfGrafter * self,
+                               GumElfModule * module,
+                               const GumElfPhdr * phdrs,
+                               guint16 num_phdrs,
+                               GArray ** slots,
+                               GError ** error)
+{
+  GumCollectSlotsOperation op;
+  guint i;
+
+  op.slots = g_array_new (FALSE, FALSE, sizeof (GumElfGraftedSlot));
+  *slots = op.slots;
+
+  op.ingest_all = (self->flags & GUM_ELF_GRAFTER_FLAGS_INGEST_IMPORTS) != 0;
+  if (self->imports->len == 0 && !op.ingest_all)
+    return TRUE;
+
+  op.wanted = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i != self->imports->len; i++)
+  {
+    g_hash_table_insert (op.wanted, g_ptr_array_index (self->imports, i),
+        NULL);
+  }
+  op.machine = gum_elf_module_get_machine (module);
+  op.preferred_address = gum_elf_module_get_preferred_address (module);
+  op.phdrs = phdrs;
+  op.num_phdrs = num_phdrs;
+
+  gum_elf_module_enumerate_relocations (module, gum_collect_slot_if_wanted,
+      &op);
+
+  if (!gum_check_all_found (op.wanted, "Import", error))
+  {
+    g_hash_table_unref (op.wanted);
+    return FALSE;
+  }
+
+  g_hash_table_unref (op.wanted);
+
+  gum_normalize_slots (op.slots);
+
+  return TRUE;
+}
+
+static gboolean
+gum_collect_slot_if_wanted (const GumElfRelocationDetails * details,
+                            gpointer user_data)
+{
+  GumCollectSlotsOperation * op = user_data;
+  const GumElfSymbolDetails * symbol = details->symbol;
+  gboolean is_jump_slot, is_glob_dat;
+  GumElfGraftedSlot slot;
+
+  if (op->machine == GUM_ELF_MACHINE_X86_64)
+  {
+    is_jump_slot = details->type == GUM_ELF_X64_JUMP_SLOT;
+    is_glob_dat = details->type == GUM_ELF_X64_GLOB_DAT;
+  }
+  else
+  {
+    is_jump_slot = details->type == GUM_ELF_ARM64_JUMP_SLOT;
+    is_glob_dat = details->type == GUM_ELF_ARM64_GLOB_DAT;
+  }
+
+  if (!is_jump_slot && !is_glob_dat)
+    return TRUE;
+
+  if (symbol == NULL || symbol->name == NULL || symbol->name[0] == '\0' ||
+      symbol->shdr_index != GUM_ELF_SHDR_INDEX_UNDEF)
+  {
+    return TRUE;
+  }
+
+  /*
+   * GLOB_DAT slots also back function pointer comparisons, so we only take
+   * over the ones we know refer to code.
+   */
+  if (is_glob_dat && symbol->type != GUM_ELF_SYMBOL_FUNC)
+    return TRUE;
+
+  if (!op->ingest_all && !g_hash_table_contains (op->wanted, symbol->name))
+    return TRUE;
+
+  if (details->address < op->preferred_address ||
+      details->address - op->preferred_address > G_MAXUINT32)
+  {
+    return TRUE;
+  }
+
+  if (g_hash_table_contains (op->wanted, symbol->name))
+  {
+    g_hash_table_insert (op->wanted, (gpointer) symbol->name,
+        GSIZE_TO_POINTER (TRUE));
+  }
+
+  slot.slot_offset = details->address - op->preferred_address;
+  slot.in_relro = gum_elf_grafted_layout_is_relro (op->phdrs, op->num_phdrs,
+      details->address);
+  g_array_append_val (op->slots, slot);
+
+  return TRUE;
+}
+
+static gboolean
+gum_check_all_found (GHashTable * wanted,
+                     const gchar * kind,
+                     GError ** error)
+{
+  GHashTableIter iter;
+  const gchar * name;
+  gpointer found;
+
+  g_hash_table_iter_init (&iter, wanted);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &name, &found))
+  {
+    if (!GPOINTER_TO_SIZE (found))
+    {
+      g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_FOUND,
+          "%s '%s' not found", kind, name);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static void
+gum_normalize_sites (GArray * sites)
+{
+  guint i;
+
+  g_array_sort (sites, gum_compare_sites);
+
+  for (i = 1; i < sites->len; i++)
+  {
+    GumElfGraftedSite * prev, * cur;
+
+    prev = &g_array_index (sites, GumElfGraftedSite, i - 1);
+    cur = &g_array_index (sites, GumElfGraftedSite, i);
+
+    if (cur->code_offset == prev->code_offset)
+    {
+      prev->required |= cur->required;
+      g_array_remove_index (sites, i);
+      i--;
+    }
+  }
+}
+
+static int
+gum_compare_sites (const void * element_a,
+                   const void * element_b)
+{
+  const GumElfGraftedSite * a = element_a;
+  const GumElfGraftedSite * b = element_b;
+
+  return (gssize) a->code_offset - (gssize) b->code_offset;
+}
+
+static void
+gum_normalize_slots (GArray * slots)
+{
+  guint i;
+
+  g_array_sort (slots, gum_compare_slots);
+
+  for (i = 1; i < slots->len; i++)
+  {
+    const GumElfGraftedSlot * prev, * cur;
+
+    prev = &g_array_index (slots, GumElfGraftedSlot, i - 1);
+    cur = &g_array_index (slots, GumElfGraftedSlot, i);
+
+    if (cur->slot_offset == prev->slot_offset)
+    {
+      g_array_remove_index (slots, i);
+      i--;
+    }
+  }
+}
+
+static int
+gum_compare_slots (const void * element_a,
+                   const void * element_b)
+{
+  const GumElfGraftedSlot * a = element_a;
+  const GumElfGraftedSlot * b = element_b;
+
+  return (gssize) a->slot_offset - (gssize) b->slot_offset;
+}
+
+static void
+gum_elf_grafter_compute_layout (GumElfMachine machine,
+                                GumAddress preferred_address,
+                                gsize input_size,
+                                const GumElfEhdr * ehdr,
+                                const GumElfPhdr * phdrs,
+                                guint num_sites,
+                                guint num_slots,
+                                GumElfGraftedLayout * layout)
+{
+  const GumElfPhdr * first_load = NULL;
+  GumAddress end_address = 0;
+  guint64 delta;
+  gsize phdrs_size;
+  guint i;
+
+  layout->machine = machine;
+  layout->page_size = 4096;
+  layout->preferred_address = preferred_address;
+
+  for (i = 0; i != ehdr->phnum; i++)
+  {
+    const GumElfPhdr * phdr = &phdrs[i];
+
+    if (phdr->type != GUM_ELF_PHDR_LOAD)
+      continue;
+
+    if (first_load == NULL)
+      first_load = phdr;
+
+    layout->page_size = MAX (layout->page_size, phdr->align);
+    end_address = MAX (end_address, phdr->vaddr + phdr->memsz);
+  }
+
+  layout->num_phdrs_in = ehdr->phnum;
+  layout->num_phdrs_out = ehdr->phnum + 3;
+
+  if (machine == GUM_ELF_MACHINE_X86_64)
+  {
+    layout->hook_trampoline_size = GUM_X86_HOOK_TRAMPOLINE_SIZE;
+    layout->import_trampoline_size = GUM_X86_IMPORT_TRAMPOLINE_SIZE;
+  }
+  else
+  {
+    layout->hook_trampoline_size = sizeof (GumElfArm64HookTrampoline);
+    layout->import_trampoline_size = sizeof (GumElfArm64ImportTrampoline);
+  }
+
+  phdrs_size = layout->num_phdrs_out * sizeof (GumElfPhdr);
+
+  /*
+   * Keep the file offset and address of our code segment congruent with the
+   * first PT_LOAD, so kernels that compute AT_PHDR from e_phoff still find
+   * the relocated program headers.
+   */
+  delta = (first_load != NULL) ? first_load->vaddr - first_load->offset : 0;
+
+  layout->code_address = gum_align_u64 (end_address, layout->page_size);
+  layout->code_offset = layout->code_address - delta;
+  while ((gsize) layout->code_offset < input_size)
+  {
+    layout->code_address += layout->page_size;
+    layout->code_offset += layout->page_size;
+  }
+
+  layout->hook_trampolines_address =
+      layout->code_address + GUM_ALIGN_SIZE (phdrs_size, 16);
+  layout->import_trampolines_address = layout->hook_trampolines_address +
+      (num_sites * layout->hook_trampoline_size);
+  layout->runtime_address = layout->import_trampolines_address +
+      (num_slots * layout->import_trampoline_size);
+  layout->code_size = layout->runtime_address - layout->code_address;
+  if (machine == GUM_ELF_MACHINE_AARCH64)
+    layout->code_size += sizeof (GumElfArm64Runtime);
+
+  layout->data_address = gum_align_u64 (
+      layout->code_address + layout->code_size, layout->page_size);
+  layout->data_offset =
+      layout->code_offset + (layout->data_address - layout->code_address);
+  layout->data_size = sizeof (GumElfGraftedHeader) +
+      (num_sites * sizeof (GumElfGraftedHook)) +
+      (num_slots * sizeof (GumElfGraftedImport));
+}
+
+static void
+gum_elf_grafter_rewrite_program_headers (guint8 * output,
+                                         const GumElfGraftedLayout * layout)
+{
+  GumElfEhdr * ehdr = (GumElfEhdr *) output;
+  GumElfPhdr * phdrs, * phdr;
+  gsize phdrs_size;
+  guint i;
+
+  phdrs = (GumElfPhdr *) (output + layout->code_offset);
+  phdrs_size = layout->num_phdrs_out * sizeof (GumElfPhdr);
+
+  memcpy (phdrs, layout->phdrs_in,
+      layout->num_phdrs_in * sizeof (GumElfPhdr));
+
+  for (i = 0; i != layout->num_phdrs_in; i++)
+  {
+    phdr = &phdrs[i];
+
+    if (phdr->type == GUM_ELF_PHDR_PHDR)
+    {
+      phdr->offset = layout->code_offset;
+      phdr->vaddr = layout->code_address;
+      phdr->paddr = layout->code_address;
+      phdr->filesz = phdrs_size;
+      phdr->memsz = phdrs_size;
+    }
+  }
+
+  phdr = &phdrs[layout->num_phdrs_in];
+  phdr->type = GUM_ELF_PHDR_LOAD;
+  phdr->flags = GUM_ELF_PHDR_R | GUM_ELF_PHDR_X;
+  phdr->offset = layout->code_offset;
+  phdr->vaddr = layout->code_address;
+  phdr->paddr = layout->code_address;
+  phdr->filesz = layout->code_size;
+  phdr->memsz = layout->code_size;
+  phdr->align = layout->page_size;
+
+  phdr++;
+  phdr->type = GUM_ELF_PHDR_LOAD;
+  phdr->flags = GUM_ELF_PHDR_R | GUM_ELF_PHDR_W;
+  phdr->offset = layout->data_offset;
+  phdr->vaddr = layout->data_address;
+  phdr->paddr = layout->data_address;
+  phdr->filesz = layout->data_size;
+  phdr->memsz = layout->data_size;
+  phdr->align = layout->page_size;
+
+  phdr++;
+  phdr->type = GUM_ELF_PHDR_GUM_GRAFTED;
+  phdr->flags = GUM_ELF_PHDR_R;
+  phdr->offset = layout->data_offset;
+  phdr->vaddr = layout->data_address;
+  phdr->paddr = layout->data_address;
+  phdr->filesz = layout->data_size;
+  phdr->memsz = layout->data_size;
+  phdr->align = 8;
+
+  ehdr->phoff = layout->code_offset;
+  ehdr->phnum = layout->num_phdrs_out;
+}
+
+static gboolean
+gum_elf_grafter_enable_bind_now (guint8 * output,
+                                 const GumElfGraftedLayout * layout,
+                                 GError ** error)
+{
+  const GumElfPhdr * dynamic = NULL;
+  GumElfDyn * entries, * flags = NULL, * flags_1 = NULL, * spare = NULL;
+  gsize n, i;
+
+  for (i = 0; i != layout->num_phdrs_in; i++)
+  {
+    if (layout->phdrs_in[i].type == GUM_ELF_PHDR_DYNAMIC)
+    {
+      dynamic = &layout->phdrs_in[i];
+      break;
+    }
+  }
+  if (dynamic == NULL)
+    return TRUE;
+
+  entries = (GumElfDyn *) (output + dynamic->offset);
+  n = dynamic->filesz / sizeof (GumElfDyn);
+
+  for (i = 0; i != n; i++)
+  {
+    GumElfDyn * entry = &entries[i];
+
+    switch (entry->tag)
+    {
+      case GUM_ELF_DYNAMIC_NULL:
+        if (i + 1 != n && entries[i + 1].tag == GUM_ELF_DYNAMIC_NULL)
+          spare = entry;
+        goto end_of_entries;
+      case GUM_ELF_DYNAMIC_BIND_NOW:
+        return TRUE;
+      case GUM_ELF_DYNAMIC_FLAGS:
+        flags = entry;
+        break;
+      case GUM_ELF_DYNAMIC_FLAGS_1:
+        flags_1 = entry;
+        break;
+      default:
+        break;
+    }
+  }
+
+end_of_entries:
+  /*
+   * Import slots are matched against their resolved implementation when
+   * claimed, so lazily bound slots must be resolved at load time.
+   */
+  if (flags != NULL)
+  {
+    flags->val |= GUM_ELF_DF_BIND_NOW;
+    return TRUE;
+  }
+
+  if (flags_1 != NULL)
+  {
+    flags_1->val |= GUM_ELF_DF_1_NOW;
+    return TRUE;
+  }
+
+  if (spare != NULL)
+  {
+    spare->tag = GUM_ELF_DYNAMIC_FLAGS;
+    spare->val = GUM_ELF_DF_BIND_NOW;
+    return TRUE;
+  }
+
+  g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+      "Unable to enable eager binding; please relink with -z now");
+  return FALSE;
+}
+
+static gboolean
+gum_elf_grafter_emit_x86_64 (guint8 * output,
+                             const GumElfGraftedLayout * layout,
+                             GArray * sites,
+                             GArray * slots,
+                             GError ** error)
+{
+  static const guint8 endbr64[] = { 0xf3, 0x0f, 0x1e, 0xfa };
+  gboolean success = FALSE;
+  GumX86Writer cw;
+  GumX86Relocator rl;
+  guint8 * hook_trampolines, * import_trampolines;
+  GumElfGraftedHeader * header;
+  GumElfGraftedHook * hook_entries;
+  GumElfGraftedImport * import_entries;
+  GumAddress header_addr, begin_invocation_addr, end_invocation_addr;
+  GumAddress hook_entries_addr, import_entries_addr;
+  guint i, num_hooks;
+
+  gum_x86_writer_init (&cw, NULL);
+  gum_x86_writer_set_target_cpu (&cw, GUM_CPU_AMD64);
+  gum_x86_writer_set_target_abi (&cw, GUM_ABI_UNIX);
+  gum_x86_relocator_init (&rl, NULL, &cw);
+
+  hook_trampolines = output + layout->code_offset +
+      (layout->hook_trampolines_address - layout->code_address);
+  import_trampolines = output + layout->code_offset +
+      (layout->import_trampolines_address - layout->code_address);
+
+  header = (GumElfGraftedHeader *) (output + layout->data_offset);
+  hook_entries = (GumElfGraftedHook *) (header + 1);
+
+  header_addr = layout->data_address;
+  begin_invocation_addr = header_addr +
+      G_STRUCT_OFFSET (GumElfGraftedHeader, begin_invocation);
+  end_invocation_addr = header_addr +
+      G_STRUCT_OFFSET (GumElfGraftedHeader, end_invocation);
+  hook_entries_addr = header_addr + sizeof (GumElfGraftedHeader);
+
+  header->abi_version = GUM_ELF_GRAFTER_ABI_VERSION;
+
+  num_hooks = 0;
+  for (i = 0; i != sites->len; i++)
+  {
+    const GumElfGraftedSite * site =
+        &g_array_index (sites, GumElfGraftedSite, i);
+    GumAddress code_addr, site_addr, trampoline_addr;
+    GumAddress entry_addr, flags_addr, user_data_addr;
+    guint8 * code, * site_code, * trampoline;
+    GumElfGraftedHook * entry = &hook_entries[num_hooks];
+    guint32 flags;
+
+    code_addr = layout->preferred_address + site->code_offset;
+    trampoline_addr = layout->hook_trampolines_address +
+        (i * GUM_X86_HOOK_TRAMPOLINE_SIZE);
+    trampoline = hook_trampolines + (i * GUM_X86_HOOK_TRAMPOLINE_SIZE);
+
+    memset (trampoline, 0xcc, GUM_X86_HOOK_TRAMPOLINE_SIZE);
+
+    code = gum_elf_grafted_layout_resolve_code (layout, output, code_addr,
+        sizeof (endbr64) + GUM_X86_JMP_SIZE);
+    if (code == NULL)
+      goto unsupported_function;
+
+    site_addr = code_addr;
+    site_code = code;
+    if (memcmp (code, endbr64, sizeof (endbr64)) == 0)
+    {
+      site_addr += sizeof (endbr64);
+      site_code += sizeof (endbr64);
+    }
+
+    entry_addr = hook_entries_addr + (num_hooks * sizeof (GumElfGraftedHook));
+    flags_addr = entry_addr + G_STRUCT_OFFSET (GumElfGraftedHook, flags);
+    user_data_addr =
+        entry_addr + G_STRUCT_OFFSET (GumElfGraftedHook, user_data);
+
+    if (!gum_emit_x86_64_hook_trampoline (&cw, &rl, site_code, site_addr,
+        trampoline, trampoline_addr, flags_addr, user_data_addr,
+        begin_invocation_addr, end_invocation_addr, &flags))
+    {
+      memset (trampoline, 0xcc, GUM_X86_HOOK_TRAMPOLINE_SIZE);
+      goto unsupported_function;
+    }
+
+    gum_reset_x86_64_writer (&cw, site_code, site_addr);
+    gum_x86_writer_put_jmp_address (&cw,
+        trampoline_addr + GUM_ELF_GRAFTED_HOOK_ON_ENTER_OFFSET (&flags));
+    gum_x86_writer_flush (&cw);
+    g_assert (gum_x86_writer_offset (&cw) == GUM_X86_JMP_SIZE);
+
+    entry->code_offset = site->code_offset;
+    entry->trampoline_offset = trampoline_addr - layout->preferred_address;
+    entry->flags = flags;
+    num_hooks++;
+
+    continue;
+
+unsupported_function:
+    if (site->required)
+    {
+      g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+          "Unable to instrument function at offset 0x%x", site->code_offset);
+      goto beach;
+    }
+  }
+
+  header->num_hooks = num_hooks;
+
+  import_entries = (GumElfGraftedImport *) (hook_entries + num_hooks);
+  import_entries_addr =
+      hook_entries_addr + (num_hooks * sizeof (GumElfGraftedHook));
+
+  for (i = 0; i != slots->len; i++)
+  {
+    const GumElfGraftedSlot * slot =
+        &g_array_index (slots, GumElfGraftedSlot, i);
+    GumAddress trampoline_addr, on_enter_addr, on_leave_addr, user_data_addr;
+    GumElfGraftedImport * entry = &import_entries[i];
+
+    trampoline_addr = layout->import_trampolines_address +
+        (i * GUM_X86_IMPORT_TRAMPOLINE_SIZE);
+    user_data_addr = import_entries_addr +
+        (i * sizeof (GumElfGraftedImport)) +
+        G_STRUCT_OFFSET (GumElfGraftedImport, user_data);
+
+    gum_reset_x86_64_writer (&cw,
+        import_trampolines + (i * GUM_X86_IMPORT_TRAMPOLINE_SIZE),
+        trampoline_addr);
+
+    on_enter_addr = cw.pc;
+    gum_x86_writer_put_bytes (&cw, endbr64, sizeof (endbr64));
+    gum_x86_writer_put_push_near_ptr (&cw, user_data_addr);
+    gum_x86_writer_put_jmp_near_ptr (&cw, begin_invocation_addr);
+
+    on_leave_addr = cw.pc;
+    gum_x86_writer_put_push_near_ptr (&cw, user_data_addr);
+    gum_x86_writer_put_jmp_near_ptr (&cw, end_invocation_addr);
+
+    gum_x86_writer_flush (&cw);
+    g_assert (gum_x86_writer_offset (&cw) <= GUM_X86_IMPORT_TRAMPOLINE_SIZE);
+
+    entry->slot_offset = slot->slot_offset;
+    entry->trampoline_offset = trampoline_addr - layout->preferred_address;
+    entry->flags =
+        GUM_X86_IMPORT_TRAMPOLINE_SIZE          << 24 |
+        (on_enter_addr - trampoline_addr)       << 17 |
+        (on_leave_addr - trampoline_addr)       << 10 |
+        (slot->in_relro ? 0x2 : 0x0);
+  }
+
+  header->num_imports = slots->len;
+
+  success = TRUE;
+
+beach:
+  gum_x86_relocator_clear (&rl);
+  gum_x86_writer_clear (&cw);
+
+  return success;
+}
+
+static gboolean
+gum_emit_x86_64_hook_trampoline (GumX86Writer * cw,
+                                 GumX86Relocator * rl,
+                                 const guint8 * site_code,
+                                 GumAddress site_address,
+                                 guint8 * trampoline,
+                                 GumAddress trampoline_address,
+                                 GumAddress flags_address,
+                                 GumAddress user_data_address,
+                                 GumAddress begin_invocation_address,
+                                 GumAddress end_invocation_address,
+                                 guint32 * flags)
+{
+  guint8 scratch[GUM_X86_HOOK_TRAMPOLINE_SIZE + 64];
+  gconstpointer not_active = scratch;
+  guint8 test_active[] = {
+    0xf6, 0x05, 0x00, 0x00, 0x00, 0x00, 0x01 /* test byte [rip + X], 1 */
+  };
+  gint64 distance;
+  guint on_enter, on_leave, on_invoke, reloc_bytes;
+
+  gum_reset_x86_64_writer (cw, scratch, trampoline_address);
+
+  on_enter = gum_x86_writer_offset (cw);
+  distance = (gint64) flags_address -
+      (gint64) (cw->pc + sizeof (test_active));
+  if (distance < G_MININT32 || distance > G_MAXINT32)
+    return FALSE;
+  *((gint32 *) (test_active + 2)) = GINT32_TO_LE ((gint32) distance);
+  gum_x86_writer_put_bytes (cw, test_active, sizeof (test_active));
+  gum_x86_writer_put_jcc_short_label (cw, X86_INS_JE, not_active,
+      GUM_NO_HINT);
+  if (!gum_x86_writer_put_push_near_ptr (cw, user_data_address) ||
+      !gum_x86_writer_put_jmp_near_ptr (cw, begin_invocation_address))
+  {
+    return FALSE;
+  }
+
+  on_leave = gum_x86_writer_offset (cw);
+  if (!gum_x86_writer_put_push_near_ptr (cw, user_data_address) ||
+      !gum_x86_writer_put_jmp_near_ptr (cw, end_invocation_address))
+  {
+    return FALSE;
+  }
+
+  on_invoke = gum_x86_writer_offset (cw);
+  gum_x86_writer_put_label (cw, not_active);
+
+  gum_x86_relocator_reset (rl, site_code, cw);
+  rl->input_pc = site_address;
+
+  do
+  {
+    reloc_bytes = gum_x86_relocator_read_one (rl, NULL);
+    if (reloc_bytes == 0)
+      return FALSE;
+  }
+  while (reloc_bytes < GUM_X86_JMP_SIZE && !gum_x86_relocator_eob (rl));
+
+  if (reloc_bytes < GUM_X86_JMP_SIZE)
+    return FALSE;
+
+  gum_x86_relocator_write_all (rl);
+
+  if (!gum_x86_relocator_eoi (rl))
+    gum_x86_writer_put_jmp_address (cw, site_address + reloc_bytes);
+
+  if (!gum_x86_writer_flush (cw))
+    return FALSE;
+
+  if (gum_x86_writer_offset (cw) > GUM_X86_HOOK_TRAMPOLINE_SIZE)
+    return FALSE;
+
+  memcpy (trampoline, scratch, gum_x86_writer_offset (cw));
+
+  *flags =
+      GUM_X86_HOOK_TRAMPOLINE_SIZE << 24 |
+      on_enter                     << 17 |
+      on_leave                     << 10 |
+      on_invoke                    <<  3 |
+      0x0;
+
+  return TRUE;
+}
+
+static void
+gum_reset_x86_64_writer (GumX86Writer * cw,
+                         gpointer code,
+                         GumAddress pc)
+{
+  gum_x86_writer_reset (cw, code);
+  gum_x86_writer_set_target_cpu (cw, GUM_CPU_AMD64);
+  gum_x86_writer_set_target_abi (cw, GUM_ABI_UNIX);
+  cw->pc = pc;
+}
+
+static gboolean
+gum_elf_grafter_emit_arm64 (guint8 * output,
+                            const GumElfGraftedLayout * layout,
+                            GArray * sites,
+                            GArray * slots,
+                            GError ** error)
+{
+  gboolean success = FALSE;
+  GumArm64Writer cw;
+  GumElfArm64HookTrampoline * hook_trampolines;
+  GumElfArm64ImportTrampoline * import_trampolines;
+  GumElfGraftedHeader * header;
+  GumElfGraftedHook * hook_entries;
+  GumElfGraftedImport * import_entries;
+  GumAddress do_begin_invocation_addr, do_end_invocation_addr;
+  GumAddress header_addr, begin_invocation_addr, end_invocation_addr;
+  GumAddress hook_entries_addr, import_entries_addr;
+  guint i, num_hooks;
+
+  gum_arm64_writer_init (&cw, NULL);
+
+  hook_trampolines = (GumElfArm64HookTrampoline *) (output +
+      layout->code_offset +
+      (layout->hook_trampolines_address - layout->code_address));
+  import_trampolines = (GumElfArm64ImportTrampoline *) (output +
+      layout->code_offset +
+      (layout->import_trampolines_address - layout->code_address));
+
+  do_begin_invocation_addr = layout->runtime_address +
+      G_STRUCT_OFFSET (GumElfArm64Runtime, do_begin_invocation);
+  do_end_invocation_addr = layout->runtime_address +
+      G_STRUCT_OFFSET (GumElfArm64Runtime, do_end_invocation);
+
+  header = (GumElfGraftedHeader *) (output + layout->data_offset);
+  hook_entries = (GumElfGraftedHook *) (header + 1);
+
+  header_addr = layout->data_address;
+  begin_invocation_addr = header_addr +
+      G_STRUCT_OFFSET (GumElfGraftedHeader, begin_invocation);
+  end_invocation_addr = header_addr +
+      G_STRUCT_OFFSET (GumElfGraftedHeader, end_invocation);
+  hook_entries_addr = header_addr + sizeof (GumElfGraftedHeader);
+
+  header->abi_version = GUM_ELF_GRAFTER_ABI_VERSION;
+
+  num_hooks = 0;
+  for (i = 0; i != sites->len; i++)
+  {
+    const GumElfGraftedSite * site =
+        &g_array_index (sites, GumElfGraftedSite, i);
+    GumAddress code_addr, site_addr, trampoline_addr, on_enter_addr;
+    GumAddress entry_addr, flags_addr, user_data_addr;
+    guint32 * code, * site_code, overwritten_insn;
+    GumElfArm64HookTrampoline * trampoline = &hook_trampolines[i];
+    GumElfGraftedHook * entry = &hook_entries[num_hooks];
+    gconstpointer not_active = trampoline;
+
+    code_addr = layout->preferred_address + site->code_offset;
+    trampoline_addr = layout->hook_trampolines_address +
+        (i * sizeof (GumElfArm64HookTrampoline));
+    on_enter_addr = trampoline_addr +
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, on_enter);
+
+    if (code_addr % sizeof (guint32) != 0)
+      goto unsupported_function;
+
+    code = (guint32 *) gum_elf_grafted_layout_resolve_code (layout, output,
+        code_addr, 2 * sizeof (guint32));
+    if (code == NULL)
+      goto unsupported_function;
+
+    /* Keep BTI landing pads in place so indirect calls remain valid. */
+    site_addr = code_addr;
+    site_code = code;
+    if (GUINT32_FROM_LE (code[0]) == GUM_ARM64_BTI_C ||
+        GUINT32_FROM_LE (code[0]) == GUM_ARM64_BTI_JC)
+    {
+      site_addr += sizeof (guint32);
+      site_code++;
+    }
+
+    overwritten_insn = GUINT32_FROM_LE (site_code[0]);
+    if (!gum_arm64_can_relocate_instruction (overwritten_insn))
+      goto unsupported_function;
+
+    entry_addr = hook_entries_addr + (num_hooks * sizeof (GumElfGraftedHook));
+    flags_addr = entry_addr + G_STRUCT_OFFSET (GumElfGraftedHook, flags);
+    user_data_addr =
+        entry_addr + G_STRUCT_OFFSET (GumElfGraftedHook, user_data);
+
+    gum_arm64_writer_reset (&cw, site_code);
+    cw.pc = site_addr;
+    if (!gum_arm64_writer_put_b_imm (&cw, on_enter_addr))
+      goto branch_error;
+    gum_arm64_writer_flush (&cw);
+
+    gum_arm64_writer_reset (&cw, trampoline->on_enter);
+    cw.pc = on_enter_addr;
+    gum_arm64_writer_put_push_reg_reg (&cw, ARM64_REG_X16, ARM64_REG_X17);
+    if (!gum_arm64_writer_put_ldr_reg_u32_ptr (&cw,
+        ARM64_REG_W16, flags_addr))
+    {
+      goto ldr_error;
+    }
+    gum_arm64_writer_put_tbz_reg_imm_label (&cw,
+        ARM64_REG_W16, 0, not_active);
+    if (!gum_arm64_writer_put_ldr_reg_u64_ptr (&cw,
+        ARM64_REG_X17, user_data_addr))
+    {
+      goto ldr_error;
+    }
+    gum_arm64_writer_put_b_imm (&cw, do_begin_invocation_addr);
+
+    g_assert (cw.pc == trampoline_addr +
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, on_leave));
+    gum_arm64_writer_put_push_reg_reg (&cw, ARM64_REG_X16, ARM64_REG_X17);
+    if (!gum_arm64_writer_put_ldr_reg_u64_ptr (&cw,
+        ARM64_REG_X17, user_data_addr))
+    {
+      goto ldr_error;
+    }
+    gum_arm64_writer_put_b_imm (&cw, do_end_invocation_addr);
+
+    g_assert (cw.pc == trampoline_addr +
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, not_active));
+    gum_arm64_writer_put_label (&cw, not_active);
+    gum_arm64_writer_put_pop_reg_reg (&cw, ARM64_REG_X16, ARM64_REG_X17);
+
+    g_assert (cw.pc == trampoline_addr +
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, on_invoke));
+    /* Reached through BR from the runtime, so it needs a landing pad. */
+    gum_arm64_writer_put_instruction (&cw, GUM_ARM64_BTI_JC);
+    gum_arm64_writer_put_instruction (&cw, overwritten_insn);
+    gum_arm64_writer_put_b_imm (&cw, site_addr + sizeof (overwritten_insn));
+
+    gum_arm64_writer_flush (&cw);
+    g_assert (
+        gum_arm64_writer_offset (&cw) == sizeof (GumElfArm64HookTrampoline));
+
+    entry->code_offset = site->code_offset;
+    entry->trampoline_offset = trampoline_addr - layout->preferred_address;
+    entry->flags =
+        sizeof (GumElfArm64HookTrampoline)                     << 24 |
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, on_enter)  << 17 |
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, on_leave)  << 10 |
+        G_STRUCT_OFFSET (GumElfArm64HookTrampoline, on_invoke) <<  3 |
+        0x0;
+    num_hooks++;
+
+    continue;
+
+unsupported_function:
+    if (site->required)
+    {
+      g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+          "Unable to instrument function at offset 0x%x", site->code_offset);
+      goto beach;
+    }
+  }
+
+  header->num_hooks = num_hooks;
+
+  import_entries = (GumElfGraftedImport *) (hook_entries + num_hooks);
+  import_entries_addr =
+      hook_entries_addr + (num_hooks * sizeof (GumElfGraftedHook));
+
+  for (i = 0; i != slots->len; i++)
+  {
+    const GumElfGraftedSlot * slot =
+        &g_array_index (slots, GumElfGraftedSlot, i);
+    GumElfArm64ImportTrampoline * trampoline = &import_trampolines[i];
+    GumAddress trampoline_addr, user_data_addr;
+    GumElfGraftedImport * entry = &import_entries[i];
+
+    trampoline_addr = layout->import_trampolines_address +
+        (i * sizeof (GumElfArm64ImportTrampoline));
+    user_data_addr = import_entries_addr +
+        (i * sizeof (GumElfGraftedImport)) +
+        G_STRUCT_OFFSET (GumElfGraftedImport, user_data);
+
+    gum_arm64_writer_reset (&cw, trampoline->on_enter);
+    cw.pc = trampoline_addr +
+        G_STRUCT_OFFSET (GumElfArm64ImportTrampoline, on_enter);
+    gum_arm64_writer_put_instruction (&cw, GUM_ARM64_BTI_C);
+    gum_arm64_writer_put_push_reg_reg (&cw, ARM64_REG_X16, ARM64_REG_X17);
+    if (!gum_arm64_writer_put_ldr_reg_u64_ptr (&cw,
+        ARM64_REG_X17, user_data_addr))
+    {
+      goto ldr_error;
+    }
+    gum_arm64_writer_put_b_imm (&cw, do_begin_invocation_addr);
+
+    g_assert (cw.pc == trampoline_addr +
+        G_STRUCT_OFFSET (GumElfArm64ImportTrampoline, on_leave));
+    gum_arm64_writer_put_push_reg_reg (&cw, ARM64_REG_X16, ARM64_REG_X17);
+    if (!gum_arm64_writer_put_ldr_reg_u64_ptr (&cw,
+        ARM64_REG_X17, user_data_addr))
+    {
+      goto ldr_error;
+    }
+    gum_arm64_writer_put_b_imm (&cw, do_end_invocation_addr);
+
+    gum_arm64_writer_flush (&cw);
+    g_assert (gum_arm64_writer_offset (&cw) ==
+        sizeof (GumElfArm64ImportTrampoline));
+
+    entry->slot_offset = slot->slot_offset;
+    entry->trampoline_offset = trampoline_addr - layout->preferred_address;
+    entry->flags =
+        sizeof (GumElfArm64ImportTrampoline)                     << 24 |
+        G_STRUCT_OFFSET (GumElfArm64ImportTrampoline, on_enter)  << 17 |
+        G_STRUCT_OFFSET (GumElfArm64ImportTrampoline, on_leave)  << 10 |
+        (slot->in_relro ? 0x2 : 0x0);
+  }
+
+  header->num_imports = slots->len;
+
+  gum_arm64_writer_reset (&cw, output + layout->code_offset +
+      (layout->runtime_address - layout->code_address));
+
+  cw.pc = do_begin_invocation_addr;
+  if (!gum_arm64_writer_put_ldr_reg_u64_ptr (&cw,
+      ARM64_REG_X16, begin_invocation_addr))
+  {
+    goto ldr_error;
+  }
+  gum_arm64_writer_put_br_reg_no_auth (&cw, ARM64_REG_X16);
+
+  g_assert (cw.pc == do_end_invocation_addr);
+  if (!gum_arm64_writer_put_ldr_reg_u64_ptr (&cw,
+      ARM64_REG_X16, end_invocation_addr))
+  {
+    goto ldr_error;
+  }
+  gum_arm64_writer_put_br_reg_no_auth (&cw, ARM64_REG_X16);
+
+  gum_arm64_writer_flush (&cw);
+
+  success = TRUE;
+  goto beach;
+
+ldr_error:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_FAILED,
+        "LDR target too far away; please file a bug");
+    goto beach;
+  }
+branch_error:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+        "Binary too large to reach grafted trampolines with a direct branch");
+    goto beach;
+  }
+beach:
+  {
+    gum_arm64_writer_clear (&cw);
+
+    return success;
+  }
+}
+
+static gboolean
+gum_arm64_can_relocate_instruction (guint32 insn)
+{
+  /* PACIASP and PACIBSP: the runtime would observe a signed LR. */
+  if (insn == 0xd503233f || insn == 0xd503237f)
+    return FALSE;
+
+  /* B, BL */
+  if ((insn & 0x7c000000) == 0x14000000)
+    return FALSE;
+
+  /* B.cond */
+  if ((insn & 0xff000010) == 0x54000000)
+    return FALSE;
+
+  /* CBZ, CBNZ, TBZ, TBNZ */
+  if ((insn & 0x7c000000) == 0x34000000)
+    return FALSE;
+
+  /* ADR, ADRP */
+  if ((insn & 0x1f000000) == 0x10000000)
+    return FALSE;
+
+  /* LDR (literal), LDRSW (literal), PRFM (literal) */
+  if ((insn & 0x3b000000) == 0x18000000)
+    return FALSE;
+
+  /* RET, BR, BLR and their authenticated variants */
+  if ((insn & 0xfe000000) == 0xd6000000)
+    return FALSE;
+
+  return TRUE;
+}
+
+static guint8 *
+gum_elf_grafted_layout_resolve_code (const GumElfGraftedLayout * layout,
+                                     guint8 * output,
+                                     GumAddress address,
+                                     gsize size)
+{
+  guint i;
+
+  for (i = 0; i != layout->num_phdrs_in; i++)
+  {
+    const GumElfPhdr * phdr = &layout->phdrs_in[i];
+
+    if (phdr->type != GUM_ELF_PHDR_LOAD ||
+        (phdr->flags & GUM_ELF_PHDR_X) == 0)
+    {
+      continue;
+    }
+
+    if (address >= phdr->vaddr &&
+        address + size <= phdr->vaddr + phdr->filesz)
+    {
+      return output + phdr->offset + (address - phdr->vaddr);
+    }
+  }
+
+  return NULL;
+}
+
+static gboolean
+gum_elf_grafted_layout_is_relro (const GumElfPhdr * phdrs,
+                                 guint16 num_phdrs,
+                                 GumAddress address)
+{
+  guint i;
+
+  for (i = 0; i != num_phdrs; i++)
+  {
+    const GumElfPhdr * phdr = &phdrs[i];
+
+    if (phdr->type == GUM_ELF_PHDR_GNU_RELRO &&
+        address >= phdr->vaddr &&
+        address < phdr->vaddr + phdr->memsz)
+    {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static guint64
+gum_align_u64 (guint64 value,
+               guint64 alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+#endif
+
+void
+_gum_elf_grafted_hook_activate (GumElfGraftedHook * self)
+{
+  self->flags |= 1;
+}
+
+void
+_gum_elf_grafted_hook_deactivate (GumElfGraftedHook * self)
+{
+  self->flags &= ~1;
+}
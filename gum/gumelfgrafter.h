@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_ELF_GRAFTER_H__
+#define __GUM_ELF_GRAFTER_H__
+
+#include <gum/gumdefs.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  GUM_ELF_GRAFTER_FLAGS_NONE           = 0,
+  GUM_ELF_GRAFTER_FLAGS_INGEST_EXPORTS = (1 << 0),
+  GUM_ELF_GRAFTER_FLAGS_INGEST_IMPORTS = (1 << 1),
+} GumElfGrafterFlags;
+
+#define GUM_TYPE_ELF_GRAFTER (gum_elf_grafter_get_type ())
+GUM_DECLARE_FINAL_TYPE (GumElfGrafter, gum_elf_grafter, GUM, ELF_GRAFTER,
+                        GObject)
+
+GUM_API GumElfGrafter * gum_elf_grafter_new_from_file (const gchar * path,
+    GumElfGrafterFlags flags);
+
+GUM_API void gum_elf_grafter_add (GumElfGrafter * self, guint32 code_offset);
+GUM_API void gum_elf_grafter_add_symbol (GumElfGrafter * self,
+    const gchar * name);
+GUM_API void gum_elf_grafter_add_import (GumElfGrafter * self,
+    const gchar * name);
+
+GUM_API gboolean gum_elf_grafter_graft (GumElfGrafter * self, GError ** error);
+
+G_END_DECLS
+
+#endif
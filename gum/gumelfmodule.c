@@ -45,6 +45,7 @@
 #define GUM_READ(dst, src, type) \
     dst = G_PASTE (gum_elf_module_read_, type) (self, &src);
 
+typedef guint GumElfFacets;
 typedef guint GumElfDynamicAddressState;
 typedef struct _GumElfRelocationGroup GumElfRelocationGroup;
 typedef struct _GumElfEnumerateImportsContext GumElfEnumerateImportsContext;
@@ -69,6 +70,7 @@ enum
   PROP_SOURCE_PATH,
   PROP_SOURCE_BLOB,
   PROP_SOURCE_MODE,
+  PROP_FLAGS,
 };
 
 struct _GumElfModule
@@ -78,6 +80,11 @@ struct _GumElfModule
   gchar * source_path;
   GBytes * source_blob;
   GumElfSourceMode source_mode;
+  GumElfModuleFlags flags;
+
+  GMutex facets_mutex;
+  volatile GumElfFacets attempted_facets;
+  GumElfFacets loaded_facets;
 
   GBytes * file_bytes;
   gconstpointer file_data;
@@ -97,6 +104,13 @@ struct _GumElfModule
   const gchar * dynamic_strings;
 };
 
+enum _GumElfFacet
+{
+  GUM_ELF_FACET_HEADERS   = (1 << 0),
+  GUM_ELF_FACET_FILE_DATA = (1 << 1),
+  GUM_ELF_FACET_SECTIONS  = (1 << 2),
+};
+
 enum _GumElfDynamicAddressState
 {
   GUM_ELF_DYNAMIC_ADDRESS_PRISTINE,
@@ -158,6 +172,16 @@ static void gum_elf_module_get_property (GObject * object,
 static void gum_elf_module_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 
+static gboolean gum_elf_module_ensure_facets (GumElfModule * self,
+    GumElfFacets facets);
+static gboolean gum_elf_module_load_facets (GumElfModule * self,
+    GumElfFacets facets, GError ** error);
+static gboolean gum_elf_module_has_facets (GumElfModule * self,
+    GumElfFacets facets);
+static gboolean gum_elf_module_load_file_data (GumElfModule * self,
+    GError ** error);
+static gboolean gum_elf_module_load_sections (GumElfModule * self,
+    GError ** error);
 static gboolean gum_elf_module_load_elf_header (GumElfModule * self,
     GError ** error);
 static gboolean gum_elf_module_load_program_headers (GumElfModule * self,
@@ -172,6 +196,9 @@ static gboolean gum_elf_module_load_dynamic_entries (GumElfModule * self,
 static gconstpointer gum_elf_module_get_live_data (GumElfModule * self,
     gsize * size);
 static void gum_elf_module_unload (GumElfModule * self);
+static void gum_elf_module_enumerate_dynamic_symbols_in_facets (
+    GumElfModule * self, GumElfFacets facets, GumFoundElfSymbolFunc func,
+    gpointer user_data);
 static gboolean gum_elf_module_emit_relocations (GumElfModule * self,
     const GumElfRelocationGroup * g, GumFoundElfRelocationFunc func,
     gpointer user_data);
@@ -300,6 +327,10 @@ gum_elf_module_class_init (GumElfModuleClass * klass)
       g_param_spec_enum ("source-mode", "SourceMode", "Source mode",
       GUM_TYPE_ELF_SOURCE_MODE, GUM_ELF_SOURCE_MODE_OFFLINE,
       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class, PROP_FLAGS,
+      g_param_spec_flags ("flags", "Flags", "Optional flags",
+      GUM_TYPE_ELF_MODULE_FLAGS, GUM_ELF_MODULE_FLAGS_NONE,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -314,6 +345,8 @@ gum_elf_module_init (GumElfModule * self)
       (GDestroyNotify) gum_elf_section_details_clear);
 
   self->mapped_size = GUM_ELF_DEFAULT_MAPPED_SIZE;
+
+  g_mutex_init (&self->facets_mutex);
 }
 
 static void
@@ -329,6 +362,8 @@ gum_elf_module_finalize (GObject * object)
   g_array_unref (self->shdrs);
   g_array_unref (self->phdrs);
 
+  g_mutex_clear (&self->facets_mutex);
+
   g_bytes_unref (self->source_blob);
   g_free (self->source_path);
 
@@ -387,6 +422,9 @@ gum_elf_module_get_property (GObject * object,
     case PROP_SOURCE_MODE:
       g_value_set_enum (value, gum_elf_module_get_source_mode (self));
       break;
+    case PROP_FLAGS:
+      g_value_set_flags (value, self->flags);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -416,6 +454,9 @@ gum_elf_module_set_property (GObject * object,
     case PROP_SOURCE_MODE:
       self->source_mode = g_value_get_enum (value);
       break;
+    case PROP_FLAGS:
+      self->flags = g_value_get_flags (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -463,6 +504,16 @@ GumElfModule *
 gum_elf_module_new_from_memory (const gchar * path,
                                 GumAddress base_address,
                                 GError ** error)
+{
+  return gum_elf_module_new_from_memory_full (path, base_address,
+      GUM_ELF_MODULE_FLAGS_NONE, error);
+}
+
+GumElfModule *
+gum_elf_module_new_from_memory_full (const gchar * path,
+                                     GumAddress base_address,
+                                     GumElfModuleFlags flags,
+                                     GError ** error)
 {
   GumElfModule * module;
 
@@ -470,6 +521,7 @@ gum_elf_module_new_from_memory (const gchar * path,
       "base-address", base_address,
       "source-path", path,
       "source-mode", GUM_ELF_SOURCE_MODE_ONLINE,
+      "flags", flags,
       NULL);
   if (!gum_elf_module_load (module, error))
   {
@@ -483,6 +535,135 @@ gum_elf_module_new_from_memory (const gchar * path,
 gboolean
 gum_elf_module_load (GumElfModule * self,
                      GError ** error)
+{
+  if ((self->loaded_facets & GUM_ELF_FACET_HEADERS) != 0)
+    return TRUE;
+
+  /*
+   * When operating online everything up to and including the dynamic entries
+   * can be read from memory, so the backing file is only mapped once we get
+   * to the section headers. In header-only mode that is deferred until the
+   * first call that needs them.
+   */
+  if (self->source_mode == GUM_ELF_SOURCE_MODE_OFFLINE)
+  {
+    if (!gum_elf_module_load_file_data (self, error))
+      goto propagate_error;
+    self->loaded_facets |= GUM_ELF_FACET_FILE_DATA;
+    self->attempted_facets |= GUM_ELF_FACET_FILE_DATA;
+  }
+
+  if (!gum_elf_module_load_elf_header (self, error))
+    goto propagate_error;
+
+  if (!gum_elf_module_load_program_headers (self, error))
+    goto propagate_error;
+
+  self->mapped_size = gum_elf_module_compute_mapped_size (self);
+  self->preferred_address = gum_elf_module_compute_preferred_address (self);
+
+  if (!gum_elf_module_load_dynamic_entries (self, error))
+    goto propagate_error;
+
+  self->dynamic_address_state =
+      gum_elf_module_detect_dynamic_address_state (self);
+
+  gum_elf_module_enumerate_dynamic_entries (self,
+      gum_store_dynamic_string_table, self);
+
+  self->loaded_facets |= GUM_ELF_FACET_HEADERS;
+  self->attempted_facets |= GUM_ELF_FACET_HEADERS;
+
+  if ((self->flags & GUM_ELF_MODULE_FLAGS_HEADER_ONLY) == 0 &&
+      !gum_elf_module_load_facets (self, GUM_ELF_FACET_SECTIONS, error))
+  {
+    goto propagate_error;
+  }
+
+  return TRUE;
+
+propagate_error:
+  {
+    gum_elf_module_unload (self);
+
+    return FALSE;
+  }
+}
+
+static gboolean
+gum_elf_module_ensure_facets (GumElfModule * self,
+                              GumElfFacets facets)
+{
+  return gum_elf_module_load_facets (self, facets, NULL);
+}
+
+static gboolean
+gum_elf_module_load_facets (GumElfModule * self,
+                            GumElfFacets facets,
+                            GError ** error)
+{
+  GumElfFacets pending;
+  GError * local_error = NULL;
+
+  if ((facets & GUM_ELF_FACET_SECTIONS) != 0)
+    facets |= GUM_ELF_FACET_FILE_DATA;
+
+  if ((g_atomic_int_get (&self->attempted_facets) & facets) == facets)
+    goto check_loaded;
+
+  g_mutex_lock (&self->facets_mutex);
+
+  pending = facets & ~self->attempted_facets;
+
+  if ((pending & GUM_ELF_FACET_FILE_DATA) != 0)
+  {
+    if (gum_elf_module_load_file_data (self, &local_error))
+      self->loaded_facets |= GUM_ELF_FACET_FILE_DATA;
+    g_atomic_int_or (&self->attempted_facets, GUM_ELF_FACET_FILE_DATA);
+  }
+
+  if ((pending & GUM_ELF_FACET_SECTIONS) != 0)
+  {
+    if ((self->loaded_facets & GUM_ELF_FACET_FILE_DATA) != 0 &&
+        gum_elf_module_load_sections (self, &local_error))
+    {
+      self->loaded_facets |= GUM_ELF_FACET_SECTIONS;
+    }
+    g_atomic_int_or (&self->attempted_facets, GUM_ELF_FACET_SECTIONS);
+  }
+
+  g_mutex_unlock (&self->facets_mutex);
+
+  if (local_error != NULL)
+  {
+    g_propagate_error (error, local_error);
+    return FALSE;
+  }
+
+check_loaded:
+  if ((self->loaded_facets & facets) != facets)
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_DATA,
+        "Unable to load %s", ((facets & GUM_ELF_FACET_SECTIONS) != 0)
+          ? "section headers"
+          : "file data");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gum_elf_module_has_facets (GumElfModule * self,
+                           GumElfFacets facets)
+{
+  return (g_atomic_int_get (&self->attempted_facets) & facets) == facets &&
+      (self->loaded_facets & facets) == facets;
+}
+
+static gboolean
+gum_elf_module_load_file_data (GumElfModule * self,
+                               GError ** error)
 {
   GError * local_error = NULL;
 
@@ -517,46 +698,30 @@ gum_elf_module_load (GumElfModule * self,
 
   self->file_data = g_bytes_get_data (self->file_bytes, &self->file_size);
 
-  if (!gum_elf_module_load_elf_header (self, error))
-    goto propagate_error;
-
-  if (!gum_elf_module_load_program_headers (self, error))
-    goto propagate_error;
-
-  self->mapped_size = gum_elf_module_compute_mapped_size (self);
-  self->preferred_address = gum_elf_module_compute_preferred_address (self);
-
-  if (!gum_elf_module_load_section_headers (self, error))
-    goto propagate_error;
-
-  if (!gum_elf_module_load_dynamic_entries (self, error))
-    goto propagate_error;
-
-  self->dynamic_address_state =
-      gum_elf_module_detect_dynamic_address_state (self);
-
-  gum_elf_module_enumerate_dynamic_entries (self,
-      gum_store_dynamic_string_table, self);
-
-  if (!gum_elf_module_load_section_details (self, error))
-    goto propagate_error;
-
   return TRUE;
 
 unable_to_open:
   {
     g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
         "%s", local_error->message);
-    goto propagate_error;
-  }
-propagate_error:
-  {
-    g_clear_error (&local_error);
+    g_error_free (local_error);
 
-    gum_elf_module_unload (self);
+    return FALSE;
+  }
+}
 
+static gboolean
+gum_elf_module_load_sections (GumElfModule * self,
+                              GError ** error)
+{
+  if (!gum_elf_module_load_section_headers (self, error) ||
+      !gum_elf_module_load_section_details (self, error))
+  {
+    g_array_set_size (self->shdrs, 0);
     return FALSE;
   }
+
+  return TRUE;
 }
 
 static gboolean
@@ -1030,6 +1195,9 @@ gum_elf_module_unload (GumElfModule * self)
   self->file_bytes = NULL;
   self->file_data = NULL;
   self->file_size = 0;
+
+  self->loaded_facets = 0;
+  self->attempted_facets = 0;
 }
 
 GumElfType
@@ -1115,6 +1283,8 @@ gum_elf_module_get_interpreter (GumElfModule * self)
       const gchar * interp;
 
       data = gum_elf_module_get_file_data (self, &size);
+      if (data == NULL)
+        return NULL;
 
       interp = (const gchar *) data + phdr->offset;
       if (!gum_elf_module_check_str_bounds (self, interp, data, size, "interp",
@@ -1152,6 +1322,8 @@ gconstpointer
 gum_elf_module_get_file_data (GumElfModule * self,
                               gsize * size)
 {
+  gum_elf_module_ensure_facets (self, GUM_ELF_FACET_FILE_DATA);
+
   if (size != NULL)
     *size = self->file_size;
 
@@ -1191,6 +1363,9 @@ gum_elf_module_enumerate_sections (GumElfModule * self,
 {
   guint i;
 
+  if (!gum_elf_module_ensure_facets (self, GUM_ELF_FACET_SECTIONS))
+    return;
+
   for (i = 0; i != self->shdrs->len; i++)
   {
     const GumElfSectionDetails * d =
@@ -1211,6 +1386,9 @@ gum_elf_module_enumerate_relocations (GumElfModule * self,
   guint i;
   GumElfRelocationGroup g = { 0, };
 
+  if (!gum_elf_module_ensure_facets (self, GUM_ELF_FACET_SECTIONS))
+    return;
+
   data = gum_elf_module_get_file_data (self, &size);
 
   for (i = 0; i != self->shdrs->len; i++)
@@ -1473,7 +1651,8 @@ gum_elf_module_enumerate_imports (GumElfModule * self,
   ctx.func = func;
   ctx.user_data = user_data;
 
-  gum_elf_module_enumerate_dynamic_symbols (self, gum_emit_elf_import, &ctx);
+  gum_elf_module_enumerate_dynamic_symbols_in_facets (self,
+      GUM_ELF_FACET_HEADERS, gum_emit_elf_import, &ctx);
 }
 
 static gboolean
@@ -1538,7 +1717,8 @@ gum_elf_module_enumerate_exports (GumElfModule * self,
   ctx.func = func;
   ctx.user_data = user_data;
 
-  gum_elf_module_enumerate_dynamic_symbols (self, gum_emit_elf_export, &ctx);
+  gum_elf_module_enumerate_dynamic_symbols_in_facets (self,
+      GUM_ELF_FACET_HEADERS, gum_emit_elf_export, &ctx);
 }
 
 static gboolean
@@ -1572,6 +1752,16 @@ void
 gum_elf_module_enumerate_dynamic_symbols (GumElfModule * self,
                                           GumFoundElfSymbolFunc func,
                                           gpointer user_data)
+{
+  gum_elf_module_enumerate_dynamic_symbols_in_facets (self,
+      GUM_ELF_FACET_HEADERS | GUM_ELF_FACET_SECTIONS, func, user_data);
+}
+
+static void
+gum_elf_module_enumerate_dynamic_symbols_in_facets (GumElfModule * self,
+                                                    GumElfFacets facets,
+                                                    GumFoundElfSymbolFunc func,
+                                                    gpointer user_data)
 {
   GumElfStoreSymtabParamsContext ctx;
   gsize i;
@@ -1593,7 +1783,12 @@ gum_elf_module_enumerate_dynamic_symbols (GumElfModule * self,
   if (ctx.pending != 0 || ctx.entry_count == 0)
     return;
 
-  gum_elf_module_enumerate_sections (self, gum_adjust_symtab_params, &ctx);
+  /*
+   * Section details only refine what we already know, so callers that do
+   * not need them get to skip mapping the backing file.
+   */
+  if ((facets & GUM_ELF_FACET_SECTIONS) != 0)
+    gum_elf_module_enumerate_sections (self, gum_adjust_symtab_params, &ctx);
 
   data = gum_elf_module_get_live_data (self, &size);
 
@@ -1832,6 +2027,9 @@ gum_elf_module_enumerate_symbols_in_section (GumElfModule * self,
   gconstpointer cursor;
   GError ** error = NULL;
 
+  if (!gum_elf_module_ensure_facets (self, GUM_ELF_FACET_SECTIONS))
+    return;
+
   shdr = gum_elf_module_find_section_header_by_type (self, section);
   if (shdr == NULL)
     return;
@@ -2043,6 +2241,9 @@ gum_elf_module_find_section_details_by_index (GumElfModule * self,
   if (i == GUM_ELF_SHDR_INDEX_UNDEF)
     return NULL;
 
+  if (!gum_elf_module_has_facets (self, GUM_ELF_FACET_SECTIONS))
+    return NULL;
+
   if (i >= self->sections->len)
     return NULL;
 
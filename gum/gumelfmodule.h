@@ -239,6 +239,15 @@ typedef enum {
   GUM_ELF_SOURCE_MODE_ONLINE,
 } GumElfSourceMode;
 
+/*
+ * In header-only mode the backing file is not mapped, and the section headers
+ * not parsed, until something first needs them.
+ */
+typedef enum {
+  GUM_ELF_MODULE_FLAGS_NONE        = 0,
+  GUM_ELF_MODULE_FLAGS_HEADER_ONLY = (1 << 0),
+} GumElfModuleFlags;
+
 typedef enum {
   GUM_ELF_SECTION_NULL,
   GUM_ELF_SECTION_PROGBITS,
@@ -946,6 +955,9 @@ GUM_API GumElfModule * gum_elf_module_new_from_blob (GBytes * blob,
     GError ** error);
 GUM_API GumElfModule * gum_elf_module_new_from_memory (const gchar * path,
     GumAddress base_address, GError ** error);
+GUM_API GumElfModule * gum_elf_module_new_from_memory_full (
+    const gchar * path, GumAddress base_address, GumElfModuleFlags flags,
+    GError ** error);
 
 GUM_API gboolean gum_elf_module_load (GumElfModule * self, GError ** error);
 
@@ -42,6 +42,7 @@ struct _GumFunctionContext
   guint8 destroyed;
   guint8 activated;
   guint8 has_on_leave_listener;
+  guint8 return_stack_balanced;
 
   GumCodeSlice * trampoline_slice;
   GumCodeDeflector * trampoline_deflector;
@@ -52,6 +53,7 @@ struct _GumFunctionContext
   guint overwritten_prologue_len;
 
   gpointer on_invoke_trampoline;
+  gpointer on_call_trampoline;
 
   gpointer on_leave_trampoline;
 
@@ -11,6 +11,7 @@
 #include "guminterceptor-priv.h"
 #include "gumlibc.h"
 #include "gummemory.h"
+#include "gumperfmap-priv.h"
 #include "gumprocess-priv.h"
 #include "gumtls.h"
 
@@ -68,6 +69,7 @@ struct _GumInterceptor
   GumCodeAllocator allocator;
 
   volatile guint selected_thread_id;
+  gboolean return_stack_balanced;
 
   GumInterceptorTransaction current_transaction;
 };
@@ -760,6 +762,30 @@ gum_interceptor_unignore_other_threads (GumInterceptor * self)
   self->selected_thread_id = 0;
 }
 
+/**
+ * gum_interceptor_set_return_stack_balanced:
+ * @self: a #GumInterceptor
+ * @balanced: whether to keep the return stack balanced
+ *
+ * Controls how functions instrumented from now on trap their return when
+ * there are listeners with `on_leave` callbacks. By default the caller's
+ * return address is replaced, which makes the CPU mispredict that return
+ * and every return up the call chain after it. When @balanced is %TRUE,
+ * the trampoline instead calls the function itself, so each call is paired
+ * with its return.
+ *
+ * Only supported on x86 and arm64 without pointer authentication, and
+ * ignored elsewhere. Replacements keep using the default approach.
+ */
+void
+gum_interceptor_set_return_stack_balanced (GumInterceptor * self,
+                                           gboolean balanced)
+{
+  GUM_INTERCEPTOR_LOCK (self);
+  self->return_stack_balanced = balanced;
+  GUM_INTERCEPTOR_UNLOCK (self);
+}
+
 gpointer
 gum_invocation_stack_translate (GumInvocationStack * self,
                                 gpointer return_address)
@@ -874,6 +900,7 @@ gum_interceptor_instrument (GumInterceptor * self,
   }
 
   ctx = gum_function_context_new (self, function_address, type);
+  ctx->return_stack_balanced = self->return_stack_balanced;
 
   if (gum_process_get_code_signing_policy () == GUM_CODE_SIGNING_REQUIRED)
   {
@@ -882,8 +909,20 @@ gum_interceptor_instrument (GumInterceptor * self,
   }
   else
   {
-    if (!_gum_interceptor_backend_create_trampoline (self->backend, ctx))
-      goto wrong_signature;
+    /* Prefer trampolines grafted ahead of time, as they need no patching. */
+    if (type == GUM_INTERCEPTOR_TYPE_FAST ||
+        !_gum_interceptor_backend_claim_grafted_trampoline (self->backend, ctx))
+    {
+      if (!_gum_interceptor_backend_create_trampoline (self->backend, ctx))
+        goto wrong_signature;
+
+      if (ctx->trampoline_slice != NULL)
+      {
+        _gum_perf_map_add_instrumented_code ("interceptor",
+            ctx->trampoline_slice->data, ctx->trampoline_slice->size,
+            function_address);
+      }
+    }
   }
 
   g_hash_table_insert (self->function_by_address, function_address, ctx);
@@ -1596,7 +1635,8 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
 
   gum_tls_key_set_value (gum_interceptor_guard_key, NULL);
 
-  if (will_trap_on_leave)
+  if (will_trap_on_leave && (function_ctx->on_call_trampoline == NULL ||
+      function_ctx->replacement_function != NULL))
   {
     *caller_ret_addr = function_ctx->on_leave_trampoline;
   }
@@ -1612,6 +1652,14 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
 
     *next_hop = function_ctx->replacement_function;
   }
+  else if (will_trap_on_leave && function_ctx->on_call_trampoline != NULL)
+  {
+    /*
+     * Leave the caller's return address alone, the trampoline calls the
+     * function and lands in on_leave_trampoline when it returns.
+     */
+    *next_hop = function_ctx->on_call_trampoline;
+  }
   else
   {
     *next_hop = function_ctx->on_invoke_trampoline;
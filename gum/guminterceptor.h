@@ -70,6 +70,9 @@ GUM_API gboolean gum_interceptor_maybe_unignore_current_thread (
 GUM_API void gum_interceptor_ignore_other_threads (GumInterceptor * self);
 GUM_API void gum_interceptor_unignore_other_threads (GumInterceptor * self);
 
+GUM_API void gum_interceptor_set_return_stack_balanced (GumInterceptor * self,
+    gboolean balanced);
+
 GUM_API gpointer gum_invocation_stack_translate (GumInvocationStack * self,
     gpointer return_address);
 
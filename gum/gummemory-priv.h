@@ -32,6 +32,7 @@ G_BEGIN_DECLS
 G_GNUC_INTERNAL void _gum_memory_backend_init (void);
 G_GNUC_INTERNAL void _gum_memory_backend_deinit (void);
 G_GNUC_INTERNAL guint _gum_memory_backend_query_page_size (void);
+G_GNUC_INTERNAL gsize _gum_memory_backend_query_huge_page_size (void);
 G_GNUC_INTERNAL gint _gum_page_protection_to_posix (GumPageProtection prot);
 
 G_GNUC_INTERNAL gpointer gum_internal_malloc (size_t size);
@@ -49,23 +49,44 @@
 # endif
 #endif
 
+typedef enum {
+  GUM_REGEX_QUANTIFIER_NONE,
+  GUM_REGEX_QUANTIFIER_OPTIONAL,
+  GUM_REGEX_QUANTIFIER_REPEATED,
+  GUM_REGEX_QUANTIFIER_INVALID
+} GumRegexQuantifier;
+
 struct _GumMatchPattern
 {
   gint ref_count;
   GPtrArray * tokens;
   guint size;
   GRegex * regex;
+  GBytes * regex_literal;
+  gboolean regex_literal_is_prefix;
 };
 
 static void gum_memory_scan_raw (const GumMemoryRange * range,
     const GumMatchPattern * pattern, GumMemoryScanMatchFunc func,
     gpointer user_data);
 static void gum_memory_scan_regex (const GumMemoryRange * range,
-    const GRegex * regex, GumMemoryScanMatchFunc func, gpointer user_data);
+    const GumMatchPattern * pattern, GumMemoryScanMatchFunc func,
+    gpointer user_data);
+static void gum_memory_scan_regex_from_prefix (const GumMemoryRange * range,
+    const GumMatchPattern * pattern, GumMemoryScanMatchFunc func,
+    gpointer user_data);
+static const guint8 * gum_memory_find_literal (const guint8 * haystack,
+    gsize haystack_size, GBytes * literal);
 static GumMatchPattern * gum_match_pattern_new_from_hexstring (
     const gchar * match_combined_str);
 static GumMatchPattern * gum_match_pattern_new_from_regex (
     const gchar * regex_str);
+static GBytes * gum_regex_extract_required_literal (const gchar * regex_str,
+    gboolean * is_prefix);
+static gboolean gum_regex_is_plain_group (const gchar * group);
+static gboolean gum_regex_skip_group (const gchar ** cursor);
+static gboolean gum_regex_skip_class (const gchar ** cursor);
+static GumRegexQuantifier gum_regex_skip_quantifier (const gchar ** cursor);
 static GumMatchPattern * gum_match_pattern_new (void);
 static void gum_match_pattern_update_computed_size (GumMatchPattern * self);
 static GumMatchToken * gum_match_pattern_get_longest_token (
@@ -199,6 +220,33 @@ gum_query_page_size (void)
   return gum_cached_page_size;
 }
 
+/**
+ * gum_query_huge_page_size:
+ *
+ * Queries the size of the huge pages that the OS may transparently back
+ * suitably aligned allocations with, after gum_memory_advise_huge_pages().
+ *
+ * Returns: the huge page size, or 0 if unavailable
+ */
+gsize
+gum_query_huge_page_size (void)
+{
+  static gsize cached_result = 0;
+
+  if (g_once_init_enter (&cached_result))
+  {
+    gsize size;
+
+    size = _gum_memory_backend_query_huge_page_size ();
+    if (size <= gum_query_page_size ())
+      size = 0;
+
+    g_once_init_leave (&cached_result, size + 1);
+  }
+
+  return cached_result - 1;
+}
+
 gboolean
 gum_query_is_rwx_supported (void)
 {
@@ -339,7 +387,7 @@ gum_memory_scan (const GumMemoryRange * range,
   if (pattern->regex == NULL)
     gum_memory_scan_raw (range, pattern, func, user_data);
   else
-    gum_memory_scan_regex (range, pattern->regex, func, user_data);
+    gum_memory_scan_regex (range, pattern, func, user_data);
 }
 
 static void
@@ -403,13 +451,28 @@ gum_memory_scan_raw (const GumMemoryRange * range,
 
 static void
 gum_memory_scan_regex (const GumMemoryRange * range,
-                       const GRegex * regex,
+                       const GumMatchPattern * pattern,
                        GumMemoryScanMatchFunc func,
                        gpointer user_data)
 {
   GMatchInfo * info;
 
-  g_regex_match_full (regex, GSIZE_TO_POINTER (range->base_address),
+  if (pattern->regex_literal != NULL)
+  {
+    if (pattern->regex_literal_is_prefix)
+    {
+      gum_memory_scan_regex_from_prefix (range, pattern, func, user_data);
+      return;
+    }
+
+    if (gum_memory_find_literal (GSIZE_TO_POINTER (range->base_address),
+        range->size, pattern->regex_literal) == NULL)
+    {
+      return;
+    }
+  }
+
+  g_regex_match_full (pattern->regex, GSIZE_TO_POINTER (range->base_address),
       range->size, 0, 0, &info, NULL);
 
   while (g_match_info_matches (info))
@@ -430,6 +493,87 @@ gum_memory_scan_regex (const GumMemoryRange * range,
   g_match_info_free (info);
 }
 
+/*
+ * Every match starts with the literal, so we only need to try an anchored
+ * match wherever it occurs. The regex still sees the whole range, so
+ * lookbehind, anchors and greedy quantifiers behave as in a full scan.
+ */
+static void
+gum_memory_scan_regex_from_prefix (const GumMemoryRange * range,
+                                   const GumMatchPattern * pattern,
+                                   GumMemoryScanMatchFunc func,
+                                   gpointer user_data)
+{
+  const guint8 * base = GSIZE_TO_POINTER (range->base_address);
+  gsize offset = 0;
+
+  while (offset < range->size)
+  {
+    const guint8 * candidate;
+    GMatchInfo * info;
+    gint start_pos, end_pos;
+    gboolean carry_on;
+
+    candidate = gum_memory_find_literal (base + offset, range->size - offset,
+        pattern->regex_literal);
+    if (candidate == NULL)
+      break;
+
+    offset = candidate - base;
+
+    if (!g_regex_match_full (pattern->regex, (const gchar *) base,
+        range->size, offset, G_REGEX_MATCH_ANCHORED, &info, NULL))
+    {
+      g_match_info_free (info);
+      offset++;
+      continue;
+    }
+
+    carry_on = g_match_info_fetch_pos (info, 0, &start_pos, &end_pos) &&
+        (gsize) end_pos <= range->size &&
+        func (GUM_ADDRESS (base + start_pos), end_pos - start_pos,
+            user_data);
+
+    g_match_info_free (info);
+
+    if (!carry_on)
+      break;
+
+    offset = MAX ((gsize) end_pos, offset + 1);
+  }
+}
+
+static const guint8 *
+gum_memory_find_literal (const guint8 * haystack,
+                         gsize haystack_size,
+                         GBytes * literal)
+{
+  const guint8 * needle, * cur, * last;
+  gsize needle_size;
+
+  needle = g_bytes_get_data (literal, &needle_size);
+  if (needle_size > haystack_size)
+    return NULL;
+
+  cur = haystack;
+  last = haystack + haystack_size - needle_size;
+
+  /* Let libc's vectorized memchr() do the heavy lifting. */
+  while (cur <= last)
+  {
+    cur = memchr (cur, needle[0], last - cur + 1);
+    if (cur == NULL)
+      return NULL;
+
+    if (memcmp (cur + 1, needle + 1, needle_size - 1) == 0)
+      return cur;
+
+    cur++;
+  }
+
+  return NULL;
+}
+
 GumMatchPattern *
 gum_match_pattern_new_from_string (const gchar * pattern_str)
 {
@@ -570,10 +714,331 @@ gum_match_pattern_new_from_regex (const gchar * regex_str)
 
   pattern = gum_match_pattern_new ();
   pattern->regex = regex;
+  pattern->regex_literal = gum_regex_extract_required_literal (regex_str,
+      &pattern->regex_literal_is_prefix);
 
   return pattern;
 }
 
+/*
+ * Finds a run of literal characters that every match of @regex_str must
+ * contain, looking only at the top level of the pattern. A run that every
+ * match starts with is preferred, otherwise the longest one wins.
+ *
+ * This is deliberately conservative: anything we don't fully understand
+ * makes us either end the current run or give up, as a literal that isn't
+ * actually required would make scans miss matches.
+ */
+static GBytes *
+gum_regex_extract_required_literal (const gchar * regex_str,
+                                    gboolean * is_prefix)
+{
+  GString * prefix, * longest, * run;
+  const gchar * cur = regex_str;
+  gboolean at_start = TRUE;
+
+  prefix = NULL;
+  longest = g_string_new (NULL);
+  run = g_string_new (NULL);
+
+  while (TRUE)
+  {
+    gsize atom_start = run->len;
+    gboolean atom_is_literal = FALSE;
+    gboolean end_of_run;
+    gchar c = *cur;
+
+    if (c == '\\')
+    {
+      gchar e = cur[1];
+
+      if (e == '\0' || (guchar) e >= 0x80 || g_ascii_isdigit (e) ||
+          strchr ("cgkopxGNPQE", e) != NULL)
+      {
+        goto unsupported;
+      }
+
+      if (e == 'n' || e == 't' || e == 'r')
+      {
+        g_string_append_c (run, (e == 'n') ? '\n' : (e == 't') ? '\t' : '\r');
+        atom_is_literal = TRUE;
+      }
+      else if (!g_ascii_isalnum (e) && (guchar) e < 0x80)
+      {
+        g_string_append_c (run, e);
+        atom_is_literal = TRUE;
+      }
+
+      cur += 2;
+    }
+    else if (c == '(')
+    {
+      if (!gum_regex_is_plain_group (cur) || !gum_regex_skip_group (&cur))
+        goto unsupported;
+    }
+    else if (c == '[')
+    {
+      if (!gum_regex_skip_class (&cur))
+        goto unsupported;
+    }
+    else if (c == '.' || c == '^' || c == '$')
+    {
+      cur++;
+    }
+    else if (strchr ("|)?*+{", c) != NULL && c != '\0')
+    {
+      goto unsupported;
+    }
+    else if (c != '\0')
+    {
+      const gchar * next = g_utf8_next_char (cur);
+
+      g_string_append_len (run, cur, next - cur);
+      atom_is_literal = TRUE;
+
+      cur = next;
+    }
+
+    end_of_run = !atom_is_literal;
+
+    switch (gum_regex_skip_quantifier (&cur))
+    {
+      case GUM_REGEX_QUANTIFIER_NONE:
+        break;
+      case GUM_REGEX_QUANTIFIER_OPTIONAL:
+        g_string_truncate (run, atom_start);
+        end_of_run = TRUE;
+        break;
+      case GUM_REGEX_QUANTIFIER_REPEATED:
+        end_of_run = TRUE;
+        break;
+      case GUM_REGEX_QUANTIFIER_INVALID:
+        goto unsupported;
+    }
+
+    if (end_of_run)
+    {
+      if (at_start && run->len != 0)
+        prefix = g_string_new_len (run->str, run->len);
+      else if (run->len > longest->len)
+        g_string_assign (longest, run->str);
+
+      g_string_truncate (run, 0);
+      at_start = FALSE;
+    }
+
+    if (c == '\0')
+      break;
+  }
+
+  g_string_free (run, TRUE);
+
+  if (prefix != NULL)
+  {
+    g_string_free (longest, TRUE);
+
+    *is_prefix = TRUE;
+    return g_string_free_to_bytes (prefix);
+  }
+
+  *is_prefix = FALSE;
+
+  if (longest->len == 0)
+  {
+    g_string_free (longest, TRUE);
+    return NULL;
+  }
+
+  return g_string_free_to_bytes (longest);
+
+unsupported:
+  {
+    if (prefix != NULL)
+      g_string_free (prefix, TRUE);
+    g_string_free (longest, TRUE);
+    g_string_free (run, TRUE);
+
+    *is_prefix = FALSE;
+
+    return NULL;
+  }
+}
+
+/*
+ * Only groups that cannot change how the rest of the pattern matches may be
+ * skipped over. Anything else, such as inline options like "(?i)" or
+ * "(?^i)", verbs, and recursion, makes us give up on finding a literal.
+ */
+static gboolean
+gum_regex_is_plain_group (const gchar * group)
+{
+  const gchar * p = group + 1;
+
+  if (*p != '?')
+    return *p != '*';
+  p++;
+
+  switch (*p)
+  {
+    case ':':
+    case '=':
+    case '!':
+    case '>':
+    case '|':
+      return TRUE;
+    case '<':
+      p++;
+      if (*p == '=' || *p == '!')
+        return TRUE;
+      break;
+    case 'P':
+      p++;
+      if (*p != '<')
+        return FALSE;
+      p++;
+      break;
+    case '\'':
+      p++;
+      break;
+    default:
+      return FALSE;
+  }
+
+  return g_ascii_isalpha (*p) || *p == '_';
+}
+
+static gboolean
+gum_regex_skip_group (const gchar ** cursor)
+{
+  const gchar * cur = *cursor;
+  guint depth = 0;
+
+  while (*cur != '\0')
+  {
+    switch (*cur)
+    {
+      case '\\':
+        if (cur[1] == '\0' || cur[1] == 'Q')
+          return FALSE;
+        cur += 2;
+        continue;
+      case '[':
+        if (!gum_regex_skip_class (&cur))
+          return FALSE;
+        continue;
+      case '(':
+        depth++;
+        break;
+      case ')':
+        if (--depth == 0)
+        {
+          *cursor = cur + 1;
+          return TRUE;
+        }
+        break;
+      default:
+        break;
+    }
+
+    cur++;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+gum_regex_skip_class (const gchar ** cursor)
+{
+  const gchar * cur = *cursor + 1;
+
+  if (*cur == '^')
+    cur++;
+  if (*cur == ']')
+    cur++;
+
+  while (*cur != '\0')
+  {
+    if (*cur == '\\')
+    {
+      if (cur[1] == '\0' || cur[1] == 'Q')
+        return FALSE;
+      cur += 2;
+    }
+    else if (cur[0] == '[' && cur[1] == ':')
+    {
+      const gchar * end = strstr (cur + 2, ":]");
+      if (end == NULL)
+        return FALSE;
+      cur = end + 2;
+    }
+    else if (*cur == ']')
+    {
+      *cursor = cur + 1;
+      return TRUE;
+    }
+    else
+    {
+      cur++;
+    }
+  }
+
+  return FALSE;
+}
+
+static GumRegexQuantifier
+gum_regex_skip_quantifier (const gchar ** cursor)
+{
+  const gchar * cur = *cursor;
+  GumRegexQuantifier quantifier;
+
+  switch (*cur)
+  {
+    case '?':
+    case '*':
+      quantifier = GUM_REGEX_QUANTIFIER_OPTIONAL;
+      cur++;
+      break;
+    case '+':
+      quantifier = GUM_REGEX_QUANTIFIER_REPEATED;
+      cur++;
+      break;
+    case '{':
+    {
+      guint64 min;
+      gchar * end;
+
+      if (!g_ascii_isdigit (cur[1]))
+        return GUM_REGEX_QUANTIFIER_INVALID;
+
+      min = g_ascii_strtoull (cur + 1, &end, 10);
+      cur = end;
+      if (*cur == ',')
+      {
+        cur++;
+        while (g_ascii_isdigit (*cur))
+          cur++;
+      }
+      if (*cur != '}')
+        return GUM_REGEX_QUANTIFIER_INVALID;
+      cur++;
+
+      quantifier = (min == 0)
+          ? GUM_REGEX_QUANTIFIER_OPTIONAL
+          : GUM_REGEX_QUANTIFIER_REPEATED;
+      break;
+    }
+    default:
+      return GUM_REGEX_QUANTIFIER_NONE;
+  }
+
+  if (*cur == '?' || *cur == '+')
+    cur++;
+
+  *cursor = cur;
+
+  return quantifier;
+}
+
 static GumMatchPattern *
 gum_match_pattern_new (void)
 {
@@ -585,6 +1050,8 @@ gum_match_pattern_new (void)
       g_ptr_array_new_with_free_func ((GDestroyNotify) gum_match_token_free);
   pattern->size = 0;
   pattern->regex = NULL;
+  pattern->regex_literal = NULL;
+  pattern->regex_literal_is_prefix = FALSE;
 
   return pattern;
 }
@@ -604,6 +1071,7 @@ gum_match_pattern_unref (GumMatchPattern * pattern)
   {
     if (pattern->regex != NULL)
       g_regex_unref (pattern->regex);
+    g_clear_pointer (&pattern->regex_literal, g_bytes_unref);
 
     g_ptr_array_free (pattern->tokens, TRUE);
 
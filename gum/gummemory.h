@@ -87,9 +87,12 @@ GUM_API GumAddress gum_sign_code_address (GumAddress value);
 GUM_API GumAddress gum_strip_code_address (GumAddress value);
 GUM_API GumPtrauthSupport gum_query_ptrauth_support (void);
 GUM_API guint gum_query_page_size (void);
+GUM_API gsize gum_query_huge_page_size (void);
 GUM_API gboolean gum_query_is_rwx_supported (void);
 GUM_API GumRwxSupport gum_query_rwx_support (void);
 GUM_API gboolean gum_memory_is_readable (gconstpointer address, gsize len);
+GUM_API gboolean gum_memory_query_protection (gconstpointer address,
+    GumPageProtection * prot);
 GUM_API guint8 * gum_memory_read (gconstpointer address, gsize len,
     gsize * n_bytes_read);
 GUM_API gboolean gum_memory_write (gpointer address, const guint8 * bytes,
@@ -157,6 +160,7 @@ GUM_API gboolean gum_memory_release (gpointer address, gsize size);
 GUM_API gboolean gum_memory_recommit (gpointer address, gsize size,
     GumPageProtection prot);
 GUM_API gboolean gum_memory_discard (gpointer address, gsize size);
+GUM_API gboolean gum_memory_advise_huge_pages (gpointer address, gsize size);
 GUM_API gboolean gum_memory_decommit (gpointer address, gsize size);
 
 GUM_API gboolean gum_address_spec_is_satisfied_by (const GumAddressSpec * spec,
@@ -0,0 +1,554 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef GUM_DIET
+
+#include "gummemorysnapshot.h"
+
+#include "gumcloak.h"
+#include "gumexceptor.h"
+#include "gumprocess.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef guint GumSnapshotPageState;
+typedef struct _GumSnapshotRange GumSnapshotRange;
+typedef struct _GumSnapshotState GumSnapshotState;
+typedef struct _GumCollectRangesContext GumCollectRangesContext;
+
+struct _GumMemorySnapshot
+{
+  GObject parent;
+
+  gsize page_size;
+  GumExceptor * exceptor;
+
+  GumSnapshotState * state;
+  gsize state_size;
+  guint8 * copies;
+  gsize copies_size;
+};
+
+enum _GumSnapshotPageState
+{
+  GUM_SNAPSHOT_PAGE_CLEAN,
+  GUM_SNAPSHOT_PAGE_SAVING,
+  GUM_SNAPSHOT_PAGE_DIRTY
+};
+
+struct _GumSnapshotRange
+{
+  guint8 * base;
+  gsize size;
+  GumPageProtection protection;
+  guint first_page;
+};
+
+/*
+ * Everything that changes after the snapshot is taken lives in memory we
+ * allocate ourselves, so it is never part of what gets tracked and rolled
+ * back.
+ */
+struct _GumSnapshotState
+{
+  volatile gint num_dirty;
+
+  guint num_ranges;
+  guint num_pages;
+  GumSnapshotRange * ranges;
+  volatile gint * page_states;
+  guint8 * page_saved;
+  guint8 ** dirty_pages;
+};
+
+struct _GumCollectRangesContext
+{
+  const GumMemoryRange * ranges;
+  guint num_ranges;
+  gsize page_size;
+  GArray * excluded;
+
+  GArray * collected;
+};
+
+static void gum_memory_snapshot_dispose (GObject * object);
+
+static gboolean gum_memory_snapshot_capture (GumMemorySnapshot * self,
+    const GumMemoryRange * ranges, guint num_ranges);
+static void gum_exclude_address (GumCollectRangesContext * ctx,
+    gconstpointer address);
+static void gum_exclude_module_containing (GumCollectRangesContext * ctx,
+    gconstpointer address);
+static gboolean gum_exclude_thread_stack (const GumThreadDetails * details,
+    gpointer user_data);
+static gboolean gum_collect_writable_range (const GumRangeDetails * details,
+    gpointer user_data);
+static void gum_collect_range_piece (GumCollectRangesContext * ctx,
+    guint8 * start, guint8 * end, GumPageProtection protection);
+static gint gum_snapshot_range_compare (const GumSnapshotRange * a,
+    const GumSnapshotRange * b);
+static const GumSnapshotRange * gum_memory_snapshot_find_range (
+    GumMemorySnapshot * self, gconstpointer address);
+
+static gboolean gum_memory_snapshot_on_exception (
+    GumExceptionDetails * details, gpointer user_data);
+
+G_DEFINE_TYPE (GumMemorySnapshot, gum_memory_snapshot, G_TYPE_OBJECT)
+
+static void
+gum_memory_snapshot_class_init (GumMemorySnapshotClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = gum_memory_snapshot_dispose;
+}
+
+static void
+gum_memory_snapshot_init (GumMemorySnapshot * self)
+{
+  self->page_size = gum_query_page_size ();
+}
+
+static void
+gum_memory_snapshot_dispose (GObject * object)
+{
+  GumMemorySnapshot * self = GUM_MEMORY_SNAPSHOT (object);
+  GumSnapshotState * state = self->state;
+
+  if (state != NULL)
+  {
+    GumMemoryRange range;
+    guint i;
+
+    for (i = 0; i != state->num_ranges; i++)
+    {
+      const GumSnapshotRange * r = &state->ranges[i];
+
+      gum_try_mprotect (r->base, r->size, r->protection);
+    }
+
+    gum_exceptor_remove (self->exceptor, gum_memory_snapshot_on_exception,
+        self);
+
+    range.base_address = GUM_ADDRESS (self->copies);
+    range.size = self->copies_size;
+    gum_cloak_remove_range (&range);
+    gum_memory_free (self->copies, self->copies_size);
+    self->copies = NULL;
+
+    range.base_address = GUM_ADDRESS (state);
+    range.size = self->state_size;
+    gum_cloak_remove_range (&range);
+    gum_memory_free (state, self->state_size);
+    self->state = NULL;
+  }
+
+  g_clear_object (&self->exceptor);
+
+  G_OBJECT_CLASS (gum_memory_snapshot_parent_class)->dispose (object);
+}
+
+/**
+ * gum_memory_snapshot_new:
+ * @ranges: (array length=num_ranges) (nullable): the memory to snapshot, or
+ *   %NULL for all writable, non-executable memory
+ * @num_ranges: number of elements in @ranges
+ * @error: return location for a #GError
+ *
+ * Takes a snapshot of writable memory so that it can later be rolled back
+ * using gum_memory_snapshot_restore(). Pages are write-protected and only
+ * copied the first time they are written to, so taking a snapshot is cheap
+ * and restoring it only touches pages that have been dirtied since.
+ *
+ * The stack of the calling thread is never included. When @ranges is %NULL
+ * the stacks of all other threads are left out too, along with the data of
+ * libc, GLib and Gum and the heap that GLib allocates from, as handling a
+ * fault touches those. Memory mapped after the snapshot is taken is not
+ * tracked, and writes performed by the kernel, e.g. a read() into a tracked
+ * buffer, will fail instead of being tracked. Other threads should be
+ * quiescent while restoring.
+ *
+ * Returns: (transfer full): the snapshot, or %NULL on error
+ */
+GumMemorySnapshot *
+gum_memory_snapshot_new (const GumMemoryRange * ranges,
+                         guint num_ranges,
+                         GError ** error)
+{
+  GumMemorySnapshot * snapshot;
+
+  snapshot = g_object_new (GUM_TYPE_MEMORY_SNAPSHOT, NULL);
+
+  if (!gum_memory_snapshot_capture (snapshot, ranges, num_ranges))
+    goto nothing_to_snapshot;
+
+  return snapshot;
+
+nothing_to_snapshot:
+  {
+    g_object_unref (snapshot);
+
+    g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_FOUND,
+        "No writable memory to snapshot");
+    return NULL;
+  }
+}
+
+/**
+ * gum_memory_snapshot_restore:
+ * @self: a snapshot
+ *
+ * Rolls back every page written to since the snapshot was taken, or since
+ * the previous restore, and starts tracking them again.
+ *
+ * Returns: the number of pages restored
+ */
+guint
+gum_memory_snapshot_restore (GumMemorySnapshot * self)
+{
+  GumSnapshotState * state = self->state;
+  const gsize page_size = self->page_size;
+  guint num_dirty, i;
+
+  num_dirty = g_atomic_int_get (&state->num_dirty);
+
+  for (i = 0; i != num_dirty; i++)
+  {
+    guint8 * page = state->dirty_pages[i];
+    const GumSnapshotRange * r;
+    guint page_index;
+
+    r = gum_memory_snapshot_find_range (self, page);
+    page_index = r->first_page + ((page - r->base) / page_size);
+
+    /* The target may have unmapped the page since. */
+    if (gum_try_mprotect (page, page_size, r->protection))
+    {
+      memcpy (page, self->copies + (page_index * page_size), page_size);
+      gum_try_mprotect (page, page_size, r->protection & ~GUM_PAGE_WRITE);
+    }
+
+    g_atomic_int_set (&state->page_states[page_index],
+        GUM_SNAPSHOT_PAGE_CLEAN);
+  }
+
+  g_atomic_int_set (&state->num_dirty, 0);
+
+  return num_dirty;
+}
+
+static gboolean
+gum_memory_snapshot_capture (GumMemorySnapshot * self,
+                             const GumMemoryRange * ranges,
+                             guint num_ranges)
+{
+  const gsize page_size = self->page_size;
+  GumCollectRangesContext ctx;
+  GumSnapshotState * state;
+  guint num_pages, i;
+  gsize ranges_offset, page_states_offset, page_saved_offset;
+  gsize dirty_pages_offset;
+  GumMemoryRange range;
+  gpointer heap_probe = NULL;
+
+  self->exceptor = gum_exceptor_obtain ();
+
+  ctx.ranges = ranges;
+  ctx.num_ranges = num_ranges;
+  ctx.page_size = page_size;
+  ctx.excluded = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
+  ctx.collected = g_array_new (FALSE, FALSE, sizeof (GumSnapshotRange));
+
+  gum_exclude_address (&ctx, &ctx);
+
+  if (ranges == NULL)
+  {
+    /*
+     * The exceptor locks and allocates while dispatching a fault, so write
+     * protecting any of the state it touches would make it fault recursively.
+     */
+    heap_probe = g_malloc (1);
+
+    gum_exclude_address (&ctx, heap_probe);
+    gum_exclude_address (&ctx, self);
+    gum_exclude_address (&ctx, self->exceptor);
+    gum_exclude_module_containing (&ctx,
+        GUM_FUNCPTR_TO_POINTER (gum_memory_snapshot_new));
+    gum_exclude_module_containing (&ctx, GUM_FUNCPTR_TO_POINTER (g_malloc));
+    gum_exclude_module_containing (&ctx, GUM_FUNCPTR_TO_POINTER (malloc));
+
+    gum_process_enumerate_threads (gum_exclude_thread_stack, &ctx);
+  }
+
+  gum_process_enumerate_ranges (GUM_PAGE_RW, gum_collect_writable_range,
+      &ctx);
+
+  g_free (heap_probe);
+  g_array_free (ctx.excluded, TRUE);
+
+  if (ctx.collected->len == 0)
+  {
+    g_array_free (ctx.collected, TRUE);
+    return FALSE;
+  }
+
+  g_array_sort (ctx.collected, (GCompareFunc) gum_snapshot_range_compare);
+
+  num_pages = 0;
+  for (i = 0; i != ctx.collected->len; i++)
+  {
+    GumSnapshotRange * r = &g_array_index (ctx.collected, GumSnapshotRange, i);
+
+    r->first_page = num_pages;
+    num_pages += r->size / page_size;
+  }
+
+  ranges_offset = sizeof (GumSnapshotState);
+  page_states_offset =
+      ranges_offset + (ctx.collected->len * sizeof (GumSnapshotRange));
+  page_saved_offset = page_states_offset + (num_pages * sizeof (gint));
+  dirty_pages_offset = GUM_ALIGN_SIZE (page_saved_offset + num_pages, 8);
+
+  self->state_size = GUM_ALIGN_SIZE (
+      dirty_pages_offset + (num_pages * sizeof (guint8 *)), page_size);
+  state = gum_memory_allocate (NULL, self->state_size, page_size,
+      GUM_PAGE_RW);
+
+  /* Reserved up front, but only backed by memory once pages get dirtied. */
+  self->copies_size = num_pages * page_size;
+  self->copies = gum_memory_allocate (NULL, self->copies_size, page_size,
+      GUM_PAGE_RW);
+
+  range.base_address = GUM_ADDRESS (state);
+  range.size = self->state_size;
+  gum_cloak_add_range (&range);
+
+  range.base_address = GUM_ADDRESS (self->copies);
+  range.size = self->copies_size;
+  gum_cloak_add_range (&range);
+
+  state->num_dirty = 0;
+  state->num_ranges = ctx.collected->len;
+  state->num_pages = num_pages;
+  state->ranges = (GumSnapshotRange *) ((guint8 *) state + ranges_offset);
+  state->page_states = (gint *) ((guint8 *) state + page_states_offset);
+  state->page_saved = (guint8 *) state + page_saved_offset;
+  state->dirty_pages = (guint8 **) ((guint8 *) state + dirty_pages_offset);
+
+  memcpy (state->ranges, ctx.collected->data,
+      ctx.collected->len * sizeof (GumSnapshotRange));
+
+  g_array_free (ctx.collected, TRUE);
+
+  self->state = state;
+
+  gum_exceptor_add (self->exceptor, gum_memory_snapshot_on_exception, self);
+
+  for (i = 0; i != state->num_ranges; i++)
+  {
+    const GumSnapshotRange * r = &state->ranges[i];
+
+    gum_try_mprotect (r->base, r->size, r->protection & ~GUM_PAGE_WRITE);
+  }
+
+  return TRUE;
+}
+
+static void
+gum_exclude_address (GumCollectRangesContext * ctx,
+                     gconstpointer address)
+{
+  GumMemoryRange r;
+
+  r.base_address = GUM_ADDRESS (address);
+  r.size = 1;
+
+  g_array_append_val (ctx->excluded, r);
+}
+
+static void
+gum_exclude_module_containing (GumCollectRangesContext * ctx,
+                               gconstpointer address)
+{
+  GumMemoryRange r;
+
+  if (gum_process_resolve_module_pointer (address, NULL, &r))
+    g_array_append_val (ctx->excluded, r);
+}
+
+static gboolean
+gum_exclude_thread_stack (const GumThreadDetails * details,
+                          gpointer user_data)
+{
+  GumCollectRangesContext * ctx = user_data;
+
+#if defined (HAVE_I386)
+  gum_exclude_address (ctx,
+      GSIZE_TO_POINTER (GUM_CPU_CONTEXT_XSP (&details->cpu_context)));
+#else
+  gum_exclude_address (ctx, GSIZE_TO_POINTER (details->cpu_context.sp));
+#endif
+
+  return TRUE;
+}
+
+static gboolean
+gum_collect_writable_range (const GumRangeDetails * details,
+                            gpointer user_data)
+{
+  GumCollectRangesContext * ctx = user_data;
+  guint8 * range_start, * range_end;
+  guint i;
+
+  if ((details->protection & GUM_PAGE_EXECUTE) != 0)
+    return TRUE;
+
+  range_start = GSIZE_TO_POINTER (details->range->base_address);
+  range_end = range_start + details->range->size;
+
+  for (i = 0; i != ctx->excluded->len; i++)
+  {
+    const GumMemoryRange * e = &g_array_index (ctx->excluded, GumMemoryRange,
+        i);
+
+    if (e->base_address < GUM_ADDRESS (range_end) &&
+        e->base_address + e->size > GUM_ADDRESS (range_start))
+    {
+      return TRUE;
+    }
+  }
+
+  if (ctx->ranges == NULL)
+  {
+    gum_collect_range_piece (ctx, range_start, range_end,
+        details->protection);
+    return TRUE;
+  }
+
+  for (i = 0; i != ctx->num_ranges; i++)
+  {
+    const GumMemoryRange * r = &ctx->ranges[i];
+    guint8 * start, * end;
+
+    start = GSIZE_TO_POINTER (r->base_address & ~(ctx->page_size - 1));
+    end = GSIZE_TO_POINTER ((r->base_address + r->size + ctx->page_size - 1) &
+        ~(ctx->page_size - 1));
+
+    gum_collect_range_piece (ctx, MAX (start, range_start),
+        MIN (end, range_end), details->protection);
+  }
+
+  return TRUE;
+}
+
+static void
+gum_collect_range_piece (GumCollectRangesContext * ctx,
+                         guint8 * start,
+                         guint8 * end,
+                         GumPageProtection protection)
+{
+  GumSnapshotRange r;
+
+  if (end <= start)
+    return;
+
+  r.base = start;
+  r.size = end - start;
+  r.protection = protection;
+  r.first_page = 0;
+
+  g_array_append_val (ctx->collected, r);
+}
+
+static gint
+gum_snapshot_range_compare (const GumSnapshotRange * a,
+                            const GumSnapshotRange * b)
+{
+  if (a->base < b->base)
+    return -1;
+  if (a->base > b->base)
+    return 1;
+  return 0;
+}
+
+static const GumSnapshotRange *
+gum_memory_snapshot_find_range (GumMemorySnapshot * self,
+                                gconstpointer address)
+{
+  const GumSnapshotState * state = self->state;
+  const guint8 * p = address;
+  guint lo, hi;
+
+  lo = 0;
+  hi = state->num_ranges;
+
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+    const GumSnapshotRange * r = &state->ranges[mid];
+
+    if (p < r->base)
+      hi = mid;
+    else if (p >= r->base + r->size)
+      lo = mid + 1;
+    else
+      return r;
+  }
+
+  return NULL;
+}
+
+static gboolean
+gum_memory_snapshot_on_exception (GumExceptionDetails * details,
+                                  gpointer user_data)
+{
+  GumMemorySnapshot * self = user_data;
+  GumSnapshotState * state = self->state;
+  const gsize page_size = self->page_size;
+  const GumSnapshotRange * r;
+  guint8 * page;
+  guint page_index;
+
+  if (details->type != GUM_EXCEPTION_ACCESS_VIOLATION ||
+      details->memory.operation != GUM_MEMOP_WRITE)
+  {
+    return FALSE;
+  }
+
+  r = gum_memory_snapshot_find_range (self, details->memory.address);
+  if (r == NULL)
+    return FALSE;
+
+  page = GSIZE_TO_POINTER (
+      GPOINTER_TO_SIZE (details->memory.address) & ~(page_size - 1));
+  page_index = r->first_page + ((page - r->base) / page_size);
+
+  if (!g_atomic_int_compare_and_exchange (&state->page_states[page_index],
+      GUM_SNAPSHOT_PAGE_CLEAN, GUM_SNAPSHOT_PAGE_SAVING))
+  {
+    /*
+     * Another thread is saving the page and will make it writable shortly,
+     * so retry. If it is already dirty the fault isn't ours.
+     */
+    return g_atomic_int_get (&state->page_states[page_index]) ==
+        GUM_SNAPSHOT_PAGE_SAVING;
+  }
+
+  if (!state->page_saved[page_index])
+  {
+    memcpy (self->copies + (page_index * page_size), page, page_size);
+    state->page_saved[page_index] = TRUE;
+  }
+
+  state->dirty_pages[g_atomic_int_add (&state->num_dirty, 1)] = page;
+
+  g_atomic_int_set (&state->page_states[page_index], GUM_SNAPSHOT_PAGE_DIRTY);
+
+  return gum_try_mprotect (page, page_size, r->protection);
+}
+
+#endif
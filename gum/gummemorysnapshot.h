@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_MEMORY_SNAPSHOT_H__
+#define __GUM_MEMORY_SNAPSHOT_H__
+
+#include <gum/gummemory.h>
+
+G_BEGIN_DECLS
+
+#define GUM_TYPE_MEMORY_SNAPSHOT (gum_memory_snapshot_get_type ())
+GUM_DECLARE_FINAL_TYPE (GumMemorySnapshot, gum_memory_snapshot, GUM,
+                        MEMORY_SNAPSHOT, GObject)
+
+GUM_API GumMemorySnapshot * gum_memory_snapshot_new (
+    const GumMemoryRange * ranges, guint num_ranges, GError ** error);
+
+GUM_API guint gum_memory_snapshot_restore (GumMemorySnapshot * self);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gumpercpucounter.h"
+
+#include "gumtls.h"
+
+#include <stddef.h>
+
+#define GUM_PER_CPU_SLOT_SIZE 64
+#define GUM_PER_CPU_MAX_SLOTS 256
+
+#if defined (HAVE_LINUX) && defined (HAVE_GLIBC) && \
+    ((defined (HAVE_I386) && GLIB_SIZEOF_VOID_P == 8) || defined (HAVE_ARM64))
+# define GUM_HAVE_RSEQ_CPU_ID 1
+#endif
+
+typedef struct _GumPerCpuSlot GumPerCpuSlot;
+
+struct _GumPerCpuCounter
+{
+  GumPerCpuSlot * slots;
+  guint slot_mask;
+  gpointer slots_mem;
+
+  GumTlsKey slot_key;
+  volatile gint next_slot;
+};
+
+struct _GumPerCpuSlot
+{
+  volatile gsize value;
+  guint8 padding[GUM_PER_CPU_SLOT_SIZE - sizeof (gsize)];
+};
+
+static guint gum_per_cpu_counter_pick_slot (GumPerCpuCounter * self);
+
+#ifdef GUM_HAVE_RSEQ_CPU_ID
+/*
+ * Provided by glibc >= 2.35, which registers an rseq area for each thread
+ * that the kernel keeps up to date with the CPU the thread is running on.
+ */
+extern const ptrdiff_t __rseq_offset __attribute__ ((weak));
+extern const unsigned int __rseq_size __attribute__ ((weak));
+
+static gint gum_rseq_get_current_cpu (void);
+#endif
+
+/**
+ * gum_per_cpu_counter_new:
+ *
+ * Creates a counter that spreads updates across one cache line per CPU, so
+ * that threads incrementing it concurrently don't contend on a single
+ * location. On Linux the current CPU is looked up through the rseq area
+ * registered by glibc, and elsewhere each thread sticks to a slot of its own.
+ * Reading folds all slots together, so it is meant to be rare compared to
+ * updates.
+ *
+ * Returns: (transfer full): a new counter
+ */
+GumPerCpuCounter *
+gum_per_cpu_counter_new (void)
+{
+  GumPerCpuCounter * counter;
+  guint n_slots;
+
+  n_slots = 1;
+  while (n_slots < g_get_num_processors () && n_slots < GUM_PER_CPU_MAX_SLOTS)
+    n_slots <<= 1;
+
+  counter = g_slice_new (GumPerCpuCounter);
+  counter->slots_mem = g_malloc0 ((n_slots + 1) * GUM_PER_CPU_SLOT_SIZE);
+  counter->slots = GUM_ALIGN_POINTER (GumPerCpuSlot *, counter->slots_mem,
+      GUM_PER_CPU_SLOT_SIZE);
+  counter->slot_mask = n_slots - 1;
+
+  counter->slot_key = gum_tls_key_new ();
+  counter->next_slot = 0;
+
+  return counter;
+}
+
+void
+gum_per_cpu_counter_free (GumPerCpuCounter * counter)
+{
+  if (counter == NULL)
+    return;
+
+  gum_tls_key_free (counter->slot_key);
+  g_free (counter->slots_mem);
+
+  g_slice_free (GumPerCpuCounter, counter);
+}
+
+void
+gum_per_cpu_counter_add (GumPerCpuCounter * self,
+                         gsize delta)
+{
+  GumPerCpuSlot * slot;
+
+  slot = &self->slots[gum_per_cpu_counter_pick_slot (self)];
+
+  /*
+   * Still atomic as the thread may migrate between picking the slot and
+   * updating it, but the cache line is almost never shared.
+   */
+  g_atomic_pointer_add (&slot->value, delta);
+}
+
+guint64
+gum_per_cpu_counter_read (GumPerCpuCounter * self)
+{
+  guint64 total = 0;
+  guint i;
+
+  for (i = 0; i <= self->slot_mask; i++)
+    total += (gsize) g_atomic_pointer_get (&self->slots[i].value);
+
+  return total;
+}
+
+static guint
+gum_per_cpu_counter_pick_slot (GumPerCpuCounter * self)
+{
+  gsize slot;
+
+#ifdef GUM_HAVE_RSEQ_CPU_ID
+  {
+    gint cpu = gum_rseq_get_current_cpu ();
+    if (cpu >= 0)
+      return cpu & self->slot_mask;
+  }
+#endif
+
+  slot = GPOINTER_TO_SIZE (gum_tls_key_get_value (self->slot_key));
+  if (slot == 0)
+  {
+    slot = ((guint) g_atomic_int_add (&self->next_slot, 1) & self->slot_mask)
+        + 1;
+    gum_tls_key_set_value (self->slot_key, GSIZE_TO_POINTER (slot));
+  }
+
+  return slot - 1;
+}
+
+#ifdef GUM_HAVE_RSEQ_CPU_ID
+
+static gint
+gum_rseq_get_current_cpu (void)
+{
+  guint8 * thread_pointer;
+  const volatile guint32 * cpu_id;
+
+  if (&__rseq_size == NULL || __rseq_size == 0)
+    return -1;
+
+# if defined (HAVE_I386)
+  asm ("mov %%fs:0, %0" : "=r" (thread_pointer));
+# else
+  asm ("mrs %0, tpidr_el0" : "=r" (thread_pointer));
+# endif
+
+  /* struct rseq: { u32 cpu_id_start; u32 cpu_id; ... } */
+  cpu_id = (const volatile guint32 *) (thread_pointer + __rseq_offset + 4);
+
+  return (gint) *cpu_id;
+}
+
+#endif
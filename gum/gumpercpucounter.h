@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_PER_CPU_COUNTER_H__
+#define __GUM_PER_CPU_COUNTER_H__
+
+#include <gum/gumdefs.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GumPerCpuCounter GumPerCpuCounter;
+
+GUM_API GumPerCpuCounter * gum_per_cpu_counter_new (void);
+GUM_API void gum_per_cpu_counter_free (GumPerCpuCounter * counter);
+
+GUM_API void gum_per_cpu_counter_add (GumPerCpuCounter * self, gsize delta);
+GUM_API guint64 gum_per_cpu_counter_read (GumPerCpuCounter * self);
+
+G_END_DECLS
+
+#endif
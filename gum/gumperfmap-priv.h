@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_PERF_MAP_PRIV_H__
+#define __GUM_PERF_MAP_PRIV_H__
+
+#include "gumperfmap.h"
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL void _gum_perf_map_add_instrumented_code (const gchar * kind,
+    gconstpointer code, gsize size, gconstpointer real_address);
+
+G_END_DECLS
+
+#endif
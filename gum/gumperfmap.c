@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gumperfmap-priv.h"
+
+#include "gummemory.h"
+#include "gumprocess.h"
+#include "gumsymbolutil.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_LINUX
+# include <sys/mman.h>
+#endif
+
+#define GUM_JITDUMP_MAGIC 0x4a695444
+#define GUM_JITDUMP_VERSION 1
+#define GUM_JITDUMP_CODE_LOAD 0
+
+#if defined (HAVE_I386) && GLIB_SIZEOF_VOID_P == 8
+# define GUM_JITDUMP_ELF_MACHINE 62
+#elif defined (HAVE_I386)
+# define GUM_JITDUMP_ELF_MACHINE 3
+#elif defined (HAVE_ARM64)
+# define GUM_JITDUMP_ELF_MACHINE 183
+#elif defined (HAVE_ARM)
+# define GUM_JITDUMP_ELF_MACHINE 40
+#elif defined (HAVE_MIPS)
+# define GUM_JITDUMP_ELF_MACHINE 8
+#else
+# define GUM_JITDUMP_ELF_MACHINE 0
+#endif
+
+typedef struct _GumJitdumpHeader GumJitdumpHeader;
+typedef struct _GumJitdumpCodeLoad GumJitdumpCodeLoad;
+
+struct _GumJitdumpHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint32 total_size;
+  guint32 elf_mach;
+  guint32 pad1;
+  guint32 pid;
+  guint64 timestamp;
+  guint64 flags;
+};
+
+struct _GumJitdumpCodeLoad
+{
+  guint32 id;
+  guint32 total_size;
+  guint64 timestamp;
+
+  guint32 pid;
+  guint32 tid;
+  guint64 vma;
+  guint64 code_addr;
+  guint64 code_size;
+  guint64 code_index;
+};
+
+static gboolean gum_perf_map_write_jitdump_header (void);
+static void gum_perf_map_write_jitdump_code_load (gconstpointer code,
+    gsize size, const gchar * name);
+static guint64 gum_perf_map_get_timestamp (void);
+
+G_LOCK_DEFINE_STATIC (gum_perf_map);
+static gint gum_perf_map_opened = FALSE;
+static GumPerfMapFormat gum_perf_map_format;
+static FILE * gum_perf_map_file = NULL;
+static gpointer gum_perf_map_marker = NULL;
+static gsize gum_perf_map_marker_size = 0;
+static guint64 gum_perf_map_code_index = 0;
+
+/**
+ * gum_perf_map_open:
+ * @format: the format to emit
+ * @path: (nullable): where to write, or %NULL for the location that `perf`
+ *   looks in by default, i.e. /tmp/perf-<pid>.map or /tmp/jit-<pid>.dump
+ * @error: return location for a #GError
+ *
+ * Starts describing code generated by Stalker and Interceptor, so that
+ * profilers like Linux `perf` can attribute samples in it.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+gum_perf_map_open (GumPerfMapFormat format,
+                   const gchar * path,
+                   GError ** error)
+{
+  gchar * default_path = NULL;
+  FILE * file;
+
+  G_LOCK (gum_perf_map);
+
+  if (gum_perf_map_file != NULL)
+    goto already_open;
+
+  if (path == NULL)
+  {
+    default_path = (format == GUM_PERF_MAP_FORMAT_MAP)
+        ? g_strdup_printf ("/tmp/perf-%u.map", gum_process_get_id ())
+        : g_strdup_printf ("/tmp/jit-%u.dump", gum_process_get_id ());
+    path = default_path;
+  }
+
+  file = fopen (path, (format == GUM_PERF_MAP_FORMAT_MAP) ? "wb" : "w+b");
+  if (file == NULL)
+    goto open_failed;
+
+  gum_perf_map_format = format;
+  gum_perf_map_file = file;
+  gum_perf_map_code_index = 0;
+
+  if (format == GUM_PERF_MAP_FORMAT_JITDUMP &&
+      !gum_perf_map_write_jitdump_header ())
+  {
+    goto write_failed;
+  }
+
+  g_atomic_int_set (&gum_perf_map_opened, TRUE);
+
+  G_UNLOCK (gum_perf_map);
+
+  g_free (default_path);
+
+  return TRUE;
+
+already_open:
+  {
+    G_UNLOCK (gum_perf_map);
+
+    g_set_error (error, GUM_ERROR, GUM_ERROR_EXISTS, "Already open");
+    return FALSE;
+  }
+open_failed:
+  {
+    G_UNLOCK (gum_perf_map);
+
+    g_set_error (error, GUM_ERROR, GUM_ERROR_FAILED, "Unable to open %s: %s",
+        path, g_strerror (errno));
+    g_free (default_path);
+    return FALSE;
+  }
+write_failed:
+  {
+    fclose (gum_perf_map_file);
+    gum_perf_map_file = NULL;
+
+    G_UNLOCK (gum_perf_map);
+
+    g_set_error (error, GUM_ERROR, GUM_ERROR_FAILED,
+        "Unable to write jitdump header to %s", path);
+    g_free (default_path);
+    return FALSE;
+  }
+}
+
+void
+gum_perf_map_close (void)
+{
+  G_LOCK (gum_perf_map);
+
+  if (gum_perf_map_file != NULL)
+  {
+    g_atomic_int_set (&gum_perf_map_opened, FALSE);
+
+#ifdef HAVE_LINUX
+    if (gum_perf_map_marker != NULL)
+      munmap (gum_perf_map_marker, gum_perf_map_marker_size);
+#endif
+    gum_perf_map_marker = NULL;
+    gum_perf_map_marker_size = 0;
+
+    fclose (gum_perf_map_file);
+    gum_perf_map_file = NULL;
+  }
+
+  G_UNLOCK (gum_perf_map);
+}
+
+gboolean
+gum_perf_map_is_open (void)
+{
+  return g_atomic_int_get (&gum_perf_map_opened);
+}
+
+/**
+ * gum_perf_map_add_code:
+ * @code: (type gpointer): start of the code
+ * @size: size of the code, in bytes
+ * @name: name to attribute samples in the code to
+ *
+ * Describes code generated at runtime. A no-op unless gum_perf_map_open()
+ * has been called. Entries are buffered, and only guaranteed to have reached
+ * the file once gum_perf_map_close() has been called.
+ */
+void
+gum_perf_map_add_code (gconstpointer code,
+                       gsize size,
+                       const gchar * name)
+{
+  if (size == 0 || !gum_perf_map_is_open ())
+    return;
+
+  G_LOCK (gum_perf_map);
+
+  if (gum_perf_map_file == NULL)
+    goto beach;
+
+  if (gum_perf_map_format == GUM_PERF_MAP_FORMAT_MAP)
+  {
+    fprintf (gum_perf_map_file, "%" G_GINT64_MODIFIER "x %" G_GSIZE_MODIFIER
+        "x %s\n", (guint64) GPOINTER_TO_SIZE (code), size, name);
+  }
+  else
+  {
+    gum_perf_map_write_jitdump_code_load (code, size, name);
+  }
+
+beach:
+  G_UNLOCK (gum_perf_map);
+}
+
+void
+_gum_perf_map_add_instrumented_code (const gchar * kind,
+                                     gconstpointer code,
+                                     gsize size,
+                                     gconstpointer real_address)
+{
+  gchar * symbol, * name;
+
+  if (!gum_perf_map_is_open ())
+    return;
+
+  symbol = gum_symbol_name_from_address ((gpointer) real_address);
+
+  if (symbol != NULL)
+    name = g_strdup_printf ("[%s] %s", kind, symbol);
+  else
+    name = g_strdup_printf ("[%s] %p", kind, real_address);
+
+  gum_perf_map_add_code (code, size, name);
+
+  g_free (name);
+  g_free (symbol);
+}
+
+static gboolean
+gum_perf_map_write_jitdump_header (void)
+{
+  GumJitdumpHeader header;
+
+  header.magic = GUM_JITDUMP_MAGIC;
+  header.version = GUM_JITDUMP_VERSION;
+  header.total_size = sizeof (header);
+  header.elf_mach = GUM_JITDUMP_ELF_MACHINE;
+  header.pad1 = 0;
+  header.pid = gum_process_get_id ();
+  header.timestamp = gum_perf_map_get_timestamp ();
+  header.flags = 0;
+
+  if (fwrite (&header, sizeof (header), 1, gum_perf_map_file) != 1)
+    return FALSE;
+  fflush (gum_perf_map_file);
+
+#ifdef HAVE_LINUX
+  {
+    gsize page_size;
+    gpointer marker;
+
+    /*
+     * `perf record` only picks up the dump if it sees it being mapped
+     * executable, which is what `perf inject --jit` keys off of later.
+     */
+    page_size = gum_query_page_size ();
+    marker = mmap (NULL, page_size, PROT_READ | PROT_EXEC, MAP_PRIVATE,
+        fileno (gum_perf_map_file), 0);
+    if (marker != MAP_FAILED)
+    {
+      gum_perf_map_marker = marker;
+      gum_perf_map_marker_size = page_size;
+    }
+  }
+#endif
+
+  return TRUE;
+}
+
+static void
+gum_perf_map_write_jitdump_code_load (gconstpointer code,
+                                      gsize size,
+                                      const gchar * name)
+{
+  GumJitdumpCodeLoad record;
+  gsize name_size;
+
+  name_size = strlen (name) + 1;
+
+  record.id = GUM_JITDUMP_CODE_LOAD;
+  record.total_size = sizeof (record) + name_size + size;
+  record.timestamp = gum_perf_map_get_timestamp ();
+
+  record.pid = gum_process_get_id ();
+  record.tid = (guint32) gum_process_get_current_thread_id ();
+  record.vma = GUM_ADDRESS (code);
+  record.code_addr = GUM_ADDRESS (code);
+  record.code_size = size;
+  record.code_index = gum_perf_map_code_index++;
+
+  fwrite (&record, sizeof (record), 1, gum_perf_map_file);
+  fwrite (name, name_size, 1, gum_perf_map_file);
+  fwrite (code, size, 1, gum_perf_map_file);
+}
+
+static guint64
+gum_perf_map_get_timestamp (void)
+{
+  /* Matches `perf record -k mono`. */
+  return (guint64) g_get_monotonic_time () * G_GUINT64_CONSTANT (1000);
+}
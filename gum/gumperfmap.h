@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_PERF_MAP_H__
+#define __GUM_PERF_MAP_H__
+
+#include <gum/gumdefs.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  GUM_PERF_MAP_FORMAT_MAP,
+  GUM_PERF_MAP_FORMAT_JITDUMP,
+} GumPerfMapFormat;
+
+GUM_API gboolean gum_perf_map_open (GumPerfMapFormat format,
+    const gchar * path, GError ** error);
+GUM_API void gum_perf_map_close (void);
+GUM_API gboolean gum_perf_map_is_open (void);
+
+GUM_API void gum_perf_map_add_code (gconstpointer code, gsize size,
+    const gchar * name);
+
+G_END_DECLS
+
+#endif
@@ -8,6 +8,36 @@
 
 #include "gumstalker.h"
 
+#include "guminterceptor.h"
+
+typedef struct _GumFollowAllSession GumFollowAllSession;
+typedef struct _GumFollowAllThreadStart GumFollowAllThreadStart;
+typedef gpointer (* GumThreadStartFunc) (gpointer data);
+
+struct _GumFollowAllSession
+{
+  guint generation;
+
+  GumStalker * stalker;
+  GumStalkerTransformer * transformer;
+  GumEventSink * sink;
+
+  GumInterceptor * interceptor;
+  GumInvocationListener * thread_start_listener;
+};
+
+struct _GumFollowAllThreadStart
+{
+  guint generation;
+
+  GumStalker * stalker;
+  GumStalkerTransformer * transformer;
+  GumEventSink * sink;
+
+  GumThreadStartFunc func;
+  gpointer data;
+};
+
 struct _GumDefaultStalkerTransformer
 {
   GObject parent;
@@ -38,6 +68,19 @@ static void gum_callback_stalker_transformer_transform_block (
 static void gum_stalker_observer_default_init (
     GumStalkerObserverInterface * iface);
 
+static gboolean gum_stalker_follow_existing_thread (
+    const GumThreadDetails * details, gpointer user_data);
+static gboolean gum_stalker_unfollow_existing_thread (
+    const GumThreadDetails * details, gpointer user_data);
+static void gum_follow_all_session_free (GumFollowAllSession * session);
+static void gum_follow_all_on_thread_create (GumInvocationContext * ic,
+    gpointer user_data);
+static void gum_follow_all_on_thread_created (GumInvocationContext * ic,
+    gpointer user_data);
+static gpointer gum_follow_all_thread_start (
+    GumFollowAllThreadStart * start);
+static void gum_follow_all_thread_start_free (GumFollowAllThreadStart * start);
+
 G_DEFINE_INTERFACE (GumStalkerTransformer, gum_stalker_transformer,
                     G_TYPE_OBJECT)
 
@@ -57,6 +100,10 @@ G_DEFINE_TYPE_EXTENDED (GumCallbackStalkerTransformer,
 
 G_DEFINE_INTERFACE (GumStalkerObserver, gum_stalker_observer, G_TYPE_OBJECT)
 
+G_LOCK_DEFINE_STATIC (gum_follow_all);
+static GumFollowAllSession * gum_follow_all_session = NULL;
+static guint gum_follow_all_generation = 0;
+
 /**
  * gum_stalker_prefetch:
  *
@@ -410,4 +457,214 @@ gum_stalker_observer_switch_callback (GumStalkerObserver * observer,
       target);
 }
 
+/**
+ * gum_stalker_follow_all:
+ *
+ * Follows every thread in the process except the calling one, including
+ * threads created from here on. Existing threads are followed the same way
+ * as with gum_stalker_follow(). New threads are caught as they are created
+ * through pthread_create(), and start out inside Stalker from their very
+ * first instruction, without having to be suspended and infected.
+ *
+ * Since a thread can only be followed by one Stalker, only one Stalker may
+ * follow all threads at a time. Threads created through raw clone() calls
+ * are not caught.
+ */
+void
+gum_stalker_follow_all (GumStalker * self,
+                        GumStalkerTransformer * transformer,
+                        GumEventSink * sink)
+{
+  GumFollowAllSession * session;
+  gpointer thread_create_impl;
+
+  G_LOCK (gum_follow_all);
+  if (gum_follow_all_session != NULL)
+  {
+    G_UNLOCK (gum_follow_all);
+    g_critical ("Another Stalker is already following all threads");
+    return;
+  }
+
+  session = g_slice_new0 (GumFollowAllSession);
+  session->generation = ++gum_follow_all_generation;
+  session->stalker = g_object_ref (self);
+  session->transformer = (transformer != NULL)
+      ? g_object_ref (transformer)
+      : NULL;
+  session->sink = g_object_ref (sink);
+
+  gum_follow_all_session = session;
+  G_UNLOCK (gum_follow_all);
+
+#ifndef HAVE_WINDOWS
+  thread_create_impl = GSIZE_TO_POINTER (
+      gum_module_find_export_by_name (NULL, "pthread_create"));
+#else
+  thread_create_impl = NULL;
+#endif
+  if (thread_create_impl != NULL)
+  {
+    session->interceptor = gum_interceptor_obtain ();
+    session->thread_start_listener = gum_make_call_listener (
+        gum_follow_all_on_thread_create, gum_follow_all_on_thread_created,
+        session, NULL);
+
+    gum_interceptor_attach (session->interceptor, thread_create_impl,
+        session->thread_start_listener, NULL);
+  }
+
+  gum_process_enumerate_threads (gum_stalker_follow_existing_thread, session);
+}
+
+/**
+ * gum_stalker_unfollow_all:
+ *
+ * Stops following new threads, and unfollows all threads except the calling
+ * one. Only valid after gum_stalker_follow_all().
+ */
+void
+gum_stalker_unfollow_all (GumStalker * self)
+{
+  GumFollowAllSession * session;
+
+  G_LOCK (gum_follow_all);
+  session = gum_follow_all_session;
+  if (session == NULL || session->stalker != self)
+  {
+    G_UNLOCK (gum_follow_all);
+    return;
+  }
+  gum_follow_all_session = NULL;
+  G_UNLOCK (gum_follow_all);
+
+  if (session->thread_start_listener != NULL)
+  {
+    gum_interceptor_detach (session->interceptor,
+        session->thread_start_listener);
+  }
+
+  gum_process_enumerate_threads (gum_stalker_unfollow_existing_thread,
+      session);
+
+  gum_follow_all_session_free (session);
+}
+
+static gboolean
+gum_stalker_follow_existing_thread (const GumThreadDetails * details,
+                                    gpointer user_data)
+{
+  GumFollowAllSession * session = user_data;
+
+  if (details->id == gum_process_get_current_thread_id ())
+    return TRUE;
+
+  gum_stalker_follow (session->stalker, details->id, session->transformer,
+      session->sink);
+
+  return TRUE;
+}
+
+static gboolean
+gum_stalker_unfollow_existing_thread (const GumThreadDetails * details,
+                                      gpointer user_data)
+{
+  GumFollowAllSession * session = user_data;
+
+  if (details->id == gum_process_get_current_thread_id ())
+    return TRUE;
+
+  gum_stalker_unfollow (session->stalker, details->id);
+
+  return TRUE;
+}
+
+static void
+gum_follow_all_session_free (GumFollowAllSession * session)
+{
+  g_clear_object (&session->thread_start_listener);
+  g_clear_object (&session->interceptor);
+
+  g_object_unref (session->sink);
+  g_clear_object (&session->transformer);
+  g_object_unref (session->stalker);
+
+  g_slice_free (GumFollowAllSession, session);
+}
+
+static void
+gum_follow_all_on_thread_create (GumInvocationContext * ic,
+                                 gpointer user_data)
+{
+  GumFollowAllSession * session = user_data;
+  GumFollowAllThreadStart ** start_ptr;
+  GumFollowAllThreadStart * start;
+
+  start_ptr = GUM_IC_GET_INVOCATION_DATA (ic, GumFollowAllThreadStart *);
+
+  start = g_slice_new (GumFollowAllThreadStart);
+  start->generation = session->generation;
+  start->stalker = g_object_ref (session->stalker);
+  start->transformer = (session->transformer != NULL)
+      ? g_object_ref (session->transformer)
+      : NULL;
+  start->sink = g_object_ref (session->sink);
+  start->func = gum_invocation_context_get_nth_argument (ic, 2);
+  start->data = gum_invocation_context_get_nth_argument (ic, 3);
+
+  gum_invocation_context_replace_nth_argument (ic, 2,
+      gum_follow_all_thread_start);
+  gum_invocation_context_replace_nth_argument (ic, 3, start);
+
+  *start_ptr = start;
+}
+
+static void
+gum_follow_all_on_thread_created (GumInvocationContext * ic,
+                                  gpointer user_data)
+{
+  GumFollowAllThreadStart * start;
+
+  start = *GUM_IC_GET_INVOCATION_DATA (ic, GumFollowAllThreadStart *);
+
+  if (GPOINTER_TO_INT (gum_invocation_context_get_return_value (ic)) != 0)
+    gum_follow_all_thread_start_free (start);
+}
+
+static gpointer
+gum_follow_all_thread_start (GumFollowAllThreadStart * start)
+{
+  GumThreadStartFunc func = start->func;
+  gpointer data = start->data;
+
+  /*
+   * The thread may only get to run after gum_stalker_unfollow_all(), or even
+   * once another session has started, in which case it must not be followed.
+   * Holding the lock ensures that an unfollow_all() racing with us sees this
+   * thread once it has been followed.
+   */
+  G_LOCK (gum_follow_all);
+  if (gum_follow_all_session != NULL &&
+      gum_follow_all_session->generation == start->generation)
+  {
+    gum_stalker_follow_me (start->stalker, start->transformer, start->sink);
+  }
+  G_UNLOCK (gum_follow_all);
+
+  /* The exec context holds on to what it needs from here on. */
+  gum_follow_all_thread_start_free (start);
+
+  return func (data);
+}
+
+static void
+gum_follow_all_thread_start_free (GumFollowAllThreadStart * start)
+{
+  g_object_unref (start->sink);
+  g_clear_object (&start->transformer);
+  g_object_unref (start->stalker);
+
+  g_slice_free (GumFollowAllThreadStart, start);
+}
+
 #endif
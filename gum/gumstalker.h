@@ -62,11 +62,21 @@ typedef void (* GumStalkerTransformerCallback) (GumStalkerIterator * iterator,
 typedef void (* GumStalkerCallout) (GumCpuContext * cpu_context,
     gpointer user_data);
 
+typedef enum {
+  GUM_STALKER_CODE_CHECKED,
+  GUM_STALKER_CODE_TRUSTED,
+  GUM_STALKER_CODE_GUARDED
+} GumStalkerCodePolicy;
+
 typedef guint GumProbeId;
 typedef struct _GumCallDetails GumCallDetails;
 typedef void (* GumCallProbeCallback) (GumCallDetails * details,
     gpointer user_data);
 
+typedef struct _GumBlockCounterDetails GumBlockCounterDetails;
+typedef gboolean (* GumFoundBlockCounterFunc) (
+    const GumBlockCounterDetails * details, gpointer user_data);
+
 #ifndef GUM_DIET
 
 struct _GumStalkerTransformerInterface
@@ -158,6 +168,14 @@ struct _GumCallDetails
   GumCpuContext * cpu_context;
 };
 
+struct _GumBlockCounterDetails
+{
+  GumThreadId thread_id;
+  gpointer real_start;
+  gsize real_size;
+  guint64 count;
+};
+
 GUM_API gboolean gum_stalker_is_supported (void);
 
 GUM_API void gum_stalker_activate_experimental_unwind_support (void);
@@ -167,10 +185,20 @@ GUM_API GumStalker * gum_stalker_new (void);
 GUM_API void gum_stalker_exclude (GumStalker * self,
     const GumMemoryRange * range);
 
+GUM_API void gum_stalker_set_code_policy (GumStalker * self,
+    const GumMemoryRange * range, GumStalkerCodePolicy policy);
+GUM_API void gum_stalker_set_trust_threshold_for_range (GumStalker * self,
+    const GumMemoryRange * range, gint trust_threshold);
+
 GUM_API gint gum_stalker_get_trust_threshold (GumStalker * self);
 GUM_API void gum_stalker_set_trust_threshold (GumStalker * self,
     gint trust_threshold);
 
+GUM_API void gum_stalker_set_block_counters_enabled (GumStalker * self,
+    gboolean enabled);
+GUM_API void gum_stalker_enumerate_block_counters (GumStalker * self,
+    GumFoundBlockCounterFunc func, gpointer user_data);
+
 GUM_API void gum_stalker_flush (GumStalker * self);
 GUM_API void gum_stalker_stop (GumStalker * self);
 GUM_API gboolean gum_stalker_garbage_collect (GumStalker * self);
@@ -183,6 +211,9 @@ GUM_API gboolean gum_stalker_is_following_me (GumStalker * self);
 GUM_API void gum_stalker_follow (GumStalker * self, GumThreadId thread_id,
     GumStalkerTransformer * transformer, GumEventSink * sink);
 GUM_API void gum_stalker_unfollow (GumStalker * self, GumThreadId thread_id);
+GUM_API void gum_stalker_follow_all (GumStalker * self,
+    GumStalkerTransformer * transformer, GumEventSink * sink);
+GUM_API void gum_stalker_unfollow_all (GumStalker * self);
 
 GUM_API void gum_stalker_activate (GumStalker * self, gconstpointer target);
 GUM_API void gum_stalker_deactivate (GumStalker * self);
@@ -204,6 +235,8 @@ GUM_API gpointer gum_stalker_backpatch_get_to (
 GUM_API void gum_stalker_invalidate (GumStalker * self, gconstpointer address);
 GUM_API void gum_stalker_invalidate_for_thread (GumStalker * self,
     GumThreadId thread_id, gconstpointer address);
+GUM_API void gum_stalker_invalidate_range (GumStalker * self,
+    const GumMemoryRange * range);
 
 GUM_API GumProbeId gum_stalker_add_call_probe (GumStalker * self,
     gpointer target_address, GumCallProbeCallback callback, gpointer data,
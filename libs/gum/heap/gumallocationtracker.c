@@ -29,6 +29,11 @@ struct _GumAllocationTracker
   GumAllocationTrackerFilterFunction filter_func;
   gpointer filter_func_user_data;
 
+  /*
+   * Updated under the mutex together with the hash tables below, so unlike
+   * the call count sampler there is no shared atomic here for a
+   * GumPerCpuCounter to take off the hot path.
+   */
   guint block_count;
   guint block_total_size;
   GHashTable * known_blocks_ht;
@@ -16,6 +16,10 @@
 
 #define DEFAULT_POOL_SIZE       4096
 #define DEFAULT_FRONT_ALIGNMENT   16
+#define DEFAULT_SAMPLE_RATE        1
+#define DEFAULT_MAX_POOL_SIZE      0
+
+#define GUM_BOUNDS_MAX_POOLS      32
 
 #define GUM_BOUNDS_CHECKER_LOCK() g_mutex_lock (&self->mutex)
 #define GUM_BOUNDS_CHECKER_UNLOCK() g_mutex_unlock (&self->mutex)
@@ -49,8 +53,17 @@ struct _GumBoundsChecker
   volatile gboolean handled_invalid_access;
 
   guint pool_size;
+  guint max_pool_size;
   guint front_alignment;
-  GumPagePool * page_pool;
+  guint sample_rate;
+  volatile gint sample_counter;
+
+  GumPagePool * page_pools[GUM_BOUNDS_MAX_POOLS];
+  guint n_page_pools;
+  guint pages_reserved;
+  volatile gboolean growing;
+  guint8 * pools_lower;
+  guint8 * pools_upper;
 };
 
 struct _GumBoundsHookGroup
@@ -64,7 +77,9 @@ enum
   PROP_0,
   PROP_BACKTRACER,
   PROP_POOL_SIZE,
-  PROP_FRONT_ALIGNMENT
+  PROP_MAX_POOL_SIZE,
+  PROP_FRONT_ALIGNMENT,
+  PROP_SAMPLE_RATE
 };
 
 static void gum_bounds_checker_dispose (GObject * object);
@@ -81,10 +96,22 @@ static gpointer replacement_realloc (gpointer old_address,
     gsize new_size);
 static void replacement_free (gpointer address);
 
+static gboolean gum_bounds_checker_should_sample (GumBoundsChecker * self);
+static gboolean gum_bounds_checker_might_own (GumBoundsChecker * self,
+    gconstpointer address);
 static gpointer gum_bounds_checker_try_alloc (GumBoundsChecker * self,
     guint size, GumInvocationContext * ctx);
+static gpointer gum_bounds_checker_try_alloc_from_pools (
+    GumBoundsChecker * self, guint size);
+static gboolean gum_bounds_checker_try_grow (GumBoundsChecker * self);
+static void gum_bounds_checker_add_pool (GumBoundsChecker * self,
+    GumPagePool * pool);
 static gboolean gum_bounds_checker_try_free (GumBoundsChecker * self,
     gpointer address, GumInvocationContext * ctx);
+static gboolean gum_bounds_checker_query_block_details (
+    GumBoundsChecker * self, gconstpointer address, GumBlockDetails * block);
+static GumPagePool * gum_bounds_checker_find_pool (GumBoundsChecker * self,
+    gconstpointer address);
 
 static gboolean gum_bounds_checker_on_exception (GumExceptionDetails * details,
     gpointer user_data);
@@ -114,11 +141,23 @@ gum_bounds_checker_class_init (GumBoundsCheckerClass * klass)
       2, G_MAXUINT, DEFAULT_POOL_SIZE,
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (object_class, PROP_MAX_POOL_SIZE,
+      g_param_spec_uint ("max-pool-size", "Max Pool Size",
+      "Number of pages the pool may grow to, or 0 to keep it fixed",
+      0, G_MAXUINT, DEFAULT_MAX_POOL_SIZE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (object_class, PROP_FRONT_ALIGNMENT,
       g_param_spec_uint ("front-alignment", "Front Alignment",
       "Front alignment requirement",
       1, 64, DEFAULT_FRONT_ALIGNMENT,
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_SAMPLE_RATE,
+      g_param_spec_uint ("sample-rate", "Sample Rate",
+      "Guard one out of this many allocations",
+      1, G_MAXUINT, DEFAULT_SAMPLE_RATE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -129,7 +168,9 @@ gum_bounds_checker_init (GumBoundsChecker * self)
   self->interceptor = gum_interceptor_obtain ();
   self->exceptor = gum_exceptor_obtain ();
   self->pool_size = DEFAULT_POOL_SIZE;
+  self->max_pool_size = DEFAULT_MAX_POOL_SIZE;
   self->front_alignment = DEFAULT_FRONT_ALIGNMENT;
+  self->sample_rate = DEFAULT_SAMPLE_RATE;
 
   gum_exceptor_add (self->exceptor, gum_bounds_checker_on_exception, self);
 }
@@ -185,9 +226,15 @@ gum_bounds_checker_get_property (GObject * object,
     case PROP_POOL_SIZE:
       g_value_set_uint (value, gum_bounds_checker_get_pool_size (self));
       break;
+    case PROP_MAX_POOL_SIZE:
+      g_value_set_uint (value, gum_bounds_checker_get_max_pool_size (self));
+      break;
     case PROP_FRONT_ALIGNMENT:
       g_value_set_uint (value, gum_bounds_checker_get_front_alignment (self));
       break;
+    case PROP_SAMPLE_RATE:
+      g_value_set_uint (value, gum_bounds_checker_get_sample_rate (self));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -222,9 +269,15 @@ gum_bounds_checker_set_property (GObject * object,
     case PROP_POOL_SIZE:
       gum_bounds_checker_set_pool_size (self, g_value_get_uint (value));
       break;
+    case PROP_MAX_POOL_SIZE:
+      gum_bounds_checker_set_max_pool_size (self, g_value_get_uint (value));
+      break;
     case PROP_FRONT_ALIGNMENT:
       gum_bounds_checker_set_front_alignment (self, g_value_get_uint (value));
       break;
+    case PROP_SAMPLE_RATE:
+      gum_bounds_checker_set_sample_rate (self, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -257,10 +310,33 @@ void
 gum_bounds_checker_set_pool_size (GumBoundsChecker * self,
                                   guint pool_size)
 {
-  g_assert (self->page_pool == NULL);
+  g_assert (self->n_page_pools == 0);
   self->pool_size = pool_size;
 }
 
+guint
+gum_bounds_checker_get_max_pool_size (GumBoundsChecker * self)
+{
+  return self->max_pool_size;
+}
+
+/**
+ * gum_bounds_checker_set_max_pool_size:
+ * @self: a bounds checker
+ * @max_pool_size: number of pages, or 0 to never grow beyond the pool size
+ *
+ * Allows the guard page pool to grow on demand once the initial pool of
+ * #GumBoundsChecker:pool-size pages is exhausted, instead of letting further
+ * allocations go unguarded.
+ */
+void
+gum_bounds_checker_set_max_pool_size (GumBoundsChecker * self,
+                                      guint max_pool_size)
+{
+  g_assert (self->n_page_pools == 0);
+  self->max_pool_size = max_pool_size;
+}
+
 guint
 gum_bounds_checker_get_front_alignment (GumBoundsChecker * self)
 {
@@ -271,10 +347,37 @@ void
 gum_bounds_checker_set_front_alignment (GumBoundsChecker * self,
                                         guint pool_size)
 {
-  g_assert (self->page_pool == NULL);
+  g_assert (self->n_page_pools == 0);
   self->front_alignment = pool_size;
 }
 
+guint
+gum_bounds_checker_get_sample_rate (GumBoundsChecker * self)
+{
+  return self->sample_rate;
+}
+
+/**
+ * gum_bounds_checker_set_sample_rate:
+ * @self: a bounds checker
+ * @sample_rate: guard one out of this many allocations
+ *
+ * Only sends a fraction of allocations to guarded pages, letting the rest go
+ * straight to the original allocator without taking any locks. This makes
+ * it viable to leave the checker attached in long-running processes, where
+ * overflows are eventually caught by one of the sampled allocations.
+ *
+ * Defaults to 1, i.e. every allocation is guarded.
+ */
+void
+gum_bounds_checker_set_sample_rate (GumBoundsChecker * self,
+                                    guint sample_rate)
+{
+  g_return_if_fail (sample_rate != 0);
+
+  self->sample_rate = sample_rate;
+}
+
 void
 gum_bounds_checker_attach (GumBoundsChecker * self)
 {
@@ -295,11 +398,9 @@ gum_bounds_checker_attach_to_apis (GumBoundsChecker * self,
   g_assert (self->hook_groups == NULL);
   self->hook_groups = g_new0 (GumBoundsHookGroup, apis->len);
 
-  g_assert (self->page_pool == NULL);
-  self->page_pool = gum_page_pool_new (GUM_PROTECT_MODE_ABOVE,
-      self->pool_size);
-  g_object_set (self->page_pool, "front-alignment", self->front_alignment,
-      NULL);
+  g_assert (self->n_page_pools == 0);
+  gum_bounds_checker_add_pool (self, gum_page_pool_new (GUM_PROTECT_MODE_ABOVE,
+      self->pool_size));
 
   gum_interceptor_begin_transaction (self->interceptor);
 
@@ -342,7 +443,8 @@ gum_bounds_checker_detach (GumBoundsChecker * self)
     self->attached = FALSE;
     self->detaching = TRUE;
 
-    g_assert (gum_page_pool_peek_used (self->page_pool) == 0);
+    for (i = 0; i != self->n_page_pools; i++)
+      g_assert (gum_page_pool_peek_used (self->page_pools[i]) == 0);
 
     gum_interceptor_begin_transaction (self->interceptor);
 
@@ -364,8 +466,15 @@ gum_bounds_checker_detach (GumBoundsChecker * self)
 
     gum_interceptor_end_transaction (self->interceptor);
 
-    g_object_unref (self->page_pool);
-    self->page_pool = NULL;
+    for (i = 0; i != self->n_page_pools; i++)
+    {
+      g_object_unref (self->page_pools[i]);
+      self->page_pools[i] = NULL;
+    }
+    self->n_page_pools = 0;
+    self->pages_reserved = 0;
+    self->pools_lower = NULL;
+    self->pools_upper = NULL;
 
     g_free (self->hook_groups);
     self->hook_groups = NULL;
@@ -387,12 +496,11 @@ replacement_malloc (gsize size)
   group = GUM_IC_GET_REPLACEMENT_DATA (ctx, GumBoundsHookGroup *);
   self = group->checker;
 
-  if (self->detaching || self->handled_invalid_access)
+  if (self->detaching || self->handled_invalid_access ||
+      !gum_bounds_checker_should_sample (self))
     goto fallback;
 
-  GUM_BOUNDS_CHECKER_LOCK ();
   result = gum_bounds_checker_try_alloc (self, MAX (size, 1), ctx);
-  GUM_BOUNDS_CHECKER_UNLOCK ();
   if (result == NULL)
     goto fallback;
 
@@ -415,12 +523,11 @@ replacement_calloc (gsize num,
   group = GUM_IC_GET_REPLACEMENT_DATA (ctx, GumBoundsHookGroup *);
   self = group->checker;
 
-  if (self->detaching || self->handled_invalid_access)
+  if (self->detaching || self->handled_invalid_access ||
+      !gum_bounds_checker_should_sample (self))
     goto fallback;
 
-  GUM_BOUNDS_CHECKER_LOCK ();
   result = gum_bounds_checker_try_alloc (self, MAX (num * size, 1), ctx);
-  GUM_BOUNDS_CHECKER_UNLOCK ();
   if (result != NULL)
     gum_memset (result, 0, num * size);
   else
@@ -455,23 +562,21 @@ replacement_realloc (gpointer old_address,
     return NULL;
   }
 
-  if (self->detaching || self->handled_invalid_access)
+  if (self->detaching || self->handled_invalid_access ||
+      !gum_bounds_checker_might_own (self, old_address))
     goto fallback;
 
   GUM_BOUNDS_CHECKER_LOCK ();
-
-  if (!gum_page_pool_query_block_details (self->page_pool, old_address,
-      &old_block))
+  if (!gum_bounds_checker_query_block_details (self, old_address, &old_block))
   {
     GUM_BOUNDS_CHECKER_UNLOCK ();
 
     goto fallback;
   }
+  GUM_BOUNDS_CHECKER_UNLOCK ();
 
   result = gum_bounds_checker_try_alloc (self, new_size, ctx);
 
-  GUM_BOUNDS_CHECKER_UNLOCK ();
-
   if (result == NULL)
     result = group->api->malloc (new_size);
 
@@ -500,14 +605,42 @@ replacement_free (gpointer address)
   group = GUM_IC_GET_REPLACEMENT_DATA (ctx, GumBoundsHookGroup *);
   self = group->checker;
 
-  GUM_BOUNDS_CHECKER_LOCK ();
-  freed = gum_bounds_checker_try_free (self, address, ctx);
-  GUM_BOUNDS_CHECKER_UNLOCK ();
+  if (gum_bounds_checker_might_own (self, address))
+  {
+    GUM_BOUNDS_CHECKER_LOCK ();
+    freed = gum_bounds_checker_try_free (self, address, ctx);
+    GUM_BOUNDS_CHECKER_UNLOCK ();
+  }
+  else
+  {
+    freed = FALSE;
+  }
 
   if (!freed)
     group->api->free (address);
 }
 
+static gboolean
+gum_bounds_checker_should_sample (GumBoundsChecker * self)
+{
+  guint rate = self->sample_rate;
+
+  if (rate == 1)
+    return TRUE;
+
+  return (guint) g_atomic_int_add (&self->sample_counter, 1) % rate == 0;
+}
+
+static gboolean
+gum_bounds_checker_might_own (GumBoundsChecker * self,
+                              gconstpointer address)
+{
+  const guint8 * p = address;
+
+  return p >= (guint8 *) g_atomic_pointer_get (&self->pools_lower) &&
+      p < (guint8 *) g_atomic_pointer_get (&self->pools_upper);
+}
+
 static gpointer
 gum_bounds_checker_try_alloc (GumBoundsChecker * self,
                               guint size,
@@ -515,13 +648,18 @@ gum_bounds_checker_try_alloc (GumBoundsChecker * self,
 {
   gpointer result;
 
-  result = gum_page_pool_try_alloc (self->page_pool, size);
+  GUM_BOUNDS_CHECKER_LOCK ();
+
+  result = gum_bounds_checker_try_alloc_from_pools (self, size);
+
+  if (result == NULL && gum_bounds_checker_try_grow (self))
+    result = gum_bounds_checker_try_alloc_from_pools (self, size);
 
   if (result != NULL && self->backtracer_instance != NULL)
   {
     GumBlockDetails block;
 
-    gum_page_pool_query_block_details (self->page_pool, result, &block);
+    gum_bounds_checker_query_block_details (self, result, &block);
 
     gum_mprotect (block.guard, block.guard_size, GUM_PAGE_RW);
 
@@ -535,23 +673,101 @@ gum_bounds_checker_try_alloc (GumBoundsChecker * self,
     gum_mprotect (block.guard, block.guard_size, GUM_PAGE_NO_ACCESS);
   }
 
+  GUM_BOUNDS_CHECKER_UNLOCK ();
+
   return result;
 }
 
+static gpointer
+gum_bounds_checker_try_alloc_from_pools (GumBoundsChecker * self,
+                                         guint size)
+{
+  guint i;
+
+  for (i = self->n_page_pools; i != 0; i--)
+  {
+    gpointer result;
+
+    result = gum_page_pool_try_alloc (self->page_pools[i - 1], size);
+    if (result != NULL)
+      return result;
+  }
+
+  return NULL;
+}
+
+/*
+ * Called with the lock held, which we drop while creating the pool as that
+ * allocates memory itself. Allocations made meanwhile, including our own,
+ * may still use the existing pools but won't try to grow them again.
+ */
+static gboolean
+gum_bounds_checker_try_grow (GumBoundsChecker * self)
+{
+  guint n_pages;
+  GumPagePool * pool;
+
+  if (self->growing || self->n_page_pools == GUM_BOUNDS_MAX_POOLS ||
+      self->pages_reserved >= self->max_pool_size)
+  {
+    return FALSE;
+  }
+
+  n_pages = MIN (self->pages_reserved,
+      self->max_pool_size - self->pages_reserved);
+  if (n_pages < 2)
+    return FALSE;
+
+  self->growing = TRUE;
+  GUM_BOUNDS_CHECKER_UNLOCK ();
+
+  pool = gum_page_pool_new (GUM_PROTECT_MODE_ABOVE, n_pages);
+
+  GUM_BOUNDS_CHECKER_LOCK ();
+  gum_bounds_checker_add_pool (self, pool);
+  self->growing = FALSE;
+
+  return TRUE;
+}
+
+static void
+gum_bounds_checker_add_pool (GumBoundsChecker * self,
+                             GumPagePool * pool)
+{
+  guint8 * lower, * upper;
+
+  g_object_set (pool, "front-alignment", self->front_alignment, NULL);
+
+  gum_page_pool_get_bounds (pool, &lower, &upper);
+
+  if (self->n_page_pools == 0 || lower < self->pools_lower)
+    g_atomic_pointer_set (&self->pools_lower, lower);
+  if (self->n_page_pools == 0 || upper > self->pools_upper)
+    g_atomic_pointer_set (&self->pools_upper, upper);
+
+  self->page_pools[self->n_page_pools++] = pool;
+  self->pages_reserved += gum_page_pool_peek_available (pool);
+}
+
 static gboolean
 gum_bounds_checker_try_free (GumBoundsChecker * self,
                              gpointer address,
                              GumInvocationContext * ctx)
 {
+  GumPagePool * pool;
   gboolean freed;
 
-  freed = gum_page_pool_try_free (self->page_pool, address);
+  pool = gum_bounds_checker_find_pool (self, address);
+  if (pool == NULL)
+    return FALSE;
+
+  freed = gum_page_pool_try_free (pool, address);
 
   if (freed && self->backtracer_instance != NULL)
   {
     GumBlockDetails block;
 
-    gum_page_pool_query_block_details (self->page_pool, address, &block);
+    gum_page_pool_query_block_details (pool, address, &block);
 
     gum_mprotect (block.guard, block.guard_size, GUM_PAGE_RW);
 
@@ -566,6 +782,39 @@ gum_bounds_checker_try_free (GumBoundsChecker * self,
   return freed;
 }
 
+static gboolean
+gum_bounds_checker_query_block_details (GumBoundsChecker * self,
+                                        gconstpointer address,
+                                        GumBlockDetails * block)
+{
+  GumPagePool * pool;
+
+  pool = gum_bounds_checker_find_pool (self, address);
+  if (pool == NULL)
+    return FALSE;
+
+  return gum_page_pool_query_block_details (pool, address, block);
+}
+
+static GumPagePool *
+gum_bounds_checker_find_pool (GumBoundsChecker * self,
+                              gconstpointer address)
+{
+  guint i;
+
+  for (i = 0; i != self->n_page_pools; i++)
+  {
+    GumPagePool * pool = self->page_pools[i];
+    guint8 * lower, * upper;
+
+    gum_page_pool_get_bounds (pool, &lower, &upper);
+    if ((const guint8 *) address >= lower && (const guint8 *) address < upper)
+      return pool;
+  }
+
+  return NULL;
+}
+
 static gboolean
 gum_bounds_checker_on_exception (GumExceptionDetails * details,
                                  gpointer user_data)
@@ -588,7 +837,7 @@ gum_bounds_checker_on_exception (GumExceptionDetails * details,
 
   address = details->memory.address;
 
-  if (!gum_page_pool_query_block_details (self->page_pool, address, &block))
+  if (!gum_bounds_checker_query_block_details (self, address, &block))
     return FALSE;
 
   if (self->handled_invalid_access)
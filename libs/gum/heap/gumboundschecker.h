@@ -25,9 +25,15 @@ GUM_API GumBoundsChecker * gum_bounds_checker_new (GumBacktracer * backtracer,
 GUM_API guint gum_bounds_checker_get_pool_size (GumBoundsChecker * self);
 GUM_API void gum_bounds_checker_set_pool_size (GumBoundsChecker * self,
   guint pool_size);
+GUM_API guint gum_bounds_checker_get_max_pool_size (GumBoundsChecker * self);
+GUM_API void gum_bounds_checker_set_max_pool_size (GumBoundsChecker * self,
+    guint max_pool_size);
 GUM_API guint gum_bounds_checker_get_front_alignment (GumBoundsChecker * self);
 GUM_API void gum_bounds_checker_set_front_alignment (GumBoundsChecker * self,
   guint pool_size);
+GUM_API guint gum_bounds_checker_get_sample_rate (GumBoundsChecker * self);
+GUM_API void gum_bounds_checker_set_sample_rate (GumBoundsChecker * self,
+    guint sample_rate);
 
 GUM_API void gum_bounds_checker_attach (GumBoundsChecker * self);
 GUM_API void gum_bounds_checker_attach_to_apis (GumBoundsChecker * self,
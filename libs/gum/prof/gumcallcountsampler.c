@@ -8,6 +8,7 @@
 #include "gumcallcountsampler.h"
 
 #include "guminterceptor.h"
+#include "gumpercpucounter.h"
 #include "gumsymbolutil.h"
 #include "gumtls.h"
 
@@ -33,7 +34,7 @@ struct _GumCallCountSampler
 
   GumInterceptor * interceptor;
 
-  volatile gint total_count;
+  GumPerCpuCounter * total_count;
 
   GumTlsKey tls_key;
   GMutex mutex;
@@ -82,6 +83,8 @@ gum_call_count_sampler_init (GumCallCountSampler * self)
 {
   self->interceptor = gum_interceptor_obtain ();
 
+  self->total_count = gum_per_cpu_counter_new ();
+
   self->tls_key = gum_tls_key_new ();
   g_mutex_init (&self->mutex);
 }
@@ -107,6 +110,8 @@ gum_call_count_sampler_finalize (GObject * object)
 {
   GumCallCountSampler * self = GUM_CALL_COUNT_SAMPLER (object);
 
+  gum_per_cpu_counter_free (self->total_count);
+
   gum_tls_key_free (self->tls_key);
   g_mutex_clear (&self->mutex);
 
@@ -219,7 +224,7 @@ gum_call_count_sampler_add_function (GumCallCountSampler * self,
 GumSample
 gum_call_count_sampler_peek_total_count (GumCallCountSampler * self)
 {
-  return g_atomic_int_get (&self->total_count);
+  return gum_per_cpu_counter_read (self->total_count);
 }
 
 static GumSample
@@ -260,7 +265,7 @@ gum_call_count_sampler_on_enter (GumInvocationListener * listener,
     gum_tls_key_set_value (self->tls_key, counter);
   }
 
-  g_atomic_int_inc (&self->total_count);
+  gum_per_cpu_counter_add (self->total_count, 1);
   (*counter)++;
 }
 
@@ -15,12 +15,30 @@
 #define GUM_PROFILER_LOCK()   (g_mutex_lock (&self->mutex))
 #define GUM_PROFILER_UNLOCK() (g_mutex_unlock (&self->mutex))
 
+#define GUM_PROFILE_FLUSH_THRESHOLD (16 * 1024)
+
+#define GUM_PPROF_SAMPLE_TYPE   1
+#define GUM_PPROF_SAMPLE        2
+#define GUM_PPROF_LOCATION      4
+#define GUM_PPROF_FUNCTION      5
+#define GUM_PPROF_STRING_TABLE  6
+#define GUM_PPROF_TIME_NANOS    9
+
+#define GUM_PB_VARINT           0
+#define GUM_PB_LENGTH_DELIMITED 2
+
 typedef struct _GumProfilerInvocation GumProfilerInvocation;
 typedef struct _GumProfilerContext GumProfilerContext;
 typedef struct _GumFunctionContext GumFunctionContext;
 typedef struct _GumWorstCaseInfo GumWorstCaseInfo;
 typedef struct _GumWorstCase GumWorstCase;
 typedef struct _GumFunctionThreadContext GumFunctionThreadContext;
+typedef struct _GumProfileEmitter GumProfileEmitter;
+typedef struct _GumEmittedFunction GumEmittedFunction;
+
+typedef void (* GumProfilerStackFunc) (
+    GumFunctionThreadContext * const * frames, guint depth, guint64 calls,
+    GumSample self_duration, gpointer user_data);
 
 struct _GumProfiler
 {
@@ -91,6 +109,26 @@ struct _GumFunctionContext
   volatile gint thread_context_count;
 };
 
+struct _GumProfileEmitter
+{
+  GumProfileOutputFunc output;
+  gpointer output_data;
+
+  GHashTable * functions;
+  gboolean folded;
+  guint next_string_index;
+
+  GByteArray * pending;
+  GByteArray * message;
+  GByteArray * submessage;
+};
+
+struct _GumEmittedFunction
+{
+  guint64 id;
+  gchar * name;
+};
+
 static void gum_profiler_invocation_listener_iface_init (gpointer g_iface,
     gpointer iface_data);
 static void gum_profiler_dispose (GObject * object);
@@ -115,6 +153,35 @@ static void thread_context_register_child_timing (
     GumFunctionThreadContext * parent_ctx,
     GumFunctionThreadContext * child_ctx);
 
+static void gum_profiler_foreach_stack (GumProfiler * self,
+    GumProfilerStackFunc func, gpointer user_data);
+static guint gum_profiler_collect_frames (GumFunctionThreadContext * root,
+    GumFunctionThreadContext ** frames);
+
+static void gum_profile_emitter_init (GumProfileEmitter * emitter,
+    gboolean folded, GumProfileOutputFunc output, gpointer output_data);
+static void gum_profile_emitter_finish (GumProfileEmitter * emitter);
+static GumEmittedFunction * gum_profile_emitter_lookup_function (
+    GumProfileEmitter * emitter, GumFunctionThreadContext * thread_ctx);
+static void gum_profile_emitter_maybe_flush (GumProfileEmitter * emitter);
+static void gum_emitted_function_free (GumEmittedFunction * function);
+static void gum_profile_emit_pprof_sample (
+    GumFunctionThreadContext * const * frames, guint depth, guint64 calls,
+    GumSample self_duration, gpointer user_data);
+static void gum_profile_emit_folded_stack (
+    GumFunctionThreadContext * const * frames, guint depth, guint64 calls,
+    GumSample self_duration, gpointer user_data);
+static guint gum_pprof_add_string (GumProfileEmitter * emitter,
+    const gchar * str);
+static void gum_pprof_add_sample_type (GumProfileEmitter * emitter,
+    const gchar * type, const gchar * unit);
+
+static void gum_pb_append_varint (GByteArray * buf, guint64 value);
+static void gum_pb_append_uint_field (GByteArray * buf, guint field,
+    guint64 value);
+static void gum_pb_append_bytes_field (GByteArray * buf, guint field,
+    gconstpointer data, gsize size);
+
 static void get_number_of_threads_foreach (gpointer key, gpointer value,
     gpointer user_data);
 
@@ -518,6 +585,382 @@ make_node (gchar * name,
   return node;
 }
 
+/**
+ * gum_profiler_emit_pprof:
+ * @self: a profiler
+ * @func: function that receives the output, one chunk at a time
+ * @user_data: data to pass to @func
+ *
+ * Streams the current state of @self as a pprof protobuf-encoded Profile,
+ * with one sample per call chain carrying the number of calls and the
+ * duration spent in its innermost function, excluding the child that was
+ * recorded for it. Durations are in the units of the sampler used for each
+ * function.
+ *
+ * Unlike gum_profiler_generate_report() no tree is materialized; memory use
+ * is bounded by the number of instrumented functions. It is safe to call
+ * this while profiling is in progress, in which case instrumented threads
+ * keep running and the result is a best-effort snapshot.
+ */
+void
+gum_profiler_emit_pprof (GumProfiler * self,
+                         GumProfileOutputFunc func,
+                         gpointer user_data)
+{
+  GumProfileEmitter emitter;
+
+  gum_profile_emitter_init (&emitter, FALSE, func, user_data);
+
+  gum_pprof_add_string (&emitter, "");
+  gum_pprof_add_sample_type (&emitter, "calls", "count");
+  gum_pprof_add_sample_type (&emitter, "duration", "samples");
+  gum_pb_append_uint_field (emitter.pending, GUM_PPROF_TIME_NANOS,
+      g_get_real_time () * G_GINT64_CONSTANT (1000));
+
+  gum_profiler_foreach_stack (self, gum_profile_emit_pprof_sample, &emitter);
+
+  gum_profile_emitter_finish (&emitter);
+}
+
+/**
+ * gum_profiler_emit_folded_stacks:
+ * @self: a profiler
+ * @func: function that receives the output, one chunk at a time
+ * @user_data: data to pass to @func
+ *
+ * Like gum_profiler_emit_pprof(), but produces the folded stack format
+ * understood by flame graph tools: one `a;b;c <duration>` line per call
+ * chain.
+ */
+void
+gum_profiler_emit_folded_stacks (GumProfiler * self,
+                                 GumProfileOutputFunc func,
+                                 gpointer user_data)
+{
+  GumProfileEmitter emitter;
+
+  gum_profile_emitter_init (&emitter, TRUE, func, user_data);
+
+  gum_profiler_foreach_stack (self, gum_profile_emit_folded_stack, &emitter);
+
+  gum_profile_emitter_finish (&emitter);
+}
+
+static void
+gum_profiler_foreach_stack (GumProfiler * self,
+                            GumProfilerStackFunc func,
+                            gpointer user_data)
+{
+  GPtrArray * functions;
+  GHashTableIter iter;
+  gpointer function_ctx;
+  GumFunctionThreadContext * frames[GUM_MAX_CALL_DEPTH];
+  guint i;
+
+  /*
+   * Only hold the lock while taking a copy of the function list, as new
+   * threads need it when entering an instrumented function for the first
+   * time. Function contexts stay alive until we are disposed.
+   */
+  functions = g_ptr_array_new ();
+  GUM_PROFILER_LOCK ();
+  g_hash_table_iter_init (&iter, self->function_by_address);
+  while (g_hash_table_iter_next (&iter, NULL, &function_ctx))
+    g_ptr_array_add (functions, function_ctx);
+  GUM_PROFILER_UNLOCK ();
+
+  for (i = 0; i != functions->len; i++)
+  {
+    GumFunctionContext * fctx = g_ptr_array_index (functions, i);
+    gint thread_count, j;
+
+    thread_count = g_atomic_int_get (&fctx->thread_context_count);
+    for (j = 0; j != thread_count; j++)
+    {
+      guint depth, k;
+
+      if (!fctx->thread_contexts[j].is_root_node)
+        continue;
+
+      depth = gum_profiler_collect_frames (&fctx->thread_contexts[j], frames);
+
+      for (k = 0; k != depth; k++)
+      {
+        GumSample total, child_total;
+
+        total = frames[k]->total_duration;
+        child_total = (k + 1 != depth) ? frames[k + 1]->total_duration : 0;
+
+        func (frames, k + 1, frames[k]->total_calls,
+            (total > child_total) ? total - child_total : 0, user_data);
+      }
+    }
+  }
+
+  g_ptr_array_free (functions, TRUE);
+}
+
+static guint
+gum_profiler_collect_frames (GumFunctionThreadContext * root,
+                             GumFunctionThreadContext ** frames)
+{
+  guint depth = 0;
+  GumFunctionThreadContext * cur;
+
+  for (cur = root; cur != NULL && depth != GUM_MAX_CALL_DEPTH;
+      cur = cur->child_ctx)
+  {
+    guint i;
+
+    for (i = 0; i != depth; i++)
+    {
+      if (frames[i] == cur)
+        return depth;
+    }
+
+    frames[depth++] = cur;
+  }
+
+  return depth;
+}
+
+static void
+gum_profile_emitter_init (GumProfileEmitter * emitter,
+                          gboolean folded,
+                          GumProfileOutputFunc output,
+                          gpointer output_data)
+{
+  emitter->output = output;
+  emitter->output_data = output_data;
+
+  emitter->functions = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) gum_emitted_function_free);
+  emitter->folded = folded;
+  emitter->next_string_index = 0;
+
+  emitter->pending = g_byte_array_sized_new (GUM_PROFILE_FLUSH_THRESHOLD);
+  emitter->message = g_byte_array_new ();
+  emitter->submessage = g_byte_array_new ();
+}
+
+static void
+gum_profile_emitter_finish (GumProfileEmitter * emitter)
+{
+  if (emitter->pending->len != 0)
+  {
+    emitter->output (emitter->pending->data, emitter->pending->len,
+        emitter->output_data);
+  }
+
+  g_byte_array_unref (emitter->submessage);
+  g_byte_array_unref (emitter->message);
+  g_byte_array_unref (emitter->pending);
+
+  g_hash_table_unref (emitter->functions);
+}
+
+static GumEmittedFunction *
+gum_profile_emitter_lookup_function (GumProfileEmitter * emitter,
+                                     GumFunctionThreadContext * thread_ctx)
+{
+  gpointer address = thread_ctx->function_ctx->function_address;
+  GumEmittedFunction * function;
+  guint name_index;
+  GByteArray * msg, * line;
+
+  function = g_hash_table_lookup (emitter->functions, address);
+  if (function != NULL)
+    return function;
+
+  function = g_slice_new (GumEmittedFunction);
+  function->id = g_hash_table_size (emitter->functions) + 1;
+  function->name = gum_symbol_name_from_address (address);
+  g_hash_table_insert (emitter->functions, address, function);
+
+  if (emitter->folded)
+  {
+    g_strdelimit (function->name, ";\n", '_');
+    return function;
+  }
+
+  name_index = gum_pprof_add_string (emitter, function->name);
+
+  msg = emitter->message;
+  g_byte_array_set_size (msg, 0);
+  gum_pb_append_uint_field (msg, 1, function->id);
+  gum_pb_append_uint_field (msg, 2, name_index);
+  gum_pb_append_uint_field (msg, 3, name_index);
+  gum_pb_append_bytes_field (emitter->pending, GUM_PPROF_FUNCTION,
+      msg->data, msg->len);
+
+  /* One location per function, sharing its ID. */
+  line = emitter->submessage;
+  g_byte_array_set_size (line, 0);
+  gum_pb_append_uint_field (line, 1, function->id);
+
+  g_byte_array_set_size (msg, 0);
+  gum_pb_append_uint_field (msg, 1, function->id);
+  gum_pb_append_uint_field (msg, 3, GPOINTER_TO_SIZE (address));
+  gum_pb_append_bytes_field (msg, 4, line->data, line->len);
+  gum_pb_append_bytes_field (emitter->pending, GUM_PPROF_LOCATION,
+      msg->data, msg->len);
+
+  return function;
+}
+
+static void
+gum_profile_emitter_maybe_flush (GumProfileEmitter * emitter)
+{
+  if (emitter->pending->len < GUM_PROFILE_FLUSH_THRESHOLD)
+    return;
+
+  emitter->output (emitter->pending->data, emitter->pending->len,
+      emitter->output_data);
+  g_byte_array_set_size (emitter->pending, 0);
+}
+
+static void
+gum_emitted_function_free (GumEmittedFunction * function)
+{
+  g_free (function->name);
+
+  g_slice_free (GumEmittedFunction, function);
+}
+
+static void
+gum_profile_emit_pprof_sample (GumFunctionThreadContext * const * frames,
+                               guint depth,
+                               guint64 calls,
+                               GumSample self_duration,
+                               gpointer user_data)
+{
+  GumProfileEmitter * emitter = user_data;
+  GumEmittedFunction * functions[GUM_MAX_CALL_DEPTH];
+  GByteArray * ids, * msg;
+  guint i;
+
+  /* Resolve first, as new functions are emitted using the scratch buffers. */
+  for (i = 0; i != depth; i++)
+    functions[i] = gum_profile_emitter_lookup_function (emitter, frames[i]);
+
+  ids = emitter->submessage;
+  g_byte_array_set_size (ids, 0);
+  for (i = depth; i != 0; i--)
+    gum_pb_append_varint (ids, functions[i - 1]->id);
+
+  msg = emitter->message;
+  g_byte_array_set_size (msg, 0);
+  gum_pb_append_bytes_field (msg, 1, ids->data, ids->len);
+
+  g_byte_array_set_size (ids, 0);
+  gum_pb_append_varint (ids, calls);
+  gum_pb_append_varint (ids, self_duration);
+  gum_pb_append_bytes_field (msg, 2, ids->data, ids->len);
+
+  gum_pb_append_bytes_field (emitter->pending, GUM_PPROF_SAMPLE,
+      msg->data, msg->len);
+
+  gum_profile_emitter_maybe_flush (emitter);
+}
+
+static void
+gum_profile_emit_folded_stack (GumFunctionThreadContext * const * frames,
+                               guint depth,
+                               guint64 calls,
+                               GumSample self_duration,
+                               gpointer user_data)
+{
+  GumProfileEmitter * emitter = user_data;
+  guint i;
+  gchar value[32];
+
+  for (i = 0; i != depth; i++)
+  {
+    const gchar * name =
+        gum_profile_emitter_lookup_function (emitter, frames[i])->name;
+
+    if (i != 0)
+      g_byte_array_append (emitter->pending, (const guint8 *) ";", 1);
+    g_byte_array_append (emitter->pending, (const guint8 *) name,
+        strlen (name));
+  }
+
+  g_snprintf (value, sizeof (value), " %" G_GUINT64_FORMAT "\n",
+      (guint64) self_duration);
+  g_byte_array_append (emitter->pending, (const guint8 *) value,
+      strlen (value));
+
+  gum_profile_emitter_maybe_flush (emitter);
+}
+
+static guint
+gum_pprof_add_string (GumProfileEmitter * emitter,
+                      const gchar * str)
+{
+  gum_pb_append_bytes_field (emitter->pending, GUM_PPROF_STRING_TABLE, str,
+      strlen (str));
+
+  return emitter->next_string_index++;
+}
+
+static void
+gum_pprof_add_sample_type (GumProfileEmitter * emitter,
+                           const gchar * type,
+                           const gchar * unit)
+{
+  guint type_index, unit_index;
+  GByteArray * msg = emitter->message;
+
+  type_index = gum_pprof_add_string (emitter, type);
+  unit_index = gum_pprof_add_string (emitter, unit);
+
+  g_byte_array_set_size (msg, 0);
+  gum_pb_append_uint_field (msg, 1, type_index);
+  gum_pb_append_uint_field (msg, 2, unit_index);
+  gum_pb_append_bytes_field (emitter->pending, GUM_PPROF_SAMPLE_TYPE,
+      msg->data, msg->len);
+}
+
+static void
+gum_pb_append_varint (GByteArray * buf,
+                      guint64 value)
+{
+  guint8 encoded[10];
+  guint n = 0;
+
+  do
+  {
+    encoded[n] = value & 0x7f;
+    value >>= 7;
+    if (value != 0)
+      encoded[n] |= 0x80;
+    n++;
+  }
+  while (value != 0);
+
+  g_byte_array_append (buf, encoded, n);
+}
+
+static void
+gum_pb_append_uint_field (GByteArray * buf,
+                          guint field,
+                          guint64 value)
+{
+  gum_pb_append_varint (buf, (field << 3) | GUM_PB_VARINT);
+  gum_pb_append_varint (buf, value);
+}
+
+static void
+gum_pb_append_bytes_field (GByteArray * buf,
+                           guint field,
+                           gconstpointer data,
+                           gsize size)
+{
+  gum_pb_append_varint (buf, (field << 3) | GUM_PB_LENGTH_DELIMITED);
+  gum_pb_append_varint (buf, size);
+  g_byte_array_append (buf, data, size);
+}
+
 guint
 gum_profiler_get_number_of_threads (GumProfiler * self)
 {
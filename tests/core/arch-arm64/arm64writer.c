@@ -23,6 +23,8 @@ TESTLIST_BEGIN (arm64writer)
   TESTENTRY (pop_reg_reg)
   TESTENTRY (ldr_x_address)
   TESTENTRY (ldr_d_address)
+  TESTENTRY (ldr_x_address_from_literal_island)
+  TESTENTRY (ldr_x_address_out_of_literal_island_range)
 #ifdef HAVE_ARM64
   TESTENTRY (ldr_in_large_block)
 #endif
@@ -231,6 +233,47 @@ TESTCASE (ldr_d_address)
       ==, 0x123456789abcdef0);
 }
 
+TESTCASE (ldr_x_address_from_literal_island)
+{
+  guint64 slots[2];
+  GumArm64LiteralIsland island = { slots, 0, G_N_ELEMENTS (slots), 0 };
+
+  island.pc = fixture->aw.pc + 0x100;
+  fixture->aw.literal_island = &island;
+
+  gum_arm64_writer_put_ldr_reg_address (&fixture->aw, ARM64_REG_X7,
+      0x123456789abcdef0);
+  gum_arm64_writer_put_ldr_reg_address (&fixture->aw, ARM64_REG_X8,
+      0x123456789abcdef0);
+  gum_arm64_writer_flush (&fixture->aw);
+
+  assert_output_n_equals (0, 0x58000807);
+  assert_output_n_equals (1, 0x580007e8);
+  g_assert_cmpuint (gum_arm64_writer_offset (&fixture->aw), ==, 8);
+  g_assert_cmpuint (island.length, ==, 1);
+  g_assert_cmphex (GUINT64_FROM_LE (slots[0]), ==, 0x123456789abcdef0);
+}
+
+TESTCASE (ldr_x_address_out_of_literal_island_range)
+{
+  guint64 slots[2];
+  GumArm64LiteralIsland island = { slots, 0, G_N_ELEMENTS (slots), 0 };
+
+  island.pc = fixture->aw.pc + (2 * 1024 * 1024);
+  fixture->aw.literal_island = &island;
+
+  gum_arm64_writer_put_ldr_reg_address (&fixture->aw, ARM64_REG_X7,
+      0x123456789abcdef0);
+  gum_arm64_writer_put_ldr_reg_address (&fixture->aw, ARM64_REG_X8,
+      0x123456789abcdef0);
+  gum_arm64_writer_flush (&fixture->aw);
+
+  assert_output_n_equals (0, 0x58000047);
+  assert_output_n_equals (1, 0x58000028);
+  g_assert_cmpuint (gum_arm64_writer_offset (&fixture->aw), ==, 16);
+  g_assert_cmpuint (island.length, ==, 0);
+}
+
 #ifdef HAVE_ARM64
 
 TESTCASE (ldr_in_large_block)
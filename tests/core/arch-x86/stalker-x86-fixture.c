@@ -215,6 +215,7 @@ typedef struct _PatchCodeContext PatchCodeContext;
 typedef struct _UnfollowTransformContext UnfollowTransformContext;
 typedef struct _InvalidationTransformContext InvalidationTransformContext;
 typedef struct _InvalidationTarget InvalidationTarget;
+typedef struct _BlockCounterLookup BlockCounterLookup;
 
 struct _PatchCodeContext
 {
@@ -222,6 +223,12 @@ struct _PatchCodeContext
   gsize size;
 };
 
+struct _BlockCounterLookup
+{
+  gpointer address;
+  guint64 count;
+};
+
 struct _UnfollowTransformContext
 {
   GumStalker * stalker;
@@ -29,6 +29,7 @@ TESTLIST_BEGIN (stalker)
   TESTENTRY (exec)
   TESTENTRY (call_depth)
   TESTENTRY (call_probe)
+  TESTENTRY (call_probe_should_release_data_once_removed)
   TESTENTRY (custom_transformer)
   TESTENTRY (transformer_should_be_able_to_skip_call)
   TESTENTRY (unfollow_should_be_allowed_before_first_transform)
@@ -41,6 +42,7 @@ TESTLIST_BEGIN (stalker)
   TESTENTRY (invalidation_for_current_thread_should_be_supported)
   TESTENTRY (invalidation_for_specific_thread_should_be_supported)
   TESTENTRY (invalidation_should_allow_block_to_grow)
+  TESTENTRY (invalidation_for_range_should_affect_all_threads)
 
   TESTENTRY (unconditional_jumps)
   TESTENTRY (short_conditional_jump_true)
@@ -83,11 +85,15 @@ TESTLIST_BEGIN (stalker)
   TESTENTRY (follow_thread)
 #ifdef HAVE_LINUX
   TESTENTRY (create_thread)
+  TESTENTRY (follow_all_should_follow_new_threads)
 #endif
   TESTENTRY (unfollow_should_handle_terminated_thread)
   TESTENTRY (self_modifying_code_should_be_detected_with_threshold_minus_one)
   TESTENTRY (self_modifying_code_should_not_be_detected_with_threshold_zero)
   TESTENTRY (self_modifying_code_should_be_detected_with_threshold_one)
+  TESTENTRY (self_modifying_code_should_be_detected_when_guarded)
+  TESTENTRY (self_modifying_code_should_be_detected_with_range_threshold)
+  TESTENTRY (block_counters_should_count_executions)
 #ifndef HAVE_WINDOWS
   TESTENTRY (performance)
 #endif
@@ -153,10 +159,14 @@ struct _PrefetchBackpatchContext
 static gpointer run_stalked_briefly (gpointer data);
 #ifdef HAVE_LINUX
 static gpointer run_spawned_thread (gpointer data);
+static gpointer run_followed_thread (gpointer data);
+static gsize mark_followed_thread (void);
 #endif
 static gpointer run_stalked_into_termination (gpointer data);
 static void patch_code (gpointer code, gconstpointer new_code, gsize size);
 static void do_patch_instruction (gpointer mem, gpointer user_data);
+static gboolean find_block_counter (const GumBlockCounterDetails * details,
+    gpointer user_data);
 #ifndef HAVE_WINDOWS
 static gboolean store_range_of_test_runner (const GumModuleDetails * details,
     gpointer user_data);
@@ -223,6 +233,7 @@ G_DEFINE_TYPE_EXTENDED (GumTestStalkerObserver,
 static GHashTable * prefetch_compiled = NULL;
 static GHashTable * prefetch_executed = NULL;
 static PrefetchBackpatchContext bp_ctx;
+static volatile guint followed_thread_mark_count;
 
 #ifndef HAVE_ANDROID
 static void callback_at_end (GumStalkerIterator * iterator,
@@ -351,12 +362,68 @@ TESTCASE (create_thread)
   g_assert (result == GSIZE_TO_POINTER (0xdeadface));
 }
 
+TESTCASE (follow_all_should_follow_new_threads)
+{
+  pthread_t thread;
+  gpointer result;
+  guint i, calls_to_mark;
+
+  followed_thread_mark_count = 0;
+  fixture->sink->mask = GUM_CALL;
+
+  gum_stalker_follow_all (fixture->stalker, fixture->transformer,
+      GUM_EVENT_SINK (fixture->sink));
+  gum_fake_event_sink_reset (fixture->sink);
+
+  pthread_create (&thread, NULL, run_followed_thread, NULL);
+  pthread_join (thread, &result);
+
+  gum_stalker_unfollow_all (fixture->stalker);
+
+  g_assert (result == GSIZE_TO_POINTER (0xdeadface));
+  g_assert_cmpuint (followed_thread_mark_count, ==, 1);
+
+  /*
+   * Other threads may be followed too, so only count the calls that the new
+   * thread alone makes.
+   */
+  calls_to_mark = 0;
+  for (i = 0; i != fixture->sink->events->len; i++)
+  {
+    const GumEvent * ev = &g_array_index (fixture->sink->events, GumEvent, i);
+
+    if (ev->type == GUM_CALL &&
+        ev->call.target == GUM_FUNCPTR_TO_POINTER (mark_followed_thread))
+    {
+      calls_to_mark++;
+    }
+  }
+  g_assert_cmpuint (calls_to_mark, ==, 1);
+
+  while (gum_stalker_garbage_collect (fixture->stalker))
+    g_usleep (10000);
+}
+
 static gpointer
 run_spawned_thread (gpointer data)
 {
   return GSIZE_TO_POINTER (0xdeadface);
 }
 
+static gpointer
+run_followed_thread (gpointer data)
+{
+  return GSIZE_TO_POINTER (mark_followed_thread () | 0xe);
+}
+
+GUM_NOINLINE static gsize
+mark_followed_thread (void)
+{
+  followed_thread_mark_count++;
+
+  return 0xdeadfac0;
+}
+
 #endif
 
 TESTCASE (unfollow_should_handle_terminated_thread)
@@ -502,6 +569,133 @@ TESTCASE (self_modifying_code_should_be_detected_with_threshold_one)
   g_assert_cmpuint (fixture->sink->events->len, >, 0);
 }
 
+TESTCASE (self_modifying_code_should_be_detected_when_guarded)
+{
+  FlatFunc f;
+  guint8 mov_eax_imm_plus_nop[] = {
+    0xb8, 0x00, 0x00, 0x00, 0x00, /* mov eax, <imm> */
+    0x90                          /* nop padding    */
+  };
+  GumMemoryRange range;
+
+  if (!gum_query_is_rwx_supported ())
+  {
+    g_print ("<skipping, not supported> ");
+    return;
+  }
+
+  f = GUM_POINTER_TO_FUNCPTR (FlatFunc,
+      test_stalker_fixture_dup_code (fixture, flat_code, sizeof (flat_code)));
+  gum_mprotect (f, sizeof (flat_code), GUM_PAGE_RWX);
+
+  range.base_address = GUM_ADDRESS (f);
+  range.size = sizeof (flat_code);
+  gum_stalker_set_code_policy (fixture->stalker, &range,
+      GUM_STALKER_CODE_GUARDED);
+
+  fixture->sink->mask = GUM_EXEC | GUM_CALL | GUM_RET;
+
+  gum_stalker_set_trust_threshold (fixture->stalker, 1);
+  gum_stalker_follow_me (fixture->stalker, fixture->transformer,
+      GUM_EVENT_SINK (fixture->sink));
+
+  g_assert_cmpuint (f (), ==, 2);
+
+  *((guint32 *) (mov_eax_imm_plus_nop + 1)) = 42;
+  memcpy (f, mov_eax_imm_plus_nop, sizeof (mov_eax_imm_plus_nop));
+  g_assert_cmpuint (f (), ==, 42);
+  f ();
+  f ();
+
+  *((guint32 *) (mov_eax_imm_plus_nop + 1)) = 1337;
+  memcpy (f, mov_eax_imm_plus_nop, sizeof (mov_eax_imm_plus_nop));
+  g_assert_cmpuint (f (), ==, 1337);
+
+  gum_stalker_unfollow_me (fixture->stalker);
+
+  g_assert_cmpuint (fixture->sink->events->len, >, 0);
+}
+
+TESTCASE (self_modifying_code_should_be_detected_with_range_threshold)
+{
+  FlatFunc f;
+  guint8 mov_eax_imm_plus_nop[] = {
+    0xb8, 0x00, 0x00, 0x00, 0x00, /* mov eax, <imm> */
+    0x90                          /* nop padding    */
+  };
+  GumMemoryRange range;
+
+  f = GUM_POINTER_TO_FUNCPTR (FlatFunc,
+      test_stalker_fixture_dup_code (fixture, flat_code, sizeof (flat_code)));
+
+  range.base_address = GUM_ADDRESS (f);
+  range.size = sizeof (flat_code);
+  gum_stalker_set_trust_threshold_for_range (fixture->stalker, &range, -1);
+
+  fixture->sink->mask = GUM_EXEC | GUM_CALL | GUM_RET;
+
+  gum_stalker_set_trust_threshold (fixture->stalker, 0);
+  gum_stalker_follow_me (fixture->stalker, fixture->transformer,
+      GUM_EVENT_SINK (fixture->sink));
+
+  g_assert_cmpuint (f (), ==, 2);
+
+  *((guint32 *) (mov_eax_imm_plus_nop + 1)) = 42;
+  patch_code (f, mov_eax_imm_plus_nop, sizeof (mov_eax_imm_plus_nop));
+  g_assert_cmpuint (f (), ==, 42);
+  f ();
+  f ();
+
+  *((guint32 *) (mov_eax_imm_plus_nop + 1)) = 1337;
+  patch_code (f, mov_eax_imm_plus_nop, sizeof (mov_eax_imm_plus_nop));
+  g_assert_cmpuint (f (), ==, 1337);
+
+  gum_stalker_unfollow_me (fixture->stalker);
+
+  g_assert_cmpuint (fixture->sink->events->len, >, 0);
+}
+
+TESTCASE (block_counters_should_count_executions)
+{
+  FlatFunc f;
+  BlockCounterLookup lookup;
+
+  f = GUM_POINTER_TO_FUNCPTR (FlatFunc,
+      test_stalker_fixture_dup_code (fixture, flat_code, sizeof (flat_code)));
+
+  fixture->sink->mask = GUM_NOTHING;
+
+  gum_stalker_set_block_counters_enabled (fixture->stalker, TRUE);
+  gum_stalker_follow_me (fixture->stalker, fixture->transformer,
+      GUM_EVENT_SINK (fixture->sink));
+
+  f ();
+  f ();
+  f ();
+
+  lookup.address = f;
+  lookup.count = 0;
+  gum_stalker_enumerate_block_counters (fixture->stalker, find_block_counter,
+      &lookup);
+
+  gum_stalker_unfollow_me (fixture->stalker);
+
+  g_assert_cmpuint (lookup.count, ==, 3);
+}
+
+static gboolean
+find_block_counter (const GumBlockCounterDetails * details,
+                    gpointer user_data)
+{
+  BlockCounterLookup * lookup = user_data;
+
+  if (details->real_start != lookup->address)
+    return TRUE;
+
+  lookup->count = details->count;
+  return FALSE;
+}
+
 static void
 patch_code (gpointer code,
             gconstpointer new_code,
@@ -853,6 +1047,60 @@ probe_func_a_invocation (GumCallDetails * details,
 #endif
 }
 
+static void count_probe_invocation (GumCallDetails * details,
+    gpointer user_data);
+static void count_probe_data_destroy (gpointer data);
+
+TESTCASE (call_probe_should_release_data_once_removed)
+{
+  const guint8 code_template[] =
+  {
+    0xe8, 0x01, 0x00, 0x00, 0x00, /* call func_a */
+    0xc3,                         /* ret         */
+
+    /* func_a: */
+    0xc3,                         /* ret         */
+  };
+  StalkerTestFunc func;
+  guint counts[2] = { 0, 0 };
+  GumProbeId probe_id;
+
+  func = GUM_POINTER_TO_FUNCPTR (StalkerTestFunc,
+      test_stalker_fixture_dup_code (fixture, code_template,
+          sizeof (code_template)));
+
+  probe_id = gum_stalker_add_call_probe (fixture->stalker, fixture->code + 6,
+      count_probe_invocation, counts, count_probe_data_destroy);
+  test_stalker_fixture_follow_and_invoke (fixture, func, 0);
+  test_stalker_fixture_follow_and_invoke (fixture, func, 0);
+  g_assert_cmpuint (counts[0], ==, 2);
+  g_assert_cmpuint (counts[1], ==, 0);
+
+  gum_stalker_remove_call_probe (fixture->stalker, probe_id);
+  g_assert_cmpuint (counts[1], ==, 1);
+
+  test_stalker_fixture_follow_and_invoke (fixture, func, 0);
+  g_assert_cmpuint (counts[0], ==, 2);
+  g_assert_cmpuint (counts[1], ==, 1);
+}
+
+static void
+count_probe_invocation (GumCallDetails * details,
+                        gpointer user_data)
+{
+  guint * counts = user_data;
+
+  counts[0]++;
+}
+
+static void
+count_probe_data_destroy (gpointer data)
+{
+  guint * counts = data;
+
+  counts[1]++;
+}
+
 static const guint8 jumpy_code[] = {
   0x31, 0xc0,                   /* xor eax, eax */
   0xeb, 0x01,                   /* jmp short +1 */
@@ -1203,6 +1451,38 @@ TESTCASE (invalidation_for_specific_thread_should_be_supported)
   g_assert_true (b.finished);
 }
 
+TESTCASE (invalidation_for_range_should_affect_all_threads)
+{
+  TestIsFinishedFunc test_is_finished;
+  InvalidationTarget a, b;
+  GumMemoryRange range;
+
+  test_is_finished = GUM_POINTER_TO_FUNCPTR (TestIsFinishedFunc,
+      test_stalker_fixture_dup_code (fixture, test_is_finished_code,
+          sizeof (test_is_finished_code)));
+
+  start_invalidation_target (&a, test_is_finished, fixture);
+  start_invalidation_target (&b, test_is_finished, fixture);
+
+  range.base_address = GUM_ADDRESS (test_is_finished) +
+      sizeof (test_is_finished_code);
+  range.size = 16;
+  gum_stalker_invalidate_range (fixture->stalker, &range);
+
+  g_usleep (50000);
+  g_assert_false (a.finished);
+  g_assert_false (b.finished);
+
+  range.base_address = GUM_ADDRESS (test_is_finished) + 1;
+  range.size = 1;
+  gum_stalker_invalidate_range (fixture->stalker, &range);
+
+  join_invalidation_target (&a);
+  join_invalidation_target (&b);
+  g_assert_true (a.finished);
+  g_assert_true (b.finished);
+}
+
 static void
 start_invalidation_target (InvalidationTarget * target,
                            gconstpointer target_function,
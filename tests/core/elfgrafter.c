@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gumelfgrafter-priv.h"
+
+#include "testutil.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#define TESTCASE(NAME) \
+    void test_elf_grafter_ ## NAME (void)
+#define TESTENTRY(NAME) \
+    TESTENTRY_SIMPLE ("Core/ElfGrafter", test_elf_grafter, NAME)
+
+#if defined (HAVE_I386)
+# define GUM_TEST_SHLIB_ARCH "x86_64"
+#else
+# define GUM_TEST_SHLIB_ARCH "arm64"
+#endif
+#define GUM_TEST_SHLIB_NAME "targetfunctions-linux-" GUM_TEST_SHLIB_ARCH ".so"
+#define GUM_TEST_HOOKED_FUNCTION "gum_test_target_nop_function_a"
+
+TESTLIST_BEGIN (elfgrafter)
+  TESTENTRY (grafted_module_should_round_trip)
+  TESTENTRY (interceptor_should_claim_grafted_hook)
+TESTLIST_END ()
+
+typedef struct _TestGraftedCopy TestGraftedCopy;
+typedef struct _TestCallCounts TestCallCounts;
+
+struct _TestGraftedCopy
+{
+  gchar * dir;
+  gchar * path;
+};
+
+struct _TestCallCounts
+{
+  guint on_enter;
+  guint on_leave;
+};
+
+static void test_grafted_copy_init (TestGraftedCopy * copy);
+static void test_grafted_copy_graft (TestGraftedCopy * copy);
+static void test_grafted_copy_finalize (TestGraftedCopy * copy);
+static guint32 find_hooked_function_offset (const gchar * path);
+static gboolean store_address_if_hooked_function (
+    const GumExportDetails * details, gpointer user_data);
+static const GumElfGraftedHeader * find_grafted_header (const guint8 * image,
+    gsize size);
+
+static void count_on_enter (GumInvocationContext * context,
+    gpointer user_data);
+static void count_on_leave (GumInvocationContext * context,
+    gpointer user_data);
+
+TESTCASE (grafted_module_should_round_trip)
+{
+  TestGraftedCopy copy;
+  guint32 expected_offset;
+  gchar * contents;
+  gsize length;
+  const GumElfGraftedHeader * header;
+  const GumElfGraftedHook * hook;
+  GumElfGrafter * grafter;
+  GError * error = NULL;
+
+  test_grafted_copy_init (&copy);
+
+  expected_offset = find_hooked_function_offset (copy.path);
+
+  test_grafted_copy_graft (&copy);
+
+  g_assert_true (g_file_get_contents (copy.path, &contents, &length, NULL));
+
+  header = find_grafted_header ((const guint8 *) contents, length);
+  g_assert_nonnull (header);
+  g_assert_cmpuint (header->abi_version, ==, GUM_ELF_GRAFTER_ABI_VERSION);
+  g_assert_cmpuint (header->num_hooks, ==, 1);
+  g_assert_cmpuint (header->num_imports, ==, 0);
+  g_assert_cmphex (header->begin_invocation, ==, 0);
+  g_assert_cmphex (header->end_invocation, ==, 0);
+
+  hook = (const GumElfGraftedHook *) (header + 1);
+  g_assert_cmphex (hook->code_offset, ==, expected_offset);
+  g_assert_cmphex (hook->trampoline_offset, !=, 0);
+  g_assert_cmphex (hook->user_data, ==, 0);
+
+  g_free (contents);
+
+  g_assert_cmphex (find_hooked_function_offset (copy.path), ==,
+      expected_offset);
+
+  grafter = gum_elf_grafter_new_from_file (copy.path,
+      GUM_ELF_GRAFTER_FLAGS_NONE);
+  gum_elf_grafter_add_symbol (grafter, GUM_TEST_HOOKED_FUNCTION);
+  g_assert_false (gum_elf_grafter_graft (grafter, &error));
+  g_assert_error (error, GUM_ERROR, GUM_ERROR_EXISTS);
+  g_clear_error (&error);
+  g_object_unref (grafter);
+
+  test_grafted_copy_finalize (&copy);
+}
+
+TESTCASE (interceptor_should_claim_grafted_hook)
+{
+  TestGraftedCopy copy;
+  void * lib;
+  gpointer (* hooked_function) (gpointer data);
+  guint8 prologue[16];
+  GumInterceptor * interceptor;
+  GumInvocationListener * listener;
+  TestCallCounts counts = { 0, };
+
+  test_grafted_copy_init (&copy);
+  test_grafted_copy_graft (&copy);
+
+  lib = dlopen (copy.path, RTLD_NOW | RTLD_LOCAL);
+  g_assert_nonnull (lib);
+
+  hooked_function = dlsym (lib, GUM_TEST_HOOKED_FUNCTION);
+  g_assert_nonnull (hooked_function);
+
+  g_assert_cmphex (GPOINTER_TO_SIZE (hooked_function (NULL)), ==, 0x1337);
+
+  memcpy (prologue, hooked_function, sizeof (prologue));
+
+  interceptor = gum_interceptor_obtain ();
+  listener = gum_make_call_listener (count_on_enter, count_on_leave, &counts,
+      NULL);
+
+  g_assert_cmpint (gum_interceptor_attach (interceptor, hooked_function,
+      listener, NULL), ==, GUM_ATTACH_OK);
+
+  /* A claimed grafted hook is switched on without touching the code. */
+  g_assert_cmpint (memcmp (hooked_function, prologue, sizeof (prologue)), ==,
+      0);
+
+  g_assert_cmphex (GPOINTER_TO_SIZE (hooked_function (NULL)), ==, 0x1337);
+  g_assert_cmpuint (counts.on_enter, ==, 1);
+  g_assert_cmpuint (counts.on_leave, ==, 1);
+
+  gum_interceptor_detach (interceptor, listener);
+
+  g_assert_cmphex (GPOINTER_TO_SIZE (hooked_function (NULL)), ==, 0x1337);
+  g_assert_cmpuint (counts.on_enter, ==, 1);
+  g_assert_cmpuint (counts.on_leave, ==, 1);
+
+  g_object_unref (listener);
+  g_object_unref (interceptor);
+
+  test_grafted_copy_finalize (&copy);
+}
+
+static void
+test_grafted_copy_init (TestGraftedCopy * copy)
+{
+  gchar * data_dir, * original_path, * contents;
+  gsize length;
+
+  copy->dir = g_dir_make_tmp ("gum-elf-grafter-XXXXXX", NULL);
+  g_assert_nonnull (copy->dir);
+
+  copy->path = g_build_filename (copy->dir, GUM_TEST_SHLIB_NAME, NULL);
+
+  data_dir = test_util_get_data_dir ();
+  original_path = g_build_filename (data_dir, GUM_TEST_SHLIB_NAME, NULL);
+
+  g_assert_true (g_file_get_contents (original_path, &contents, &length,
+      NULL));
+  g_assert_true (g_file_set_contents (copy->path, contents, length, NULL));
+
+  g_free (contents);
+  g_free (original_path);
+  g_free (data_dir);
+}
+
+static void
+test_grafted_copy_graft (TestGraftedCopy * copy)
+{
+  GumElfGrafter * grafter;
+  GError * error = NULL;
+
+  grafter = gum_elf_grafter_new_from_file (copy->path,
+      GUM_ELF_GRAFTER_FLAGS_NONE);
+  gum_elf_grafter_add_symbol (grafter, GUM_TEST_HOOKED_FUNCTION);
+
+  g_assert_true (gum_elf_grafter_graft (grafter, &error));
+  g_assert_no_error (error);
+
+  g_object_unref (grafter);
+}
+
+static void
+test_grafted_copy_finalize (TestGraftedCopy * copy)
+{
+  g_unlink (copy->path);
+  g_rmdir (copy->dir);
+
+  g_free (copy->path);
+  g_free (copy->dir);
+}
+
+static guint32
+find_hooked_function_offset (const gchar * path)
+{
+  GumElfModule * module;
+  GumAddress address = 0;
+
+  module = gum_elf_module_new_from_file (path, NULL);
+  g_assert_nonnull (module);
+
+  gum_elf_module_enumerate_exports (module, store_address_if_hooked_function,
+      &address);
+  g_assert_cmphex (address, !=, 0);
+
+  address -= gum_elf_module_get_preferred_address (module);
+
+  g_object_unref (module);
+
+  return address;
+}
+
+static gboolean
+store_address_if_hooked_function (const GumExportDetails * details,
+                                  gpointer user_data)
+{
+  GumAddress * address = user_data;
+
+  if (strcmp (details->name, GUM_TEST_HOOKED_FUNCTION) != 0)
+    return TRUE;
+
+  *address = details->address;
+
+  return FALSE;
+}
+
+static const GumElfGraftedHeader *
+find_grafted_header (const guint8 * image,
+                     gsize size)
+{
+  const Elf64_Ehdr * ehdr = (const Elf64_Ehdr *) image;
+  const Elf64_Phdr * phdrs;
+  guint i;
+
+  g_assert_cmpuint (ehdr->e_phoff + ehdr->e_phnum * sizeof (Elf64_Phdr), <=,
+      size);
+  phdrs = (const Elf64_Phdr *) (image + ehdr->e_phoff);
+
+  for (i = 0; i != ehdr->e_phnum; i++)
+  {
+    const Elf64_Phdr * phdr = &phdrs[i];
+
+    if (phdr->p_type != GUM_ELF_PHDR_GUM_GRAFTED)
+      continue;
+
+    g_assert_cmpuint (phdr->p_offset + phdr->p_filesz, <=, size);
+    g_assert_cmpuint (phdr->p_filesz, >=, sizeof (GumElfGraftedHeader));
+
+    return (const GumElfGraftedHeader *) (image + phdr->p_offset);
+  }
+
+  return NULL;
+}
+
+static void
+count_on_enter (GumInvocationContext * context,
+                gpointer user_data)
+{
+  TestCallCounts * counts = user_data;
+
+  counts->on_enter++;
+}
+
+static void
+count_on_leave (GumInvocationContext * context,
+                gpointer user_data)
+{
+  TestCallCounts * counts = user_data;
+
+  counts->on_leave++;
+}
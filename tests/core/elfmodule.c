@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "testutil.h"
+
+#include <string.h>
+
+#define TESTCASE(NAME) \
+    void test_elf_module_ ## NAME (void)
+#define TESTENTRY(NAME) \
+    TESTENTRY_SIMPLE ("Core/ElfModule", test_elf_module, NAME)
+
+TESTLIST_BEGIN (elfmodule)
+  TESTENTRY (header_only_module_should_provide_exports)
+  TESTENTRY (header_only_module_should_load_sections_on_demand)
+  TESTENTRY (header_only_module_should_provide_relocations)
+  TESTENTRY (header_only_module_should_provide_symbols)
+TESTLIST_END ()
+
+static GumElfModule * open_main_module (GumElfModuleFlags flags);
+
+static gboolean count_export (const GumExportDetails * details,
+    gpointer user_data);
+static gboolean count_section (const GumElfSectionDetails * details,
+    gpointer user_data);
+static gboolean check_for_text_section (const GumElfSectionDetails * details,
+    gpointer user_data);
+static gboolean count_relocation (const GumElfRelocationDetails * details,
+    gpointer user_data);
+static gboolean count_symbol (const GumElfSymbolDetails * details,
+    gpointer user_data);
+static gboolean count_symbol_with_section (const GumElfSymbolDetails * details,
+    gpointer user_data);
+
+TESTCASE (header_only_module_should_provide_exports)
+{
+  GumElfModule * full, * header_only;
+  guint full_count = 0, header_only_count = 0;
+
+  full = open_main_module (GUM_ELF_MODULE_FLAGS_NONE);
+  header_only = open_main_module (GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
+
+  gum_elf_module_enumerate_exports (full, count_export, &full_count);
+  gum_elf_module_enumerate_exports (header_only, count_export,
+      &header_only_count);
+  g_assert_cmpuint (header_only_count, ==, full_count);
+
+  g_object_unref (header_only);
+  g_object_unref (full);
+}
+
+TESTCASE (header_only_module_should_load_sections_on_demand)
+{
+  GumElfModule * full, * header_only;
+  guint full_count = 0, header_only_count = 0;
+  gboolean found_text = FALSE;
+
+  full = open_main_module (GUM_ELF_MODULE_FLAGS_NONE);
+  header_only = open_main_module (GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
+
+  gum_elf_module_enumerate_sections (full, count_section, &full_count);
+  g_assert_cmpuint (full_count, !=, 0);
+
+  gum_elf_module_enumerate_sections (header_only, count_section,
+      &header_only_count);
+  g_assert_cmpuint (header_only_count, ==, full_count);
+
+  gum_elf_module_enumerate_sections (header_only, check_for_text_section,
+      &found_text);
+  g_assert_true (found_text);
+
+  g_object_unref (header_only);
+  g_object_unref (full);
+}
+
+TESTCASE (header_only_module_should_provide_relocations)
+{
+  GumElfModule * full, * header_only;
+  guint full_count = 0, header_only_count = 0;
+
+  full = open_main_module (GUM_ELF_MODULE_FLAGS_NONE);
+  header_only = open_main_module (GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
+
+  gum_elf_module_enumerate_relocations (full, count_relocation, &full_count);
+  g_assert_cmpuint (full_count, !=, 0);
+
+  gum_elf_module_enumerate_relocations (header_only, count_relocation,
+      &header_only_count);
+  g_assert_cmpuint (header_only_count, ==, full_count);
+
+  g_object_unref (header_only);
+  g_object_unref (full);
+}
+
+TESTCASE (header_only_module_should_provide_symbols)
+{
+  GumElfModule * full, * header_only;
+  guint full_count = 0, header_only_count = 0;
+  guint with_section_count = 0;
+
+  full = open_main_module (GUM_ELF_MODULE_FLAGS_NONE);
+  header_only = open_main_module (GUM_ELF_MODULE_FLAGS_HEADER_ONLY);
+
+  gum_elf_module_enumerate_symbols (full, count_symbol, &full_count);
+  gum_elf_module_enumerate_symbols (header_only, count_symbol,
+      &header_only_count);
+  g_assert_cmpuint (header_only_count, ==, full_count);
+
+  gum_elf_module_enumerate_dynamic_symbols (header_only,
+      count_symbol_with_section, &with_section_count);
+  g_assert_cmpuint (with_section_count, !=, 0);
+
+  g_object_unref (header_only);
+  g_object_unref (full);
+}
+
+static GumElfModule *
+open_main_module (GumElfModuleFlags flags)
+{
+  const GumModuleDetails * main_module;
+  GumElfModule * module;
+  GError * error = NULL;
+
+  main_module = gum_process_get_main_module ();
+
+  module = gum_elf_module_new_from_memory_full (main_module->path,
+      main_module->range->base_address, flags, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (module);
+
+  return module;
+}
+
+static gboolean
+count_export (const GumExportDetails * details,
+              gpointer user_data)
+{
+  guint * count = user_data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+static gboolean
+count_section (const GumElfSectionDetails * details,
+               gpointer user_data)
+{
+  guint * count = user_data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+static gboolean
+check_for_text_section (const GumElfSectionDetails * details,
+                        gpointer user_data)
+{
+  gboolean * found = user_data;
+
+  if (strcmp (details->name, ".text") == 0)
+  {
+    *found = TRUE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+count_relocation (const GumElfRelocationDetails * details,
+                  gpointer user_data)
+{
+  guint * count = user_data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+static gboolean
+count_symbol (const GumElfSymbolDetails * details,
+              gpointer user_data)
+{
+  guint * count = user_data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+static gboolean
+count_symbol_with_section (const GumElfSymbolDetails * details,
+                           gpointer user_data)
+{
+  guint * count = user_data;
+
+  if (details->section != NULL)
+    (*count)++;
+
+  return TRUE;
+}
@@ -26,6 +26,7 @@ TESTLIST_BEGIN (interceptor)
   TESTENTRY (attach_one)
   TESTENTRY (attach_two)
   TESTENTRY (attach_to_recursive_function)
+  TESTENTRY (attach_with_balanced_return_stack)
   TESTENTRY (attach_to_special_function)
 #ifdef G_OS_UNIX
   TESTENTRY (attach_to_pthread_key_create)
@@ -113,6 +114,22 @@ TESTCASE (attach_to_recursive_function)
   g_assert_cmpstr (fixture->result->str, ==, ">>>>>0<1<2<3<4<");
 }
 
+TESTCASE (attach_with_balanced_return_stack)
+{
+  gum_interceptor_set_return_stack_balanced (fixture->interceptor, TRUE);
+
+  interceptor_fixture_attach (fixture, 0, recursive_function, '>', '<');
+  recursive_function (fixture->result, 4);
+  g_assert_cmpstr (fixture->result->str, ==, ">>>>>0<1<2<3<4<");
+
+  g_string_truncate (fixture->result, 0);
+  interceptor_fixture_attach (fixture, 1, target_function, '>', '<');
+  target_function (fixture->result);
+  g_assert_cmpstr (fixture->result->str, ==, ">|<");
+
+  gum_interceptor_set_return_stack_balanced (fixture->interceptor, FALSE);
+}
+
 TESTCASE (attach_to_special_function)
 {
   interceptor_fixture_attach (fixture, 0, special_function, '>', '<');
@@ -26,11 +26,15 @@ TESTLIST_BEGIN (memory)
   TESTENTRY (scan_range_finds_three_wildcarded_matches)
   TESTENTRY (scan_range_finds_three_masked_matches)
   TESTENTRY (scan_range_finds_three_regex_matches)
+  TESTENTRY (scan_range_finds_three_regex_matches_with_literal_prefix)
+  TESTENTRY (scan_range_finds_three_regex_matches_with_inline_options)
+  TESTENTRY (scan_range_finds_no_regex_matches_without_required_literal)
   TESTENTRY (is_memory_readable_handles_mixed_page_protections)
   TESTENTRY (alloc_n_pages_returns_aligned_rw_address)
   TESTENTRY (alloc_n_pages_near_returns_aligned_rw_address_within_range)
   TESTENTRY (allocate_handles_alignment)
   TESTENTRY (allocate_near_handles_alignment)
+  TESTENTRY (allocate_near_handles_huge_page_alignment)
   TESTENTRY (mprotect_handles_page_boundaries)
 TESTLIST_END ()
 
@@ -406,6 +410,90 @@ TESTCASE (scan_range_finds_three_regex_matches)
   gum_match_pattern_unref (pattern);
 }
 
+TESTCASE (scan_range_finds_three_regex_matches_with_literal_prefix)
+{
+  gchar buf[] = "Brainfuck_OR_brainsuckANDbrainluck\nbrainmuck";
+  GumMemoryRange range;
+  GumMatchPattern * pattern;
+  TestForEachContext ctx;
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = sizeof (buf);
+
+  pattern = gum_match_pattern_new_from_string ("/brain[slm]u+ck/");
+  g_assert_nonnull (pattern);
+
+  ctx.number_of_calls = 0;
+  ctx.value_to_return = TRUE;
+
+  ctx.expected_address[0] = buf + sizeof ("Brainfuck_OR_") - 1;
+  ctx.expected_address[1] = buf + sizeof ("Brainfuck_OR_brainsuckAND") - 1;
+  ctx.expected_address[2] = buf +
+      sizeof ("Brainfuck_OR_brainsuckANDbrainluck\n") - 1;
+  ctx.expected_size = 9;
+
+  gum_memory_scan (&range, pattern, match_found_cb, &ctx);
+
+  g_assert_cmpuint (ctx.number_of_calls, ==, 3);
+
+  gum_match_pattern_unref (pattern);
+}
+
+TESTCASE (scan_range_finds_three_regex_matches_with_inline_options)
+{
+  gchar buf[] = "Brainfuck_OR_brainsuckANDbrainluck\nbrainmuck";
+  GumMemoryRange range;
+  GumMatchPattern * pattern;
+  TestForEachContext ctx;
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = sizeof (buf);
+
+  pattern = gum_match_pattern_new_from_string ("/(?^i)BRAIN[SLM]UCK/");
+  g_assert_nonnull (pattern);
+
+  ctx.number_of_calls = 0;
+  ctx.value_to_return = TRUE;
+
+  ctx.expected_address[0] = buf + sizeof ("Brainfuck_OR_") - 1;
+  ctx.expected_address[1] = buf + sizeof ("Brainfuck_OR_brainsuckAND") - 1;
+  ctx.expected_address[2] = buf +
+      sizeof ("Brainfuck_OR_brainsuckANDbrainluck\n") - 1;
+  ctx.expected_size = 9;
+
+  gum_memory_scan (&range, pattern, match_found_cb, &ctx);
+
+  g_assert_cmpuint (ctx.number_of_calls, ==, 3);
+
+  gum_match_pattern_unref (pattern);
+}
+
+TESTCASE (scan_range_finds_no_regex_matches_without_required_literal)
+{
+  gchar buf[] = "Brainfuck_OR_brainsuckANDbrainluck\nbrainmuck";
+  GumMemoryRange range;
+  GumMatchPattern * pattern;
+  TestForEachContext ctx;
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = sizeof (buf);
+
+  ctx.number_of_calls = 0;
+  ctx.value_to_return = TRUE;
+
+  pattern = gum_match_pattern_new_from_string ("/[Bb]rain[fsm]..k_NOT/");
+  g_assert_nonnull (pattern);
+  gum_memory_scan (&range, pattern, match_found_cb, &ctx);
+  gum_match_pattern_unref (pattern);
+
+  pattern = gum_match_pattern_new_from_string ("/bra(in)?xyzzy/");
+  g_assert_nonnull (pattern);
+  gum_memory_scan (&range, pattern, match_found_cb, &ctx);
+  gum_match_pattern_unref (pattern);
+
+  g_assert_cmpuint (ctx.number_of_calls, ==, 0);
+}
+
 TESTCASE (is_memory_readable_handles_mixed_page_protections)
 {
   guint8 * pages;
@@ -538,6 +626,33 @@ TESTCASE (allocate_near_handles_alignment)
   gum_memory_free (page, size);
 }
 
+TESTCASE (allocate_near_handles_huge_page_alignment)
+{
+  GumAddressSpec as;
+  guint variable_on_stack;
+  gsize huge_page_size, size;
+  gpointer mem;
+
+  huge_page_size = gum_query_huge_page_size ();
+  if (huge_page_size == 0)
+  {
+    g_print ("<skipping, not available> ");
+    return;
+  }
+
+  as.near_address = &variable_on_stack;
+  as.max_distance = G_MAXINT32;
+
+  size = 2 * huge_page_size;
+
+  mem = gum_memory_allocate_near (&as, size, huge_page_size, GUM_PAGE_RW);
+  g_assert_nonnull (mem);
+  g_assert_cmpuint (GPOINTER_TO_SIZE (mem) % huge_page_size, ==, 0);
+  g_assert_true (gum_memory_advise_huge_pages (mem, size));
+
+  gum_memory_free (mem, size);
+}
+
 TESTCASE (mprotect_handles_page_boundaries)
 {
   guint8 * pages;
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "testutil.h"
+
+#define TESTCASE(NAME) \
+    void test_memory_snapshot_ ## NAME (void)
+#define TESTENTRY(NAME) \
+    TESTENTRY_SIMPLE ("Core/MemorySnapshot", test_memory_snapshot, NAME)
+
+TESTLIST_BEGIN (memorysnapshot)
+  TESTENTRY (restore_should_roll_back_dirty_pages)
+  TESTENTRY (restore_should_keep_tracking_pages)
+  TESTENTRY (pages_outside_snapshot_should_not_be_tracked)
+  TESTENTRY (default_snapshot_should_cover_anonymous_memory)
+TESTLIST_END ()
+
+TESTCASE (restore_should_roll_back_dirty_pages)
+{
+  guint page_size;
+  volatile guint8 * pages;
+  GumMemoryRange range;
+  GumMemorySnapshot * snapshot;
+  GError * error = NULL;
+
+  page_size = gum_query_page_size ();
+  pages = gum_memory_allocate (NULL, 3 * page_size, page_size, GUM_PAGE_RW);
+  pages[0] = 0x13;
+  pages[page_size] = 0x37;
+  pages[2 * page_size] = 0x42;
+
+  range.base_address = GUM_ADDRESS (pages);
+  range.size = 3 * page_size;
+  snapshot = gum_memory_snapshot_new (&range, 1, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (snapshot);
+
+  g_assert_cmpuint (gum_memory_snapshot_restore (snapshot), ==, 0);
+
+  pages[0] = 0xaa;
+  pages[1] = 0xbb;
+  pages[2 * page_size] = 0xcc;
+  g_assert_cmphex (pages[0], ==, 0xaa);
+  g_assert_cmphex (pages[2 * page_size], ==, 0xcc);
+
+  g_assert_cmpuint (gum_memory_snapshot_restore (snapshot), ==, 2);
+  g_assert_cmphex (pages[0], ==, 0x13);
+  g_assert_cmphex (pages[1], ==, 0x00);
+  g_assert_cmphex (pages[page_size], ==, 0x37);
+  g_assert_cmphex (pages[2 * page_size], ==, 0x42);
+
+  g_object_unref (snapshot);
+
+  pages[0] = 0x55;
+  g_assert_cmphex (pages[0], ==, 0x55);
+
+  gum_memory_free ((gpointer) pages, 3 * page_size);
+}
+
+TESTCASE (restore_should_keep_tracking_pages)
+{
+  guint page_size, i;
+  volatile guint32 * counter;
+  GumMemoryRange range;
+  GumMemorySnapshot * snapshot;
+
+  page_size = gum_query_page_size ();
+  counter = gum_memory_allocate (NULL, page_size, page_size, GUM_PAGE_RW);
+  *counter = 1;
+
+  range.base_address = GUM_ADDRESS (counter);
+  range.size = page_size;
+  snapshot = gum_memory_snapshot_new (&range, 1, NULL);
+
+  for (i = 0; i != 3; i++)
+  {
+    *counter += 41;
+    g_assert_cmpuint (*counter, ==, 42);
+
+    g_assert_cmpuint (gum_memory_snapshot_restore (snapshot), ==, 1);
+    g_assert_cmpuint (*counter, ==, 1);
+  }
+
+  g_object_unref (snapshot);
+
+  gum_memory_free ((gpointer) counter, page_size);
+}
+
+TESTCASE (pages_outside_snapshot_should_not_be_tracked)
+{
+  guint page_size;
+  volatile guint8 * pages;
+  GumMemoryRange range;
+  GumMemorySnapshot * snapshot;
+
+  page_size = gum_query_page_size ();
+  pages = gum_memory_allocate (NULL, 2 * page_size, page_size, GUM_PAGE_RW);
+
+  range.base_address = GUM_ADDRESS (pages + page_size);
+  range.size = 1;
+  snapshot = gum_memory_snapshot_new (&range, 1, NULL);
+
+  pages[0] = 0x13;
+  pages[page_size + 1] = 0x37;
+
+  g_assert_cmpuint (gum_memory_snapshot_restore (snapshot), ==, 1);
+  g_assert_cmphex (pages[0], ==, 0x13);
+  g_assert_cmphex (pages[page_size + 1], ==, 0x00);
+
+  g_object_unref (snapshot);
+
+  gum_memory_free ((gpointer) pages, 2 * page_size);
+}
+
+TESTCASE (default_snapshot_should_cover_anonymous_memory)
+{
+  guint page_size;
+  volatile guint8 * pages;
+  GumMemorySnapshot * snapshot;
+  GError * error = NULL;
+  gpointer block;
+
+  page_size = gum_query_page_size ();
+  pages = gum_memory_allocate (NULL, page_size, page_size, GUM_PAGE_RW);
+  pages[0] = 0x13;
+
+  snapshot = gum_memory_snapshot_new (NULL, 0, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (snapshot);
+
+  pages[0] = 0x37;
+  g_assert_cmphex (pages[0], ==, 0x37);
+
+  block = g_malloc0 (page_size);
+  g_free (block);
+
+  g_assert_cmpuint (gum_memory_snapshot_restore (snapshot), >=, 1);
+  g_assert_cmphex (pages[0], ==, 0x13);
+
+  g_object_unref (snapshot);
+
+  pages[0] = 0x42;
+  g_assert_cmphex (pages[0], ==, 0x42);
+
+  gum_memory_free ((gpointer) pages, page_size);
+}
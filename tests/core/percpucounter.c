@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "testutil.h"
+
+#define TESTCASE(NAME) \
+    void test_per_cpu_counter_ ## NAME (void)
+#define TESTENTRY(NAME) \
+    TESTENTRY_SIMPLE ("Core/PerCpuCounter", test_per_cpu_counter, NAME)
+
+#define ADDS_PER_THREAD 100000
+
+TESTLIST_BEGIN (percpucounter)
+  TESTENTRY (read_should_return_sum_of_adds)
+  TESTENTRY (concurrent_adds_should_not_be_lost)
+TESTLIST_END ()
+
+static gpointer add_repeatedly (gpointer data);
+
+TESTCASE (read_should_return_sum_of_adds)
+{
+  GumPerCpuCounter * counter;
+
+  counter = gum_per_cpu_counter_new ();
+  g_assert_cmpuint (gum_per_cpu_counter_read (counter), ==, 0);
+
+  gum_per_cpu_counter_add (counter, 1);
+  gum_per_cpu_counter_add (counter, 41);
+  g_assert_cmpuint (gum_per_cpu_counter_read (counter), ==, 42);
+
+  gum_per_cpu_counter_free (counter);
+}
+
+TESTCASE (concurrent_adds_should_not_be_lost)
+{
+  GumPerCpuCounter * counter;
+  GThread * threads[4];
+  guint i;
+
+  counter = gum_per_cpu_counter_new ();
+
+  for (i = 0; i != G_N_ELEMENTS (threads); i++)
+  {
+    threads[i] = g_thread_new ("per-cpu-counter-test", add_repeatedly,
+        counter);
+  }
+  add_repeatedly (counter);
+
+  for (i = 0; i != G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+
+  g_assert_cmpuint (gum_per_cpu_counter_read (counter), ==,
+      (G_N_ELEMENTS (threads) + 1) * ADDS_PER_THREAD);
+
+  gum_per_cpu_counter_free (counter);
+}
+
+static gpointer
+add_repeatedly (gpointer data)
+{
+  GumPerCpuCounter * counter = data;
+  guint i;
+
+  for (i = 0; i != ADDS_PER_THREAD; i++)
+    gum_per_cpu_counter_add (counter, 1);
+
+  return NULL;
+}
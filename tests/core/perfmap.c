@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "testutil.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define TESTCASE(NAME) \
+    void test_perf_map_ ## NAME (void)
+#define TESTENTRY(NAME) \
+    TESTENTRY_SIMPLE ("Core/PerfMap", test_perf_map, NAME)
+
+TESTLIST_BEGIN (perfmap)
+  TESTENTRY (map_should_contain_one_line_per_entry)
+  TESTENTRY (jitdump_should_contain_header_and_code_load)
+  TESTENTRY (entries_should_be_ignored_when_closed)
+  TESTENTRY (opening_twice_should_fail)
+TESTLIST_END ()
+
+static gchar * make_temporary_path (void);
+
+TESTCASE (map_should_contain_one_line_per_entry)
+{
+  gchar * path, * contents;
+  const gchar * expected;
+  GError * error = NULL;
+
+  path = make_temporary_path ();
+
+  g_assert_true (gum_perf_map_open (GUM_PERF_MAP_FORMAT_MAP, path, &error));
+  g_assert_no_error (error);
+  g_assert_true (gum_perf_map_is_open ());
+
+  gum_perf_map_add_code (GSIZE_TO_POINTER (0x1000), 0x20, "[stalker] open");
+  gum_perf_map_add_code (GSIZE_TO_POINTER (0x2000), 0x0, "[stalker] empty");
+  gum_perf_map_add_code (GSIZE_TO_POINTER (0xabc0), 0x18, "[interceptor] f");
+  gum_perf_map_close ();
+  g_assert_false (gum_perf_map_is_open ());
+
+  g_assert_true (g_file_get_contents (path, &contents, NULL, NULL));
+  expected = "1000 20 [stalker] open\n"
+      "abc0 18 [interceptor] f\n";
+  g_assert_cmpstr (contents, ==, expected);
+  g_free (contents);
+
+  g_unlink (path);
+  g_free (path);
+}
+
+TESTCASE (jitdump_should_contain_header_and_code_load)
+{
+  const guint8 code[] = { 0xc3, 0x90, 0x90, 0xcc };
+  const gchar * name = "[stalker] dummy";
+  gchar * path, * contents;
+  gsize length, record_size;
+  GError * error = NULL;
+  guint32 value;
+  guint64 code_size;
+  const gchar * record;
+
+  path = make_temporary_path ();
+
+  g_assert_true (gum_perf_map_open (GUM_PERF_MAP_FORMAT_JITDUMP, path,
+      &error));
+  g_assert_no_error (error);
+  gum_perf_map_add_code (code, sizeof (code), name);
+  gum_perf_map_close ();
+
+  g_assert_true (g_file_get_contents (path, &contents, &length, NULL));
+
+  record_size = 56 + strlen (name) + 1 + sizeof (code);
+  g_assert_cmpuint (length, ==, 40 + record_size);
+
+  memcpy (&value, contents + 0, sizeof (value));
+  g_assert_cmphex (value, ==, 0x4a695444);
+  memcpy (&value, contents + 4, sizeof (value));
+  g_assert_cmpuint (value, ==, 1);
+  memcpy (&value, contents + 8, sizeof (value));
+  g_assert_cmpuint (value, ==, 40);
+  memcpy (&value, contents + 20, sizeof (value));
+  g_assert_cmpuint (value, ==, gum_process_get_id ());
+
+  record = contents + 40;
+  memcpy (&value, record + 0, sizeof (value));
+  g_assert_cmpuint (value, ==, 0);
+  memcpy (&value, record + 4, sizeof (value));
+  g_assert_cmpuint (value, ==, record_size);
+  memcpy (&code_size, record + 40, sizeof (code_size));
+  g_assert_cmpuint (code_size, ==, sizeof (code));
+  g_assert_cmpstr (record + 56, ==, name);
+  g_assert_cmpint (memcmp (record + 56 + strlen (name) + 1, code,
+      sizeof (code)), ==, 0);
+
+  g_free (contents);
+
+  g_unlink (path);
+  g_free (path);
+}
+
+TESTCASE (entries_should_be_ignored_when_closed)
+{
+  gchar * path, * contents;
+  GError * error = NULL;
+
+  path = make_temporary_path ();
+
+  gum_perf_map_add_code (GSIZE_TO_POINTER (0x1000), 0x20, "before");
+  g_assert_true (gum_perf_map_open (GUM_PERF_MAP_FORMAT_MAP, path, &error));
+  g_assert_no_error (error);
+  gum_perf_map_close ();
+  gum_perf_map_add_code (GSIZE_TO_POINTER (0x1000), 0x20, "after");
+
+  g_assert_true (g_file_get_contents (path, &contents, NULL, NULL));
+  g_assert_cmpstr (contents, ==, "");
+  g_free (contents);
+
+  g_unlink (path);
+  g_free (path);
+}
+
+TESTCASE (opening_twice_should_fail)
+{
+  gchar * path;
+  GError * error = NULL;
+
+  path = make_temporary_path ();
+
+  g_assert_true (gum_perf_map_open (GUM_PERF_MAP_FORMAT_MAP, path, &error));
+  g_assert_no_error (error);
+
+  g_assert_false (gum_perf_map_open (GUM_PERF_MAP_FORMAT_JITDUMP, path,
+      &error));
+  g_assert_error (error, GUM_ERROR, GUM_ERROR_EXISTS);
+  g_clear_error (&error);
+
+  gum_perf_map_close ();
+
+  g_unlink (path);
+  g_free (path);
+}
+
+static gchar *
+make_temporary_path (void)
+{
+  gchar * path;
+  gint fd;
+
+  fd = g_file_open_tmp ("gum-perf-map-XXXXXX", &path, NULL);
+  g_assert_cmpint (fd, !=, -1);
+  g_close (fd, NULL);
+
+  return path;
+}
@@ -52,6 +52,7 @@ TESTLIST_BEGIN (script)
 
   TESTGROUP_BEGIN ("Interceptor")
     TESTENTRY (argument_can_be_read)
+    TESTENTRY (argument_predicates_can_filter_calls)
     TESTENTRY (argument_can_be_replaced)
     TESTENTRY (return_value_can_be_read)
     TESTENTRY (return_value_can_be_replaced)
@@ -166,6 +167,7 @@ TESTLIST_BEGIN (script)
     TESTENTRY (ansi_string_can_be_allocated_in_code_page_1252)
 #endif
     TESTENTRY (invalid_read_results_in_exception)
+    TESTENTRY (invalid_read_after_optimization_results_in_exception)
     TESTENTRY (invalid_write_results_in_exception)
     TESTENTRY (invalid_read_write_execute_results_in_exception)
     TESTENTRY (memory_can_be_scanned_with_pattern_string)
@@ -438,6 +440,8 @@ TESTLIST_BEGIN (script)
     TESTENTRY (execution_can_be_traced)
     TESTENTRY (execution_can_be_traced_with_custom_transformer)
     TESTENTRY (execution_can_be_traced_with_faulty_transformer)
+    TESTENTRY (execution_can_be_traced_with_transform_rules)
+    TESTENTRY (execution_can_be_traced_with_high_water_mark)
     TESTENTRY (execution_can_be_traced_during_immediate_native_function_call)
     TESTENTRY (execution_can_be_traced_during_scheduled_native_function_call)
     TESTENTRY (execution_can_be_traced_after_native_function_call_from_hook)
@@ -559,6 +563,7 @@ static void on_read_ready (GObject * source_object, GAsyncResult * res,
     gpointer user_data);
 
 #if defined (HAVE_I386) || defined (HAVE_ARM) || defined (HAVE_ARM64)
+static gpointer run_stalked_through_counted_function (gpointer data);
 static gpointer run_stalked_through_hooked_function (gpointer data);
 static gpointer run_stalked_through_block_invalidated_in_callout (
     gpointer data);
@@ -4396,6 +4401,142 @@ TESTCASE (execution_can_be_traced_with_faulty_transformer)
       !gum_stalker_is_following_me (gum_script_get_stalker (fixture->script)));
 }
 
+TESTCASE (execution_can_be_traced_with_transform_rules)
+{
+  StalkerDummyChannel channel;
+  GThread * thread;
+  GumThreadId thread_id;
+
+#if defined (HAVE_QNX) || defined (__ARM_PCS_VFP)
+  if (!g_test_slow ())
+  {
+    g_print ("<skipping, run in slow mode> ");
+    return;
+  }
+#endif
+
+  sdc_init (&channel);
+
+  thread = g_thread_new ("stalker-test-target",
+      run_stalked_through_counted_function, &channel);
+  thread_id = sdc_await_thread_id (&channel);
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "const targetThreadId = %" G_GSIZE_FORMAT ";"
+      "const targetFuncInt = " GUM_PTR_CONST ";"
+      "const targetEntry = targetFuncInt.sub(targetFuncInt.and(1));"
+
+      "try {"
+      "  Stalker.follow(targetThreadId, {"
+      "    transform: [{ mnemonic: 'ret' }]"
+      "  });"
+      "} catch (e) {"
+      "  send(e.message);"
+      "}"
+
+      "const calls = Memory.alloc(8);"
+      "Stalker.follow(targetThreadId, {"
+      "  transform: [{"
+      "    ranges: [{ base: targetEntry, size: 1 }],"
+      "    count: calls"
+      "  }]"
+      "});"
+
+      "recv('stop', message => {"
+      "  Stalker.unfollow(targetThreadId);"
+      "  send(calls.readU64().toNumber());"
+      "});"
+
+      "send('ready');",
+
+      thread_id,
+      target_function_int);
+  EXPECT_SEND_MESSAGE_WITH (
+      "\"each rule must specify exactly one of count or callout\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"ready\"");
+  EXPECT_NO_MESSAGES ();
+
+  sdc_put_follow_confirmation (&channel);
+  sdc_await_run_confirmation (&channel);
+
+  POST_MESSAGE ("{\"type\":\"stop\"}");
+  EXPECT_SEND_MESSAGE_WITH ("3");
+  EXPECT_NO_MESSAGES ();
+
+  sdc_put_finish_confirmation (&channel);
+
+  g_thread_join (thread);
+
+  sdc_finalize (&channel);
+}
+
+static gpointer
+run_stalked_through_counted_function (gpointer data)
+{
+  StalkerDummyChannel * channel = data;
+
+  sdc_put_thread_id (channel, gum_process_get_current_thread_id ());
+
+  sdc_await_follow_confirmation (channel);
+
+  target_function_int (1);
+  target_function_int (2);
+  target_function_int (3);
+
+  sdc_put_run_confirmation (channel);
+
+  sdc_await_finish_confirmation (channel);
+
+  return NULL;
+}
+
+TESTCASE (execution_can_be_traced_with_high_water_mark)
+{
+  GumThreadId test_thread_id;
+
+#ifdef __ARM_PCS_VFP
+  if (!g_test_slow ())
+  {
+    g_print ("<skipping, run in slow mode> ");
+    return;
+  }
+#endif
+
+  test_thread_id = gum_process_get_current_thread_id ();
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "Stalker.queueDrainInterval = 60000;"
+      "Stalker.queueHighWaterMark = 16;"
+      "const testsRange = Process.getModuleByName('%s');"
+      "Stalker.exclude(testsRange);"
+
+      "let received = false;"
+      "Stalker.follow(%" G_GSIZE_FORMAT ", {"
+      "  events: {"
+      "    call: true,"
+      "    ret: true"
+      "  },"
+      "  onReceive(events) {"
+      "    if (!received) {"
+      "      received = true;"
+      "      send('onReceive: ' + (events.byteLength > 0));"
+      "    }"
+      "  }"
+      "});"
+
+      "recv('stop', message => {"
+      "  Stalker.unfollow(%" G_GSIZE_FORMAT ");"
+      "});",
+
+      GUM_TESTS_MODULE_NAME,
+      test_thread_id,
+      test_thread_id);
+  EXPECT_SEND_MESSAGE_WITH ("\"onReceive: true\"");
+
+  POST_MESSAGE ("{\"type\":\"stop\"}");
+  EXPECT_NO_MESSAGES ();
+}
+
 TESTCASE (execution_can_be_traced_during_immediate_native_function_call)
 {
   COMPILE_AND_LOAD_SCRIPT (
@@ -6517,6 +6658,54 @@ TESTCASE (argument_can_be_read)
   EXPECT_SEND_MESSAGE_WITH ("-42");
 }
 
+TESTCASE (argument_predicates_can_filter_calls)
+{
+  COMPILE_AND_LOAD_SCRIPT (
+      "Interceptor.attach(" GUM_PTR_CONST ", {"
+      "  when: [{ arg: 0, in: [7, 42] }],"
+      "  onEnter(args) {"
+      "    send(args[0].toInt32());"
+      "  },"
+      "  onLeave(retval) {"
+      "    send('leave');"
+      "  }"
+      "});", target_function_int);
+
+  EXPECT_NO_MESSAGES ();
+
+  target_function_int (1);
+  target_function_int (-42);
+  EXPECT_NO_MESSAGES ();
+
+  target_function_int (42);
+  EXPECT_SEND_MESSAGE_WITH ("42");
+  EXPECT_SEND_MESSAGE_WITH ("\"leave\"");
+  EXPECT_NO_MESSAGES ();
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "Interceptor.attach(" GUM_PTR_CONST ", {"
+      "  when: [{ arg: 0, equals: -42, type: 'int' }],"
+      "  onEnter(args) {"
+      "    send(args[0].toInt32());"
+      "  }"
+      "});", target_function_int);
+
+  target_function_int (42);
+  EXPECT_NO_MESSAGES ();
+
+  target_function_int (-42);
+  EXPECT_SEND_MESSAGE_WITH ("-42");
+  EXPECT_NO_MESSAGES ();
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "Interceptor.attach(" GUM_PTR_CONST ", {"
+      "  when: [{ arg: 0, bogus: 1 }],"
+      "  onEnter(args) {}"
+      "});", target_function_int);
+  EXPECT_ERROR_MESSAGE_WITH (ANY_LINE_NUMBER,
+      "Error: expected one of equals, in, mask, or startsWith");
+}
+
 TESTCASE (argument_can_be_replaced)
 {
   COMPILE_AND_LOAD_SCRIPT (
@@ -8801,6 +8990,32 @@ TESTCASE (ansi_string_can_be_allocated_in_code_page_1252)
 
 #endif
 
+TESTCASE (invalid_read_after_optimization_results_in_exception)
+{
+  guint32 values[] = { 1, 2, 3, 4 };
+
+  if (!check_exception_handling_testable ())
+    return;
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "const values = " GUM_PTR_CONST ";"
+      "function sum(p) {"
+      "  let total = 0;"
+      "  for (let i = 0; i !== 4; i++)"
+      "    total += p.isNull() ? 0 : p.add(i * 4).readU32();"
+      "  return total;"
+      "}"
+      "let total = 0;"
+      "for (let i = 0; i !== 100000; i++)"
+      "  total = sum(values);"
+      "send(total);"
+      "sum(ptr('1328'));",
+      values);
+  EXPECT_SEND_MESSAGE_WITH ("10");
+  EXPECT_ERROR_MESSAGE_WITH (ANY_LINE_NUMBER,
+      "Error: access violation accessing 0x530");
+}
+
 TESTCASE (invalid_read_results_in_exception)
 {
   const gchar * type_name[] = {
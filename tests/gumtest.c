@@ -179,8 +179,16 @@ main (gint argc, gchar * argv[])
   TESTLIST_REGISTER (testutil);
   TESTLIST_REGISTER (tls);
   TESTLIST_REGISTER (cloak);
+  TESTLIST_REGISTER (perfmap);
   TESTLIST_REGISTER (memory);
   TESTLIST_REGISTER (process);
+#ifdef HAVE_ELF
+  TESTLIST_REGISTER (elfmodule);
+#endif
+#if defined (HAVE_LINUX) && !defined (HAVE_ANDROID) && \
+    (defined (HAVE_I386) || defined (HAVE_ARM64)) && GLIB_SIZEOF_VOID_P == 8
+  TESTLIST_REGISTER (elfgrafter);
+#endif
 #if !defined (HAVE_QNX) && !(defined (HAVE_ANDROID) && defined (HAVE_ARM64))
   TESTLIST_REGISTER (symbolutil);
 #endif
@@ -210,6 +218,8 @@ main (gint argc, gchar * argv[])
   TESTLIST_REGISTER (interceptor_arm64);
 #endif
   TESTLIST_REGISTER (memoryaccessmonitor);
+  TESTLIST_REGISTER (memorysnapshot);
+  TESTLIST_REGISTER (percpucounter);
 
   if (gum_stalker_is_supported ())
   {
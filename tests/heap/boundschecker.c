@@ -17,6 +17,8 @@ TESTLIST_BEGIN (boundschecker)
   TESTENTRY (protected_after_free)
   TESTENTRY (calloc_initializes_to_zero)
   TESTENTRY (custom_front_alignment)
+  TESTENTRY (sampling_guards_a_fraction_of_allocations)
+  TESTENTRY (pool_grows_up_to_max_pool_size)
 #ifndef HAVE_QNX
   TESTENTRY (output_report_on_access_beyond_end)
   TESTENTRY (output_report_on_access_after_free)
@@ -228,3 +230,46 @@ TESTCASE (custom_front_alignment)
 
   g_assert_true (exception_on_read && exception_on_write);
 }
+
+TESTCASE (sampling_guards_a_fraction_of_allocations)
+{
+  guint8 * blocks[4];
+  guint i, n_guarded;
+
+  g_object_set (fixture->checker, "sample-rate", 2, NULL);
+
+  ATTACH_CHECKER ();
+  for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+    blocks[i] = (guint8 *) malloc (16);
+  n_guarded = 0;
+  for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+  {
+    if (!gum_memory_is_readable (blocks[i] + 16, 1))
+      n_guarded++;
+  }
+  for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+    free (blocks[i]);
+  DETACH_CHECKER ();
+
+  g_assert_cmpuint (n_guarded, ==, 2);
+}
+
+TESTCASE (pool_grows_up_to_max_pool_size)
+{
+  guint8 * blocks[4];
+  guint i;
+
+  g_object_set (fixture->checker,
+      "pool-size", 2,
+      "max-pool-size", 8,
+      NULL);
+
+  ATTACH_CHECKER ();
+  for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+    blocks[i] = (guint8 *) malloc (16);
+  for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+    g_assert_false (gum_memory_is_readable (blocks[i] + 16, 1));
+  for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+    free (blocks[i]);
+  DETACH_CHECKER ();
+}
@@ -82,7 +82,7 @@ static void
 test_profile_report_fixture_teardown (TestProfileReportFixture * fixture,
                                       gconstpointer data)
 {
-  g_object_unref (fixture->report);
+  g_clear_object (&fixture->report);
   g_object_unref (fixture->sampler);
   g_object_unref (fixture->profiler);
 }
@@ -190,6 +190,353 @@ assert_same_xml (TestProfileReportFixture * fixture,
   g_free (generated_xml);
 }
 
+static void
+append_to_string (gconstpointer data,
+                  gsize size,
+                  gpointer user_data)
+{
+  GString * output = user_data;
+
+  g_string_append_len (output, data, size);
+}
+
+/*
+ * Just enough of a protobuf decoder to check the structure of what
+ * gum_profiler_emit_pprof() produces.
+ */
+
+typedef struct _TestPprofProfile TestPprofProfile;
+typedef struct _TestPprofFunction TestPprofFunction;
+typedef struct _TestPprofLocation TestPprofLocation;
+typedef struct _TestPprofSample TestPprofSample;
+
+struct _TestPprofProfile
+{
+  GPtrArray * strings;
+  GArray * functions;
+  GArray * locations;
+  GArray * samples;
+};
+
+struct _TestPprofFunction
+{
+  guint64 id;
+  guint64 name;
+};
+
+struct _TestPprofLocation
+{
+  guint64 id;
+  guint64 address;
+  guint64 function_id;
+};
+
+struct _TestPprofSample
+{
+  GArray * location_ids;
+  GArray * values;
+};
+
+static guint64
+test_pb_read_varint (const guint8 ** cursor,
+                     const guint8 * end)
+{
+  guint64 value = 0;
+  guint shift = 0;
+  guint8 b;
+
+  do
+  {
+    g_assert_true (*cursor != end);
+    g_assert_cmpuint (shift, <, 64);
+
+    b = *(*cursor)++;
+    value |= (guint64) (b & 0x7f) << shift;
+    shift += 7;
+  }
+  while ((b & 0x80) != 0);
+
+  return value;
+}
+
+static guint
+test_pb_read_field (const guint8 ** cursor,
+                    const guint8 * end,
+                    guint64 * value,
+                    const guint8 ** data,
+                    gsize * size)
+{
+  guint64 key;
+
+  key = test_pb_read_varint (cursor, end);
+
+  switch (key & 7)
+  {
+    case 0:
+      *value = test_pb_read_varint (cursor, end);
+      *data = NULL;
+      *size = 0;
+      break;
+    case 2:
+      *size = test_pb_read_varint (cursor, end);
+      g_assert_cmpuint (*size, <=, end - *cursor);
+      *data = *cursor;
+      *cursor += *size;
+      *value = 0;
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+
+  return key >> 3;
+}
+
+static void
+test_pb_read_repeated_varint (guint64 value,
+                              const guint8 * data,
+                              gsize size,
+                              GArray * values)
+{
+  const guint8 * end;
+
+  if (data == NULL)
+  {
+    g_array_append_val (values, value);
+    return;
+  }
+
+  for (end = data + size; data != end;)
+  {
+    value = test_pb_read_varint (&data, end);
+    g_array_append_val (values, value);
+  }
+}
+
+static TestPprofProfile *
+test_pprof_profile_parse (const gchar * data,
+                          gsize size)
+{
+  TestPprofProfile * profile;
+  const guint8 * cursor, * end;
+
+  profile = g_slice_new (TestPprofProfile);
+  profile->strings = g_ptr_array_new_with_free_func (g_free);
+  profile->functions = g_array_new (FALSE, FALSE, sizeof (TestPprofFunction));
+  profile->locations = g_array_new (FALSE, FALSE, sizeof (TestPprofLocation));
+  profile->samples = g_array_new (FALSE, FALSE, sizeof (TestPprofSample));
+
+  cursor = (const guint8 *) data;
+  end = cursor + size;
+
+  while (cursor != end)
+  {
+    guint field;
+    guint64 value;
+    const guint8 * field_data, * field_cursor, * field_end;
+    gsize field_size;
+
+    field = test_pb_read_field (&cursor, end, &value, &field_data,
+        &field_size);
+    field_cursor = field_data;
+    field_end = field_data + field_size;
+
+    switch (field)
+    {
+      case 2:
+      {
+        TestPprofSample sample;
+
+        sample.location_ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+        sample.values = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+        while (field_cursor != field_end)
+        {
+          const guint8 * d;
+          gsize n;
+
+          switch (test_pb_read_field (&field_cursor, field_end, &value, &d,
+              &n))
+          {
+            case 1:
+              test_pb_read_repeated_varint (value, d, n, sample.location_ids);
+              break;
+            case 2:
+              test_pb_read_repeated_varint (value, d, n, sample.values);
+              break;
+          }
+        }
+
+        g_array_append_val (profile->samples, sample);
+
+        break;
+      }
+      case 4:
+      {
+        TestPprofLocation location = { 0, };
+
+        while (field_cursor != field_end)
+        {
+          const guint8 * d;
+          gsize n;
+
+          switch (test_pb_read_field (&field_cursor, field_end, &value, &d,
+              &n))
+          {
+            case 1:
+              location.id = value;
+              break;
+            case 3:
+              location.address = value;
+              break;
+            case 4:
+            {
+              const guint8 * line_end = d + n;
+
+              while (d != line_end)
+              {
+                const guint8 * line_data;
+                gsize line_size;
+
+                if (test_pb_read_field (&d, line_end, &value, &line_data,
+                    &line_size) == 1)
+                {
+                  location.function_id = value;
+                }
+              }
+
+              break;
+            }
+          }
+        }
+
+        g_array_append_val (profile->locations, location);
+
+        break;
+      }
+      case 5:
+      {
+        TestPprofFunction function = { 0, };
+
+        while (field_cursor != field_end)
+        {
+          const guint8 * d;
+          gsize n;
+
+          switch (test_pb_read_field (&field_cursor, field_end, &value, &d,
+              &n))
+          {
+            case 1:
+              function.id = value;
+              break;
+            case 2:
+              function.name = value;
+              break;
+          }
+        }
+
+        g_array_append_val (profile->functions, function);
+
+        break;
+      }
+      case 6:
+        g_ptr_array_add (profile->strings,
+            g_strndup ((const gchar *) field_data, field_size));
+        break;
+      default:
+        break;
+    }
+  }
+
+  return profile;
+}
+
+static void
+test_pprof_profile_free (TestPprofProfile * profile)
+{
+  guint i;
+
+  for (i = 0; i != profile->samples->len; i++)
+  {
+    TestPprofSample * sample =
+        &g_array_index (profile->samples, TestPprofSample, i);
+
+    g_array_unref (sample->values);
+    g_array_unref (sample->location_ids);
+  }
+  g_array_unref (profile->samples);
+  g_array_unref (profile->locations);
+  g_array_unref (profile->functions);
+  g_ptr_array_unref (profile->strings);
+
+  g_slice_free (TestPprofProfile, profile);
+}
+
+static const TestPprofLocation *
+test_pprof_profile_find_location (TestPprofProfile * profile,
+                                  const gchar * function_name)
+{
+  guint i, j;
+
+  for (i = 0; i != profile->functions->len; i++)
+  {
+    const TestPprofFunction * function =
+        &g_array_index (profile->functions, TestPprofFunction, i);
+
+    g_assert_cmpuint (function->name, <, profile->strings->len);
+    if (strcmp (g_ptr_array_index (profile->strings, function->name),
+        function_name) != 0)
+      continue;
+
+    for (j = 0; j != profile->locations->len; j++)
+    {
+      const TestPprofLocation * location =
+          &g_array_index (profile->locations, TestPprofLocation, j);
+
+      if (location->function_id == function->id)
+        return location;
+    }
+  }
+
+  return NULL;
+}
+
+static const TestPprofSample *
+test_pprof_profile_find_sample (TestPprofProfile * profile,
+                                guint depth,
+                                ...)
+{
+  guint i;
+
+  for (i = 0; i != profile->samples->len; i++)
+  {
+    const TestPprofSample * sample =
+        &g_array_index (profile->samples, TestPprofSample, i);
+    va_list args;
+    guint j;
+    gboolean matches;
+
+    if (sample->location_ids->len != depth)
+      continue;
+
+    va_start (args, depth);
+    matches = TRUE;
+    for (j = 0; j != depth && matches; j++)
+    {
+      const TestPprofLocation * location =
+          va_arg (args, const TestPprofLocation *);
+
+      matches = g_array_index (sample->location_ids, guint64, j) ==
+          location->id;
+    }
+    va_end (args);
+
+    if (matches)
+      return sample;
+  }
+
+  return NULL;
+}
+
 /*
  * Guinea pig functions:
  */
@@ -34,6 +34,8 @@ TESTLIST_BEGIN (profiler)
   REPORT_TESTENTRY (xml_multiple_threads)
   REPORT_TESTENTRY (xml_worst_case_info)
   REPORT_TESTENTRY (xml_thread_ordering)
+  REPORT_TESTENTRY (folded_stacks)
+  REPORT_TESTENTRY (pprof_basic)
 TESTLIST_END ()
 
 #ifdef HAVE_I386
@@ -294,6 +296,86 @@ REPORT_TESTCASE (xml_thread_ordering)
       "</ProfileReport>");
 }
 
+REPORT_TESTCASE (folded_stacks)
+{
+  GString * output;
+
+  instrument_example_functions (fixture);
+
+  example_a (fixture->fake_sampler);
+
+  output = g_string_new ("");
+  gum_profiler_emit_folded_stacks (fixture->profiler, append_to_string,
+      output);
+  g_assert_cmpstr (output->str, ==,
+      "example_a 5\n"
+      "example_a;example_c 4\n");
+  g_string_free (output, TRUE);
+
+  example_a (fixture->fake_sampler);
+
+  output = g_string_new ("");
+  gum_profiler_emit_folded_stacks (fixture->profiler, append_to_string,
+      output);
+  g_assert_cmpstr (output->str, ==,
+      "example_a 10\n"
+      "example_a;example_c 8\n");
+  g_string_free (output, TRUE);
+}
+
+REPORT_TESTCASE (pprof_basic)
+{
+  GString * output;
+  TestPprofProfile * profile;
+  const TestPprofLocation * loc_a, * loc_c;
+  const TestPprofSample * sample;
+
+  instrument_example_functions (fixture);
+
+  example_a (fixture->fake_sampler);
+
+  output = g_string_new ("");
+  gum_profiler_emit_pprof (fixture->profiler, append_to_string, output);
+
+  g_assert_cmpuint (output->len, >=, 2);
+  g_assert_cmphex ((guint8) output->str[0], ==, 0x32);
+  g_assert_cmphex ((guint8) output->str[1], ==, 0x00);
+  g_assert_nonnull (g_strstr_len (output->str, output->len, "example_a"));
+  g_assert_nonnull (g_strstr_len (output->str, output->len, "example_c"));
+  g_assert_null (g_strstr_len (output->str, output->len, "example_b"));
+
+  profile = test_pprof_profile_parse (output->str, output->len);
+
+  loc_a = test_pprof_profile_find_location (profile, "example_a");
+  g_assert_nonnull (loc_a);
+  g_assert_cmphex (loc_a->address, ==,
+      GPOINTER_TO_SIZE (GUM_FUNCPTR_TO_POINTER (example_a)));
+
+  loc_c = test_pprof_profile_find_location (profile, "example_c");
+  g_assert_nonnull (loc_c);
+  g_assert_cmphex (loc_c->address, ==,
+      GPOINTER_TO_SIZE (GUM_FUNCPTR_TO_POINTER (example_c)));
+  g_assert_cmpuint (loc_c->id, !=, loc_a->id);
+
+  g_assert_cmpuint (profile->samples->len, ==, 2);
+
+  sample = test_pprof_profile_find_sample (profile, 1, loc_a);
+  g_assert_nonnull (sample);
+  g_assert_cmpuint (sample->values->len, ==, 2);
+  g_assert_cmpuint (g_array_index (sample->values, guint64, 0), ==, 1);
+  g_assert_cmpuint (g_array_index (sample->values, guint64, 1), ==, 5);
+
+  /* Leaf first, as pprof expects. */
+  sample = test_pprof_profile_find_sample (profile, 2, loc_c, loc_a);
+  g_assert_nonnull (sample);
+  g_assert_cmpuint (sample->values->len, ==, 2);
+  g_assert_cmpuint (g_array_index (sample->values, guint64, 0), ==, 1);
+  g_assert_cmpuint (g_array_index (sample->values, guint64, 1), ==, 4);
+
+  test_pprof_profile_free (profile);
+  g_string_free (output, TRUE);
+}
+
 TESTCASE (profile_matching_functions)
 {
   gum_profiler_instrument_functions_matching (fixture->profiler, "simple_*",
@@ -6,21 +6,66 @@
 
 #include <gum/gum.h>
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+typedef struct _GumGraftContext GumGraftContext;
+
+struct _GumGraftContext
+{
+  GArray * offsets;
+  gboolean multiple_inputs;
+
+  GMutex mutex;
+  gint status;
+};
+
+static gboolean gum_parse_code_offsets (GArray * offsets, GError ** error);
+static GPtrArray * gum_collect_input_paths (GError ** error);
+static gboolean gum_add_input_path (GPtrArray * paths, GHashTable * seen,
+    const gchar * path, GError ** error);
+static void gum_graft_binary (gchar * input_path, GumGraftContext * ctx);
+static gint gum_graft_elf_binary (const gchar * input_path,
+    GumGraftContext * ctx, GError ** error);
+static gint gum_graft_darwin_binary (const gchar * input_path,
+    GumGraftContext * ctx, GError ** error);
+static void gum_graft_context_report_status (GumGraftContext * ctx,
+    gint status);
+static gboolean gum_is_elf_binary (const gchar * path);
+
 static gchar ** input_paths = NULL;
+static gchar * manifest_path = NULL;
+static gint num_jobs = 0;
 static gchar ** code_offsets = NULL;
+static gchar ** symbol_names = NULL;
+static gchar ** import_names = NULL;
 static gboolean ingest_function_starts = FALSE;
+static gboolean ingest_exports = FALSE;
 static gboolean ingest_imports = FALSE;
 static gboolean transform_lazy_binds = FALSE;
 
 static GOptionEntry options[] =
 {
   { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &input_paths,
-      "Mach-O binary to instrument", "BINARY" },
+      "Mach-O or ELF binary to instrument", "BINARY..." },
+  { "manifest", 'f', 0, G_OPTION_ARG_FILENAME, &manifest_path,
+      "Read binaries to instrument from FILE, one per line", "FILE" },
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, &num_jobs,
+      "Graft up to N binaries in parallel (default: number of CPUs)", "N" },
   { "instrument", 'i', 0, G_OPTION_ARG_STRING_ARRAY, &code_offsets,
       "Include instrumentation for a specific code offset", "0x1234" },
+  { "symbol", 'y', 0, G_OPTION_ARG_STRING_ARRAY, &symbol_names,
+      "Include instrumentation for a specific function symbol (ELF only)",
+      "NAME" },
+  { "import", 'I', 0, G_OPTION_ARG_STRING_ARRAY, &import_names,
+      "Include instrumentation for a specific import (ELF only)", "NAME" },
   { "ingest-function-starts", 's', 0, G_OPTION_ARG_NONE, &ingest_function_starts,
       "Include instrumentation for offsets retrieved from LC_FUNCTION_STARTS",
       NULL },
+  { "ingest-exports", 'e', 0, G_OPTION_ARG_NONE, &ingest_exports,
+      "Include instrumentation for exported functions (ELF only)", NULL },
   { "ingest-imports", 'm', 0, G_OPTION_ARG_NONE, &ingest_imports,
       "Include instrumentation for imports", NULL },
   { "transform-lazy-binds", 'z', 0, G_OPTION_ARG_NONE, &transform_lazy_binds,
@@ -33,14 +78,15 @@ main (int argc,
       char * argv[])
 {
   GOptionContext * context;
-  const gchar * input_path;
-  GumDarwinGrafterFlags flags;
-  GumDarwinGrafter * grafter;
-  GError * error;
+  GPtrArray * paths;
+  GumGraftContext ctx;
+  guint i;
+  GError * error = NULL;
 
   gum_init ();
 
-  context = g_option_context_new ("- graft instrumentation into Mach-O binaries");
+  context = g_option_context_new (
+      "- graft instrumentation into Mach-O and ELF binaries");
   g_option_context_add_main_entries (context, options, "gum-graft");
   if (!g_option_context_parse (context, &argc, &argv, &error))
   {
@@ -48,75 +94,323 @@ main (int argc,
     return 1;
   }
 
-  if (input_paths == NULL || g_strv_length (input_paths) != 1)
+  paths = gum_collect_input_paths (&error);
+  if (paths == NULL)
   {
-    g_printerr ("Usage: %s <path/to/binary>\n", argv[0]);
+    g_printerr ("%s\n", error->message);
+    return 1;
+  }
+
+  if (paths->len == 0)
+  {
+    g_printerr ("Usage: %s <path/to/binary>... | --manifest <path/to/list>\n",
+        argv[0]);
     return 2;
   }
-  input_path = input_paths[0];
 
-  flags = GUM_DARWIN_GRAFTER_FLAGS_NONE;
-  if (ingest_function_starts)
-    flags |= GUM_DARWIN_GRAFTER_FLAGS_INGEST_FUNCTION_STARTS;
-  if (ingest_imports)
-    flags |= GUM_DARWIN_GRAFTER_FLAGS_INGEST_IMPORTS;
-  if (transform_lazy_binds)
-    flags |= GUM_DARWIN_GRAFTER_FLAGS_TRANSFORM_LAZY_BINDS;
+  ctx.offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  if (!gum_parse_code_offsets (ctx.offsets, &error))
+  {
+    g_printerr ("%s\n", error->message);
+    return 3;
+  }
+  ctx.multiple_inputs = paths->len > 1;
+  g_mutex_init (&ctx.mutex);
+  ctx.status = 0;
 
-  grafter = gum_darwin_grafter_new_from_file (input_path, flags);
+  if (num_jobs <= 0)
+    num_jobs = g_get_num_processors ();
+  num_jobs = MIN (num_jobs, (gint) paths->len);
+
+  if (num_jobs == 1)
+  {
+    for (i = 0; i != paths->len; i++)
+      gum_graft_binary (g_ptr_array_index (paths, i), &ctx);
+  }
+  else
+  {
+    GThreadPool * pool;
+
+    /*
+     * Each binary is grafted in isolation, so the pool only needs to keep
+     * the workers busy. Inputs were de-duplicated up front, which means no
+     * two workers ever rewrite the same file.
+     */
+    pool = g_thread_pool_new ((GFunc) gum_graft_binary, &ctx, num_jobs, TRUE,
+        NULL);
+
+    for (i = 0; i != paths->len; i++)
+      g_thread_pool_push (pool, g_ptr_array_index (paths, i), NULL);
+
+    g_thread_pool_free (pool, FALSE, TRUE);
+  }
+
+  g_mutex_clear (&ctx.mutex);
+  g_array_unref (ctx.offsets);
+  g_ptr_array_unref (paths);
 
-  if (code_offsets != NULL)
+  return ctx.status;
+}
+
+static gboolean
+gum_parse_code_offsets (GArray * offsets,
+                        GError ** error)
+{
+  gchar * const * cursor;
+
+  if (code_offsets == NULL)
+    return TRUE;
+
+  for (cursor = code_offsets; *cursor != NULL; cursor++)
   {
-    gchar * const * cursor;
+    const gchar * raw_offset = *cursor;
+    guint base;
+    guint64 offset;
+    guint32 code_offset;
 
-    for (cursor = code_offsets; *cursor != NULL; cursor++)
+    if (g_str_has_prefix (raw_offset, "0x"))
     {
-      const gchar * raw_offset = *cursor;
-      guint base;
-      guint64 offset;
+      raw_offset += 2;
+      base = 16;
+    }
+    else
+    {
+      base = 10;
+    }
 
-      if (g_str_has_prefix (raw_offset, "0x"))
-      {
-        raw_offset += 2;
-        base = 16;
-      }
-      else
-      {
-        base = 10;
-      }
+    if (!g_ascii_string_to_unsigned (raw_offset, base, 4096, G_MAXUINT32,
+        &offset, error))
+    {
+      return FALSE;
+    }
 
-      if (!g_ascii_string_to_unsigned (raw_offset, base, 4096, G_MAXUINT32,
-          &offset, &error))
-      {
-        g_printerr ("%s\n", error->message);
-        return 3;
-      }
+    code_offset = offset;
+    g_array_append_val (offsets, code_offset);
+  }
 
-      if (offset % sizeof (guint32) != 0)
+  return TRUE;
+}
+
+static GPtrArray *
+gum_collect_input_paths (GError ** error)
+{
+  GPtrArray * paths;
+  GHashTable * seen;
+  gchar * const * cursor;
+  gchar * manifest = NULL;
+
+  paths = g_ptr_array_new_with_free_func (g_free);
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (cursor = input_paths; cursor != NULL && *cursor != NULL; cursor++)
+  {
+    if (!gum_add_input_path (paths, seen, *cursor, error))
+      goto failure;
+  }
+
+  if (manifest_path != NULL)
+  {
+    gchar ** lines, ** line;
+
+    if (!g_file_get_contents (manifest_path, &manifest, NULL, error))
+      goto failure;
+
+    lines = g_strsplit (manifest, "\n", -1);
+    for (line = lines; *line != NULL; line++)
+    {
+      const gchar * path = g_strstrip (*line);
+
+      if (path[0] == '\0' || path[0] == '#')
+        continue;
+
+      if (!gum_add_input_path (paths, seen, path, error))
       {
-        g_printerr ("%" G_GINT64_MODIFIER "x: Offset is not aligned on a "
-            "4-byte boundary\n", offset);
-        return 4;
+        g_strfreev (lines);
+        goto failure;
       }
-
-      gum_darwin_grafter_add (grafter, offset);
     }
+    g_strfreev (lines);
+  }
+
+  g_free (manifest);
+  g_hash_table_unref (seen);
+
+  return paths;
+
+failure:
+  {
+    g_free (manifest);
+    g_hash_table_unref (seen);
+    g_ptr_array_unref (paths);
+
+    return NULL;
+  }
+}
+
+static gboolean
+gum_add_input_path (GPtrArray * paths,
+                    GHashTable * seen,
+                    const gchar * path,
+                    GError ** error)
+{
+  GStatBuf st;
+  gchar * identity;
+
+  if (g_stat (path, &st) != 0)
+  {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "%s: %s", path, g_strerror (errno));
+    return FALSE;
+  }
+
+  /*
+   * App bundles tend to reach the same binary through several paths, e.g.
+   * Versions/Current symlinks. Grafting it twice would either race or hit
+   * the "Already grafted" path, so only keep the first path we see.
+   */
+  identity = g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+      (guint64) st.st_dev, (guint64) st.st_ino);
+  if (!g_hash_table_add (seen, identity))
+    return TRUE;
+
+  g_ptr_array_add (paths, g_strdup (path));
+
+  return TRUE;
+}
+
+static void
+gum_graft_binary (gchar * input_path,
+                  GumGraftContext * ctx)
+{
+  gint status;
+  GError * error = NULL;
+
+  if (gum_is_elf_binary (input_path))
+    status = gum_graft_elf_binary (input_path, ctx, &error);
+  else
+    status = gum_graft_darwin_binary (input_path, ctx, &error);
+
+  if (error == NULL)
+    return;
+
+  if (g_error_matches (error, GUM_ERROR, GUM_ERROR_EXISTS))
+  {
+    g_print ("%s: Already grafted. Assuming it contains the desired "
+        "instrumentation.\n", input_path);
   }
+  else
+  {
+    if (ctx->multiple_inputs)
+      g_printerr ("%s: %s\n", input_path, error->message);
+    else
+      g_printerr ("%s\n", error->message);
+
+    gum_graft_context_report_status (ctx, status);
+  }
+
+  g_error_free (error);
+}
+
+static gint
+gum_graft_elf_binary (const gchar * input_path,
+                      GumGraftContext * ctx,
+                      GError ** error)
+{
+  GumElfGrafterFlags flags;
+  GumElfGrafter * grafter;
+  guint i;
+  gchar * const * cursor;
+
+  flags = GUM_ELF_GRAFTER_FLAGS_NONE;
+  if (ingest_exports)
+    flags |= GUM_ELF_GRAFTER_FLAGS_INGEST_EXPORTS;
+  if (ingest_imports)
+    flags |= GUM_ELF_GRAFTER_FLAGS_INGEST_IMPORTS;
+
+  grafter = gum_elf_grafter_new_from_file (input_path, flags);
+
+  for (i = 0; i != ctx->offsets->len; i++)
+    gum_elf_grafter_add (grafter, g_array_index (ctx->offsets, guint32, i));
+
+  for (cursor = symbol_names; cursor != NULL && *cursor != NULL; cursor++)
+    gum_elf_grafter_add_symbol (grafter, *cursor);
+
+  for (cursor = import_names; cursor != NULL && *cursor != NULL; cursor++)
+    gum_elf_grafter_add_import (grafter, *cursor);
 
-  error = NULL;
-  gum_darwin_grafter_graft (grafter, &error);
-  if (error != NULL)
+  gum_elf_grafter_graft (grafter, error);
+
+  g_object_unref (grafter);
+
+  return 5;
+}
+
+static gint
+gum_graft_darwin_binary (const gchar * input_path,
+                         GumGraftContext * ctx,
+                         GError ** error)
+{
+  GumDarwinGrafterFlags flags;
+  GumDarwinGrafter * grafter;
+  guint i;
+
+  for (i = 0; i != ctx->offsets->len; i++)
   {
-    if (g_error_matches (error, GUM_ERROR, GUM_ERROR_EXISTS))
+    guint32 offset = g_array_index (ctx->offsets, guint32, i);
+
+    if (offset % sizeof (guint32) != 0)
     {
-      g_print ("%s: Already grafted. Assuming it contains the desired "
-          "instrumentation.\n", input_path);
-      return 0;
+      g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
+          "%x: Offset is not aligned on a 4-byte boundary", offset);
+      return 4;
     }
-
-    g_printerr ("%s\n", error->message);
-    return 5;
   }
 
-  return 0;
+  flags = GUM_DARWIN_GRAFTER_FLAGS_NONE;
+  if (ingest_function_starts)
+    flags |= GUM_DARWIN_GRAFTER_FLAGS_INGEST_FUNCTION_STARTS;
+  if (ingest_imports)
+    flags |= GUM_DARWIN_GRAFTER_FLAGS_INGEST_IMPORTS;
+  if (transform_lazy_binds)
+    flags |= GUM_DARWIN_GRAFTER_FLAGS_TRANSFORM_LAZY_BINDS;
+
+  grafter = gum_darwin_grafter_new_from_file (input_path, flags);
+
+  for (i = 0; i != ctx->offsets->len; i++)
+    gum_darwin_grafter_add (grafter, g_array_index (ctx->offsets, guint32, i));
+
+  gum_darwin_grafter_graft (grafter, error);
+
+  g_object_unref (grafter);
+
+  return 5;
+}
+
+static void
+gum_graft_context_report_status (GumGraftContext * ctx,
+                                 gint status)
+{
+  g_mutex_lock (&ctx->mutex);
+  if (ctx->status == 0)
+    ctx->status = status;
+  g_mutex_unlock (&ctx->mutex);
+}
+
+static gboolean
+gum_is_elf_binary (const gchar * path)
+{
+  gboolean is_elf = FALSE;
+  FILE * file;
+  guint8 magic[4];
+
+  file = fopen (path, "rb");
+  if (file == NULL)
+    return FALSE;
+
+  if (fread (magic, sizeof (magic), 1, file) == 1)
+    is_elf = memcmp (magic, "\x7f" "ELF", sizeof (magic)) == 0;
+
+  fclose (file);
+
+  return is_elf;
 }